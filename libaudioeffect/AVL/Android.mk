@@ -14,15 +14,27 @@ LOCAL_SHARED_LIBRARIES := \
 
 LOCAL_C_INCLUDES := \
     $(LOCAL_PATH) \
+    vendor/amlogic/frameworks/av/libaudioeffect/Utility \
     hardware/amlogic/audio/utils/ini/include \
     hardware/libhardware/include/hardware \
     hardware/libhardware/include \
     system/media/audio/include
 
 LOCAL_SRC_FILES += Avl.cpp
-
+LOCAL_SRC_FILES += ../Utility/ParamSnapshot.c
+LOCAL_SRC_FILES += ../Utility/AudioSilence.c
+LOCAL_SRC_FILES += ../Utility/AudioBypass.c
+
+# AVL_SOURCE_ENGINE := true runs the look-ahead leveler in Avl.cpp
+# instead of the prebuilt lib_aml_agc
+ifeq ($(AVL_SOURCE_ENGINE),true)
+LOCAL_CFLAGS += -DAVL_SOURCE_ENGINE
+LOCAL_SRC_FILES += ../Utility/AudioConvert.c
+else
 LOCAL_LDFLAGS_arm  += $(LOCAL_PATH)/lib_aml_agc.a
 LOCAL_LDFLAGS_arm64  += $(LOCAL_PATH)/lib_aml_agc64.a
+endif
+
 LOCAL_MULTILIB := both
 LOCAL_PRELINK_MODULE := false
 
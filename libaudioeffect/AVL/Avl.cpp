@@ -37,10 +37,26 @@
 
 #include "IniParser.h"
 #include "Avl.h"
+#include "ParamSnapshot.h"
+#ifdef AVL_SOURCE_ENGINE
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+#include <arm_neon.h>
+#define AVL_USE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define AVL_USE_SSE2
+#endif
+#endif
 
 extern "C"{
 
+#ifdef AVL_SOURCE_ENGINE
+#include "../Utility/AudioConvert.h"
+#else
 #include "aml_agc.h"
+#endif
+#include "../Utility/AudioSilence.h"
+#include "../Utility/AudioBypass.h"
 
 #define MODEL_SUM_DEFAULT_PATH "/vendor/etc/tvconfig/model/model_sum.ini"
 #define AUDIO_EFFECT_DEFAULT_PATH "/vendor/etc/tvconfig/audio/AMLOGIC_AUDIO_EFFECT_DEFAULT.ini"
@@ -76,6 +92,8 @@ typedef enum {
     AVL_PARAM_RESPONSE_TIME,
     AVL_PARAM_RELEASE_TIME,
     AVL_PARAM_SOURCE_IN,
+    AVL_PARAM_LOOKAHEAD_TIME,
+    AVL_PARAM_LATENCY, // query only: frames of delay of the look-ahead
 
 } Avlparams;
 
@@ -88,11 +106,11 @@ typedef struct Avlcfg_s{
     int response_time;
     /*in ms*/
     int release_time;
+    /*in ms, 0 for none*/
+    int lookahead_time;
 } Avlcfg;
 
 typedef struct Avldata_s {
-    /* avl API needed data */
-    void        *agc;
     Avlcfg      tbcfg;
     int32_t     enable;
     int32_t     *usr_cfg;
@@ -101,15 +119,411 @@ typedef struct Avldata_s {
     int32_t     soure_id;
 } Avldata;
 
+/* snapshot read by Avl_process */
+typedef struct Avlparam_s {
+    int32_t     enable;
+    Avlcfg      tbcfg;
+    /* bumped by EFFECT_CMD_RESET, the engine is reset by the audio thread */
+    uint32_t    reset_seq;
+} Avlparam;
+
+#define AVL_MAX_CHANNELS 8
+// frames between two gain updates
+#define AVL_BLOCK_FRAMES 32
+#define AVL_LOOKAHEAD_MAX_BLOCKS 32
+#define AVL_LOOKAHEAD_DEFAULT_MS 5
+// averaging time of the loudness detector
+#define AVL_RMS_MS 50
+// range of the leveling gain, in dB
+#define AVL_GAIN_MIN_DB -24.0f
+#define AVL_GAIN_MAX_DB 12.0f
+// gain ramp vectors of 4 samples repeat every lcm(4, channels) samples
+#define AVL_RAMP_MAX_VECTORS 7
+/* the longest look-ahead at 8 kHz plus the detector, after that the
+ * delay line holds zeros only */
+#define AVL_TAIL_MS 200
+
+#ifdef AVL_SOURCE_ENGINE
+
+/* Loudness leveler with a look-ahead peak limit, all channels linked.
+ * Every block of AVL_BLOCK_FRAMES the mean square of all channels is
+ * averaged over AVL_RMS_MS, and the gain that brings it to
+ * dynamic_threshold is followed in dB with the response time when it
+ * falls and the release time when it rises. The gain is held while the
+ * level is under noise_threshold. The output is delayed by the look-ahead,
+ * and the gain is also kept low enough for the delayed peaks to stay under
+ * peak_level. Gains ramp linearly over each block.
+ * Owned by the audio thread. */
+typedef struct Avlengine_s {
+    uint32_t    sample_rate;
+    int32_t     channels;
+    int32_t     active;
+    int32_t     lookahead_time;
+    int32_t     lookahead_blocks;
+    // one pole coefficients per block
+    float       average;
+    float       attack;
+    float       release;
+    float       peak_level;
+    float       dynamic_threshold;
+    float       noise_threshold;
+    // smoothed mean square and the leveling gain in dB
+    float       power;
+    float       level_gain;
+    // linear gains at the start and the end of the block being output
+    float       gain_prev;
+    float       gain_next;
+    // frames of the block being detected, also the position in it of the output
+    int32_t     fill;
+    float       block_peak;
+    float       block_energy;
+    // peaks of the blocks in the delay line
+    int32_t     peak_pos;
+    float       peaks[AVL_LOOKAHEAD_MAX_BLOCKS];
+    int32_t     delay_pos;
+    // frame offset of each sample of the ramp vectors
+    int32_t     ramp_vectors;
+    int32_t     ramp_frames;
+    float       ramp_pattern[AVL_RAMP_MAX_VECTORS * 4];
+    float       delay[AVL_LOOKAHEAD_MAX_BLOCKS * AVL_BLOCK_FRAMES * AVL_MAX_CHANNELS];
+    float       swap[AVL_BLOCK_FRAMES * AVL_MAX_CHANNELS];
+    float       work[AVL_BLOCK_FRAMES * AVL_MAX_CHANNELS];
+} Avlengine;
+
+static float Avl_time_coef(const Avlengine *eng, int ms)
+{
+    float frames = (float)ms * eng->sample_rate / 1000.0f;
+
+    if (frames < AVL_BLOCK_FRAMES)
+        return 0.0f;
+    return expf(-(float)AVL_BLOCK_FRAMES / frames);
+}
+
+static void Avl_engine_set(Avlengine *eng, const Avlcfg *tbcfg)
+{
+    eng->average = Avl_time_coef(eng, AVL_RMS_MS);
+    eng->attack = Avl_time_coef(eng, tbcfg->response_time);
+    eng->release = Avl_time_coef(eng, tbcfg->release_time);
+    eng->peak_level = tbcfg->peak_level;
+    eng->dynamic_threshold = tbcfg->dynamic_threshold;
+    eng->noise_threshold = tbcfg->noise_threshold;
+}
+
+/* unity gain, empty delay line */
+static void Avl_engine_reset(Avlengine *eng)
+{
+    eng->power = powf(10.0f, eng->dynamic_threshold / 10.0f);
+    eng->level_gain = 0.0f;
+    eng->gain_prev = 1.0f;
+    eng->gain_next = 1.0f;
+    eng->fill = 0;
+    eng->block_peak = 0.0f;
+    eng->block_energy = 0.0f;
+    eng->peak_pos = 0;
+    memset(eng->peaks, 0, sizeof(eng->peaks));
+    eng->delay_pos = 0;
+    memset(eng->delay, 0, sizeof(eng->delay));
+}
+
+// blocks of delay line for lookahead_time ms, also used for AVL_PARAM_LOOKAHEAD_TIME
+static int32_t Avl_lookahead_blocks(int32_t lookahead_time, uint32_t sample_rate)
+{
+    int32_t blocks;
+
+    // the gain at both ends of a block has to see its peak, 2 blocks at least
+    blocks = ((int64_t)lookahead_time * sample_rate / 1000 + AVL_BLOCK_FRAMES - 1) / AVL_BLOCK_FRAMES;
+    if (blocks > 0 && blocks < 2)
+        blocks = 2;
+    if (blocks > AVL_LOOKAHEAD_MAX_BLOCKS)
+        blocks = AVL_LOOKAHEAD_MAX_BLOCKS;
+    return blocks < 0 ? 0 : blocks;
+}
+
+static void Avl_engine_init(Avlengine *eng, uint32_t sample_rate, int32_t channels, const Avlcfg *tbcfg)
+{
+    int32_t period, i;
+
+    eng->sample_rate = sample_rate;
+    eng->channels = channels;
+    eng->lookahead_time = tbcfg->lookahead_time;
+    eng->lookahead_blocks = Avl_lookahead_blocks(tbcfg->lookahead_time, sample_rate);
+
+    for (period = 4; period % channels != 0; period += 4)
+        ;
+    eng->ramp_vectors = period / 4;
+    eng->ramp_frames = period / channels;
+    for (i = 0; i < period; i++)
+        eng->ramp_pattern[i] = (float)(i / channels);
+
+    Avl_engine_set(eng, tbcfg);
+    Avl_engine_reset(eng);
+    ALOGI("%s: %u Hz %d channels, look-ahead %d frames", __FUNCTION__, sample_rate, channels,
+            eng->lookahead_blocks * AVL_BLOCK_FRAMES);
+}
+
+// largest magnitude and sum of squares of the samples
+static void Avl_block_stats(const float *in, size_t samples, float *peak, float *energy)
+{
+    float p = *peak, e = *energy;
+    size_t i = 0;
+
+#if defined(AVL_USE_NEON)
+    float32x4_t vp = vdupq_n_f32(0.0f), ve = vdupq_n_f32(0.0f);
+    for (; i + 4 <= samples; i += 4) {
+        float32x4_t x = vld1q_f32(in + i);
+        vp = vmaxq_f32(vp, vabsq_f32(x));
+        ve = vmlaq_f32(ve, x, x);
+    }
+    float32x2_t p2 = vpmax_f32(vget_low_f32(vp), vget_high_f32(vp));
+    float32x2_t e2 = vadd_f32(vget_low_f32(ve), vget_high_f32(ve));
+    p2 = vpmax_f32(p2, p2);
+    e2 = vpadd_f32(e2, e2);
+    p = p > vget_lane_f32(p2, 0) ? p : vget_lane_f32(p2, 0);
+    e += vget_lane_f32(e2, 0);
+#elif defined(AVL_USE_SSE2)
+    const __m128 vabs = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 vp = _mm_setzero_ps(), ve = _mm_setzero_ps();
+    float t[4];
+    for (; i + 4 <= samples; i += 4) {
+        __m128 x = _mm_loadu_ps(in + i);
+        vp = _mm_max_ps(vp, _mm_and_ps(x, vabs));
+        ve = _mm_add_ps(ve, _mm_mul_ps(x, x));
+    }
+    vp = _mm_max_ps(vp, _mm_movehl_ps(vp, vp));
+    vp = _mm_max_ss(vp, _mm_shuffle_ps(vp, vp, 1));
+    _mm_storeu_ps(t, ve);
+    p = p > _mm_cvtss_f32(vp) ? p : _mm_cvtss_f32(vp);
+    e += t[0] + t[1] + t[2] + t[3];
+#endif
+    for (; i < samples; i++) {
+        float a = fabsf(in[i]);
+        p = p > a ? p : a;
+        e += in[i] * in[i];
+    }
+    *peak = p;
+    *energy = e;
+}
+
+/* gain of frame i is g0 + dg * i, every channel of the frame alike */
+static void Avl_apply_ramp(const Avlengine *eng, float *buf, size_t frames, float g0, float dg)
+{
+    size_t samples = frames * eng->channels;
+    size_t i = 0;
+    int32_t v = 0;
+    float base = g0;
+
+#if defined(AVL_USE_NEON)
+    for (; i + 4 <= samples; i += 4) {
+        float32x4_t g = vmlaq_n_f32(vdupq_n_f32(base), vld1q_f32(eng->ramp_pattern + v * 4), dg);
+        vst1q_f32(buf + i, vmulq_f32(vld1q_f32(buf + i), g));
+        if (++v == eng->ramp_vectors) {
+            v = 0;
+            base += dg * eng->ramp_frames;
+        }
+    }
+#elif defined(AVL_USE_SSE2)
+    __m128 vdg = _mm_set1_ps(dg);
+    for (; i + 4 <= samples; i += 4) {
+        __m128 g = _mm_add_ps(_mm_set1_ps(base), _mm_mul_ps(_mm_loadu_ps(eng->ramp_pattern + v * 4), vdg));
+        _mm_storeu_ps(buf + i, _mm_mul_ps(_mm_loadu_ps(buf + i), g));
+        if (++v == eng->ramp_vectors) {
+            v = 0;
+            base += dg * eng->ramp_frames;
+        }
+    }
+#endif
+    for (; i < samples; i++)
+        buf[i] *= g0 + dg * (float)(i / eng->channels);
+}
+
+/* end of a detected block: gains of the next block to be output */
+static void Avl_engine_update(Avlengine *eng)
+{
+    float ms = eng->block_energy / (AVL_BLOCK_FRAMES * eng->channels);
+    float level, gain, coef, peak = eng->block_peak;
+    int32_t i;
+
+    eng->power = ms + eng->average * (eng->power - ms);
+    level = 10.0f * log10f(eng->power + 1e-12f);
+    if (level >= eng->noise_threshold) {
+        gain = eng->dynamic_threshold - level;
+        gain = gain < AVL_GAIN_MIN_DB ? AVL_GAIN_MIN_DB : (gain > AVL_GAIN_MAX_DB ? AVL_GAIN_MAX_DB : gain);
+        coef = gain < eng->level_gain ? eng->attack : eng->release;
+        eng->level_gain = gain + coef * (eng->level_gain - gain);
+    }
+    gain = eng->level_gain;
+
+    // everything still in the delay line is output within the next blocks
+    if (eng->lookahead_blocks > 0) {
+        eng->peaks[eng->peak_pos] = eng->block_peak;
+        if (++eng->peak_pos == eng->lookahead_blocks)
+            eng->peak_pos = 0;
+        for (i = 0; i < eng->lookahead_blocks; i++)
+            peak = peak > eng->peaks[i] ? peak : eng->peaks[i];
+    }
+    if (peak > 0.0f && gain > eng->peak_level - 20.0f * log10f(peak))
+        gain = eng->peak_level - 20.0f * log10f(peak);
+
+    eng->gain_prev = eng->gain_next;
+    eng->gain_next = powf(10.0f, gain / 20.0f);
+    eng->block_peak = 0.0f;
+    eng->block_energy = 0.0f;
+    eng->fill = 0;
+}
+
+/* frames up to the end of the current block, in may be out */
+static void Avl_engine_run(Avlengine *eng, const float *in, float *out, size_t frames)
+{
+    size_t samples = frames * eng->channels;
+    float dg = (eng->gain_next - eng->gain_prev) / AVL_BLOCK_FRAMES;
+
+    Avl_block_stats(in, samples, &eng->block_peak, &eng->block_energy);
+    if (eng->lookahead_blocks > 0) {
+        float *delay = eng->delay + eng->delay_pos * eng->channels;
+        if (in == out) {
+            memcpy(eng->swap, in, samples * sizeof(float));
+            in = eng->swap;
+        }
+        memcpy(out, delay, samples * sizeof(float));
+        memcpy(delay, in, samples * sizeof(float));
+        eng->delay_pos += frames;
+        if (eng->delay_pos == eng->lookahead_blocks * AVL_BLOCK_FRAMES)
+            eng->delay_pos = 0;
+    } else if (in != out) {
+        memcpy(out, in, samples * sizeof(float));
+    }
+    Avl_apply_ramp(eng, out, frames, eng->gain_prev + dg * eng->fill, dg);
+
+    eng->fill += frames;
+    if (eng->fill == AVL_BLOCK_FRAMES)
+        Avl_engine_update(eng);
+}
+
+static void Avl_engine_process(Avlengine *eng, const int16_t *in, int16_t *out, size_t frames)
+{
+    size_t n;
+
+    while (frames > 0) {
+        n = AVL_BLOCK_FRAMES - eng->fill;
+        n = frames < n ? frames : n;
+        AudioConvertS16ToFloat(in, eng->work, n * eng->channels);
+        Avl_engine_run(eng, eng->work, eng->work, n);
+        AudioConvertFloatToS16(eng->work, out, n * eng->channels);
+        in += n * eng->channels;
+        out += n * eng->channels;
+        frames -= n;
+    }
+}
+
+static void Avl_engine_process_float(Avlengine *eng, const float *in, float *out, size_t frames)
+{
+    size_t n;
+
+    while (frames > 0) {
+        n = AVL_BLOCK_FRAMES - eng->fill;
+        n = frames < n ? frames : n;
+        Avl_engine_run(eng, in, out, n);
+        in += n * eng->channels;
+        out += n * eng->channels;
+        frames -= n;
+    }
+}
+
+#else
+
+/* The prebuilt lib_aml_agc: 16 bit stereo only, no look-ahead. It stays
+ * the default until the source leveler has been compared with it. */
+typedef struct Avlengine_s {
+    void        *agc;
+    uint32_t    sample_rate;
+    int32_t     channels;
+    int32_t     active;
+    int32_t     lookahead_time;
+    int32_t     lookahead_blocks;
+} Avlengine;
+
+// the archive has no delay line
+static int32_t Avl_lookahead_blocks(int32_t lookahead_time __unused, uint32_t sample_rate __unused)
+{
+    return 0;
+}
+
+static void Avl_engine_set(Avlengine *eng, const Avlcfg *tbcfg)
+{
+    SetAmlAGC(eng->agc, tbcfg->peak_level, tbcfg->dynamic_threshold,
+        tbcfg->noise_threshold, tbcfg->response_time, tbcfg->release_time);
+}
+
+// the archive has no reset, its state carries over
+static void Avl_engine_reset(Avlengine *eng __unused)
+{
+}
+
+static void Avl_engine_init(Avlengine *eng, uint32_t sample_rate, int32_t channels, const Avlcfg *tbcfg)
+{
+    eng->sample_rate = sample_rate;
+    eng->channels = channels;
+    eng->lookahead_time = tbcfg->lookahead_time;
+    eng->lookahead_blocks = 0;
+    Avl_engine_set(eng, tbcfg);
+}
+
+static void Avl_engine_process(Avlengine *eng, const int16_t *in, int16_t *out, size_t frames)
+{
+    if (in != out)
+        memcpy(out, in, frames * eng->channels * sizeof(int16_t));
+    DoAmlAGC(eng->agc, (void *)out, (int)(frames * eng->channels));
+}
+
+#endif
+
 typedef struct AvlContext_s {
     const struct effect_interface_s *itfe;
     effect_config_t                 config;
     Avl_state_e                    state;
     Avldata                        gAvldata;
+    ParamSnapshot_t                params;
+    uint32_t                       reset_seq;      // control thread
+    // delay in frames read by AVL_PARAM_LATENCY, written by the audio thread
+    int32_t                        latency;
+    // owned by the audio thread
+    uint32_t                       reset_seq_done;
+    Avlengine                      engine;
+    AudioSilence_t                 silence;
+    AudioAccumulate_t              accumulate;
 } AvlContext;
 
 const char *AvlStatusstr[] = {"Disable", "Enable"};
 
+static void Avl_get_params(AvlContext *pContext, Avlparam *params)
+{
+    Avldata *data = &pContext->gAvldata;
+
+    params->enable = data->enable;
+    params->tbcfg = data->tbcfg;
+    params->reset_seq = pContext->reset_seq;
+}
+
+/* hand the current settings to the audio thread, the engine is set there */
+static void Avl_publish(AvlContext *pContext)
+{
+    Avlparam params;
+
+    Avl_get_params(pContext, &params);
+    ParamSnapshotPublish(&pContext->params, &params);
+}
+
+// audio thread: make the delay of this block visible to AVL_PARAM_LATENCY
+static void Avl_publish_latency(AvlContext *pContext, int active)
+{
+    int32_t latency = active ? pContext->engine.lookahead_blocks * AVL_BLOCK_FRAMES : 0;
+
+    if (latency != __atomic_load_n(&pContext->latency, __ATOMIC_RELAXED)) {
+        ALOGI("%s: latency %d frames", __FUNCTION__, latency);
+        __atomic_store_n(&pContext->latency, latency, __ATOMIC_RELAXED);
+    }
+}
+
 int Avl_get_model_name(char *model_name, int size)
 {
     int ret = -1;
@@ -233,6 +647,12 @@ int Avl_load_ini_file(AvlContext *pContext)
     if (result != 0)
         goto error;
 
+    ini_value = pIniParser->GetString("Avl", "avl_lookahead", "5");
+    if (ini_value == NULL)
+        goto error;
+    ALOGD("%s: lookahead -> %s ms", __FUNCTION__, ini_value);
+    data->tbcfg.lookahead_time = atoi(ini_value);
+
     ALOGD("%s: %s", __FUNCTION__, result == 0 ? "sucessful" : "failed");
     delete pIniParser;
     pIniParser = NULL;
@@ -250,6 +670,7 @@ error:
     pContext->gAvldata.tbcfg.noise_threshold = -60;
     pContext->gAvldata.tbcfg.response_time = 100;
     pContext->gAvldata.tbcfg.release_time = 3000;
+    pContext->gAvldata.tbcfg.lookahead_time = AVL_LOOKAHEAD_DEFAULT_MS;
 
     return result;
 }
@@ -275,17 +696,8 @@ int Avl_init(AvlContext *pContext)
     pContext->config.outputCfg.bufferProvider.cookie = NULL;
     pContext->config.outputCfg.mask = EFFECT_CONFIG_ALL;
 
-    DeleteAmlAGC(data->agc);
-    if (data->agc == NULL) {
-        data->agc = NewAmlAGC();
-        SetAmlAGC(data->agc, data->tbcfg.peak_level, data->tbcfg.dynamic_threshold,
-            data->tbcfg.noise_threshold, data->tbcfg.response_time, data->tbcfg.release_time);
-
-        ALOGI("Avl_init! peak_level = %fdB, dynamic_theshold = %fdB, noise_threshold = %fdB\n",
-            data->tbcfg.peak_level, data->tbcfg.dynamic_threshold, data->tbcfg.noise_threshold);
-    } else {
-        ALOGE("%s, AGC is exist\n", __FUNCTION__);
-    }
+    ALOGI("Avl_init! peak_level = %fdB, dynamic_theshold = %fdB, noise_threshold = %fdB\n",
+        data->tbcfg.peak_level, data->tbcfg.dynamic_threshold, data->tbcfg.noise_threshold);
 
     ALOGD("%s: sucessful", __FUNCTION__);
     return 0;
@@ -300,7 +712,12 @@ int Avl_configure(AvlContext *pContext, effect_config_t *pConfig)
         return -EINVAL;
     if (pConfig->inputCfg.format != pConfig->outputCfg.format)
         return -EINVAL;
+#ifdef AVL_SOURCE_ENGINE
+    if (audio_channel_count_from_out_mask(pConfig->inputCfg.channels) == 0 ||
+        audio_channel_count_from_out_mask(pConfig->inputCfg.channels) > AVL_MAX_CHANNELS) {
+#else
     if (pConfig->inputCfg.channels != AUDIO_CHANNEL_OUT_STEREO) {
+#endif
         ALOGW("%s: channels in = 0x%x channels out = 0x%x", __FUNCTION__,
             pConfig->inputCfg.channels, pConfig->outputCfg.channels);
         pConfig->inputCfg.channels = pConfig->outputCfg.channels = AUDIO_CHANNEL_OUT_STEREO;
@@ -308,7 +725,12 @@ int Avl_configure(AvlContext *pContext, effect_config_t *pConfig)
     if (pConfig->outputCfg.accessMode != EFFECT_BUFFER_ACCESS_WRITE &&
         pConfig->outputCfg.accessMode != EFFECT_BUFFER_ACCESS_ACCUMULATE)
         return -EINVAL;
+#ifdef AVL_SOURCE_ENGINE
+    if (pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT &&
+        pConfig->inputCfg.format != AUDIO_FORMAT_PCM_FLOAT) {
+#else
     if (pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT) {
+#endif
         ALOGW("%s: format in = 0x%x format out = 0x%x", __FUNCTION__,
             pConfig->inputCfg.format, pConfig->outputCfg.format);
         pConfig->inputCfg.format = pConfig->outputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
@@ -329,41 +751,37 @@ int Avl_setParameter(AvlContext *pContext, void *pParam, void *pValue)
        case AVL_PARAM_PEAK_LEVEL:
             value = *(int32_t *)pValue;
             tbcfg->peak_level = (float)value;
-            SetAmlAGC(data->agc,tbcfg->peak_level, tbcfg->dynamic_threshold,
-                tbcfg->noise_threshold, tbcfg->response_time,tbcfg->release_time);
+            Avl_publish(pContext);
             ALOGD("%s: set peak_level -> %f ", __FUNCTION__, tbcfg->peak_level);
             break;
        case AVL_PARAM_DYNAMIC_THRESHOLD:
             value = *(int32_t *)pValue;
             tbcfg->dynamic_threshold = (float)value;
-            SetAmlAGC(data->agc,tbcfg->peak_level, tbcfg->dynamic_threshold,
-                tbcfg->noise_threshold, tbcfg->response_time,tbcfg->release_time);
+            Avl_publish(pContext);
             ALOGD("%s: set dynamic_threshold -> %f ", __FUNCTION__, tbcfg->dynamic_threshold);
             break;
        case AVL_PARAM_NOISE_THRESHOLD :
             value = *(int32_t *)pValue;
             tbcfg->noise_threshold = (float)value;
-            SetAmlAGC(data->agc,tbcfg->peak_level, tbcfg->dynamic_threshold,
-                tbcfg->noise_threshold, tbcfg->response_time,tbcfg->release_time);
+            Avl_publish(pContext);
             ALOGD("%s: set noise_threshold -> %f ", __FUNCTION__, tbcfg->noise_threshold);
             break;
        case AVL_PARAM_RESPONSE_TIME:
             value = *(int32_t *)pValue;
             tbcfg->response_time = value / 48; // UI set sample
-            SetAmlAGC(data->agc,tbcfg->peak_level, tbcfg->dynamic_threshold,
-                tbcfg->noise_threshold, tbcfg->response_time,tbcfg->release_time);
+            Avl_publish(pContext);
             ALOGD("%s: set response_time-> %d ", __FUNCTION__, tbcfg->response_time);
             break;
        case AVL_PARAM_ENABLE:
             value = *(int32_t *)pValue;
             data->enable = value;
+            Avl_publish(pContext);
             ALOGD("%s: Set status -> %s", __FUNCTION__, AvlStatusstr[value]);
             break;
        case AVL_PARAM_RELEASE_TIME:
             value = *(int32_t *)pValue;
             tbcfg->release_time = value * 1000; // UI set s, here change s to ms
-            SetAmlAGC(data->agc,tbcfg->peak_level, tbcfg->dynamic_threshold,
-                tbcfg->noise_threshold, tbcfg->response_time,tbcfg->release_time);
+            Avl_publish(pContext);
             ALOGD("%s: set release_time-> %d ", __FUNCTION__, tbcfg->release_time);
             break;
        case AVL_PARAM_SOURCE_IN:
@@ -375,6 +793,16 @@ int Avl_setParameter(AvlContext *pContext, void *pParam, void *pValue)
             data->soure_id = value;
             ALOGD("%s: Set source_id -> %d", __FUNCTION__, value);
             break;
+       case AVL_PARAM_LOOKAHEAD_TIME:
+            value = *(int32_t *)pValue;
+            if (value < 0) {
+                ALOGE("%s: incorrect lookahead %d", __FUNCTION__, value);
+                return -EINVAL;
+            }
+            tbcfg->lookahead_time = value;
+            Avl_publish(pContext);
+            ALOGD("%s: set lookahead_time -> %d ms", __FUNCTION__, tbcfg->lookahead_time);
+            break;
        default:
             ALOGE("%s: unknown param %08x", __FUNCTION__, param);
             return -EINVAL;
@@ -386,6 +814,7 @@ int Avl_getParameter(AvlContext*pContext, void *pParam, size_t *pValueSize, void
 {
     int32_t param = *(int32_t *)pParam;
     int32_t value;
+    uint32_t rate;
     Avldata *data=&pContext->gAvldata;
     Avlcfg *tbcfg=&data->tbcfg;
 
@@ -452,6 +881,26 @@ int Avl_getParameter(AvlContext*pContext, void *pParam, size_t *pValueSize, void
         *(int32_t *) pValue = value;
         ALOGD("%s: Get aource_id -> %d", __FUNCTION__, value);
         break;
+    case AVL_PARAM_LOOKAHEAD_TIME:
+        if (*pValueSize < sizeof(int32_t)) {
+            *pValueSize = 0;
+            return -EINVAL;
+        }
+        // what the delay line holds at the current rate, 1024 frames at most
+        rate = pContext->config.inputCfg.samplingRate ? pContext->config.inputCfg.samplingRate : 48000;
+        value = Avl_lookahead_blocks(tbcfg->lookahead_time, rate) * AVL_BLOCK_FRAMES * 1000 / rate;
+        *(int32_t *) pValue = value;
+        ALOGD("%s: Get lookahead_time -> %d ms (set %d ms)", __FUNCTION__, value, tbcfg->lookahead_time);
+        break;
+    case AVL_PARAM_LATENCY:
+        if (*pValueSize < sizeof(int32_t)) {
+            *pValueSize = 0;
+            return -EINVAL;
+        }
+        value = __atomic_load_n(&pContext->latency, __ATOMIC_RELAXED);
+        *(int32_t *) pValue = value;
+        ALOGD("%s: Get latency -> %d frames", __FUNCTION__, value);
+        break;
     default:
         ALOGE("%s: unknown param %d", __FUNCTION__, param);
         return -EINVAL;
@@ -463,12 +912,17 @@ int Avl_release(AvlContext *pContext)
 {
     Avldata *data = &pContext->gAvldata;
 
-    DeleteAmlAGC(data->agc);
-
     if (data->usr_cfg != NULL) {
         free(data->usr_cfg);
         data->usr_cfg = NULL;
     }
+#ifndef AVL_SOURCE_ENGINE
+    if (pContext->engine.agc != NULL) {
+        DeleteAmlAGC(pContext->engine.agc);
+        pContext->engine.agc = NULL;
+    }
+#endif
+    ParamSnapshotRelease(&pContext->params);
 
     return 0;
 }
@@ -490,18 +944,51 @@ int Avl_process(effect_handle_t self, audio_buffer_t *inBuffer, audio_buffer_t *
     if (pContext->state != AVL_STATE_ACTIVE)
         return -ENODATA;
 
-    int16_t *in  = (int16_t *)inBuffer->raw;
-    int16_t *out = (int16_t *)outBuffer->raw;
-    Avldata*data = &pContext->gAvldata;
-
-    if (!data->enable) {
-        for (size_t i = 0; i < inBuffer->frameCount; i++) {
-            *out++ = *in++;
-            *out++ = *in++;
-        }
-    } else {
-        DoAmlAGC(data->agc, (void *)in, (inBuffer->frameCount) << 1);
+    Avlengine *eng = &pContext->engine;
+    uint32_t sample_rate = pContext->config.inputCfg.samplingRate;
+    int32_t channels = audio_channel_count_from_out_mask(pContext->config.inputCfg.channels);
+    int is_float = pContext->config.inputCfg.format == AUDIO_FORMAT_PCM_FLOAT;
+    size_t frame_size = channels * (is_float ? sizeof(float) : sizeof(int16_t));
+    int accumulate = AudioAccumulateNeeded(&pContext->accumulate, &pContext->config, inBuffer, outBuffer);
+    int changed;
+    const Avlparam *params = (const Avlparam *)ParamSnapshotAcquire(&pContext->params, &changed);
+
+    if (eng->sample_rate != sample_rate || eng->channels != channels ||
+        params->tbcfg.lookahead_time != eng->lookahead_time) {
+        // new layout or look-ahead, the delay line starts over
+        Avl_engine_init(eng, sample_rate, channels, &params->tbcfg);
+    } else if (changed) {
+        Avl_engine_set(eng, &params->tbcfg);
+    }
+    if (params->reset_seq != pContext->reset_seq_done) {
+        pContext->reset_seq_done = params->reset_seq;
+        Avl_engine_reset(eng);
+    }
+    if (!params->enable) {
+        eng->active = 0;
+        Avl_publish_latency(pContext, 0);
+        AudioBypass(&pContext->config, accumulate, inBuffer, outBuffer);
+        return 0;
+    }
+    if (accumulate)
+        return AudioAccumulateProcess(&pContext->accumulate, self, &pContext->config, inBuffer, outBuffer);
+    if (!eng->active) {
+        // the delay line holds stale audio from before the bypass
+        Avl_engine_reset(eng);
+        eng->active = 1;
     }
+    if (AudioSilenceDetect(&pContext->silence, inBuffer->raw, inBuffer->frameCount, frame_size, sample_rate)) {
+        // silent past the tail, the delay line and the detector are drained
+        AudioBypass(&pContext->config, 0, inBuffer, outBuffer);
+        return 0;
+    }
+#ifdef AVL_SOURCE_ENGINE
+    if (is_float)
+        Avl_engine_process_float(eng, (const float *)inBuffer->raw, (float *)outBuffer->raw, inBuffer->frameCount);
+    else
+#endif
+        Avl_engine_process(eng, (const int16_t *)inBuffer->raw, (int16_t *)outBuffer->raw, inBuffer->frameCount);
+    Avl_publish_latency(pContext, 1);
 
     return 0;
 }
@@ -530,6 +1017,9 @@ int Avl_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
         *(int *) pReplyData = Avl_configure(pContext, (effect_config_t *) pCmdData);
         break;
     case EFFECT_CMD_RESET:
+        // the engine belongs to the audio thread, reset there
+        pContext->reset_seq++;
+        Avl_publish(pContext);
         break;
     case EFFECT_CMD_ENABLE:
         if (pReplyData == NULL || replySize == NULL || *replySize != sizeof(int))
@@ -626,6 +1116,23 @@ int AvlLib_Create(const effect_uuid_t * uuid, int32_t sessionId __unused, int32_
         ALOGE("%s: Load INI File faied, use default param", __FUNCTION__);
         pContext->gAvldata.enable = 0;
     }
+    Avlparam params;
+    Avl_get_params(pContext, &params);
+    if (ParamSnapshotInit(&pContext->params, &params, sizeof(Avlparam)) < 0) {
+        Avl_release(pContext);
+        delete pContext;
+        return -EINVAL;
+    }
+#ifndef AVL_SOURCE_ENGINE
+    pContext->engine.agc = NewAmlAGC();
+    if (pContext->engine.agc == NULL) {
+        ALOGE("%s: NewAmlAGC failed", __FUNCTION__);
+        Avl_release(pContext);
+        delete pContext;
+        return -EINVAL;
+    }
+#endif
+    AudioSilenceInit(&pContext->silence, AVL_TAIL_MS);
 
     pContext->itfe = &AvlInterface;
     pContext->state = AVL_STATE_UNINITIALIZED;
@@ -16,12 +16,16 @@ LOCAL_SHARED_LIBRARIES := \
 
 LOCAL_C_INCLUDES := \
     $(LOCAL_PATH) \
+    vendor/amlogic/frameworks/av/libaudioeffect/Utility \
     hardware/amlogic/audio/utils/ini/include \
     hardware/libhardware/include/hardware \
     hardware/libhardware/include \
     system/media/audio/include
 
 LOCAL_SRC_FILES := Balance.cpp
+LOCAL_SRC_FILES += ../Utility/ParamSnapshot.c
+LOCAL_SRC_FILES += ../Utility/AudioSilence.c
+LOCAL_SRC_FILES += ../Utility/AudioBypass.c
 LOCAL_PRELINK_MODULE := false
 
 LOCAL_LDLIBS   +=  -llog
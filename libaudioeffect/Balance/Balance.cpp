@@ -34,9 +34,19 @@
 #include <cutils/properties.h>
 #include <stdio.h>
 #include <unistd.h>
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+#include <arm_neon.h>
+#define BALANCE_USE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define BALANCE_USE_SSE2
+#endif
 
 #include "IniParser.h"
 #include "Balance.h"
+#include "ParamSnapshot.h"
+#include "AudioSilence.h"
+#include "AudioBypass.h"
 
 extern "C" {
 
@@ -77,20 +87,57 @@ typedef struct Balancecfg_s {
     float   *level;
 } Balancecfg;
 
+#define BALANCE_MAX_CHANNELS    8
+/* per-sample gain pattern, one pattern covers lcm(channels, vector lanes) samples */
+#define BALANCE_PATTERN_MAX     24
+
 typedef struct Balancedata_s {
     Balancecfg  usr_cfg;
+    /* usr_cfg.level[] in Q15, BALANCE_Q15_UNITY means no attenuation */
+    int32_t     *level_q15;
     int32_t     enable;
     int32_t     index;
 } Balancedata;
 
+/* what Balance_process needs, derived by Balance_update_gains() and
+ * handed to the audio thread as an immutable snapshot */
+typedef struct Balancegains_s {
+    int32_t     channels;
+    int32_t     is_float;
+    int32_t     bypass;
+    int32_t     pattern_len_q15;
+    int32_t     pattern_len_f32;
+    int16_t     gain_q15[BALANCE_PATTERN_MAX];
+    uint16_t    mask_q15[BALANCE_PATTERN_MAX];
+    float       gain_f32[BALANCE_PATTERN_MAX];
+} Balancegains;
+
 typedef struct BalanceContext_s{
     const struct effect_interface_s *itfe;
     effect_config_t                 config;
     balance_state_e                 state;
     Balancedata                     gBalancedata;
+    ParamSnapshot_t                 gains;
+    // owned by the audio thread
+    AudioSilence_t                  silence;
+    AudioAccumulate_t               accumulate;
 } BalanceContext;
 
 #define LSR (1)
+#define BALANCE_Q15_SHIFT   (15)
+#define BALANCE_Q15_UNITY   (1 << BALANCE_Q15_SHIFT)
+
+#define BALANCE_LEFT_CHANNELS   (AUDIO_CHANNEL_OUT_FRONT_LEFT | AUDIO_CHANNEL_OUT_BACK_LEFT | \
+                                 AUDIO_CHANNEL_OUT_SIDE_LEFT | AUDIO_CHANNEL_OUT_FRONT_LEFT_OF_CENTER)
+#define BALANCE_RIGHT_CHANNELS  (AUDIO_CHANNEL_OUT_FRONT_RIGHT | AUDIO_CHANNEL_OUT_BACK_RIGHT | \
+                                 AUDIO_CHANNEL_OUT_SIDE_RIGHT | AUDIO_CHANNEL_OUT_FRONT_RIGHT_OF_CENTER)
+
+typedef enum {
+    BALANCE_KERNEL_BYPASS,
+    BALANCE_KERNEL_Q15,
+    BALANCE_KERNEL_FLOAT,
+} balance_kernel_e;
+
 /*Absolute min volume in dB (can be represented in single precision normal float value)*/
 float default_level[] = {
     -50.0, -48.0, -46.0, -44.0, -42.0,  /*0-4*/
@@ -197,6 +244,91 @@ int Balance_parse_level(BalanceContext *pContext, int num, const char *buffer)
     return 0;
 }
 
+int Balance_init_level_q15(BalanceContext *pContext)
+{
+    int i;
+    Balancedata *data = &pContext->gBalancedata;
+
+    if (data->level_q15 != NULL)
+        free(data->level_q15);
+    data->level_q15 = (int32_t *)calloc(data->usr_cfg.num, sizeof(int32_t));
+    if (!data->level_q15) {
+        ALOGE("%s: alloc failed", __FUNCTION__);
+        return -EINVAL;
+    }
+
+    /* balance only ever attenuates, gains at or above 0dB become bypass */
+    for (i = 0; i < data->usr_cfg.num; i++) {
+        float level = data->usr_cfg.level[i];
+        if (level >= 1.0f)
+            data->level_q15[i] = BALANCE_Q15_UNITY;
+        else if (level <= 0.0f)
+            data->level_q15[i] = 0;
+        else
+            data->level_q15[i] = (int32_t)(level * BALANCE_Q15_UNITY + 0.5f);
+    }
+
+    return 0;
+}
+
+static int Balance_gcd(int a, int b)
+{
+    while (b) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* rebuild the per-channel gain patterns from the balance index and channel mask */
+static void Balance_build_gains(BalanceContext *pContext, Balancegains *gains)
+{
+    Balancedata *data = &pContext->gBalancedata;
+    uint32_t mask = pContext->config.inputCfg.channels;
+    int32_t val = data->index;
+    int32_t gain = data->level_q15[val];
+    uint32_t attenuated;
+    int32_t ch_gain[BALANCE_MAX_CHANNELS];
+    int ch, i;
+
+    memset(gains, 0, sizeof(Balancegains));
+    /* left of center attenuates the right side and vice versa */
+    attenuated = (val < (data->usr_cfg.num >> LSR)) ? BALANCE_RIGHT_CHANNELS : BALANCE_LEFT_CHANNELS;
+    gains->channels = audio_channel_count_from_out_mask(mask);
+    gains->is_float = pContext->config.inputCfg.format == AUDIO_FORMAT_PCM_FLOAT;
+    gains->bypass = !data->enable || gain >= BALANCE_Q15_UNITY || gains->channels == 0;
+    if (gains->channels == 0)
+        return;
+
+    ch = 0;
+    for (uint32_t bit = 1; bit != 0 && ch < gains->channels; bit <<= 1) {
+        if (!(mask & bit))
+            continue;
+        ch_gain[ch++] = (bit & attenuated) ? gain : BALANCE_Q15_UNITY;
+    }
+
+    gains->pattern_len_q15 = gains->channels * 8 / Balance_gcd(gains->channels, 8);
+    gains->pattern_len_f32 = gains->channels * 4 / Balance_gcd(gains->channels, 4);
+    for (i = 0; i < gains->pattern_len_q15; i++) {
+        int32_t g = ch_gain[i % gains->channels];
+        gains->gain_q15[i] = (g >= BALANCE_Q15_UNITY) ? 0x7fff : g;
+        gains->mask_q15[i] = (g >= BALANCE_Q15_UNITY) ? 0 : 0xffff;
+    }
+    for (i = 0; i < gains->pattern_len_f32; i++) {
+        int32_t g = ch_gain[i % gains->channels];
+        gains->gain_f32[i] = (g >= BALANCE_Q15_UNITY) ? 1.0f : data->usr_cfg.level[val];
+    }
+}
+
+void Balance_update_gains(BalanceContext *pContext)
+{
+    Balancegains gains;
+
+    Balance_build_gains(pContext, &gains);
+    ParamSnapshotPublish(&pContext->gains, &gains);
+}
+
 int Balance_load_ini_file(BalanceContext *pContext)
 {
     int result = -1;
@@ -265,6 +397,7 @@ int Balance_init(BalanceContext *pContext)
     pContext->config.outputCfg.mask = EFFECT_CONFIG_ALL;
 
     data->index = (num>>LSR);
+    Balance_update_gains(pContext);
 
     ALOGD("%s: sucessful", __FUNCTION__);
 
@@ -284,19 +417,23 @@ int Balance_configure(BalanceContext *pContext, effect_config_t *pConfig)
         return -EINVAL;
     if (pConfig->inputCfg.format != pConfig->outputCfg.format)
         return -EINVAL;
-    if (pConfig->inputCfg.channels != AUDIO_CHANNEL_OUT_STEREO) {
+    if (pConfig->inputCfg.channels != AUDIO_CHANNEL_OUT_STEREO &&
+            pConfig->inputCfg.channels != AUDIO_CHANNEL_OUT_5POINT1 &&
+            pConfig->inputCfg.channels != AUDIO_CHANNEL_OUT_7POINT1) {
         ALOGW("%s: channels in = 0x%x channels out = 0x%x", __FUNCTION__, pConfig->inputCfg.channels, pConfig->outputCfg.channels);
         pConfig->inputCfg.channels = pConfig->outputCfg.channels = AUDIO_CHANNEL_OUT_STEREO;
     }
     if (pConfig->outputCfg.accessMode != EFFECT_BUFFER_ACCESS_WRITE &&
             pConfig->outputCfg.accessMode != EFFECT_BUFFER_ACCESS_ACCUMULATE)
         return -EINVAL;
-    if (pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT) {
+    if (pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT &&
+            pConfig->inputCfg.format != AUDIO_FORMAT_PCM_FLOAT) {
         ALOGW("%s: format in = 0x%x format out = 0x%x", __FUNCTION__, pConfig->inputCfg.format, pConfig->outputCfg.format);
         pConfig->inputCfg.format = pConfig->outputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
     }
 
     memcpy(&pContext->config, pConfig, sizeof(effect_config_t));
+    Balance_update_gains(pContext);
 
     return 0;
 }
@@ -365,11 +502,13 @@ int Balance_setParameter(BalanceContext *pContext, void *pParam, void *pValue)
         else if (value < 0)
             value = 0;
         data->index = value;
+        Balance_update_gains(pContext);
         ALOGD("%s: Set Balance Gain %d -> %f", __FUNCTION__, value, data->usr_cfg.level[value]);
         break;
     case BALANCE_PARAM_ENABLE:
         value = *(int32_t *)pValue;
         data->enable = value;
+        Balance_update_gains(pContext);
 
         ALOGD("%s: Set status -> %s", __FUNCTION__, BalanceStatusstr[value]);
         break;
@@ -389,10 +528,98 @@ int Balance_release(BalanceContext *pContext)
         free(data->usr_cfg.level);
         data->usr_cfg.level = NULL;
     }
+    if (data->level_q15 != NULL) {
+        free(data->level_q15);
+        data->level_q15 = NULL;
+    }
+    ParamSnapshotRelease(&pContext->gains);
 
     return 0;
 }
 
+/* int16 samples scaled by the Q15 gain pattern (rounded), 8 samples per vector */
+static void Balance_process_q15(const int16_t *in, int16_t *out, size_t samples, const Balancegains *data)
+{
+    size_t i = 0, k;
+    size_t plen = data->pattern_len_q15;
+
+#if defined(BALANCE_USE_NEON)
+    int16x8_t vgain[BALANCE_PATTERN_MAX / 8];
+    uint16x8_t vmask[BALANCE_PATTERN_MAX / 8];
+
+    for (k = 0; k < plen / 8; k++) {
+        vgain[k] = vld1q_s16(data->gain_q15 + k * 8);
+        vmask[k] = vld1q_u16(data->mask_q15 + k * 8);
+    }
+    for (; i + plen <= samples; i += plen) {
+        for (k = 0; k < plen / 8; k++) {
+            int16x8_t x = vld1q_s16(in + i + k * 8);
+            int16x8_t y = vqrdmulhq_s16(x, vgain[k]);
+            vst1q_s16(out + i + k * 8, vbslq_s16(vmask[k], y, x));
+        }
+    }
+#elif defined(BALANCE_USE_SSE2)
+    /* (x, 1) . (gain, 0.5) = x * gain + rounding in one madd */
+    const __m128i vone = _mm_set1_epi16(1);
+    const __m128i vround = _mm_set1_epi16(1 << (BALANCE_Q15_SHIFT - 1));
+    __m128i vgain_lo[BALANCE_PATTERN_MAX / 8], vgain_hi[BALANCE_PATTERN_MAX / 8];
+    __m128i vmask[BALANCE_PATTERN_MAX / 8];
+
+    for (k = 0; k < plen / 8; k++) {
+        __m128i g = _mm_loadu_si128((const __m128i *)(data->gain_q15 + k * 8));
+        vgain_lo[k] = _mm_unpacklo_epi16(g, vround);
+        vgain_hi[k] = _mm_unpackhi_epi16(g, vround);
+        vmask[k] = _mm_loadu_si128((const __m128i *)(data->mask_q15 + k * 8));
+    }
+    for (; i + plen <= samples; i += plen) {
+        for (k = 0; k < plen / 8; k++) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(in + i + k * 8));
+            __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(x, vone), vgain_lo[k]);
+            __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(x, vone), vgain_hi[k]);
+            __m128i y = _mm_packs_epi32(_mm_srai_epi32(lo, BALANCE_Q15_SHIFT), _mm_srai_epi32(hi, BALANCE_Q15_SHIFT));
+            y = _mm_or_si128(_mm_and_si128(vmask[k], y), _mm_andnot_si128(vmask[k], x));
+            _mm_storeu_si128((__m128i *)(out + i + k * 8), y);
+        }
+    }
+#endif
+    /* whole patterns are done, the tail starts at pattern lane 0 */
+    for (k = 0; i < samples; i++, k = (k + 1 == plen) ? 0 : k + 1) {
+        if (data->mask_q15[k])
+            out[i] = (int16_t)((in[i] * data->gain_q15[k] + (1 << (BALANCE_Q15_SHIFT - 1))) >> BALANCE_Q15_SHIFT);
+        else
+            out[i] = in[i];
+    }
+}
+
+/* float samples scaled by the float gain pattern, 4 samples per vector */
+static void Balance_process_float(const float *in, float *out, size_t samples, const Balancegains *data)
+{
+    size_t i = 0, k;
+    size_t plen = data->pattern_len_f32;
+
+#if defined(BALANCE_USE_NEON)
+    float32x4_t vgain[BALANCE_PATTERN_MAX / 4];
+
+    for (k = 0; k < plen / 4; k++)
+        vgain[k] = vld1q_f32(data->gain_f32 + k * 4);
+    for (; i + plen <= samples; i += plen) {
+        for (k = 0; k < plen / 4; k++)
+            vst1q_f32(out + i + k * 4, vmulq_f32(vld1q_f32(in + i + k * 4), vgain[k]));
+    }
+#elif defined(BALANCE_USE_SSE2)
+    __m128 vgain[BALANCE_PATTERN_MAX / 4];
+
+    for (k = 0; k < plen / 4; k++)
+        vgain[k] = _mm_loadu_ps(data->gain_f32 + k * 4);
+    for (; i + plen <= samples; i += plen) {
+        for (k = 0; k < plen / 4; k++)
+            _mm_storeu_ps(out + i + k * 4, _mm_mul_ps(_mm_loadu_ps(in + i + k * 4), vgain[k]));
+    }
+#endif
+    for (k = 0; i < samples; i++, k = (k + 1 == plen) ? 0 : k + 1)
+        out[i] = in[i] * data->gain_f32[k];
+}
+
 //-------------------Effect Control Interface Implementation--------------------------
 
 int Balance_process(effect_handle_t self, audio_buffer_t *inBuffer, audio_buffer_t *outBuffer)
@@ -411,24 +638,39 @@ int Balance_process(effect_handle_t self, audio_buffer_t *inBuffer, audio_buffer
     if (pContext->state != BALANCE_STATE_ACTIVE)
         return -ENODATA;
 
-    int16_t *in  = (int16_t *)inBuffer->raw;
-    int16_t *out = (int16_t *)outBuffer->raw;
-    Balancedata *data = &pContext->gBalancedata;
-    int32_t val = data->index;
+    const Balancegains *data = (const Balancegains *)ParamSnapshotAcquire(&pContext->gains, NULL);
+    int is_float = data->is_float;
+    size_t samples = inBuffer->frameCount * data->channels;
+    int accumulate = AudioAccumulateNeeded(&pContext->accumulate, &pContext->config, inBuffer, outBuffer);
+    balance_kernel_e kernel;
 
-    for (size_t i = 0; i < inBuffer->frameCount; i++) {
-        if (!data->enable) {
-            *out++ = *in++;
-            *out++ = *in++;
-        } else if (val < (data->usr_cfg.num >> LSR)) {
-            *out++ = *in++;
-            /*Input right process*/
-            *out++ = clamp16((int32_t)(*in++ * data->usr_cfg.level[val]));
-        } else {
-            /*Input left process*/
-            *out++ = clamp16((int32_t)(*in++ * data->usr_cfg.level[val]));
-            *out++ = *in++;
-        }
+    if (data->bypass) {
+        AudioBypass(&pContext->config, accumulate, inBuffer, outBuffer);
+        return 0;
+    }
+    if (accumulate)
+        return AudioAccumulateProcess(&pContext->accumulate, self, &pContext->config, inBuffer, outBuffer);
+
+    /* pick the kernel once per buffer, silence in is silence out */
+    if (AudioSilenceDetect(&pContext->silence, inBuffer->raw, inBuffer->frameCount,
+            data->channels * (is_float ? sizeof(float) : sizeof(int16_t)), pContext->config.inputCfg.samplingRate))
+        kernel = BALANCE_KERNEL_BYPASS;
+    else if (is_float)
+        kernel = BALANCE_KERNEL_FLOAT;
+    else
+        kernel = BALANCE_KERNEL_Q15;
+
+    switch (kernel) {
+    case BALANCE_KERNEL_Q15:
+        Balance_process_q15(inBuffer->s16, outBuffer->s16, samples, data);
+        break;
+    case BALANCE_KERNEL_FLOAT:
+        Balance_process_float(inBuffer->f32, outBuffer->f32, samples, data);
+        break;
+    case BALANCE_KERNEL_BYPASS:
+    default:
+        AudioBypass(&pContext->config, 0, inBuffer, outBuffer);
+        break;
     }
 
     return 0;
@@ -562,6 +804,21 @@ int BalanceLib_Create(const effect_uuid_t *uuid, int32_t sessionId __unused, int
         for (i = 0; i < pContext->gBalancedata.usr_cfg.num; i++)
             pContext->gBalancedata.usr_cfg.level[i] = db_to_ampl(default_level[i]);
     }
+    if (Balance_init_level_q15(pContext) < 0) {
+        Balance_release(pContext);
+        delete pContext;
+        return -EINVAL;
+    }
+    Balancegains gains;
+    Balance_build_gains(pContext, &gains);
+    if (ParamSnapshotInit(&pContext->gains, &gains, sizeof(Balancegains)) < 0) {
+        Balance_release(pContext);
+        delete pContext;
+        return -EINVAL;
+    }
+
+    // a gain has no tail
+    AudioSilenceInit(&pContext->silence, 0);
 
     pContext->itfe = &BalanceInterface;
     pContext->state = BALANCE_STATE_UNINITIALIZED;
@@ -19,9 +19,13 @@ LOCAL_C_INCLUDES := \
     hardware/amlogic/audio/utils/ini/include \
     hardware/libhardware/include/hardware \
     hardware/libhardware/include \
-    system/media/audio/include
+    system/media/audio/include \
+    vendor/amlogic/frameworks/av/libaudioeffect/Utility
 
 LOCAL_SRC_FILES := dbx.cpp
+LOCAL_SRC_FILES += ../Utility/AudioArena.c
+LOCAL_SRC_FILES += ../Utility/AudioSilence.c
+LOCAL_SRC_FILES += ../Utility/AudioBypass.c
 
 LOCAL_CFLAGS += -O2
 
@@ -39,12 +39,26 @@
 
 #include "IniParser.h"
 #include "dbx.h"
+#include "AudioArena.h"
+#include "AudioSilence.h"
+#include "AudioBypass.h"
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+#include <arm_neon.h>
+#define DBX_USE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define DBX_USE_SSE2
+#endif
 
 extern "C" {
 
 #define MODEL_SUM_DEFAULT_PATH "/vendor/etc/tvconfig/model/model_sum.ini"
 #define AUDIO_EFFECT_DEFAULT_PATH "/vendor/etc/tvconfig/audio/AMLOGIC_AUDIO_EFFECT_DEFAULT.ini"
 #define BUFFSIZE    (1024)
+// frames per libdbx_tv call, longer buffers are processed in chunks
+#define DBX_CHUNK_FRAMES    (BUFFSIZE * 4)
+// libdbx_tv does not report its latency, leave its limiter room to drain
+#define DBX_TAIL_MS         500
 
 #if defined(__LP64__)
 #define LIBVX_PATH_A "/vendor/lib64/soundfx/libdbx_tv.so"
@@ -113,10 +127,14 @@ typedef struct DBXContext_s {
     void                     *gDBXLibHandler;
     DBxapi                    gDBXapi;
     DBXdata                   gDBXdata;
+    /* work buffers of DBX_process, carved from arena */
+    AudioArena_t              arena;
     int32_t                  *aiLeftA;
     int32_t                  *aiRightA;
     int32_t                  *aiLeftB;
     int32_t                  *aiRightB;
+    AudioSilence_t            silence;
+    AudioAccumulate_t         accumulate;
 } DBXContext;
 
 int DBX_get_model_name(char *model_name, int size)
@@ -285,10 +303,16 @@ int DBX_init(DBXContext *pContext)
     pContext->config.outputCfg.bufferProvider.cookie = NULL;
     pContext->config.outputCfg.mask = EFFECT_CONFIG_ALL;
 
-    pContext->aiLeftA  = (int32_t *)malloc(sizeof(int32_t) * BUFFSIZE * 4);
-    pContext->aiLeftB  = (int32_t *)malloc(sizeof(int32_t) * BUFFSIZE * 4);
-    pContext->aiRightA = (int32_t *)malloc(sizeof(int32_t) * BUFFSIZE * 4);
-    pContext->aiRightB = (int32_t *)malloc(sizeof(int32_t) * BUFFSIZE * 4);
+    // a repeated init gets the same buffers back without allocating
+    if (AudioArenaReserve(&pContext->arena, AudioArenaBlockSize(sizeof(int32_t) * DBX_CHUNK_FRAMES) * 4,
+                          AUDIO_ARENA_MLOCK) != AUDIO_ARENA_OK) {
+        ALOGE("Malloc temp buffer failed !\n");
+        return -EINVAL;
+    }
+    pContext->aiLeftA  = (int32_t *)AudioArenaAlloc(&pContext->arena, sizeof(int32_t) * DBX_CHUNK_FRAMES);
+    pContext->aiLeftB  = (int32_t *)AudioArenaAlloc(&pContext->arena, sizeof(int32_t) * DBX_CHUNK_FRAMES);
+    pContext->aiRightA = (int32_t *)AudioArenaAlloc(&pContext->arena, sizeof(int32_t) * DBX_CHUNK_FRAMES);
+    pContext->aiRightB = (int32_t *)AudioArenaAlloc(&pContext->arena, sizeof(int32_t) * DBX_CHUNK_FRAMES);
 
     if (pContext->aiLeftA == NULL || pContext->aiLeftB == NULL ||
             pContext->aiRightA == NULL || pContext->aiRightB == NULL) {
@@ -400,23 +424,76 @@ int DBX_setParameter(DBXContext *pContext, void *pParam, void *pValue) {
 
 int DBX_release(DBXContext *pContext)
 {
-    if (pContext->aiLeftA != NULL || pContext->aiLeftB != NULL ||
-            pContext->aiRightA != NULL || pContext->aiRightB != NULL){
-        free(pContext->aiLeftA);
-        pContext->aiLeftA = NULL;
-        free(pContext->aiLeftB);
-        pContext->aiLeftB = NULL;
-        free(pContext->aiRightA);
-        pContext->aiRightA = NULL;
-        free(pContext->aiRightB);
-        pContext->aiRightB = NULL;
-    }
+    AudioArenaRelease(&pContext->arena);
+    pContext->aiLeftA = NULL;
+    pContext->aiLeftB = NULL;
+    pContext->aiRightA = NULL;
+    pContext->aiRightB = NULL;
     if (pContext->gDBXLibHandler) {
        (*pContext->gDBXapi.DBX_release)();
     }
     return 0;
 }
 
+// interleaved int16 stereo to Q31 left/right planes (x << 16)
+static void DBX_split_q31(const int16_t *in, int32_t *left, int32_t *right, size_t frames)
+{
+    size_t i = 0;
+
+#if defined(DBX_USE_NEON)
+    for (; i + 8 <= frames; i += 8) {
+        int16x8x2_t x = vld2q_s16(in + i * 2);
+        vst1q_s32(left + i, vshll_n_s16(vget_low_s16(x.val[0]), 16));
+        vst1q_s32(left + i + 4, vshll_n_s16(vget_high_s16(x.val[0]), 16));
+        vst1q_s32(right + i, vshll_n_s16(vget_low_s16(x.val[1]), 16));
+        vst1q_s32(right + i + 4, vshll_n_s16(vget_high_s16(x.val[1]), 16));
+    }
+#elif defined(DBX_USE_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= frames; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i * 2));
+        // the sample in the high half of each 32 bit lane: L0 R0 L1 R1 / L2 R2 L3 R3
+        __m128 lo = _mm_castsi128_ps(_mm_unpacklo_epi16(zero, x));
+        __m128 hi = _mm_castsi128_ps(_mm_unpackhi_epi16(zero, x));
+        _mm_storeu_si128((__m128i *)(left + i), _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0))));
+        _mm_storeu_si128((__m128i *)(right + i), _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1))));
+    }
+#endif
+    for (; i < frames; i++) {
+        left[i] = ((int32_t)in[i * 2]) << 16;
+        right[i] = ((int32_t)in[i * 2 + 1]) << 16;
+    }
+}
+
+// Q31 left/right planes to interleaved int16 stereo, the high 16 bits of each sample
+static void DBX_merge_q31(const int32_t *left, const int32_t *right, int16_t *out, size_t frames)
+{
+    size_t i = 0;
+
+#if defined(DBX_USE_NEON)
+    for (; i + 8 <= frames; i += 8) {
+        int16x8x2_t y;
+        y.val[0] = vcombine_s16(vshrn_n_s32(vld1q_s32(left + i), 16), vshrn_n_s32(vld1q_s32(left + i + 4), 16));
+        y.val[1] = vcombine_s16(vshrn_n_s32(vld1q_s32(right + i), 16), vshrn_n_s32(vld1q_s32(right + i + 4), 16));
+        vst2q_s16(out + i * 2, y);
+    }
+#elif defined(DBX_USE_SSE2)
+    for (; i + 8 <= frames; i += 8) {
+        // x >> 16 always fits, the saturating pack does not change it
+        __m128i l = _mm_packs_epi32(_mm_srai_epi32(_mm_loadu_si128((const __m128i *)(left + i)), 16),
+                                    _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(left + i + 4)), 16));
+        __m128i r = _mm_packs_epi32(_mm_srai_epi32(_mm_loadu_si128((const __m128i *)(right + i)), 16),
+                                    _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(right + i + 4)), 16));
+        _mm_storeu_si128((__m128i *)(out + i * 2), _mm_unpacklo_epi16(l, r));
+        _mm_storeu_si128((__m128i *)(out + i * 2 + 8), _mm_unpackhi_epi16(l, r));
+    }
+#endif
+    for (; i < frames; i++) {
+        out[i * 2] = (int16_t)(left[i] >> 16);
+        out[i * 2 + 1] = (int16_t)(right[i] >> 16);
+    }
+}
+
 int DBX_process(effect_handle_t self, audio_buffer_t *inBuffer, audio_buffer_t *outBuffer)
 {
     DBXContext *pContext = (DBXContext *)self;
@@ -435,21 +512,24 @@ int DBX_process(effect_handle_t self, audio_buffer_t *inBuffer, audio_buffer_t *
     int16_t   *in  = (int16_t *)inBuffer->raw;
     int16_t   *out = (int16_t *)outBuffer->raw;
     DBXdata *data = &pContext->gDBXdata;
+    int accumulate = AudioAccumulateNeeded(&pContext->accumulate, &pContext->config, inBuffer, outBuffer);
     if (!data->enable || !pContext->gDBXLibHandler) {
-        for (size_t i = 0; i < inBuffer->frameCount; i++) {
-            *out++ = *in++;
-            *out++ = *in++;
-        }
+        AudioBypass(&pContext->config, accumulate, inBuffer, outBuffer);
+    } else if (accumulate) {
+        return AudioAccumulateProcess(&pContext->accumulate, self, &pContext->config, inBuffer, outBuffer);
+    } else if (AudioSilenceDetect(&pContext->silence, in, inBuffer->frameCount,
+            2 * sizeof(int16_t), pContext->config.inputCfg.samplingRate)) {
+        AudioBypass(&pContext->config, 0, inBuffer, outBuffer);
     } else {
-        for (size_t i = 0; i < inBuffer->frameCount; i++) {
-            pContext->aiLeftA[i] = ((int32_t)in[i*2]) << 16;
-            pContext->aiRightA[i] = ((int32_t)in[i*2+1]) << 16;
-        }
-        (*pContext->gDBXapi.DBX_process)(pContext->aiLeftA, pContext->aiRightA, pContext->aiLeftB,
-            pContext->aiRightB, inBuffer->frameCount);
-        for (size_t i = 0; i < inBuffer->frameCount; i++) {
-            out[i*2] = (int16_t)(pContext->aiLeftB[i] >> 16);
-            out[i*2+1] = (int16_t)(pContext->aiRightB[i] >> 16);
+        // a chunk is read completely before its output is written, in place is fine
+        for (size_t i = 0; i < inBuffer->frameCount; i += DBX_CHUNK_FRAMES) {
+            size_t n = inBuffer->frameCount - i;
+            if (n > DBX_CHUNK_FRAMES)
+                n = DBX_CHUNK_FRAMES;
+            DBX_split_q31(in + i * 2, pContext->aiLeftA, pContext->aiRightA, n);
+            (*pContext->gDBXapi.DBX_process)(pContext->aiLeftA, pContext->aiRightA, pContext->aiLeftB,
+                pContext->aiRightB, n);
+            DBX_merge_q31(pContext->aiLeftB, pContext->aiRightB, out + i * 2, n);
         }
    }
     return 0;
@@ -577,6 +657,8 @@ int DBXLib_Create(const effect_uuid_t *uuid, int32_t sessionId __unused, int32_t
         ALOGE("%s: Load Library File faied", __FUNCTION__);
     }
 
+    AudioSilenceInit(&pContext->silence, DBX_TAIL_MS);
+
     pContext->itfe = &DBXInterface;
     pContext->state = DBX_STATE_UNINITIALIZED;
 
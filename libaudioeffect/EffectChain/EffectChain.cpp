@@ -0,0 +1,848 @@
+/*
+ * Copyright (C) 2018 Amlogic Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *  DESCRIPTION:
+ *      Runs a chain of the Amlogic effects as one effect.
+ *
+ *      The member libraries listed in the INI are loaded through
+ *      AUDIO_EFFECT_LIBRARY_INFO_SYM and configured for float. The chain
+ *      converts the buffer once on the way in and once on the way out and
+ *      runs every member in place on EFFECT_CHAIN_BLOCK_FRAMES frames at a
+ *      time, so the block stays in cache from the first member to the
+ *      last. Members that keep 16 bit after SET_CONFIG get the block
+ *      converted around their process(), members that are not active are
+ *      not called at all.
+ *
+ */
+
+#define LOG_TAG "EffectChain_Effect"
+//#define LOG_NDEBUG 0
+
+#include <cutils/log.h>
+#include <utils/Log.h>
+#include <sys/types.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <dlfcn.h>
+#include <hardware/audio_effect.h>
+#include <cutils/properties.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "IniParser.h"
+#include "EffectChain.h"
+
+extern "C" {
+
+#include "../Utility/AudioConvert.h"
+#include "../Utility/AudioSilence.h"
+#include "../Utility/AudioBypass.h"
+
+#define MODEL_SUM_DEFAULT_PATH "/vendor/etc/tvconfig/model/model_sum.ini"
+#define AUDIO_EFFECT_DEFAULT_PATH "/vendor/etc/tvconfig/audio/AMLOGIC_AUDIO_EFFECT_DEFAULT.ini"
+
+#if defined(__LP64__)
+#define EFFECT_CHAIN_LIB_PATH "/vendor/lib64/soundfx"
+#else
+#define EFFECT_CHAIN_LIB_PATH "/vendor/lib/soundfx"
+#endif
+// host builds of the members are lib<name>_host.so
+#ifndef EFFECT_CHAIN_LIB_SUFFIX
+#define EFFECT_CHAIN_LIB_SUFFIX ""
+#endif
+#define EFFECT_CHAIN_DEFAULT_MEMBERS "TrebleBass,Geq,VirtualBass,Avl,Balance"
+
+/* frames run through all members before the next block, 8 channels of
+ * float are 8kB */
+#define EFFECT_CHAIN_BLOCK_FRAMES   256
+#define EFFECT_CHAIN_MAX_CHANNELS   8
+// longest tail of the members, look-ahead and library latency included
+#define EFFECT_CHAIN_TAIL_MS        1000
+
+// effect_handle_t interface implementation for EffectChain effect
+extern const struct effect_interface_s EffectChainInterface;
+
+//EffectChain effect TYPE: b2d4306b-03a2-44d2-9ca9-8459a5b6131c
+//EffectChain effect UUID: 85190cc9-0597-416b-8ebc-789412684aaf
+const effect_descriptor_t EffectChainDescriptor = {
+        {0xb2d4306b, 0x03a2, 0x44d2, 0x9ca9, {0x84, 0x59, 0xa5, 0xb6, 0x13, 0x1c}}, // type
+        {0x85190cc9, 0x0597, 0x416b, 0x8ebc, {0x78, 0x94, 0x12, 0x68, 0x4a, 0xaf}}, // uuid
+        EFFECT_CONTROL_API_VERSION,
+        EFFECT_FLAG_TYPE_POST_PROC | EFFECT_FLAG_DEVICE_IND,
+        EFFECT_CHAIN_CUP_LOAD_ARM9E,
+        EFFECT_CHAIN_MEM_USAGE,
+        "EffectChain",
+        "Amlogic",
+};
+
+enum effect_chain_state_e {
+    EFFECT_CHAIN_STATE_UNINITIALIZED,
+    EFFECT_CHAIN_STATE_INITIALIZED,
+    EFFECT_CHAIN_STATE_ACTIVE,
+};
+
+typedef enum {
+    EFFECT_CHAIN_PARAM_MEMBERS = 0,     // get only, bit (1 << member id) per member in the chain
+    EFFECT_CHAIN_PARAM_ACTIVE,          // bit per member that is run
+} EffectChainparams;
+
+/* A SET/GET_PARAM with psize > 4 whose first int32 is a member id goes to
+ * that member with the id removed, the rest is the member's own param. */
+typedef enum {
+    EFFECT_CHAIN_MEMBER_BALANCE = 0,
+    EFFECT_CHAIN_MEMBER_TREBLEBASS,
+    EFFECT_CHAIN_MEMBER_GEQ,
+    EFFECT_CHAIN_MEMBER_HPEQ,
+    EFFECT_CHAIN_MEMBER_AVL,
+    EFFECT_CHAIN_MEMBER_VIRTUALBASS,
+    EFFECT_CHAIN_MEMBER_DBX,
+    EFFECT_CHAIN_MEMBER_VIRTUALX,
+    EFFECT_CHAIN_MEMBER_TRUSURROUND,
+    EFFECT_CHAIN_MEMBER_VIRTUALSURROUND,
+    EFFECT_CHAIN_MEMBER_NUM,
+} EffectChainmembers;
+
+typedef struct EffectChainlib_s {
+    const char      *name;
+    const char      *lib;
+    effect_uuid_t   uuid;
+    // the input layout follows a parameter of the effect, not SET_CONFIG
+    int32_t         own_layout;
+} EffectChainlib;
+
+// indexed by member id
+static const EffectChainlib gEffectChainLibs[EFFECT_CHAIN_MEMBER_NUM] = {
+    {"Balance",         "libbalance",            {0x6f33b3a0, 0x578e, 0x11e5, 0x892f, {0x00, 0x02, 0xa5, 0xd5, 0xc5, 0x1b}}, 0},
+    {"TrebleBass",      "libtreblebasswrapper",  {0x76733af0, 0x2889, 0x11e2, 0x81c1, {0x08, 0x00, 0x20, 0x0c, 0x9a, 0x66}}, 0},
+    {"Geq",             "libgeq",                {0x2e2a5fa6, 0xcae8, 0x45f5, 0xbb70, {0xa2, 0x9c, 0x1f, 0x30, 0x74, 0xb2}}, 0},
+    {"Hpeq",            "libhpeqwrapper",        {0x049754aa, 0xc4cf, 0x439f, 0x897e, {0x37, 0xdd, 0x0c, 0x38, 0x11, 0x20}}, 0},
+    {"Avl",             "libavl",                {0x08246a2a, 0xb2d3, 0x4621, 0xb804, {0x42, 0xc9, 0xb4, 0x78, 0xeb, 0x9d}}, 0},
+    {"VirtualBass",     "libvirtualbass",        {0xa7eb1f3d, 0x2c99, 0x4664, 0x8593, {0x19, 0x40, 0x59, 0x51, 0xe3, 0x02}}, 0},
+    {"DBX",             "libdbx",                {0x07210842, 0x7432, 0x4624, 0x8b97, {0x35, 0xac, 0x87, 0x82, 0xef, 0xa3}}, 0},
+    {"VirtualX",        "libvirtualx",           {0x61821587, 0xce3c, 0x4aac, 0x9122, {0x86, 0xd8, 0x74, 0xea, 0x1f, 0xb1}}, 1},
+    {"TruSurround",     "libsrswrapper",         {0x8a857720, 0x0209, 0x11e2, 0xa9d8, {0x00, 0x02, 0xa5, 0xd5, 0xc5, 0x1b}}, 0},
+    {"Virtualsurround", "libvirtualsurround",    {0xc8459cd3, 0x4400, 0x4859, 0xb76b, {0xe1, 0x2c, 0xc2, 0xaa, 0x67, 0xce}}, 0},
+};
+
+typedef struct EffectChaincfg_s {
+    char    members[256];
+    char    lib_path[128];
+} EffectChaincfg;
+
+typedef struct EffectChainmember_s {
+    int32_t                 id;
+    void                    *dl;
+    audio_effect_library_t  *lib;
+    effect_handle_t         handle;
+    // EFFECT_CMD_ENABLE sent to the member
+    int32_t                 enabled;
+    // the member kept float in SET_CONFIG, otherwise it runs on 16 bit
+    int32_t                 is_float;
+} EffectChainmember;
+
+typedef struct EffectChainContext_s {
+    const struct effect_interface_s *itfe;
+    effect_config_t                 config;
+    effect_chain_state_e            state;
+    EffectChaincfg                  cfg;
+    // in processing order
+    EffectChainmember               member[EFFECT_CHAIN_MEMBER_NUM];
+    int32_t                         member_num;
+    // bit per member id, read by the audio thread
+    int32_t                         usable_mask;
+    int32_t                         active_mask;
+    float                           work[EFFECT_CHAIN_BLOCK_FRAMES * EFFECT_CHAIN_MAX_CHANNELS];
+    int16_t                         work_s16[EFFECT_CHAIN_BLOCK_FRAMES * EFFECT_CHAIN_MAX_CHANNELS];
+    AudioSilence_t                  silence;
+    AudioAccumulate_t               accumulate;
+} EffectChainContext;
+
+int EffectChain_get_model_name(char *model_name, int size)
+{
+    int ret = -1;
+    char node[PROPERTY_VALUE_MAX];
+
+    ret = property_get("tv.model_name", node, NULL);
+
+    if (ret < 0)
+        snprintf(model_name, size, "DEFAULT");
+    else
+        snprintf(model_name, size, "%s", node);
+    ALOGD("%s: Model Name -> %s", __FUNCTION__, model_name);
+    return ret;
+}
+
+int EffectChain_get_ini_file(char *ini_name, int size)
+{
+    int result = -1;
+    char model_name[50] = {0};
+    IniParser* pIniParser = NULL;
+    const char *ini_value = NULL;
+    const char *filename = MODEL_SUM_DEFAULT_PATH;
+
+    EffectChain_get_model_name(model_name, sizeof(model_name));
+    pIniParser = new IniParser();
+    if (pIniParser->parse(filename) < 0) {
+        ALOGW("%s: Load INI file -> %s Failed", __FUNCTION__, filename);
+        goto exit;
+    }
+
+    ini_value = pIniParser->GetString(model_name, "AMLOGIC_AUDIO_EFFECT_INI_PATH", AUDIO_EFFECT_DEFAULT_PATH);
+    if (ini_value == NULL || access(ini_value, F_OK) == -1) {
+        ALOGD("%s: INI File is not exist", __FUNCTION__);
+        goto exit;
+    }
+    ALOGD("%s: INI File -> %s", __FUNCTION__, ini_value);
+    strncpy(ini_name, ini_value, size);
+
+    result = 0;
+exit:
+    delete pIniParser;
+    pIniParser = NULL;
+    return result;
+}
+
+int EffectChain_load_ini_file(EffectChainContext *pContext)
+{
+    int result = -1;
+    char ini_name[100] = {0};
+    const char *ini_value = NULL;
+    EffectChaincfg *cfg = &pContext->cfg;
+    IniParser* pIniParser = NULL;
+
+    if (EffectChain_get_ini_file(ini_name, sizeof(ini_name)) < 0)
+        goto error;
+
+    pIniParser = new IniParser();
+    if (pIniParser->parse((const char *)ini_name) < 0) {
+        ALOGD("%s: %s load failed", __FUNCTION__, ini_name);
+        goto error;
+    }
+    ini_value = pIniParser->GetString("EffectChain", "chain_members", EFFECT_CHAIN_DEFAULT_MEMBERS);
+    if (ini_value == NULL)
+        goto error;
+    ALOGD("%s: members -> %s", __FUNCTION__, ini_value);
+    snprintf(cfg->members, sizeof(cfg->members), "%s", ini_value);
+
+    ini_value = pIniParser->GetString("EffectChain", "chain_lib_path", EFFECT_CHAIN_LIB_PATH);
+    if (ini_value == NULL)
+        goto error;
+    ALOGD("%s: lib path -> %s", __FUNCTION__, ini_value);
+    snprintf(cfg->lib_path, sizeof(cfg->lib_path), "%s", ini_value);
+
+    result = 0;
+error:
+    ALOGD("%s: %s", __FUNCTION__, result == 0 ? "sucessful" : "failed");
+    delete pIniParser;
+    pIniParser = NULL;
+    return result;
+}
+
+static int EffectChain_member_command(EffectChainmember *m, uint32_t cmdCode, uint32_t cmdSize, void *pCmdData)
+{
+    int reply = 0;
+    uint32_t replySize = sizeof(reply);
+    int ret;
+
+    ret = (*m->handle)->command(m->handle, cmdCode, cmdSize, pCmdData, &replySize, &reply);
+    return ret < 0 ? ret : reply;
+}
+
+static EffectChainmember *EffectChain_find_member(EffectChainContext *pContext, int32_t id)
+{
+    for (int i = 0; i < pContext->member_num; i++) {
+        if (pContext->member[i].id == id)
+            return &pContext->member[i];
+    }
+    return NULL;
+}
+
+static int EffectChain_load_member(EffectChainContext *pContext, int32_t id)
+{
+    EffectChainmember *m = &pContext->member[pContext->member_num];
+    const EffectChainlib *lib = &gEffectChainLibs[id];
+    char path[256];
+    int ret;
+
+    snprintf(path, sizeof(path), "%s/%s%s.so", pContext->cfg.lib_path, lib->lib, EFFECT_CHAIN_LIB_SUFFIX);
+    m->dl = dlopen(path, RTLD_NOW);
+    if (m->dl == NULL) {
+        ALOGE("%s: dlopen %s failed: %s", __FUNCTION__, path, dlerror());
+        return -EINVAL;
+    }
+    m->lib = (audio_effect_library_t *)dlsym(m->dl, AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR);
+    if (m->lib == NULL || m->lib->tag != AUDIO_EFFECT_LIBRARY_TAG) {
+        ALOGE("%s: %s has no valid %s", __FUNCTION__, path, AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR);
+        goto error;
+    }
+    ret = m->lib->create_effect(&lib->uuid, 0, 0, &m->handle);
+    if (ret < 0 || m->handle == NULL) {
+        ALOGE("%s: create %s failed: %d", __FUNCTION__, lib->name, ret);
+        goto error;
+    }
+    m->id = id;
+    m->enabled = 0;
+    m->is_float = 0;
+    pContext->member_num++;
+    ALOGD("%s: %s -> %s", __FUNCTION__, lib->name, path);
+    return 0;
+
+error:
+    dlclose(m->dl);
+    memset(m, 0, sizeof(EffectChainmember));
+    return -EINVAL;
+}
+
+/* members from the comma separated chain_members, in that order */
+static void EffectChain_load_members(EffectChainContext *pContext)
+{
+    char names[sizeof(pContext->cfg.members)];
+    char *name, *save = NULL;
+    int32_t id;
+
+    snprintf(names, sizeof(names), "%s", pContext->cfg.members);
+    for (name = strtok_r(names, ", ", &save); name != NULL; name = strtok_r(NULL, ", ", &save)) {
+        for (id = 0; id < EFFECT_CHAIN_MEMBER_NUM; id++) {
+            if (strcasecmp(name, gEffectChainLibs[id].name) == 0)
+                break;
+        }
+        if (id == EFFECT_CHAIN_MEMBER_NUM || EffectChain_find_member(pContext, id) != NULL) {
+            ALOGW("%s: %s is unknown or listed twice", __FUNCTION__, name);
+            continue;
+        }
+        EffectChain_load_member(pContext, id);
+    }
+}
+
+static void EffectChain_unload_members(EffectChainContext *pContext)
+{
+    for (int i = 0; i < pContext->member_num; i++) {
+        EffectChainmember *m = &pContext->member[i];
+        m->lib->release_effect(m->handle);
+        dlclose(m->dl);
+    }
+    memset(pContext->member, 0, sizeof(pContext->member));
+    pContext->member_num = 0;
+}
+
+/* Float first, a member that does not support it rewrites the config to
+ * what it does and keeps going. One that changes the layout, the rate or
+ * the format between its input and output, or whose input layout does not
+ * come from the config, can not run in place on the work block and is
+ * left out until the next SET_CONFIG. */
+static void EffectChain_configure_members(EffectChainContext *pContext)
+{
+    int32_t usable = 0;
+
+    for (int i = 0; i < pContext->member_num; i++) {
+        EffectChainmember *m = &pContext->member[i];
+        effect_config_t mcfg = pContext->config;
+        int ret;
+
+        if (gEffectChainLibs[m->id].own_layout) {
+            ALOGW("%s: %s takes its layout from a parameter, left out", __FUNCTION__,
+                gEffectChainLibs[m->id].name);
+            continue;
+        }
+        mcfg.inputCfg.format = mcfg.outputCfg.format = AUDIO_FORMAT_PCM_FLOAT;
+        mcfg.inputCfg.accessMode = EFFECT_BUFFER_ACCESS_READ;
+        mcfg.outputCfg.accessMode = EFFECT_BUFFER_ACCESS_WRITE;
+        ret = EffectChain_member_command(m, EFFECT_CMD_SET_CONFIG, sizeof(effect_config_t), &mcfg);
+        if (ret < 0 ||
+                mcfg.inputCfg.channels != pContext->config.inputCfg.channels ||
+                mcfg.inputCfg.samplingRate != pContext->config.inputCfg.samplingRate ||
+                mcfg.outputCfg.channels != mcfg.inputCfg.channels ||
+                mcfg.outputCfg.samplingRate != mcfg.inputCfg.samplingRate ||
+                mcfg.outputCfg.format != mcfg.inputCfg.format ||
+                (mcfg.inputCfg.format != AUDIO_FORMAT_PCM_FLOAT &&
+                 mcfg.inputCfg.format != AUDIO_FORMAT_PCM_16_BIT)) {
+            ALOGW("%s: %s can not run 0x%x at %u Hz, left out", __FUNCTION__,
+                gEffectChainLibs[m->id].name, pContext->config.inputCfg.channels,
+                pContext->config.inputCfg.samplingRate);
+            continue;
+        }
+        m->is_float = mcfg.inputCfg.format == AUDIO_FORMAT_PCM_FLOAT;
+        usable |= 1 << m->id;
+        ALOGD("%s: %s on %s", __FUNCTION__, gEffectChainLibs[m->id].name, m->is_float ? "float" : "16 bit");
+    }
+    __atomic_store_n(&pContext->usable_mask, usable, __ATOMIC_RELEASE);
+}
+
+static void EffectChain_set_active(EffectChainContext *pContext, int32_t mask)
+{
+    int32_t active = 0;
+
+    for (int i = 0; i < pContext->member_num; i++) {
+        EffectChainmember *m = &pContext->member[i];
+        int32_t want = (mask >> m->id) & 1;
+
+        if (want && !m->enabled)
+            m->enabled = EffectChain_member_command(m, EFFECT_CMD_ENABLE, 0, NULL) == 0;
+        else if (!want && m->enabled)
+            m->enabled = EffectChain_member_command(m, EFFECT_CMD_DISABLE, 0, NULL) != 0;
+        if (m->enabled)
+            active |= 1 << m->id;
+    }
+    __atomic_store_n(&pContext->active_mask, active, __ATOMIC_RELEASE);
+}
+
+int EffectChain_init(EffectChainContext *pContext)
+{
+    pContext->config.inputCfg.accessMode = EFFECT_BUFFER_ACCESS_READ;
+    pContext->config.inputCfg.channels = AUDIO_CHANNEL_OUT_STEREO;
+    pContext->config.inputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+    pContext->config.inputCfg.samplingRate = 48000;
+    pContext->config.inputCfg.bufferProvider.getBuffer = NULL;
+    pContext->config.inputCfg.bufferProvider.releaseBuffer = NULL;
+    pContext->config.inputCfg.bufferProvider.cookie = NULL;
+    pContext->config.inputCfg.mask = EFFECT_CONFIG_ALL;
+    pContext->config.outputCfg.accessMode = EFFECT_BUFFER_ACCESS_ACCUMULATE;
+    pContext->config.outputCfg.channels = AUDIO_CHANNEL_OUT_STEREO;
+    pContext->config.outputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+    pContext->config.outputCfg.samplingRate = 48000;
+    pContext->config.outputCfg.bufferProvider.getBuffer = NULL;
+    pContext->config.outputCfg.bufferProvider.releaseBuffer = NULL;
+    pContext->config.outputCfg.bufferProvider.cookie = NULL;
+    pContext->config.outputCfg.mask = EFFECT_CONFIG_ALL;
+
+    for (int i = 0; i < pContext->member_num; i++) {
+        if (EffectChain_member_command(&pContext->member[i], EFFECT_CMD_INIT, 0, NULL) < 0)
+            ALOGW("%s: %s init failed", __FUNCTION__, gEffectChainLibs[pContext->member[i].id].name);
+    }
+    EffectChain_configure_members(pContext);
+
+    ALOGD("%s: sucessful, %d members", __FUNCTION__, pContext->member_num);
+
+    return 0;
+}
+
+int EffectChain_reset(EffectChainContext *pContext)
+{
+    for (int i = 0; i < pContext->member_num; i++)
+        EffectChain_member_command(&pContext->member[i], EFFECT_CMD_RESET, 0, NULL);
+    return 0;
+}
+
+int EffectChain_configure(EffectChainContext *pContext, effect_config_t *pConfig)
+{
+    uint32_t channels;
+
+    if (pConfig->inputCfg.samplingRate != pConfig->outputCfg.samplingRate)
+        return -EINVAL;
+    if (pConfig->inputCfg.channels != pConfig->outputCfg.channels)
+        return -EINVAL;
+    if (pConfig->inputCfg.format != pConfig->outputCfg.format)
+        return -EINVAL;
+    channels = audio_channel_count_from_out_mask(pConfig->inputCfg.channels);
+    if (channels == 0 || channels > EFFECT_CHAIN_MAX_CHANNELS) {
+        ALOGW("%s: channels in = 0x%x channels out = 0x%x", __FUNCTION__, pConfig->inputCfg.channels, pConfig->outputCfg.channels);
+        pConfig->inputCfg.channels = pConfig->outputCfg.channels = AUDIO_CHANNEL_OUT_STEREO;
+    }
+    if (pConfig->outputCfg.accessMode != EFFECT_BUFFER_ACCESS_WRITE &&
+            pConfig->outputCfg.accessMode != EFFECT_BUFFER_ACCESS_ACCUMULATE)
+        return -EINVAL;
+    if (pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT &&
+            pConfig->inputCfg.format != AUDIO_FORMAT_PCM_FLOAT) {
+        ALOGW("%s: format in = 0x%x format out = 0x%x", __FUNCTION__, pConfig->inputCfg.format, pConfig->outputCfg.format);
+        pConfig->inputCfg.format = pConfig->outputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+    }
+
+    memcpy(&pContext->config, pConfig, sizeof(effect_config_t));
+    EffectChain_configure_members(pContext);
+
+    return 0;
+}
+
+int EffectChain_getParameter(EffectChainContext *pContext, void *pParam, size_t *pValueSize, void *pValue)
+{
+    int32_t param = *(int32_t *)pParam;
+    int32_t value = 0;
+
+    switch (param) {
+    case EFFECT_CHAIN_PARAM_MEMBERS:
+        if (*pValueSize < sizeof(int32_t)) {
+            *pValueSize = 0;
+            return -EINVAL;
+        }
+        for (int i = 0; i < pContext->member_num; i++)
+            value |= 1 << pContext->member[i].id;
+        *(int32_t *) pValue = value;
+        break;
+    case EFFECT_CHAIN_PARAM_ACTIVE:
+        if (*pValueSize < sizeof(int32_t)) {
+            *pValueSize = 0;
+            return -EINVAL;
+        }
+        value = __atomic_load_n(&pContext->active_mask, __ATOMIC_RELAXED);
+        *(int32_t *) pValue = value;
+        break;
+    default:
+        ALOGE("%s: unknown param %d", __FUNCTION__, param);
+        return -EINVAL;
+    }
+    *pValueSize = sizeof(int32_t);
+    ALOGD("%s: param %d -> 0x%x", __FUNCTION__, param, value);
+    return 0;
+}
+
+int EffectChain_setParameter(EffectChainContext *pContext, void *pParam, void *pValue)
+{
+    int32_t param = *(int32_t *)pParam;
+    int32_t value;
+
+    switch (param) {
+    case EFFECT_CHAIN_PARAM_ACTIVE:
+        value = *(int32_t *)pValue;
+        EffectChain_set_active(pContext, value);
+        ALOGD("%s: Set active 0x%x -> 0x%x", __FUNCTION__, value, pContext->active_mask);
+        break;
+    default:
+        ALOGE("%s: unknown param %08x", __FUNCTION__, param);
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+/* the member id is taken out of the param and put back into the reply,
+ * everything else is up to the member */
+static int EffectChain_forward_param(EffectChainContext *pContext, uint32_t cmdCode, uint32_t cmdSize,
+        effect_param_t *p, uint32_t *replySize, void *pReplyData)
+{
+    int32_t id = *(int32_t *)p->data;
+    EffectChainmember *m = EffectChain_find_member(pContext, id);
+    uint32_t size = cmdSize - sizeof(int32_t);
+    effect_param_t *q, *r = NULL;
+    uint32_t rsize;
+    int ret;
+
+    if (m == NULL) {
+        ALOGE("%s: member %d is not in the chain", __FUNCTION__, id);
+        return -EINVAL;
+    }
+    q = (effect_param_t *)malloc(size);
+    if (q == NULL)
+        return -ENOMEM;
+    q->status = 0;
+    q->psize = p->psize - sizeof(int32_t);
+    q->vsize = p->vsize;
+    memcpy(q->data, p->data + sizeof(int32_t), size - sizeof(effect_param_t));
+
+    if (cmdCode == EFFECT_CMD_SET_PARAM) {
+        ret = (*m->handle)->command(m->handle, cmdCode, size, q, replySize, pReplyData);
+    } else {
+        rsize = *replySize - sizeof(int32_t);
+        r = (effect_param_t *)malloc(rsize);
+        if (r == NULL) {
+            free(q);
+            return -ENOMEM;
+        }
+        ret = (*m->handle)->command(m->handle, cmdCode, size, q, &rsize, r);
+        if (ret == 0) {
+            effect_param_t *reply = (effect_param_t *)pReplyData;
+            reply->status = r->status;
+            reply->psize = r->psize + sizeof(int32_t);
+            reply->vsize = r->vsize;
+            *(int32_t *)reply->data = id;
+            memcpy(reply->data + sizeof(int32_t), r->data, rsize - sizeof(effect_param_t));
+            *replySize = rsize + sizeof(int32_t);
+        }
+    }
+    free(q);
+    free(r);
+    return ret;
+}
+
+int EffectChain_release(EffectChainContext *pContext)
+{
+    EffectChain_unload_members(pContext);
+    return 0;
+}
+
+//-------------------Effect Control Interface Implementation--------------------------
+
+/* the block is float here, in place for the member */
+static void EffectChain_run_member(EffectChainContext *pContext, EffectChainmember *m,
+        float *buf, size_t frames, size_t samples)
+{
+    audio_buffer_t b;
+
+    b.frameCount = frames;
+    if (m->is_float) {
+        b.f32 = buf;
+        (*m->handle)->process(m->handle, &b, &b);
+        return;
+    }
+    AudioConvertFloatToS16(buf, pContext->work_s16, samples);
+    b.s16 = pContext->work_s16;
+    if ((*m->handle)->process(m->handle, &b, &b) == 0)
+        AudioConvertS16ToFloat(pContext->work_s16, buf, samples);
+}
+
+int EffectChain_process(effect_handle_t self, audio_buffer_t *inBuffer, audio_buffer_t *outBuffer)
+{
+    EffectChainContext *pContext = (EffectChainContext *)self;
+
+    if (pContext == NULL)
+        return -EINVAL;
+
+    if (inBuffer == NULL || inBuffer->raw == NULL ||
+        outBuffer == NULL || outBuffer->raw == NULL ||
+        inBuffer->frameCount != outBuffer->frameCount ||
+        inBuffer->frameCount == 0)
+        return -EINVAL;
+
+    if (pContext->state != EFFECT_CHAIN_STATE_ACTIVE)
+        return -ENODATA;
+
+    int is_float = pContext->config.inputCfg.format == AUDIO_FORMAT_PCM_FLOAT;
+    size_t channels = audio_channel_count_from_out_mask(pContext->config.inputCfg.channels);
+    int32_t run = __atomic_load_n(&pContext->active_mask, __ATOMIC_ACQUIRE) &
+                  __atomic_load_n(&pContext->usable_mask, __ATOMIC_ACQUIRE);
+    size_t frame_size = channels * (is_float ? sizeof(float) : sizeof(int16_t));
+    int accumulate = AudioAccumulateNeeded(&pContext->accumulate, &pContext->config, inBuffer, outBuffer);
+    size_t pos, n, samples;
+    float *buf;
+
+    if (run == 0) {
+        AudioBypass(&pContext->config, accumulate, inBuffer, outBuffer);
+        return 0;
+    }
+    if (accumulate)
+        return AudioAccumulateProcess(&pContext->accumulate, self, &pContext->config, inBuffer, outBuffer);
+    // drained silence is neither converted nor run through the members
+    if (AudioSilenceDetect(&pContext->silence, inBuffer->raw, inBuffer->frameCount,
+            frame_size, pContext->config.inputCfg.samplingRate)) {
+        AudioBypass(&pContext->config, 0, inBuffer, outBuffer);
+        return 0;
+    }
+
+    for (pos = 0; pos < inBuffer->frameCount; pos += n) {
+        n = inBuffer->frameCount - pos;
+        if (n > EFFECT_CHAIN_BLOCK_FRAMES)
+            n = EFFECT_CHAIN_BLOCK_FRAMES;
+        samples = n * channels;
+        if (is_float) {
+            buf = outBuffer->f32 + pos * channels;
+            if (outBuffer->raw != inBuffer->raw)
+                memcpy(buf, inBuffer->f32 + pos * channels, samples * sizeof(float));
+        } else {
+            buf = pContext->work;
+            AudioConvertS16ToFloat(inBuffer->s16 + pos * channels, buf, samples);
+        }
+        for (int i = 0; i < pContext->member_num; i++) {
+            if (run & (1 << pContext->member[i].id))
+                EffectChain_run_member(pContext, &pContext->member[i], buf, n, samples);
+        }
+        // float stays unclipped between members, 16 bit saturates once here
+        if (!is_float)
+            AudioConvertFloatToS16(buf, outBuffer->s16 + pos * channels, samples);
+    }
+
+    return 0;
+}
+
+int EffectChain_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
+        void *pCmdData, uint32_t *replySize, void *pReplyData)
+{
+    EffectChainContext *pContext = (EffectChainContext *)self;
+    effect_param_t *p;
+    int voffset;
+
+    if (pContext == NULL || pContext->state == EFFECT_CHAIN_STATE_UNINITIALIZED)
+        return -EINVAL;
+
+    ALOGD("%s: cmd = %u", __FUNCTION__, cmdCode);
+    switch (cmdCode) {
+    case EFFECT_CMD_INIT:
+        if (pReplyData == NULL || replySize == NULL || *replySize != sizeof(int))
+            return -EINVAL;
+        *(int *) pReplyData = EffectChain_init(pContext);
+        break;
+    case EFFECT_CMD_SET_CONFIG:
+        if (pCmdData == NULL || cmdSize != sizeof(effect_config_t) || pReplyData == NULL || replySize == NULL || *replySize != sizeof(int))
+            return -EINVAL;
+        *(int *) pReplyData = EffectChain_configure(pContext, (effect_config_t *) pCmdData);
+        break;
+    case EFFECT_CMD_RESET:
+        EffectChain_reset(pContext);
+        break;
+    case EFFECT_CMD_ENABLE:
+        if (pReplyData == NULL || replySize == NULL || *replySize != sizeof(int))
+            return -EINVAL;
+        if (pContext->state != EFFECT_CHAIN_STATE_INITIALIZED)
+            return -ENOSYS;
+        pContext->state = EFFECT_CHAIN_STATE_ACTIVE;
+        *(int *)pReplyData = 0;
+        break;
+    case EFFECT_CMD_DISABLE:
+        if (pReplyData == NULL || replySize == NULL || *replySize != sizeof(int))
+            return -EINVAL;
+        if (pContext->state != EFFECT_CHAIN_STATE_ACTIVE)
+            return -ENOSYS;
+        pContext->state = EFFECT_CHAIN_STATE_INITIALIZED;
+        *(int *)pReplyData = 0;
+        break;
+    case EFFECT_CMD_GET_PARAM:
+        if (pCmdData == NULL ||
+            cmdSize < (int)(sizeof(effect_param_t) + sizeof(uint32_t)) ||
+            pReplyData == NULL || replySize == NULL ||
+            *replySize < (int)(sizeof(effect_param_t) + sizeof(uint32_t) + sizeof(uint32_t)))
+            return -EINVAL;
+        p = (effect_param_t *)pCmdData;
+        if (p->psize > sizeof(uint32_t) && p->psize % sizeof(uint32_t) == 0)
+            return EffectChain_forward_param(pContext, cmdCode, cmdSize, p, replySize, pReplyData);
+        if (p->psize != sizeof(uint32_t))
+            return -EINVAL;
+        memcpy(pReplyData, pCmdData, sizeof(effect_param_t) + p->psize);
+        p = (effect_param_t *)pReplyData;
+
+        voffset = ((p->psize - 1) / sizeof(int32_t) + 1) * sizeof(int32_t);
+
+        p->status = EffectChain_getParameter(pContext, p->data, (size_t  *)&p->vsize, p->data + voffset);
+        *replySize = sizeof(effect_param_t) + voffset + p->vsize;
+        break;
+    case EFFECT_CMD_SET_PARAM:
+        if (pCmdData == NULL ||
+            cmdSize < (int)(sizeof(effect_param_t) + sizeof(uint32_t) + sizeof(uint32_t)) ||
+            pReplyData == NULL || replySize == NULL || *replySize != sizeof(int32_t))
+            return -EINVAL;
+        p = (effect_param_t *)pCmdData;
+        if (p->psize > sizeof(uint32_t) && p->psize % sizeof(uint32_t) == 0)
+            return EffectChain_forward_param(pContext, cmdCode, cmdSize, p, replySize, pReplyData);
+        if (p->psize != sizeof(uint32_t) || p->vsize != sizeof(uint32_t)) {
+            *(int32_t *)pReplyData = -EINVAL;
+            break;
+        }
+        *(int *)pReplyData = EffectChain_setParameter(pContext, (void *)p->data, p->data + p->psize);
+        break;
+    case EFFECT_CMD_OFFLOAD:
+        *(int *)pReplyData = 0;
+        break;
+    case EFFECT_CMD_SET_DEVICE:
+    case EFFECT_CMD_SET_VOLUME:
+    case EFFECT_CMD_SET_AUDIO_MODE:
+        break;
+    default:
+        ALOGE("%s: invalid command %d", __FUNCTION__, cmdCode);
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+int EffectChain_getDescriptor(effect_handle_t self, effect_descriptor_t *pDescriptor)
+{
+    EffectChainContext *pContext = (EffectChainContext *) self;
+
+    if (pContext == NULL || pDescriptor == NULL) {
+        ALOGE("%s: invalid param", __FUNCTION__);
+        return -EINVAL;
+    }
+
+    *pDescriptor = EffectChainDescriptor;
+
+    return 0;
+}
+
+//-------------------- Effect Library Interface Implementation------------------------
+
+int EffectChainLib_Create(const effect_uuid_t *uuid, int32_t sessionId __unused, int32_t ioId __unused, effect_handle_t *pHandle)
+{
+    if (pHandle == NULL || uuid == NULL)
+        return -EINVAL;
+
+    if (memcmp(uuid, &EffectChainDescriptor.uuid, sizeof(effect_uuid_t)) != 0)
+        return -EINVAL;
+
+    EffectChainContext *pContext = new EffectChainContext;
+    if (!pContext) {
+        ALOGE("%s: alloc EffectChainContext failed", __FUNCTION__);
+        return -EINVAL;
+    }
+    memset(pContext, 0, sizeof(EffectChainContext));
+    snprintf(pContext->cfg.members, sizeof(pContext->cfg.members), "%s", EFFECT_CHAIN_DEFAULT_MEMBERS);
+    snprintf(pContext->cfg.lib_path, sizeof(pContext->cfg.lib_path), "%s", EFFECT_CHAIN_LIB_PATH);
+    if (EffectChain_load_ini_file(pContext) < 0)
+        ALOGE("%s: Load INI File faied, use default param", __FUNCTION__);
+    EffectChain_load_members(pContext);
+    if (pContext->member_num == 0)
+        ALOGW("%s: no member loaded, the chain passes audio through", __FUNCTION__);
+    // every member runs until EFFECT_CHAIN_PARAM_ACTIVE says otherwise,
+    // EFFECT_CMD_INIT keeps what it said
+    EffectChain_set_active(pContext, -1);
+    AudioSilenceInit(&pContext->silence, EFFECT_CHAIN_TAIL_MS);
+
+    pContext->itfe = &EffectChainInterface;
+    pContext->state = EFFECT_CHAIN_STATE_UNINITIALIZED;
+
+    *pHandle = (effect_handle_t)pContext;
+
+    pContext->state = EFFECT_CHAIN_STATE_INITIALIZED;
+
+    ALOGD("%s: %p", __FUNCTION__, pContext);
+
+    return 0;
+}
+
+int EffectChainLib_Release(effect_handle_t handle)
+{
+    EffectChainContext *pContext = (EffectChainContext *)handle;
+
+    if (pContext == NULL)
+        return -EINVAL;
+
+    EffectChain_release(pContext);
+    pContext->state = EFFECT_CHAIN_STATE_UNINITIALIZED;
+    delete pContext;
+
+    return 0;
+}
+
+int EffectChainLib_GetDescriptor(const effect_uuid_t *uuid, effect_descriptor_t *pDescriptor)
+{
+    if (pDescriptor == NULL || uuid == NULL) {
+        ALOGE("%s: called with NULL pointer", __FUNCTION__);
+        return -EINVAL;
+    }
+
+    if (memcmp(uuid, &EffectChainDescriptor.uuid, sizeof(effect_uuid_t)) == 0) {
+        *pDescriptor = EffectChainDescriptor;
+        return 0;
+    }
+
+    return  -EINVAL;
+}
+
+// effect_handle_t interface implementation for EffectChain effect
+const struct effect_interface_s EffectChainInterface = {
+        EffectChain_process,
+        EffectChain_command,
+        EffectChain_getDescriptor,
+        NULL,
+};
+
+audio_effect_library_t AUDIO_EFFECT_LIBRARY_INFO_SYM = {
+    .tag = AUDIO_EFFECT_LIBRARY_TAG,
+    .version = EFFECT_LIBRARY_API_VERSION,
+    .name = "EffectChain",
+    .implementor = "Amlogic",
+    .create_effect = EffectChainLib_Create,
+    .release_effect = EffectChainLib_Release,
+    .get_descriptor = EffectChainLib_GetDescriptor,
+};
+
+}; // extern "C"
@@ -24,9 +24,20 @@ LOCAL_C_INCLUDES := \
 
 LOCAL_SRC_FILES += Geq.cpp
 LOCAL_SRC_FILES += ../Utility/AudioFade.c
-
+LOCAL_SRC_FILES += ../Utility/ParamSnapshot.c
+LOCAL_SRC_FILES += ../Utility/AudioSilence.c
+LOCAL_SRC_FILES += ../Utility/AudioBypass.c
+
+# GEQ_SOURCE_ENGINE := true runs the per-session engine in Geq.cpp
+# instead of the prebuilt libAmlGeq
+ifeq ($(GEQ_SOURCE_ENGINE),true)
+LOCAL_CFLAGS += -DGEQ_SOURCE_ENGINE
+LOCAL_SRC_FILES += ../Utility/AudioBiquad.c
+LOCAL_SRC_FILES += ../Utility/AudioConvert.c
+else
 LOCAL_LDFLAGS_arm  += $(LOCAL_PATH)/libAmlGeq.a
 LOCAL_LDFLAGS_arm64 += $(LOCAL_PATH)/libAmlGeq64.a
+endif
 
 LOCAL_MULTILIB := both
 
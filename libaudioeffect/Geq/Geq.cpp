@@ -41,8 +41,16 @@
 
 extern "C" {
 
-#include "libAmlGeq.h"
 #include "../Utility/AudioFade.h"
+#ifdef GEQ_SOURCE_ENGINE
+#include "../Utility/AudioBiquad.h"
+#include "../Utility/AudioConvert.h"
+#else
+#include "libAmlGeq.h"
+#endif
+#include "../Utility/ParamSnapshot.h"
+#include "../Utility/AudioSilence.h"
+#include "../Utility/AudioBypass.h"
 
 #define MODEL_SUM_DEFAULT_PATH "/vendor/etc/tvconfig/model/model_sum.ini"
 #define AUDIO_EFFECT_DEFAULT_PATH "/vendor/etc/tvconfig/audio/AMLOGIC_AUDIO_EFFECT_DEFAULT.ini"
@@ -101,6 +109,25 @@ typedef struct GEQcfg_8bit_s {
     signed char band9;
 } GEQcfg_8bit;
 
+#define GEQ_BAND_MAX 9
+#define GEQ_GAIN_MIN -10
+#define GEQ_GAIN_MAX 10
+// frames converted to float and run through the bank at a time
+#define GEQ_BLOCK_FRAMES 256
+// bandwidth of a band over the distance to its neighbours
+#define GEQ_BAND_OVERLAP 1.25
+// filter gains closer to 0dB than this are not run
+#define GEQ_DESIGN_MIN 0.01f
+// ring out time of the narrowest low band
+#define GEQ_TAIL_MS 200
+
+/* band centers of the nine band layout, one between each pair of crossovers
+ * of the former libAmlGeq shelving bank (121, 257, 462, 862, 1449, 2669,
+ * 4853 and 8266Hz), overridden by geq_band_center in the INI */
+static const float GEQ_default_center[GEQ_BAND_MAX] = {
+    63.0f, 176.0f, 344.0f, 631.0f, 1118.0f, 1967.0f, 3599.0f, 6334.0f, 12000.0f,
+};
+
 typedef struct GEQdata_s {
     /* This struct is used to initialize GEQ default config*/
     GEQcfg       cfg;
@@ -110,8 +137,296 @@ typedef struct GEQdata_s {
     int32_t       mode;
     int32_t       mode_num;
     int32_t       band_num;
+    float         center[GEQ_BAND_MAX];
 } GEQdata;
 
+/* snapshot read by GEQ_process, bands of the active mode already clamped */
+typedef struct GEQparam_s {
+    int32_t       enable;
+    int32_t       band_num;
+    int32_t       band[GEQ_BAND_MAX];
+    float         center[GEQ_BAND_MAX];
+    /* bumped for every change that has to go through a fade */
+    uint32_t      fade_seq;
+    /* bumped by EFFECT_CMD_INIT and EFFECT_CMD_RESET, the engine is
+     * (re)started by the audio thread */
+    uint32_t      init_seq;
+    uint32_t      reset_seq;
+} GEQparam;
+
+#ifdef GEQ_SOURCE_ENGINE
+
+/* one peaking biquad per band, the bands with a gain are run as one
+ * cascade over interleaved stereo. Owned by the audio thread. */
+typedef struct GEQengine_s {
+    uint32_t      sample_rate;
+    int32_t       band_num;
+    float         center[GEQ_BAND_MAX];
+    float         q[GEQ_BAND_MAX];
+    // band gains asked for, in dB
+    int32_t       gain[GEQ_BAND_MAX];
+    int32_t       dirty;
+    // inverse interaction matrix, gains the filters are designed with
+    float         inter[GEQ_BAND_MAX][GEQ_BAND_MAX];
+    float         design[GEQ_BAND_MAX];
+    AudioBiquadCoef_t coef[GEQ_BAND_MAX];
+    // band of each stage of the cascade
+    int32_t       active_num;
+    int32_t       active[GEQ_BAND_MAX];
+    AudioBiquad_t bank;
+    float         work[GEQ_BLOCK_FRAMES * 2];
+} GEQengine;
+
+/* Q of a band from the distance to its neighbours, so that the bands
+ * overlap the same way whatever centers the INI gives */
+static float GEQ_band_q(const float *center, int32_t band_num, int32_t band)
+{
+    double lo, hi, bw, w;
+
+    lo = band > 0 ? center[band - 1] : center[band];
+    hi = band < band_num - 1 ? center[band + 1] : center[band];
+    bw = log2(hi / lo);
+    if (band > 0 && band < band_num - 1)
+        bw *= 0.5;
+    bw *= GEQ_BAND_OVERLAP;
+    if (!(bw >= 0.1))
+        bw = band_num > 1 ? 0.1 : 1.0;
+    if (bw > 3.0)
+        bw = 3.0;
+    w = pow(2.0, bw);
+    return (float)(sqrt(w) / (w - 1.0));
+}
+
+/* Neighbouring bands add up at each other's centers. The interaction matrix
+ * holds what every band contributes at every center, its inverse gives the
+ * filter gains that put the response on the band gains at the centers. */
+static void GEQ_engine_interaction(GEQengine *eng)
+{
+    double m[GEQ_BAND_MAX][GEQ_BAND_MAX * 2];
+    AudioBiquadCoef_t c;
+    int32_t n = eng->band_num;
+    int32_t i, j, k, pivot;
+    double t;
+
+    for (j = 0; j < n; j++) {
+        AudioBiquadDesign(&c, AUDIO_BIQUAD_PEAK, eng->sample_rate, eng->center[j], eng->q[j], GEQ_GAIN_MAX);
+        for (i = 0; i < n; i++) {
+            m[i][j] = AudioBiquadResponseDb(&c, eng->sample_rate, eng->center[i]) / GEQ_GAIN_MAX;
+            m[i][n + j] = i == j ? 1.0 : 0.0;
+        }
+    }
+    // Gauss-Jordan with partial pivoting
+    for (k = 0; k < n; k++) {
+        pivot = k;
+        for (i = k + 1; i < n; i++) {
+            if (fabs(m[i][k]) > fabs(m[pivot][k]))
+                pivot = i;
+        }
+        if (fabs(m[pivot][k]) < 1e-6) {
+            // centers on top of each other, run the bands uncorrected
+            ALOGW("%s: band[%d] center %.0fHz overlaps, no correction", __FUNCTION__, k + 1, eng->center[k]);
+            for (i = 0; i < n; i++) {
+                for (j = 0; j < n; j++)
+                    eng->inter[i][j] = i == j ? 1.0f : 0.0f;
+            }
+            return;
+        }
+        if (pivot != k) {
+            for (j = 0; j < 2 * n; j++) {
+                t = m[k][j];
+                m[k][j] = m[pivot][j];
+                m[pivot][j] = t;
+            }
+        }
+        t = m[k][k];
+        for (j = 0; j < 2 * n; j++)
+            m[k][j] /= t;
+        for (i = 0; i < n; i++) {
+            if (i == k || m[i][k] == 0.0)
+                continue;
+            t = m[i][k];
+            for (j = 0; j < 2 * n; j++)
+                m[i][j] -= t * m[k][j];
+        }
+    }
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++)
+            eng->inter[i][j] = (float)m[i][n + j];
+    }
+}
+
+// redesign the filters after band gain changes
+static void GEQ_engine_update(GEQengine *eng)
+{
+    AudioBiquad_t *bank = &eng->bank;
+    float s1[GEQ_BAND_MAX][2], s2[GEQ_BAND_MAX][2];
+    int32_t i, j, k = 0;
+    float design;
+
+    if (!eng->dirty)
+        return;
+    eng->dirty = 0;
+    for (i = 0; i < eng->band_num; i++) {
+        s1[i][0] = s1[i][1] = s2[i][0] = s2[i][1] = 0.0f;
+    }
+    // state of the bands that run so far, by band
+    for (i = 0; i < eng->active_num; i++) {
+        j = eng->active[i];
+        memcpy(s1[j], bank->s1[i], sizeof(s1[j]));
+        memcpy(s2[j], bank->s2[i], sizeof(s2[j]));
+    }
+    for (i = 0; i < eng->band_num; i++) {
+        design = 0.0f;
+        for (j = 0; j < eng->band_num; j++)
+            design += eng->inter[i][j] * eng->gain[j];
+        if (fabsf(design) < GEQ_DESIGN_MIN)
+            design = 0.0f;
+        if (design != eng->design[i]) {
+            eng->design[i] = design;
+            AudioBiquadDesign(&eng->coef[i], AUDIO_BIQUAD_PEAK, eng->sample_rate, eng->center[i], eng->q[i], design);
+        }
+        // bands designed flat are not run, a band coming back in starts from rest
+        if (design != 0.0f)
+            eng->active[k++] = i;
+    }
+    eng->active_num = k;
+    AudioBiquadInit(bank, k, 2);
+    for (i = 0; i < k; i++) {
+        j = eng->active[i];
+        AudioBiquadSetCoef(bank, i, &eng->coef[j]);
+        memcpy(bank->s1[i], s1[j], sizeof(s1[j]));
+        memcpy(bank->s2[i], s2[j], sizeof(s2[j]));
+    }
+}
+
+/* (re)start the bank at a sample rate, the band gains are kept */
+static void GEQ_engine_init(GEQengine *eng, const GEQparam *params, uint32_t sample_rate)
+{
+    const float *center = params->center;
+    int32_t band_num = params->band_num;
+    int32_t i;
+
+    if (band_num > GEQ_BAND_MAX)
+        band_num = GEQ_BAND_MAX;
+    if (band_num < 0)
+        band_num = 0;
+    eng->sample_rate = sample_rate;
+    eng->band_num = band_num;
+    for (i = 0; i < band_num; i++) {
+        eng->center[i] = center[i];
+        eng->q[i] = GEQ_band_q(center, band_num, i);
+    }
+    GEQ_engine_interaction(eng);
+    // NAN forces every band to be designed again
+    for (i = 0; i < band_num; i++)
+        eng->design[i] = NAN;
+    eng->active_num = 0;
+    eng->dirty = 1;
+    GEQ_engine_update(eng);
+}
+
+static void GEQ_engine_reset(GEQengine *eng)
+{
+    AudioBiquadReset(&eng->bank);
+}
+
+// takes effect with the next GEQ_engine_update
+static void GEQ_engine_set_band(GEQengine *eng, int32_t band, int32_t gain)
+{
+    if (band < 0 || band >= eng->band_num)
+        return;
+    gain = gain < GEQ_GAIN_MIN ? GEQ_GAIN_MIN : (gain > GEQ_GAIN_MAX ? GEQ_GAIN_MAX : gain);
+    if (gain == eng->gain[band])
+        return;
+    eng->gain[band] = gain;
+    eng->dirty = 1;
+}
+
+/* stereo 16 bit in place or not, like the former GEQ_process_api */
+static void GEQ_engine_process(GEQengine *eng, const int16_t *in, int16_t *out, size_t frames)
+{
+    size_t n;
+
+    if (eng->active_num == 0) {
+        if (out != in)
+            memmove(out, in, frames * 2 * sizeof(int16_t));
+        return;
+    }
+    while (frames > 0) {
+        n = frames < GEQ_BLOCK_FRAMES ? frames : GEQ_BLOCK_FRAMES;
+        AudioConvertS16ToFloat(in, eng->work, n * 2);
+        AudioBiquadProcess(&eng->bank, eng->work, eng->work, n);
+        AudioConvertFloatToS16(eng->work, out, n * 2);
+        in += n * 2;
+        out += n * 2;
+        frames -= n;
+    }
+}
+
+static void GEQ_engine_process_float(GEQengine *eng, const float *in, float *out, size_t frames)
+{
+    AudioBiquadProcess(&eng->bank, in, out, frames);
+}
+
+static void GEQ_engine_release(GEQengine *eng __unused)
+{
+}
+
+#else
+
+/* The prebuilt libAmlGeq: 16 bit stereo only, and a single filter state
+ * shared by all the sessions. It stays the default until the response of
+ * the source engine has been compared with it mode by mode. */
+typedef struct GEQengine_s {
+    uint32_t      sample_rate;
+    // what GEQ_init_api() reads, kept for as long as the archive may use it
+    GEQdata       init_data;
+    int32_t       init_band[GEQ_BAND_MAX];
+} GEQengine;
+
+/* The init data is built from the snapshot: default bands of 0 as before,
+ * and a table of one mode holding the active bands. */
+static void GEQ_engine_init(GEQengine *eng, const GEQparam *params, uint32_t sample_rate)
+{
+    GEQdata *data = &eng->init_data;
+
+    memcpy(eng->init_band, params->band, sizeof(eng->init_band));
+    memset(data, 0, sizeof(GEQdata));
+    data->usr_cfg = eng->init_band;
+    data->enable = params->enable;
+    data->mode_num = 1;
+    data->band_num = params->band_num;
+    memcpy(data->center, params->center, sizeof(data->center));
+    eng->sample_rate = sample_rate;
+    GEQ_init_api((void *)data);
+}
+
+static void GEQ_engine_reset(GEQengine *eng __unused)
+{
+    GEQ_reset_api();
+}
+
+static void GEQ_engine_set_band(GEQengine *eng __unused, int32_t band, int32_t gain)
+{
+    GEQ_setBand_api(gain, band + 1);
+}
+
+static void GEQ_engine_update(GEQengine *eng __unused)
+{
+}
+
+static void GEQ_engine_process(GEQengine *eng __unused, const int16_t *in, int16_t *out, size_t frames)
+{
+    GEQ_process_api((short *)in, out, (int)frames);
+}
+
+static void GEQ_engine_release(GEQengine *eng __unused)
+{
+    GEQ_release_api();
+}
+
+#endif
+
 typedef struct GEQContext_s {
     const struct effect_interface_s *itfe;
     effect_config_t                 config;
@@ -119,14 +434,105 @@ typedef struct GEQContext_s {
     GEQdata                        gGEQdata;
 
     // when recieve setting change from app,
-    //"fade audio out->do setting->fade audio In"
+    // crossfade from the old bands to the new ones
     int                             bUseFade;
     AudioFade_t                     gAudFade;
+    AudioCrossFade_t                gCrossFade;
     int32_t                         modeValue;
+
+    ParamSnapshot_t                 params;
+    uint32_t                        fade_seq;       // control thread
+    uint32_t                        init_seq;       // control thread
+    uint32_t                        reset_seq;      // control thread
+    uint32_t                        fade_seq_done;  // audio thread
+    uint32_t                        init_seq_done;  // audio thread
+    uint32_t                        reset_seq_done; // audio thread
+
+    GEQengine                       engine;
+    AudioSilence_t                  silence;
+    AudioAccumulate_t               accumulate;
 } GEQContext;
 
 const char *GEQStatusstr[] = {"Disable", "Enable"};
 
+static void GEQ_get_params(GEQContext *pContext, GEQparam *params)
+{
+    GEQdata *data = &pContext->gGEQdata;
+    int32_t i, band;
+
+    memset(params, 0, sizeof(GEQparam));
+    params->enable = data->enable;
+    params->band_num = data->band_num < GEQ_BAND_MAX ? data->band_num : GEQ_BAND_MAX;
+    memcpy(params->center, data->center, sizeof(params->center));
+    params->fade_seq = pContext->fade_seq;
+    params->init_seq = pContext->init_seq;
+    params->reset_seq = pContext->reset_seq;
+    if (data->usr_cfg == NULL)
+        return;
+    for (i = 0; i < params->band_num; i++) {
+        band = data->usr_cfg[pContext->modeValue * data->band_num + i];
+        params->band[i] = band < GEQ_GAIN_MIN ? GEQ_GAIN_MIN : (band > GEQ_GAIN_MAX ? GEQ_GAIN_MAX : band);
+    }
+}
+
+/* hand the current settings to the audio thread, the bands are applied there */
+static void GEQ_publish(GEQContext *pContext, int needFade)
+{
+    GEQparam params;
+
+    if (needFade)
+        pContext->fade_seq++;
+    GEQ_get_params(pContext, &params);
+    ParamSnapshotPublish(&pContext->params, &params);
+}
+
+static void GEQ_apply_bands(GEQContext *pContext, const GEQparam *params)
+{
+    int32_t i;
+
+    for (i = 0; i < params->band_num; i++) {
+        ALOGV("%s: Set band[%d] -> %d", __FUNCTION__, i + 1, params->band[i]);
+        GEQ_engine_set_band(&pContext->engine, i, params->band[i]);
+    }
+    GEQ_engine_update(&pContext->engine);
+}
+
+/* switch to the new bands inside this block: the crossfade window is run
+ * with both band sets and blended, the rest with the new bands only */
+static void GEQ_process_crossfade(GEQContext *pContext, const GEQparam *params,
+        int16_t *in, int16_t *out, unsigned int nSamples)
+{
+    AudioFade_t *pAudFade = &pContext->gAudFade;
+    AudioCrossFade_t *pCross = &pContext->gCrossFade;
+    GEQengine *eng = &pContext->engine;
+    unsigned int nCross = AudioCrossFadeFrames(pAudFade, nSamples);
+    unsigned int nPreRoll;
+
+    pAudFade->mFadeState = AUD_FADE_IDLE;
+    if (nCross == 0) {
+        GEQ_apply_bands(pContext, params);
+        AudioCrossFadeKeep(pAudFade, pCross, in, nSamples);
+        GEQ_engine_process(eng, in, out, nSamples);
+        return;
+    }
+
+    memcpy(pCross->input, in, nCross * 2 * sizeof(int16_t));
+    GEQ_engine_process(eng, pCross->input, pCross->old, nCross);
+
+    // warm the filters up with the new bands on the preceding input
+    GEQ_apply_bands(pContext, params);
+    nPreRoll = AudioCrossFadePreRoll(pAudFade, pCross);
+    if (nPreRoll != 0)
+        GEQ_engine_process(eng, pCross->preRoll, pCross->preRoll, nPreRoll);
+    AudioCrossFadeKeep(pAudFade, pCross, in, nSamples);
+
+    GEQ_engine_process(eng, pCross->input, out, nCross);
+    AudioCrossFadeBuf(pAudFade, pCross->old, out, nCross);
+    if (nSamples > nCross)
+        GEQ_engine_process(eng, in + nCross * 2, out + nCross * 2, nSamples - nCross);
+    ALOGV("%s: crossfade %u of %u frames, pre-roll %u", __FUNCTION__, nCross, nSamples, nPreRoll);
+}
+
 static int getprop_bool(const char *path)
 {
     char buf[PROPERTY_VALUE_MAX];
@@ -214,6 +620,31 @@ int GEQ_parse_mode_config(GEQContext *pContext, int mode_num, int band_num, cons
     return 0;
 }
 
+/* "63,176,..." in Hz, bands not given keep their default center */
+int GEQ_parse_band_center(GEQContext *pContext, int band_num, const char *buffer)
+{
+    int i;
+    const char *p = buffer;
+    char *end = NULL;
+    float fc;
+    GEQdata *data = &pContext->gGEQdata;
+
+    for (i = 0; i < band_num && i < GEQ_BAND_MAX; i++) {
+        fc = strtof(p, &end);
+        if (end == p || !(fc > 0.0f)) {
+            ALOGE("%s: band[%d] center parse failed, using default", __FUNCTION__, i + 1);
+            return -1;
+        }
+        data->center[i] = fc;
+        ALOGD("%s: band[%d] center -> %.0fHz", __FUNCTION__, i + 1, fc);
+        p = end;
+        while (*p == ',' || *p == ' ')
+            p++;
+    }
+
+    return 0;
+}
+
 int GEQ_load_ini_file(GEQContext *pContext)
 {
     int result = -1;
@@ -247,6 +678,9 @@ int GEQ_load_ini_file(GEQContext *pContext)
         goto error;
     ALOGD("%s: sound band num -> %s", __FUNCTION__, ini_value);
     data->band_num = atoi(ini_value);
+    ini_value = pIniParser->GetString("Geq", "geq_band_center", "NULL");
+    if (ini_value != NULL && strcmp(ini_value, "NULL") != 0)
+        GEQ_parse_band_center(pContext, data->band_num, ini_value);
     // level parse
     ini_value = pIniParser->GetString("Geq", "geq_config", "NULL");
     if (ini_value == NULL)
@@ -295,15 +729,18 @@ int GEQ_init(GEQContext *pContext)
     data->cfg.band8 = 0/*data->usr_cfg[(count >> LSR) + 1].band8*/;
     data->cfg.band9 = 0/*data->usr_cfg[(count >> LSR) + 1].band9*/;
 
-    GEQ_init_api((void *)data);
+    // the engine is started by the audio thread
+    pContext->init_seq++;
+    GEQ_publish(pContext, 0);
 
     ALOGD("%s: sucessful", __FUNCTION__);
 
     return 0;
 }
-int GEQ_reset(GEQContext *pContext __unused)
+int GEQ_reset(GEQContext *pContext)
 {
-    GEQ_reset_api();
+    pContext->reset_seq++;
+    GEQ_publish(pContext, 0);
     return 0;
 }
 
@@ -322,7 +759,12 @@ int GEQ_configure(GEQContext *pContext, effect_config_t *pConfig)
     if (pConfig->outputCfg.accessMode != EFFECT_BUFFER_ACCESS_WRITE &&
             pConfig->outputCfg.accessMode != EFFECT_BUFFER_ACCESS_ACCUMULATE)
         return -EINVAL;
+#ifdef GEQ_SOURCE_ENGINE
+    if (pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT &&
+            pConfig->inputCfg.format != AUDIO_FORMAT_PCM_FLOAT) {
+#else
     if (pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT) {
+#endif
         ALOGW("%s: format in = 0x%x format out = 0x%x", __FUNCTION__, pConfig->inputCfg.format, pConfig->outputCfg.format);
         pConfig->inputCfg.format = pConfig->outputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
     }
@@ -405,31 +847,22 @@ int GEQ_setParameter(GEQContext *pContext, void *pParam, void *pValue)
     case GEQ_PARAM_ENABLE:
         value = *(int32_t *)pValue;
         data->enable = value;
+        GEQ_publish(pContext, 0);
         ALOGD("%s: Set status -> %s", __FUNCTION__, GEQStatusstr[value]);
         break;
     case GEQ_PARAM_EFFECT_MODE:
         value = *(int32_t *)pValue;
-        if (value < 0 || value > data->mode_num) {
+        if (value < 0 || value >= data->mode_num) {
             ALOGE("%s: incorrect mode value %d", __FUNCTION__, value);
             return -EINVAL;
         }
         data->mode = value;
         pContext->modeValue = data->mode;
         ALOGD("%s: Set Mode -> %d, bUseFade = %d", __FUNCTION__, value , pContext->bUseFade);
-        if (pContext->bUseFade) {
-            AudioFade_t *pAudioFade = (AudioFade_t *) & (pContext->gAudFade);
-            AudioFadeInit(pAudioFade, fadeLinear, 10, 0);
-            AudioFadeSetState(pAudioFade, AUD_FADE_OUT_START);
-        } else {
-            for (i = 0; i < data->band_num; i++) {
-                ALOGD("%s: Set band[%d] -> %d", __FUNCTION__, i + 1, data->usr_cfg[value * data->band_num + i]);
-                if (data->usr_cfg[data->mode * data->band_num + i] < -10)
-                    data->usr_cfg[data->mode * data->band_num + i] = -10;
-                else if (data->usr_cfg[data->mode * data->band_num + i] > 10)
-                    data->usr_cfg[data->mode * data->band_num + i] = 10;
-                GEQ_setBand_api(data->usr_cfg[data->mode * data->band_num + i], i + 1);
-            }
+        for (i = 0; i < data->band_num; i++) {
+            ALOGD("%s: Set band[%d] -> %d", __FUNCTION__, i + 1, data->usr_cfg[value * data->band_num + i]);
         }
+        GEQ_publish(pContext, pContext->bUseFade);
         break;
     case GEQ_PARAM_EFFECT_CUSTOM:
         custom_value = *(GEQcfg_8bit_s *)pValue;
@@ -453,20 +886,10 @@ int GEQ_setParameter(GEQContext *pContext, void *pParam, void *pValue)
 
         pContext->modeValue = data->mode_num - 1;
         ALOGD("%s: Set Mode -> %d, bUseFade = %d", __FUNCTION__, pContext->modeValue , pContext->bUseFade);
-        if (pContext->bUseFade && needFade) {
-            AudioFade_t *pAudioFade = (AudioFade_t *) & (pContext->gAudFade);
-            AudioFadeInit(pAudioFade, fadeLinear, 10, 0);
-            AudioFadeSetState(pAudioFade, AUD_FADE_OUT_START);
-        } else {
-            for (i = 0; i < data->band_num; i++) {
-                ALOGD("%s: Set band[%d] -> %d", __FUNCTION__, i + 1, data->usr_cfg[(data->mode_num - 1) * data->band_num + i]);
-                if (data->usr_cfg[(data->mode_num - 1) * data->band_num + i] > 10)
-                    data->usr_cfg[(data->mode_num - 1) * data->band_num + i] = 10;
-                else if ( data->usr_cfg[(data->mode_num - 1) * data->band_num + i] < -10)
-                    data->usr_cfg[(data->mode_num - 1) * data->band_num + i] = -10;
-                GEQ_setBand_api(data->usr_cfg[(data->mode_num - 1) * data->band_num + i], i + 1);
-            }
+        for (i = 0; i < data->band_num; i++) {
+            ALOGD("%s: Set band[%d] -> %d", __FUNCTION__, i + 1, data->usr_cfg[(data->mode_num - 1) * data->band_num + i]);
         }
+        GEQ_publish(pContext, pContext->bUseFade && needFade);
     break;
     default:
         ALOGE("%s: unknown param %08x", __FUNCTION__, param);
@@ -479,11 +902,12 @@ int GEQ_setParameter(GEQContext *pContext, void *pParam, void *pValue)
 int GEQ_release(GEQContext *pContext)
 {
     GEQdata *data = &pContext->gGEQdata;
-    GEQ_release_api();
+    GEQ_engine_release(&pContext->engine);
     if (data->usr_cfg != NULL) {
         free(data->usr_cfg);
         data->usr_cfg = NULL;
     }
+    ParamSnapshotRelease(&pContext->params);
     return 0;
 }
 
@@ -507,116 +931,111 @@ int GEQ_process(effect_handle_t self, audio_buffer_t *inBuffer, audio_buffer_t *
     }
     int16_t *in  = (int16_t *)inBuffer->raw;
     int16_t *out = (int16_t *)outBuffer->raw;
-    GEQdata *data = &pContext->gGEQdata;
-    if (!data->enable) {
-        for (size_t i = 0; i < inBuffer->frameCount; i++) {
-            *out++ = *in++;
-            *out++ = *in++;
+    GEQengine *eng = &pContext->engine;
+    int changed;
+    const GEQparam *params = (const GEQparam *)ParamSnapshotAcquire(&pContext->params, &changed);
+    if (params->init_seq != pContext->init_seq_done ||
+            eng->sample_rate != pContext->config.inputCfg.samplingRate) {
+        // EFFECT_CMD_INIT or a new rate from EFFECT_CMD_SET_CONFIG,
+        // (re)start the engine and set the bands again
+        pContext->init_seq_done = params->init_seq;
+        GEQ_engine_init(eng, params, pContext->config.inputCfg.samplingRate);
+        changed = 1;
+    }
+    if (params->reset_seq != pContext->reset_seq_done) {
+        pContext->reset_seq_done = params->reset_seq;
+        GEQ_engine_reset(eng);
+    }
+    if (changed) {
+        AudioFade_t *pAudFade = (AudioFade_t *) & (pContext->gAudFade);
+        if (pContext->bUseFade && params->fade_seq != pContext->fade_seq_done) {
+            // bands are switched by a crossfade in the next processed block
+            pContext->fade_seq_done = params->fade_seq;
+            AudioFadeInit(pAudFade, fadeLinear, DEFAULT_CROSSFADE_MS, 0);
+            AudioFadeSetState(pAudFade, AUD_FADE_CROSS);
+        } else if (pAudFade->mFadeState != AUD_FADE_CROSS) {
+            GEQ_apply_bands(pContext, params);
         }
-    } else {
-        if (pContext->bUseFade) {
-            int i;
-            AudioFade_t *pAudFade = (AudioFade_t *) & (pContext->gAudFade);
-            unsigned int modeValue;
-            unsigned int nSamples = (unsigned int)inBuffer->frameCount;
-
-            if (pAudFade->mFadeState != AUD_FADE_IDLE) {
-                ALOGI("%s: mFadeState -> %d, mCurrentVolume = %d,nSamples = %d", __FUNCTION__, pAudFade->mFadeState, pAudFade->mCurrentVolume, nSamples);
-            }
+    }
+    size_t frame_size = 2 * (pContext->config.inputCfg.format == AUDIO_FORMAT_PCM_FLOAT ? sizeof(float) : sizeof(int16_t));
+    int accumulate = AudioAccumulateNeeded(&pContext->accumulate, &pContext->config, inBuffer, outBuffer);
+    if (!params->enable) {
+        if (pContext->gAudFade.mFadeState == AUD_FADE_CROSS) {
+            GEQ_apply_bands(pContext, params);
+            pContext->gAudFade.mFadeState = AUD_FADE_IDLE;
+        }
+        // stale once the input is no longer followed
+        pContext->gCrossFade.preRollFrames = 0;
+        AudioBypass(&pContext->config, accumulate, inBuffer, outBuffer);
+        return 0;
+    }
+    if (accumulate)
+        return AudioAccumulateProcess(&pContext->accumulate, self, &pContext->config, inBuffer, outBuffer);
+    if (AudioSilenceDetect(&pContext->silence, inBuffer->raw, inBuffer->frameCount,
+            frame_size, pContext->config.inputCfg.samplingRate)) {
+        // silent past the tail, there is nothing to crossfade or to keep
+        if (pContext->gAudFade.mFadeState == AUD_FADE_CROSS) {
+            GEQ_apply_bands(pContext, params);
+            pContext->gAudFade.mFadeState = AUD_FADE_IDLE;
+        }
+        pContext->gCrossFade.preRollFrames = 0;
+        AudioBypass(&pContext->config, 0, inBuffer, outBuffer);
+        return 0;
+    }
+#ifdef GEQ_SOURCE_ENGINE
+    if (pContext->config.inputCfg.format == AUDIO_FORMAT_PCM_FLOAT) {
+        // the crossfade buffers are 16 bit only, switch the bands at once
+        if (pContext->gAudFade.mFadeState == AUD_FADE_CROSS) {
+            GEQ_apply_bands(pContext, params);
+            pContext->gAudFade.mFadeState = AUD_FADE_IDLE;
+        }
+        pContext->gCrossFade.preRollFrames = 0;
+        GEQ_engine_process_float(eng, (float *)inBuffer->raw, (float *)outBuffer->raw, inBuffer->frameCount);
+        return 0;
+    }
+#endif
+    if (pContext->bUseFade) {
+        AudioFade_t *pAudFade = (AudioFade_t *) & (pContext->gAudFade);
+        unsigned int nSamples = (unsigned int)inBuffer->frameCount;
 
-            // do audio traisition
-            switch (pAudFade->mFadeState) {
-            case AUD_FADE_OUT_START: {
-                pAudFade->mTargetVolume = 0;
-                pAudFade->mStartVolume = 1 << 16;
-                pAudFade->mCurrentVolume = 1 << 16;
-                pAudFade->mfadeTimeUsed = 0;
-                pAudFade->mfadeFramesUsed = 0;
-                pAudFade->mfadeTimeTotal = DEFAULT_FADE_OUT_MS;
-                pAudFade->muteCounts = 1;
-                AudioFadeBuf(pAudFade, in, nSamples);
-                pAudFade->mFadeState = AUD_FADE_OUT;
-            }
-            break;
-            case AUD_FADE_OUT: {
-                // do fade out process
-                if (pAudFade->mCurrentVolume != 0) {
-                    AudioFadeBuf(pAudFade, in, nSamples);
-                } else {
-                    pAudFade->mFadeState = AUD_FADE_MUTE;
-                    // do actrually setting
-                    modeValue = pContext->modeValue;
-                    for (i = 0; i < data->band_num; i++) {
-                        ALOGD("%s: Set band[%d] -> %d", __FUNCTION__, i + 1, data->usr_cfg[modeValue * data->band_num + i]);
-                        GEQ_setBand_api(data->usr_cfg[modeValue * data->band_num + i], i + 1);
-                    }
-                    mutePCMBuf(pAudFade, in, nSamples);
-                }
-            }
-            break;
-            case AUD_FADE_MUTE: {
-                if (pAudFade->muteCounts <= 0) {
-                    pAudFade->mFadeState = AUD_FADE_IN;
-                    // slowly increase audio volume
-                    pAudFade->mTargetVolume = 1 << 16;
-                    pAudFade->mStartVolume = 0;
-                    pAudFade->mCurrentVolume = 0;
-                    pAudFade->mfadeTimeUsed = 0;
-                    pAudFade->mfadeFramesUsed = 0;
-                    pAudFade->mfadeTimeTotal = DEFAULT_FADE_IN_MS;
-                    mutePCMBuf(pAudFade, in, nSamples);
-                } else {
-                    mutePCMBuf(pAudFade, in, nSamples);
-                    pAudFade->muteCounts--;
-                }
-            }
-            break;
-            case AUD_FADE_IN: {
-                AudioFadeBuf(pAudFade, in, nSamples);
-                if (pAudFade->mCurrentVolume == 1 << 16) {
-                    pAudFade->mFadeState = AUD_FADE_IDLE;
-                }
-            }
-            break;
-            case AUD_FADE_IDLE:
-                // do nothing
-                break;
-            default:
-                break;
-            }
+        if (pAudFade->mFadeState == AUD_FADE_CROSS) {
+            GEQ_process_crossfade(pContext, params, in, out, nSamples);
+            return 0;
+        }
+        // input preceding the next crossfade
+        AudioCrossFadeKeep(pAudFade, &pContext->gCrossFade, in, nSamples);
 
 #if 0
-            if (getprop_bool("media.audiofade.dump1")) {
-                FILE *dump_fp = NULL;
-                dump_fp = fopen("/data/audio_hal/audio_in.pcm", "a+");
-                if (dump_fp != NULL) {
-                    fwrite(in, nSamples * 2 * 2, 1, dump_fp);
-                    fclose(dump_fp);
-                } else {
-                    ALOGW("[Error] Can't write to /data/dump_in.pcm");
-                }
+        if (getprop_bool("media.audiofade.dump1")) {
+            FILE *dump_fp = NULL;
+            dump_fp = fopen("/data/audio_hal/audio_in.pcm", "a+");
+            if (dump_fp != NULL) {
+                fwrite(in, nSamples * 2 * 2, 1, dump_fp);
+                fclose(dump_fp);
+            } else {
+                ALOGW("[Error] Can't write to /data/dump_in.pcm");
             }
+        }
 #endif
 
-            GEQ_process_api(in, out, inBuffer->frameCount);
+        GEQ_engine_process(eng, in, out, inBuffer->frameCount);
 
 #if 0
-            if (getprop_bool("media.audiofade.dump1")) {
-                FILE *dump_fp = NULL;
-                dump_fp = fopen("/data/audio_hal/audio_out.pcm", "a+");
-                if (dump_fp != NULL) {
-                    fwrite(out, nSamples * 2 * 2, 1, dump_fp);
-                    fclose(dump_fp);
-                } else {
-                    ALOGW("[Error] Can't write to /data/dump_in.pcm");
-                }
+        if (getprop_bool("media.audiofade.dump1")) {
+            FILE *dump_fp = NULL;
+            dump_fp = fopen("/data/audio_hal/audio_out.pcm", "a+");
+            if (dump_fp != NULL) {
+                fwrite(out, nSamples * 2 * 2, 1, dump_fp);
+                fclose(dump_fp);
+            } else {
+                ALOGW("[Error] Can't write to /data/dump_in.pcm");
             }
+        }
 #endif
 
-        } else {
-            // original processing
-            GEQ_process_api(in, out, inBuffer->frameCount);
-        }
+    } else {
+        // original processing
+        GEQ_engine_process(eng, in, out, inBuffer->frameCount);
     }
     return 0;
 }
@@ -742,10 +1161,21 @@ int GEQLib_Create(const effect_uuid_t *uuid, int32_t sessionId __unused, int32_t
         return -EINVAL;
     }
     memset(pContext, 0, sizeof(GEQContext));
+    memcpy(pContext->gGEQdata.center, GEQ_default_center, sizeof(GEQ_default_center));
+    pContext->gGEQdata.band_num = GEQ_BAND_MAX;
     if (GEQ_load_ini_file(pContext) < 0) {
         ALOGE("%s: Load INI File faied, use default param", __FUNCTION__);
         pContext->gGEQdata.enable = 1;
     }
+    GEQparam params;
+    GEQ_get_params(pContext, &params);
+    if (ParamSnapshotInit(&pContext->params, &params, sizeof(GEQparam)) < 0) {
+        free(pContext->gGEQdata.usr_cfg);
+        delete pContext;
+        return -EINVAL;
+    }
+
+    AudioSilenceInit(&pContext->silence, GEQ_TAIL_MS);
 
     pContext->itfe = &GEQInterface;
     pContext->state = GEQ_STATE_UNINITIALIZED;
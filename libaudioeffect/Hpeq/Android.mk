@@ -24,6 +24,9 @@ LOCAL_C_INCLUDES := \
 
 LOCAL_SRC_FILES += Hpeq.cpp
 LOCAL_SRC_FILES += ../Utility/AudioFade.c
+LOCAL_SRC_FILES += ../Utility/AudioSilence.c
+LOCAL_SRC_FILES += ../Utility/AudioBypass.c
+LOCAL_SRC_FILES += ../Utility/ParamSnapshot.c
 
 LOCAL_LDFLAGS_arm  += $(LOCAL_PATH)/libAmlHpeq.a
 LOCAL_LDFLAGS_arm64 += $(LOCAL_PATH)/libAmlHpeq64.a
@@ -43,9 +43,15 @@ extern "C" {
 
 #include "libAmlHpeq.h"
 #include "../Utility/AudioFade.h"
+#include "../Utility/AudioSilence.h"
+#include "../Utility/AudioBypass.h"
+#include "../Utility/ParamSnapshot.h"
 
 #define MODEL_SUM_DEFAULT_PATH "/vendor/etc/tvconfig/model/model_sum.ini"
 #define AUDIO_EFFECT_DEFAULT_PATH "/vendor/etc/tvconfig/audio/AMLOGIC_AUDIO_EFFECT_DEFAULT.ini"
+// ring out time of the narrowest low band
+#define HPEQ_TAIL_MS 200
+#define HPEQ_BAND_MAX 16
 
 // effect_handle_t interface implementation for HPEQ effect
 extern const struct effect_interface_s HPEQInterface;
@@ -103,6 +109,17 @@ typedef struct HPEQdata_s {
     int32_t       band_num;
 } HPEQdata;
 
+/* snapshot read by HPEQ_process, bands of the active mode */
+typedef struct HPEQparam_s {
+    int32_t       enable;
+    int32_t       band_num;
+    int32_t       band[HPEQ_BAND_MAX];
+    /* bumped for every change that has to go through a fade */
+    uint32_t      fade_seq;
+    /* bumped by EFFECT_CMD_RESET, the library is reset by the audio thread */
+    uint32_t      reset_seq;
+} HPEQparam;
+
 typedef struct HPEQContext_s {
     const struct effect_interface_s *itfe;
     effect_config_t                 config;
@@ -110,10 +127,19 @@ typedef struct HPEQContext_s {
     HPEQdata                        gHPEQdata;
 
     // when recieve setting change from app,
-    //"fade audio out->do setting->fade audio In"
+    // crossfade from the old bands to the new ones
     int                             bUseFade;
     AudioFade_t                     gAudFade;
+    AudioCrossFade_t                gCrossFade;
+    AudioSilence_t                  silence;
+    AudioAccumulate_t               accumulate;
     int32_t                         modeValue;
+
+    ParamSnapshot_t                 params;
+    uint32_t                        fade_seq;       // control thread
+    uint32_t                        reset_seq;      // control thread
+    uint32_t                        fade_seq_done;  // audio thread
+    uint32_t                        reset_seq_done; // audio thread
 } HPEQContext;
 
 const char *HPEQStatusstr[] = {"Disable", "Enable"};
@@ -298,9 +324,37 @@ int HPEQ_init(HPEQContext *pContext)
     return 0;
 }
 
-int HPEQ_reset(HPEQContext *pContext __unused)
+static void HPEQ_get_params(HPEQContext *pContext, HPEQparam *params)
 {
-    HPEQ_reset_api();
+    HPEQdata *data = &pContext->gHPEQdata;
+    int32_t i;
+
+    memset(params, 0, sizeof(HPEQparam));
+    params->enable = data->enable;
+    params->band_num = data->band_num < HPEQ_BAND_MAX ? data->band_num : HPEQ_BAND_MAX;
+    params->fade_seq = pContext->fade_seq;
+    params->reset_seq = pContext->reset_seq;
+    if (data->usr_cfg == NULL)
+        return;
+    for (i = 0; i < params->band_num; i++)
+        params->band[i] = data->usr_cfg[pContext->modeValue * data->band_num + i];
+}
+
+/* hand the current settings to the audio thread, the bands are applied there */
+static void HPEQ_publish(HPEQContext *pContext, int needFade)
+{
+    HPEQparam params;
+
+    if (needFade)
+        pContext->fade_seq++;
+    HPEQ_get_params(pContext, &params);
+    ParamSnapshotPublish(&pContext->params, &params);
+}
+
+int HPEQ_reset(HPEQContext *pContext)
+{
+    pContext->reset_seq++;
+    HPEQ_publish(pContext, 0);
     return 0;
 }
 
@@ -398,27 +452,22 @@ int HPEQ_setParameter(HPEQContext *pContext, void *pParam, void *pValue)
     case HPEQ_PARAM_ENABLE:
         value = *(int32_t *)pValue;
         data->enable = value;
+        HPEQ_publish(pContext, 0);
         ALOGD("%s: Set status -> %s", __FUNCTION__, HPEQStatusstr[value]);
         break;
     case HPEQ_PARAM_EFFECT_MODE:
         value = *(int32_t *)pValue;
-        if (value < 0 || value > data->mode_num) {
+        if (value < 0 || value >= data->mode_num) {
             ALOGE("%s: incorrect mode value %d", __FUNCTION__, value);
             return -EINVAL;
         }
         data->mode = value;
         pContext->modeValue = data->mode;
         ALOGD("%s: Set Mode -> %d, bUseFade = %d", __FUNCTION__, value , pContext->bUseFade);
-        if (pContext->bUseFade) {
-            AudioFade_t *pAudioFade = (AudioFade_t *) & (pContext->gAudFade);
-            AudioFadeInit(pAudioFade, fadeLinear, 10, 0);
-            AudioFadeSetState(pAudioFade, AUD_FADE_OUT_START);
-        } else {
-            for (i = 0; i < data->band_num; i++) {
-                ALOGD("%s: Set band[%d] -> %d", __FUNCTION__, i + 1, data->usr_cfg[value * data->band_num + i]);
-                HPEQ_setBand_api(data->usr_cfg[data->mode * data->band_num + i], i + 1);
-            }
+        for (i = 0; i < data->band_num; i++) {
+            ALOGD("%s: Set band[%d] -> %d", __FUNCTION__, i + 1, data->usr_cfg[value * data->band_num + i]);
         }
+        HPEQ_publish(pContext, pContext->bUseFade);
         break;
     case HPEQ_PARAM_EFFECT_CUSTOM:
         custom_value = *(HPEQcfg_8bit_s *)pValue;
@@ -438,16 +487,10 @@ int HPEQ_setParameter(HPEQContext *pContext, void *pParam, void *pValue)
 
         pContext->modeValue = data->mode_num - 1;
         ALOGD("%s: Set Mode -> %d, bUseFade = %d", __FUNCTION__, pContext->modeValue , pContext->bUseFade);
-        if (pContext->bUseFade && needFade) {
-            AudioFade_t *pAudioFade = (AudioFade_t *) & (pContext->gAudFade);
-            AudioFadeInit(pAudioFade, fadeLinear, 10, 0);
-            AudioFadeSetState(pAudioFade, AUD_FADE_OUT_START);
-        } else {
-            for (i = 0; i < data->band_num; i++) {
-                ALOGD("%s: Set band[%d] -> %d", __FUNCTION__, i + 1, data->usr_cfg[(data->mode_num - 1) * data->band_num + i]);
-                HPEQ_setBand_api(data->usr_cfg[(data->mode_num - 1) * data->band_num + i], i + 1);
-            }
+        for (i = 0; i < data->band_num; i++) {
+            ALOGD("%s: Set band[%d] -> %d", __FUNCTION__, i + 1, data->usr_cfg[(data->mode_num - 1) * data->band_num + i]);
         }
+        HPEQ_publish(pContext, pContext->bUseFade && needFade);
     break;
     default:
         ALOGE("%s: unknown param %08x", __FUNCTION__, param);
@@ -457,6 +500,51 @@ int HPEQ_setParameter(HPEQContext *pContext, void *pParam, void *pValue)
     return 0;
 }
 
+static void HPEQ_apply_bands(const HPEQparam *params)
+{
+    int32_t i;
+
+    for (i = 0; i < params->band_num; i++) {
+        ALOGV("%s: Set band[%d] -> %d", __FUNCTION__, i + 1, params->band[i]);
+        HPEQ_setBand_api(params->band[i], i + 1);
+    }
+}
+
+/* switch to the new bands inside this block: the crossfade window is run
+ * with both band sets and blended, the rest with the new bands only */
+static void HPEQ_process_crossfade(HPEQContext *pContext, const HPEQparam *params,
+        int16_t *in, int16_t *out, unsigned int nSamples)
+{
+    AudioFade_t *pAudFade = &pContext->gAudFade;
+    AudioCrossFade_t *pCross = &pContext->gCrossFade;
+    unsigned int nCross = AudioCrossFadeFrames(pAudFade, nSamples);
+    unsigned int nPreRoll;
+
+    pAudFade->mFadeState = AUD_FADE_IDLE;
+    if (nCross == 0) {
+        HPEQ_apply_bands(params);
+        AudioCrossFadeKeep(pAudFade, pCross, in, nSamples);
+        HPEQ_process_api(in, out, nSamples);
+        return;
+    }
+
+    memcpy(pCross->input, in, nCross * 2 * sizeof(int16_t));
+    HPEQ_process_api(pCross->input, pCross->old, nCross);
+
+    // warm the filters up with the new bands on the preceding input
+    HPEQ_apply_bands(params);
+    nPreRoll = AudioCrossFadePreRoll(pAudFade, pCross);
+    if (nPreRoll != 0)
+        HPEQ_process_api(pCross->preRoll, pCross->preRoll, nPreRoll);
+    AudioCrossFadeKeep(pAudFade, pCross, in, nSamples);
+
+    HPEQ_process_api(pCross->input, out, nCross);
+    AudioCrossFadeBuf(pAudFade, pCross->old, out, nCross);
+    if (nSamples > nCross)
+        HPEQ_process_api(in + nCross * 2, out + nCross * 2, nSamples - nCross);
+    ALOGV("%s: crossfade %u of %u frames, pre-roll %u", __FUNCTION__, nCross, nSamples, nPreRoll);
+}
+
 int HPEQ_release(HPEQContext *pContext)
 {
     HPEQdata *data = &pContext->gHPEQdata;
@@ -465,6 +553,7 @@ int HPEQ_release(HPEQContext *pContext)
         free(data->usr_cfg);
         data->usr_cfg = NULL;
     }
+    ParamSnapshotRelease(&pContext->params);
     return 0;
 }
 
@@ -488,83 +577,54 @@ int HPEQ_process(effect_handle_t self, audio_buffer_t *inBuffer, audio_buffer_t
     }
     int16_t *in  = (int16_t *)inBuffer->raw;
     int16_t *out = (int16_t *)outBuffer->raw;
-    HPEQdata *data = &pContext->gHPEQdata;
-    if (!data->enable) {
-        for (size_t i = 0; i < inBuffer->frameCount; i++) {
-            *out++ = *in++;
-            *out++ = *in++;
+    int changed;
+    const HPEQparam *params = (const HPEQparam *)ParamSnapshotAcquire(&pContext->params, &changed);
+    if (changed) {
+        AudioFade_t *pAudFade = (AudioFade_t *) & (pContext->gAudFade);
+        if (params->reset_seq != pContext->reset_seq_done) {
+            pContext->reset_seq_done = params->reset_seq;
+            HPEQ_reset_api();
+        }
+        if (pContext->bUseFade && params->fade_seq != pContext->fade_seq_done) {
+            // bands are switched by a crossfade in the next processed block
+            pContext->fade_seq_done = params->fade_seq;
+            AudioFadeInit(pAudFade, fadeLinear, DEFAULT_CROSSFADE_MS, 0);
+            AudioFadeSetState(pAudFade, AUD_FADE_CROSS);
+        } else if (pAudFade->mFadeState != AUD_FADE_CROSS) {
+            HPEQ_apply_bands(params);
+        }
+    }
+    int accumulate = AudioAccumulateNeeded(&pContext->accumulate, &pContext->config, inBuffer, outBuffer);
+    if (!params->enable) {
+        if (pContext->gAudFade.mFadeState == AUD_FADE_CROSS) {
+            HPEQ_apply_bands(params);
+            pContext->gAudFade.mFadeState = AUD_FADE_IDLE;
         }
+        // stale once the input is no longer followed
+        pContext->gCrossFade.preRollFrames = 0;
+        AudioBypass(&pContext->config, accumulate, inBuffer, outBuffer);
+    } else if (accumulate) {
+        return AudioAccumulateProcess(&pContext->accumulate, self, &pContext->config, inBuffer, outBuffer);
+    } else if (AudioSilenceDetect(&pContext->silence, in, inBuffer->frameCount,
+            2 * sizeof(int16_t), pContext->config.inputCfg.samplingRate)) {
+        // silent past the tail, no library call and nothing to crossfade
+        if (pContext->gAudFade.mFadeState == AUD_FADE_CROSS) {
+            HPEQ_apply_bands(params);
+            pContext->gAudFade.mFadeState = AUD_FADE_IDLE;
+        }
+        pContext->gCrossFade.preRollFrames = 0;
+        AudioBypass(&pContext->config, 0, inBuffer, outBuffer);
     } else {
         if (pContext->bUseFade) {
-            int i;
             AudioFade_t *pAudFade = (AudioFade_t *) & (pContext->gAudFade);
-            unsigned int modeValue;
             unsigned int nSamples = (unsigned int)inBuffer->frameCount;
 
-            if (pAudFade->mFadeState != AUD_FADE_IDLE) {
-                ALOGI("%s: mFadeState -> %d, mCurrentVolume = %d,nSamples = %d", __FUNCTION__, pAudFade->mFadeState, pAudFade->mCurrentVolume, nSamples);
-            }
-
-            // do audio traisition
-            switch (pAudFade->mFadeState) {
-            case AUD_FADE_OUT_START: {
-                pAudFade->mTargetVolume = 0;
-                pAudFade->mStartVolume = 1 << 16;
-                pAudFade->mCurrentVolume = 1 << 16;
-                pAudFade->mfadeTimeUsed = 0;
-                pAudFade->mfadeFramesUsed = 0;
-                pAudFade->mfadeTimeTotal = DEFAULT_FADE_OUT_MS;
-                pAudFade->muteCounts = 1;
-                AudioFadeBuf(pAudFade, in, nSamples);
-                pAudFade->mFadeState = AUD_FADE_OUT;
-            }
-            break;
-            case AUD_FADE_OUT: {
-                // do fade out process
-                if (pAudFade->mCurrentVolume != 0) {
-                    AudioFadeBuf(pAudFade, in, nSamples);
-                } else {
-                    pAudFade->mFadeState = AUD_FADE_MUTE;
-                    // do actrually setting
-                    modeValue = pContext->modeValue;
-                    for (i = 0; i < data->band_num; i++) {
-                        ALOGD("%s: Set band[%d] -> %d", __FUNCTION__, i + 1, data->usr_cfg[modeValue * data->band_num + i]);
-                        HPEQ_setBand_api(data->usr_cfg[modeValue * data->band_num + i], i + 1);
-                    }
-                    mutePCMBuf(pAudFade, in, nSamples);
-                }
-            }
-            break;
-            case AUD_FADE_MUTE: {
-                if (pAudFade->muteCounts <= 0) {
-                    pAudFade->mFadeState = AUD_FADE_IN;
-                    // slowly increase audio volume
-                    pAudFade->mTargetVolume = 1 << 16;
-                    pAudFade->mStartVolume = 0;
-                    pAudFade->mCurrentVolume = 0;
-                    pAudFade->mfadeTimeUsed = 0;
-                    pAudFade->mfadeFramesUsed = 0;
-                    pAudFade->mfadeTimeTotal = DEFAULT_FADE_IN_MS;
-                    mutePCMBuf(pAudFade, in, nSamples);
-                } else {
-                    mutePCMBuf(pAudFade, in, nSamples);
-                    pAudFade->muteCounts--;
-                }
-            }
-            break;
-            case AUD_FADE_IN: {
-                AudioFadeBuf(pAudFade, in, nSamples);
-                if (pAudFade->mCurrentVolume == 1 << 16) {
-                    pAudFade->mFadeState = AUD_FADE_IDLE;
-                }
-            }
-            break;
-            case AUD_FADE_IDLE:
-                // do nothing
-                break;
-            default:
-                break;
+            if (pAudFade->mFadeState == AUD_FADE_CROSS) {
+                HPEQ_process_crossfade(pContext, params, in, out, nSamples);
+                return 0;
             }
+            // input preceding the next crossfade
+            AudioCrossFadeKeep(pAudFade, &pContext->gCrossFade, in, nSamples);
 
 #if 0
             if (getprop_bool("media.audiofade.dump")) {
@@ -727,6 +787,14 @@ int HPEQLib_Create(const effect_uuid_t *uuid, int32_t sessionId __unused, int32_
         ALOGE("%s: Load INI File faied, use default param", __FUNCTION__);
         pContext->gHPEQdata.enable = 1;
     }
+    HPEQparam params;
+    HPEQ_get_params(pContext, &params);
+    if (ParamSnapshotInit(&pContext->params, &params, sizeof(HPEQparam)) < 0) {
+        free(pContext->gHPEQdata.usr_cfg);
+        delete pContext;
+        return -EINVAL;
+    }
+    AudioSilenceInit(&pContext->silence, HPEQ_TAIL_MS);
 
     pContext->itfe = &HPEQInterface;
     pContext->state = HPEQ_STATE_UNINITIALIZED;
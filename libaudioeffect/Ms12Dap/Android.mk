@@ -23,6 +23,10 @@ LOCAL_C_INCLUDES := \
 
 LOCAL_SRC_FILES := ms12_dap_wapper.cpp
 LOCAL_SRC_FILES += ../Utility/AudioFade.c
+LOCAL_SRC_FILES += ../Utility/ParamSnapshot.c
+LOCAL_SRC_FILES += ../Utility/AudioArena.c
+LOCAL_SRC_FILES += ../Utility/AudioSilence.c
+LOCAL_SRC_FILES += ../Utility/AudioBypass.c
 
 LOCAL_CFLAGS += -O2
 
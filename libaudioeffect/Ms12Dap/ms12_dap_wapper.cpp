@@ -42,6 +42,10 @@
 
 extern "C" {
 #include "../Utility/AudioFade.h"
+#include "../Utility/ParamSnapshot.h"
+#include "../Utility/AudioArena.h"
+#include "../Utility/AudioSilence.h"
+#include "../Utility/AudioBypass.h"
 
 #define LOG_NDEBUG_FUNCTION
 #ifdef LOG_NDEBUG_FUNCTION
@@ -81,8 +85,13 @@ extern "C" {
 #define DAP_RET_SUCESS 0
 #define DAP_RET_FAIL -1
 #define DAP_GEQ_NB_BANDS_DEFAULT 5
-#define DAP_INPUT_STORE_SIZE 8192 // 2048 samples * 2ch * 2 bytes
+// frames of input staged at once for in place upmix, larger blocks go in chunks
+#define DAP_INPUT_STORE_FRAMES 2048
 #define DEFAULT_POSTGAIN     0
+// frames buffered once the block FIFO is in use, enough for any frameCount
+#define DAP_FIFO_LATENCY (DAP_CPDP_PCM_SAMPLES_PER_BLOCK - 1)
+// volume leveler release and virtualizer tail of dap_cpdp, FIFO included
+#define DAP_TAIL_MS 1000
 
     enum DAP_state_e {
         DAP_STATE_UNINITIALIZED,
@@ -121,7 +130,8 @@ extern "C" {
         DAP_PARAM_DE_AMOUNT,
         DAP_PARAM_SUROUND_ENABLE,
         DAP_PARAM_SURROUND_BOOST,
-        DAP_PARAM_VIRTUALIZER_ENABLE
+        DAP_PARAM_VIRTUALIZER_ENABLE,
+        DAP_PARAM_LATENCY, // query only: frames of delay, dap_cpdp plus the block FIFO
     } DAPparams;
 
     typedef struct DAPapi_s {
@@ -332,18 +342,25 @@ extern "C" {
 
         /* DAP API needed data */
         dap_cpdp_init_info init_info;
+        // dolby_base values live in dap_cpdp, valid once bDapBaseValid is set
         dolby_base dapBase;
+        unsigned int bDapBaseValid;
+        // holds pPersistMem and pScratchMem, kept across re-init
+        AudioArena_t arena;
+        // input channels dap_cpdp was set up for
+        unsigned int dapInitChannels;
         void *pPersistMem;
         size_t uPersistMemSize;
         void *pScratchMem;
         size_t uScratchSize;
 
         void *dap_cpdp;
-        // audioInTmp16 for DLB buffer usage for dap process
-        short audioInTmp16[DAP_CPDP_MAX_NUM_CHANNELS][DAP_CPDP_PCM_SAMPLES_PER_BLOCK];
-        // should copy input data into "inStorgeBuf" for legacy reason
+        // copy of the input when in place processing would overwrite input
+        // blocks not yet read (DAP output has more channels than its input)
         void *inStorgeBuf;
         unsigned int inStorgeBufSize;
+        // channels returned by dap_cpdp_prepare(), 0 until the first block
+        unsigned int dapOutChannels;
         unsigned int curInfrmCnts;
         unsigned long totalFrmCnts;
         unsigned int islicenseOK;
@@ -366,6 +383,33 @@ extern "C" {
     } DAPdata;
 
 
+    typedef enum {
+        DAP_MODE_SET_DIRECT,
+        DAP_MODE_SET_FADE_OUT,  // fade out, apply, fade in
+        DAP_MODE_SET_UNMUTE,    // leaving DAP_MODE_DISABLE: enable muted, apply, fade in
+    } DAPmodeSet;
+
+    /* settings handed to DAP_process, which owns dap_cpdp and applies them
+     * between two blocks. Every *_seq is bumped by DAP_setParameter when
+     * the matching group has to be (re)applied. */
+    typedef struct DAPparam_s {
+        int32_t                  modeValue;
+        int32_t                  enable;
+        int32_t                  postgain;
+        dolby_vol_leveler_t      dapVolLeveler;
+        dolby_dialog_enhance_t   dapDialogEnhance;
+        dolby_virtual_surround_t dapVirtualSrnd;
+        dolby_eq_t               dapEQ;
+        int32_t                  modeSet;
+        uint32_t                 mode_seq;
+        uint32_t                 enable_seq;
+        uint32_t                 postgain_seq;
+        uint32_t                 vl_seq;
+        uint32_t                 de_seq;
+        uint32_t                 vs_seq;
+        uint32_t                 eq_seq;
+    } DAPparam;
+
     typedef struct DAPContext_s {
         const struct effect_interface_s *itfe;
         effect_config_t                 config;
@@ -377,6 +421,34 @@ extern "C" {
         int                             bUseFade; // when recieve setting change from app, "fade audio out->do setting->fade audio In"
         AudioFade_t                     gAudFade;
         int32_t                         modeValue;
+
+        ParamSnapshot_t                 params;
+        DAPparam                        next_params; // control thread
+        DAPparam                        cur_params;  // audio thread, last applied
+
+        // delay in frames read by DAP_PARAM_LATENCY, written by the audio thread
+        int32_t                         latency;
+        // dap_cpdp latency for the current output and effect mode, audio thread
+        unsigned int                    lib_latency;
+
+        // sample format of input and output, DLB_BUFFER_* code and bytes, audio thread
+        int                             dlb_data_type;
+        unsigned int                    sample_size;
+
+        // block adapter for frame counts that are not a multiple of
+        // DAP_CPDP_PCM_SAMPLES_PER_BLOCK, audio thread only. The FIFOs are
+        // sized for 32 bit samples and hold samples of sample_size bytes.
+        int                             fifo_enable;
+        unsigned int                    fifo_in_ch;
+        unsigned int                    fifo_out_ch;
+        unsigned int                    fifo_in_frames;
+        unsigned int                    fifo_out_frames;
+        int32_t                         fifo_in[DAP_CPDP_PCM_SAMPLES_PER_BLOCK * DAP_CPDP_MAX_NUM_CHANNELS];
+        int32_t                         fifo_out[DAP_CPDP_PCM_SAMPLES_PER_BLOCK * 2 * DAP_CPDP_MAX_NUM_CHANNELS];
+
+        // digital silence on the input, audio thread only
+        AudioSilence_t                  silence;
+        AudioAccumulate_t               accumulate;
     } DAPContext;
 
 
@@ -2121,6 +2193,7 @@ extern "C" {
             sampleSize = 2;
             break;
         case AUDIO_FORMAT_PCM_32_BIT:
+        case AUDIO_FORMAT_PCM_FLOAT:
             //case AUDIO_FORMAT_PCM_SUB_32_BIT:
             sampleSize = 4;
             break;
@@ -2130,8 +2203,67 @@ extern "C" {
         return sampleSize;
     }
 
+    // dlb_buffer data type for the PCM formats dap_cpdp can read and write directly
+    static int audioFormat2dlbDataType(audio_format_t aFormat)
+    {
+        switch (aFormat) {
+        case AUDIO_FORMAT_PCM_16_BIT:
+            return DLB_BUFFER_SHORT_16;
+        case AUDIO_FORMAT_PCM_32_BIT:
+            return DLB_BUFFER_LONG_32;
+        case AUDIO_FORMAT_PCM_FLOAT:
+            return DLB_BUFFER_FLOAT;
+        default:
+            return -1;
+        }
+    }
+
 
 
+    static void dap_fill_init_info(dap_cpdp_init_info *pDapInitInfo, unsigned long sample_rate)
+    {
+        pDapInitInfo->sample_rate = sample_rate;
+        pDapInitInfo->license_data = (unsigned char*)"full\n1589474320,0\n";
+        pDapInitInfo->license_size = strlen((char*)pDapInitInfo->license_data) + 1;
+        pDapInitInfo->manufacturer_id = 0;
+        pDapInitInfo->mode = 0;
+        pDapInitInfo->mi_process_disable = 0;
+        pDapInitInfo->virtual_bass_process_enable = 1;
+    }
+
+    /* Control thread: reserve the arena for the most memory dap_cpdp needs at
+     * any of its sample rates, so that dap_init_api() only carves it, also
+     * when the audio thread sets dap_cpdp up again for a new rate. */
+    static int dap_reserve_arena(DAPContext *pContext)
+    {
+        static const unsigned long rates[] = {32000, 44100, 48000};
+        DAPdata *pDapData = &(pContext->gDAPdata);
+        DAPapi *pDAPapi = &(pContext->gDAPapi);
+        dap_cpdp_init_info info;
+        size_t persist, scratch, size = 0;
+        unsigned i;
+
+        for (i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+            memset(&info, 0, sizeof(info));
+            dap_fill_init_info(&info, rates[i]);
+            persist = aml_dap_cpdp_query_memory(pDAPapi, &info);
+            scratch = aml_dap_cpdp_query_scratch(pDAPapi, &info);
+            // aml_dap_cpdp_query_memory() returns (size_t)-1 without the library
+            if (persist == 0 || persist == (size_t)-1 || scratch == 0) {
+                ALOGE("%s, %lu Hz: persistent %zu scratch %zu", __FUNCTION__, rates[i], persist, scratch);
+                return DAP_RET_FAIL;
+            }
+            if (AudioArenaBlockSize(persist) + AudioArenaBlockSize(scratch) > size) {
+                size = AudioArenaBlockSize(persist) + AudioArenaBlockSize(scratch);
+            }
+        }
+        if (AudioArenaReserve(&pDapData->arena, size, AUDIO_ARENA_MLOCK) != AUDIO_ARENA_OK) {
+            ALOGE("%s, arena reserve of %zu bytes failed", __FUNCTION__, size);
+            return DAP_RET_FAIL;
+        }
+        return DAP_RET_SUCESS;
+    }
+
     int dap_init_api(DAPContext *pContext)
     {
         DAPdata *pDapData = NULL;
@@ -2146,19 +2278,21 @@ extern "C" {
         pDapData = &(pContext->gDAPdata);
 
         pDapInitInfo = (dap_cpdp_init_info *) & (pDapData->init_info);
-        pDapInitInfo->sample_rate = pContext->config.inputCfg.samplingRate;
+        dap_fill_init_info(pDapInitInfo, pContext->config.inputCfg.samplingRate);
         // dap_cpdp.h says Valid values are 32000, 44100 and 48000
         if ((pDapInitInfo->sample_rate != 32000)
             && (pDapInitInfo->sample_rate != 44100)
             && (pDapInitInfo->sample_rate != 48000)) {
             ALOGW("%s, pDapInitInfo->sample_rate = %lu\n", __FUNCTION__, pDapInitInfo->sample_rate);
         }
-        pDapInitInfo->license_data = (unsigned char*)"full\n1589474320,0\n";
-        pDapInitInfo->license_size = strlen((char*)pDapInitInfo->license_data) + 1;
-        pDapInitInfo->manufacturer_id = 0;
-        pDapInitInfo->mode = 0;
-        pDapInitInfo->mi_process_disable = 0;
-        pDapInitInfo->virtual_bass_process_enable = 1;
+
+        // just in case dap_cpdp is not closed before, its memory is reused below
+        if (pDapData->dap_cpdp) {
+            aml_dap_cpdp_shutdown(pDAPapi, pDapData->dap_cpdp);
+            pDapData->dap_cpdp = NULL;
+        }
+        pDapData->pPersistMem = NULL;
+        pDapData->pScratchMem = NULL;
 
         // query dap persist memory usage
         pDapData->uPersistMemSize = aml_dap_cpdp_query_memory(pDAPapi, (const dap_cpdp_init_info *)pDapInitInfo);
@@ -2168,75 +2302,40 @@ extern "C" {
         }
         //ALOGI("<%s::%d>--[pDapData->uPersistMemSize = %d]", __FUNCTION__, __LINE__,pDapData->uPersistMemSize);
 
-        // just in case pPersistMen is not free before
-        if (pDapData->pPersistMem) {
-            free(pDapData->pPersistMem);
-            pDapData->pPersistMem = NULL;
-        }
-
-        pDapData->pPersistMem = malloc(pDapData->uPersistMemSize);
-        if (pDapData->pPersistMem == NULL) {
-            ALOGE("<%s::%d>--[pPersistMem malloc error]", __FUNCTION__, __LINE__);
-            return DAP_RET_FAIL;
-        }
-
-
         // Query DAP scratch memory usage
         pDapData->uScratchSize = aml_dap_cpdp_query_scratch(pDAPapi, (const dap_cpdp_init_info *)pDapInitInfo);
         if (pDapData->uScratchSize <= 0) {
             ALOGE("<%s::%d>--[aml_dap_cpdp_query_scratch return size illegal]", __FUNCTION__, __LINE__);
-            if (pDapData->pPersistMem) {
-                free(pDapData->pPersistMem);
-                pDapData->pPersistMem = NULL;
-            }
             //return -EINVAL;
             return DAP_RET_FAIL;
         }
         //ALOGV("%s, scratch_size = %d\n", __FUNCTION__,scratch_size);
 
-        // prepare scratch memory
-        if (pDapData->pScratchMem) {
-            free(pDapData->pScratchMem);
+        // the arena was reserved by dap_reserve_arena(), it is only carved here
+        AudioArenaRewind(&pDapData->arena);
+        pDapData->pPersistMem = AudioArenaAlloc(&pDapData->arena, pDapData->uPersistMemSize);
+        pDapData->pScratchMem = AudioArenaAlloc(&pDapData->arena, pDapData->uScratchSize);
+        if (pDapData->pPersistMem == NULL || pDapData->pScratchMem == NULL) {
+            pDapData->pPersistMem = NULL;
             pDapData->pScratchMem = NULL;
-        }
-
-        // malloc scratch  memory
-        pDapData->pScratchMem = malloc(pDapData->uScratchSize);
-        if (pDapData->pScratchMem == NULL) {
-            ALOGE("<%s::%d>--[aml_dap_cpdp_query_scratch return size illegal]", __FUNCTION__, __LINE__);
-            if (pDapData->pPersistMem) {
-                free(pDapData->pPersistMem);
-                pDapData->pPersistMem = NULL;
-            }
-            //return -EINVAL;
+            ALOGE("<%s::%d>--[arena of %zu bytes too small]", __FUNCTION__, __LINE__, pDapData->arena.size);
             return DAP_RET_FAIL;
         }
         memset(pDapData->pScratchMem, 0, pDapData->uScratchSize);
 
-        // just in case dap_cpdp is not closed before
-        if (pDapData->dap_cpdp) {
-            aml_dap_cpdp_shutdown(pDAPapi, pDapData->dap_cpdp);
-            pDapData->dap_cpdp = NULL;
-        }
-        //ALOGE("<%s::%d>--aml_dap_cpdp_shutdown done", __FUNCTION__, __LINE__);
-
         /* The dap_cpdp_init_info struct passed here must be the same as the one
          * passed to dap_cpdp_query_memory(). */
         pDapData->dap_cpdp = aml_dap_cpdp_init(pDAPapi, pDapInitInfo, pDapData->pPersistMem);
         if (pDapData->dap_cpdp == NULL) {
-            if (pDapData->pPersistMem != NULL) {
-                free(pDapData->pPersistMem);
-                pDapData->pPersistMem = NULL;
-            }
-            if (pDapData->pScratchMem) {
-                free(pDapData->pScratchMem);
-                pDapData->pScratchMem = NULL;
-            }
+            pDapData->pPersistMem = NULL;
+            pDapData->pScratchMem = NULL;
             ALOGE("<%s::%d>--[aml_dap_cpdp_init init error]", __FUNCTION__, __LINE__);
             return DAP_RET_FAIL;
         }
 
         pDapData->bDapCPDPInited = 1;
+        // a new instance starts from the library defaults
+        pDapData->bDapBaseValid = 0;
 
         ALOGI("<%s::%d>--[persistent_size:%d]--[persistent_memory:0x%p]--[dap_cpdp:0x%p]",
               __FUNCTION__, __LINE__, pDapData->uPersistMemSize, pDapData->pPersistMem, pDapData->dap_cpdp);
@@ -2259,46 +2358,41 @@ extern "C" {
         }
 
         /* Note that the dap_cpdp pointer is likely to be different to the
-        * persistent_memory pointer, so we need to be careful to free
-        * the correct pointer. */
-        if (pDapData->pPersistMem) {
-            free(pDapData->pPersistMem);
-            pDapData->pPersistMem = NULL;
-        }
-
-        if (pDapData->pScratchMem) {
-            free(pDapData->pScratchMem);
-            pDapData->pScratchMem = NULL;
-        }
+        * persistent_memory pointer. Both memories stay in the arena for
+        * the next dap_init_api(), DAP_release() frees it. */
+        pDapData->pPersistMem = NULL;
+        pDapData->pScratchMem = NULL;
 
         pDapData->bDapCPDPInited = 0;
+        pDapData->bDapBaseValid = 0;
 
         ALOGI("<%s::%d>--[dap_release end]", __FUNCTION__, __LINE__);
         return 0;
     }
 
-    int do_passthrough(audio_buffer_t *inBuffer, audio_buffer_t *outBuffer)
-    {
-        int16_t   *in  = (int16_t *)inBuffer->raw;
-        int16_t   *out = (int16_t *)outBuffer->raw;
-
-        for (size_t i = 0; i < inBuffer->frameCount; i++) {
-            *out++ = *in++;
-            *out++ = *in++;
-        }
-        return 0;
-    }
-
 
+    /* Only the settings that differ from the ones dap_cpdp already has are
+     * sent, a mode switch then costs a few calls instead of a full reload. */
     static int dap_load_user_param(DAPContext *pContext, dolby_base *effect_mode)
     {
         void *dap_cpdp = NULL;
         int *ao_gains[DAP_CPDP_MAX_NUM_CHANNELS];
         DAPapi *pDAPapi = (DAPapi *) & (pContext->gDAPapi);
+        DAPdata *pDapData = &pContext->gDAPdata;
+        dolby_base *live = &pDapData->dapBase;
+        int all = !pDapData->bDapBaseValid;
+        int nSet = 0;
         //int **pp_ao_gains;
 
+#define DAP_BASE_DIFF(field) \
+        (all || memcmp(&live->field, &effect_mode->field, sizeof(live->field)) != 0)
+#define DAP_BASE_SET(field, setter) \
+        if (DAP_BASE_DIFF(field)) { \
+            setter(pDAPapi, dap_cpdp, effect_mode->field); \
+            nSet++; \
+        }
 
-        dap_cpdp = pContext->gDAPdata.dap_cpdp;
+        dap_cpdp = pDapData->dap_cpdp;
         if (!dap_cpdp) {
             ALOGE("%s, !dap_cpdp\n", __FUNCTION__);
             return DAP_RET_FAIL;
@@ -2309,62 +2403,88 @@ extern "C" {
             ao_gains[i] = effect_mode->ao_band_gains[i];
         }
 
-        aml_dap_cpdp_pregain_set(pDAPapi, dap_cpdp, effect_mode->pregain);
-        aml_dap_cpdp_postgain_set(pDAPapi, dap_cpdp, effect_mode->postgain);
-        aml_dap_cpdp_system_gain_set(pDAPapi, dap_cpdp, effect_mode->systemgain);
-
-        aml_dap_cpdp_virtualizer_headphone_reverb_gain_set(pDAPapi, dap_cpdp, effect_mode->headphone_reverb);
-        aml_dap_cpdp_virtualizer_speaker_angle_set(pDAPapi, dap_cpdp, effect_mode->speaker_angle);
-        aml_dap_cpdp_virtualizer_speaker_start_freq_set(pDAPapi, dap_cpdp, effect_mode->speaker_start);
-        aml_dap_cpdp_mi2ieq_steering_enable_set(pDAPapi, dap_cpdp, effect_mode->mi_ieq_enable);
-        aml_dap_cpdp_mi2dv_leveler_steering_enable_set(pDAPapi, dap_cpdp, effect_mode->mi_dv_enable);
-        aml_dap_cpdp_mi2dialog_enhancer_steering_enable_set(pDAPapi, dap_cpdp, effect_mode->mi_de_enable);
-        aml_dap_cpdp_mi2surround_compressor_steering_enable_set(pDAPapi, dap_cpdp, effect_mode->mi_surround_enable);
-
-        aml_dap_cpdp_calibration_boost_set(pDAPapi, dap_cpdp, effect_mode->calibration_boost);
-        aml_dap_cpdp_volume_leveler_in_target_set(pDAPapi, dap_cpdp, effect_mode->leveler_input);
-        aml_dap_cpdp_volume_leveler_out_target_set(pDAPapi, dap_cpdp, effect_mode->leveler_output);
-        aml_dap_cpdp_volume_modeler_enable_set(pDAPapi, dap_cpdp, effect_mode->modeler_enable);
-        aml_dap_cpdp_volume_modeler_calibration_set(pDAPapi, dap_cpdp, effect_mode->modeler_calibration);
-
-        aml_dap_cpdp_ieq_enable_set(pDAPapi, dap_cpdp, effect_mode->ieq_enable);
-        aml_dap_cpdp_ieq_amount_set(pDAPapi, dap_cpdp, effect_mode->ieq_amount);
-        aml_dap_cpdp_ieq_bands_set(pDAPapi, dap_cpdp, effect_mode->ieq_nb_bands,
-                                   (const unsigned int *)effect_mode->a_ieq_band_center,
-                                   (const int *)effect_mode->a_ieq_band_target);
-        aml_dap_cpdp_de_ducking_set(pDAPapi, dap_cpdp, effect_mode->de_ducking);
-        aml_dap_cpdp_volmax_boost_set(pDAPapi, dap_cpdp, effect_mode->volmax_boost);
-
-        aml_dap_cpdp_audio_optimizer_enable_set(pDAPapi, dap_cpdp, effect_mode->optimizer_enable);
-        aml_dap_cpdp_audio_optimizer_bands_set(pDAPapi, dap_cpdp, effect_mode->ao_bands,
-                                               (const unsigned int *)effect_mode->ao_band_center_freq,
-                                               ao_gains);
-
-        aml_dap_cpdp_bass_enhancer_enable_set(pDAPapi, dap_cpdp, effect_mode->bass_enable);
-        aml_dap_cpdp_bass_enhancer_boost_set(pDAPapi, dap_cpdp, effect_mode->bass_boost);
-        aml_dap_cpdp_bass_enhancer_cutoff_frequency_set(pDAPapi, dap_cpdp, effect_mode->bass_cutoff);
-        aml_dap_cpdp_bass_enhancer_width_set(pDAPapi, dap_cpdp, effect_mode->bass_width);
-
-        aml_dap_cpdp_regulator_tuning_set(pDAPapi, dap_cpdp, (unsigned int) effect_mode->ar_bands,
-                                          (const  unsigned int *)effect_mode->ar_band_center_freq,
-                                          (const  int *)effect_mode->ar_low_thresholds,
-                                          (const  int *)effect_mode->ar_high_thresholds,
-                                          (const  int *)effect_mode->ar_isolated_bands);
-
-        aml_dap_cpdp_regulator_overdrive_set(pDAPapi, dap_cpdp, effect_mode->regulator_overdrive);
-        aml_dap_cpdp_regulator_timbre_preservation_set(pDAPapi, dap_cpdp, effect_mode->regulator_timbre);
-        aml_dap_cpdp_regulator_relaxation_amount_set(pDAPapi, dap_cpdp, effect_mode->regulator_distortion);
-        aml_dap_cpdp_regulator_speaker_distortion_enable_set(pDAPapi, dap_cpdp, effect_mode->regulator_mode);
-        aml_dap_cpdp_regulator_enable_set(pDAPapi, dap_cpdp, effect_mode->regulator_enable);
-
-        aml_dap_cpdp_virtual_bass_mode_set(pDAPapi, dap_cpdp, effect_mode->virtual_bass_mode);
-        aml_dap_cpdp_virtual_bass_src_freqs_set(pDAPapi, dap_cpdp, effect_mode->virtual_bass_low_src_freq,
-                                                effect_mode->virtual_bass_high_src_freq);
-        aml_dap_cpdp_virtual_bass_overall_gain_set(pDAPapi, dap_cpdp, effect_mode->virtual_bass_overall_gain);
-        aml_dap_cpdp_virtual_bass_slope_gain_set(pDAPapi, dap_cpdp, effect_mode->virtual_bass_slope_gain);
-        aml_dap_cpdp_virtual_bass_subgains_set(pDAPapi, dap_cpdp, 3, effect_mode->virtual_bass_subgain);
-        aml_dap_cpdp_virtual_bass_mix_freqs_set(pDAPapi, dap_cpdp, effect_mode->virtual_bass_mix_low_freq,
-                                                effect_mode->virtual_bass_mix_high_freq);
+        DAP_BASE_SET(pregain, aml_dap_cpdp_pregain_set);
+        DAP_BASE_SET(postgain, aml_dap_cpdp_postgain_set);
+        DAP_BASE_SET(systemgain, aml_dap_cpdp_system_gain_set);
+
+        DAP_BASE_SET(headphone_reverb, aml_dap_cpdp_virtualizer_headphone_reverb_gain_set);
+        DAP_BASE_SET(speaker_angle, aml_dap_cpdp_virtualizer_speaker_angle_set);
+        DAP_BASE_SET(speaker_start, aml_dap_cpdp_virtualizer_speaker_start_freq_set);
+        DAP_BASE_SET(mi_ieq_enable, aml_dap_cpdp_mi2ieq_steering_enable_set);
+        DAP_BASE_SET(mi_dv_enable, aml_dap_cpdp_mi2dv_leveler_steering_enable_set);
+        DAP_BASE_SET(mi_de_enable, aml_dap_cpdp_mi2dialog_enhancer_steering_enable_set);
+        DAP_BASE_SET(mi_surround_enable, aml_dap_cpdp_mi2surround_compressor_steering_enable_set);
+
+        DAP_BASE_SET(calibration_boost, aml_dap_cpdp_calibration_boost_set);
+        DAP_BASE_SET(leveler_input, aml_dap_cpdp_volume_leveler_in_target_set);
+        DAP_BASE_SET(leveler_output, aml_dap_cpdp_volume_leveler_out_target_set);
+        DAP_BASE_SET(modeler_enable, aml_dap_cpdp_volume_modeler_enable_set);
+        DAP_BASE_SET(modeler_calibration, aml_dap_cpdp_volume_modeler_calibration_set);
+
+        DAP_BASE_SET(ieq_enable, aml_dap_cpdp_ieq_enable_set);
+        DAP_BASE_SET(ieq_amount, aml_dap_cpdp_ieq_amount_set);
+        if (DAP_BASE_DIFF(ieq_nb_bands) || DAP_BASE_DIFF(a_ieq_band_center) || DAP_BASE_DIFF(a_ieq_band_target)) {
+            aml_dap_cpdp_ieq_bands_set(pDAPapi, dap_cpdp, effect_mode->ieq_nb_bands,
+                                       (const unsigned int *)effect_mode->a_ieq_band_center,
+                                       (const int *)effect_mode->a_ieq_band_target);
+            nSet++;
+        }
+        DAP_BASE_SET(de_ducking, aml_dap_cpdp_de_ducking_set);
+        DAP_BASE_SET(volmax_boost, aml_dap_cpdp_volmax_boost_set);
+
+        DAP_BASE_SET(optimizer_enable, aml_dap_cpdp_audio_optimizer_enable_set);
+        if (DAP_BASE_DIFF(ao_bands) || DAP_BASE_DIFF(ao_band_center_freq) || DAP_BASE_DIFF(ao_band_gains)) {
+            aml_dap_cpdp_audio_optimizer_bands_set(pDAPapi, dap_cpdp, effect_mode->ao_bands,
+                                                   (const unsigned int *)effect_mode->ao_band_center_freq,
+                                                   ao_gains);
+            nSet++;
+        }
+
+        DAP_BASE_SET(bass_enable, aml_dap_cpdp_bass_enhancer_enable_set);
+        DAP_BASE_SET(bass_boost, aml_dap_cpdp_bass_enhancer_boost_set);
+        DAP_BASE_SET(bass_cutoff, aml_dap_cpdp_bass_enhancer_cutoff_frequency_set);
+        DAP_BASE_SET(bass_width, aml_dap_cpdp_bass_enhancer_width_set);
+
+        if (DAP_BASE_DIFF(ar_bands) || DAP_BASE_DIFF(ar_band_center_freq) || DAP_BASE_DIFF(ar_low_thresholds) ||
+            DAP_BASE_DIFF(ar_high_thresholds) || DAP_BASE_DIFF(ar_isolated_bands)) {
+            aml_dap_cpdp_regulator_tuning_set(pDAPapi, dap_cpdp, (unsigned int) effect_mode->ar_bands,
+                                              (const  unsigned int *)effect_mode->ar_band_center_freq,
+                                              (const  int *)effect_mode->ar_low_thresholds,
+                                              (const  int *)effect_mode->ar_high_thresholds,
+                                              (const  int *)effect_mode->ar_isolated_bands);
+            nSet++;
+        }
+
+        DAP_BASE_SET(regulator_overdrive, aml_dap_cpdp_regulator_overdrive_set);
+        DAP_BASE_SET(regulator_timbre, aml_dap_cpdp_regulator_timbre_preservation_set);
+        DAP_BASE_SET(regulator_distortion, aml_dap_cpdp_regulator_relaxation_amount_set);
+        DAP_BASE_SET(regulator_mode, aml_dap_cpdp_regulator_speaker_distortion_enable_set);
+        DAP_BASE_SET(regulator_enable, aml_dap_cpdp_regulator_enable_set);
+
+        DAP_BASE_SET(virtual_bass_mode, aml_dap_cpdp_virtual_bass_mode_set);
+        if (DAP_BASE_DIFF(virtual_bass_low_src_freq) || DAP_BASE_DIFF(virtual_bass_high_src_freq)) {
+            aml_dap_cpdp_virtual_bass_src_freqs_set(pDAPapi, dap_cpdp, effect_mode->virtual_bass_low_src_freq,
+                                                    effect_mode->virtual_bass_high_src_freq);
+            nSet++;
+        }
+        DAP_BASE_SET(virtual_bass_overall_gain, aml_dap_cpdp_virtual_bass_overall_gain_set);
+        DAP_BASE_SET(virtual_bass_slope_gain, aml_dap_cpdp_virtual_bass_slope_gain_set);
+        if (DAP_BASE_DIFF(virtual_bass_subgain)) {
+            aml_dap_cpdp_virtual_bass_subgains_set(pDAPapi, dap_cpdp, 3, effect_mode->virtual_bass_subgain);
+            nSet++;
+        }
+        if (DAP_BASE_DIFF(virtual_bass_mix_low_freq) || DAP_BASE_DIFF(virtual_bass_mix_high_freq)) {
+            aml_dap_cpdp_virtual_bass_mix_freqs_set(pDAPapi, dap_cpdp, effect_mode->virtual_bass_mix_low_freq,
+                                                    effect_mode->virtual_bass_mix_high_freq);
+            nSet++;
+        }
+
+#undef DAP_BASE_SET
+#undef DAP_BASE_DIFF
+
+        memcpy(live, effect_mode, sizeof(dolby_base));
+        pDapData->bDapBaseValid = 1;
+        ALOGD("%s: %d settings sent%s", __FUNCTION__, nSet, all ? " (full load)" : "");
 
         return 0;
     }
@@ -2585,8 +2705,8 @@ extern "C" {
         return ret;
     }
 
-    int dap_get_mode_param(DAPContext *pContext, uint32_t param, void* pValue, bool first) {
-        DAPdata *pDapData = &pContext->gDAPdata;
+    /* resolve the settings of pParams->modeValue, custom ones come from pParams */
+    static int dap_resolve_mode_param(const DAPparam *pParams, uint32_t param, void* pValue, bool first) {
         int i=0;
 
         switch (param) {
@@ -2597,12 +2717,12 @@ extern "C" {
                 if (first) {
                     dapVolLeveler->vl_enable = default_vl_param[DAP_MODE_CUSTOM][0];
                     dapVolLeveler->vl_amount = default_vl_param[DAP_MODE_CUSTOM][1];
-                } else if (pContext->modeValue == DAP_MODE_CUSTOM) {
-                    dapVolLeveler->vl_enable = pDapData->dapVolLeveler.vl_enable;
-                    dapVolLeveler->vl_amount = pDapData->dapVolLeveler.vl_amount;
+                } else if (pParams->modeValue == DAP_MODE_CUSTOM) {
+                    dapVolLeveler->vl_enable = pParams->dapVolLeveler.vl_enable;
+                    dapVolLeveler->vl_amount = pParams->dapVolLeveler.vl_amount;
                 } else {
-                    dapVolLeveler->vl_enable = default_vl_param[pContext->modeValue][0];
-                    dapVolLeveler->vl_amount = default_vl_param[pContext->modeValue][1];
+                    dapVolLeveler->vl_enable = default_vl_param[pParams->modeValue][0];
+                    dapVolLeveler->vl_amount = default_vl_param[pParams->modeValue][1];
                 }
                 break;
             }
@@ -2613,12 +2733,12 @@ extern "C" {
                 if (first) {
                     dapDialogEnhance->de_enable = default_de_param[DAP_MODE_CUSTOM][0];
                     dapDialogEnhance->de_amount = default_de_param[DAP_MODE_CUSTOM][1];
-                } else if (pContext->modeValue == DAP_MODE_CUSTOM) {
-                    dapDialogEnhance->de_enable = pDapData->dapDialogEnhance.de_enable;
-                    dapDialogEnhance->de_amount = pDapData->dapDialogEnhance.de_amount;
+                } else if (pParams->modeValue == DAP_MODE_CUSTOM) {
+                    dapDialogEnhance->de_enable = pParams->dapDialogEnhance.de_enable;
+                    dapDialogEnhance->de_amount = pParams->dapDialogEnhance.de_amount;
                 } else {
-                    dapDialogEnhance->de_enable = default_de_param[pContext->modeValue][0];
-                    dapDialogEnhance->de_amount = default_de_param[pContext->modeValue][1];
+                    dapDialogEnhance->de_enable = default_de_param[pParams->modeValue][0];
+                    dapDialogEnhance->de_amount = default_de_param[pParams->modeValue][1];
                 }
                 break;
             }
@@ -2631,14 +2751,14 @@ extern "C" {
                     dapVirtualSrnd->enable.surround_decoder_enable = default_surr_param[DAP_MODE_CUSTOM][0];
                     dapVirtualSrnd->enable.virtualizer_enable = default_surr_param[DAP_MODE_CUSTOM][1];
                     dapVirtualSrnd->surround_boost = default_surr_param[DAP_MODE_CUSTOM][2];
-                } else if (pContext->modeValue == DAP_MODE_CUSTOM) {
-                    dapVirtualSrnd->enable.surround_decoder_enable = pDapData->dapVirtualSrnd.enable.surround_decoder_enable;
-                    dapVirtualSrnd->enable.virtualizer_enable = pDapData->dapVirtualSrnd.enable.virtualizer_enable;
-                    dapVirtualSrnd->surround_boost = pDapData->dapVirtualSrnd.surround_boost;
+                } else if (pParams->modeValue == DAP_MODE_CUSTOM) {
+                    dapVirtualSrnd->enable.surround_decoder_enable = pParams->dapVirtualSrnd.enable.surround_decoder_enable;
+                    dapVirtualSrnd->enable.virtualizer_enable = pParams->dapVirtualSrnd.enable.virtualizer_enable;
+                    dapVirtualSrnd->surround_boost = pParams->dapVirtualSrnd.surround_boost;
                 } else {
-                    dapVirtualSrnd->enable.surround_decoder_enable = default_surr_param[pContext->modeValue][0];
-                    dapVirtualSrnd->enable.virtualizer_enable = default_surr_param[pContext->modeValue][1];
-                    dapVirtualSrnd->surround_boost = default_surr_param[pContext->modeValue][2];
+                    dapVirtualSrnd->enable.surround_decoder_enable = default_surr_param[pParams->modeValue][0];
+                    dapVirtualSrnd->enable.virtualizer_enable = default_surr_param[pParams->modeValue][1];
+                    dapVirtualSrnd->surround_boost = default_surr_param[pParams->modeValue][2];
                 }
                 break;
             }
@@ -2651,17 +2771,17 @@ extern "C" {
                     dapGeq->eq_params.a_geq_band_center[i] = default_geq_center[i];
                 if (first) {
                     dapGeq->eq_enable.geq_enable = default_geq_enable[DAP_MODE_CUSTOM];
-                } else if (pContext->modeValue == DAP_MODE_CUSTOM) {
-                    dapGeq->eq_enable.geq_enable = pDapData->dapEQ.eq_enable.geq_enable;
+                } else if (pParams->modeValue == DAP_MODE_CUSTOM) {
+                    dapGeq->eq_enable.geq_enable = pParams->dapEQ.eq_enable.geq_enable;
                 } else {
-                    dapGeq->eq_enable.geq_enable = default_geq_enable[pContext->modeValue];
+                    dapGeq->eq_enable.geq_enable = default_geq_enable[pParams->modeValue];
                 }
                 if (first) {
                     for (i=0; i<dapGeq->eq_params.geq_nb_bands; i++)
                         dapGeq->eq_params.a_geq_band_target[i] = default_geq_gains[GEQ_MODE_USER][i];
                 } else if (dapGeq->eq_enable.geq_enable == GEQ_MODE_USER) {
                     for (i=0; i<dapGeq->eq_params.geq_nb_bands; i++)
-                        dapGeq->eq_params.a_geq_band_target[i] = pDapData->dapEQ.eq_params.a_geq_band_target[i];
+                        dapGeq->eq_params.a_geq_band_target[i] = pParams->dapEQ.eq_params.a_geq_band_target[i];
                 } else {
                     for (i=0; i<dapGeq->eq_params.geq_nb_bands; i++)
                         dapGeq->eq_params.a_geq_band_target[i] = default_geq_gains[dapGeq->eq_enable.geq_enable][i];
@@ -2672,6 +2792,33 @@ extern "C" {
         return 0;
     }
 
+    static void DAP_get_params(DAPContext *pContext, DAPparam *pParams)
+    {
+        DAPdata *pDapData = &pContext->gDAPdata;
+
+        pParams->modeValue = pContext->modeValue;
+        pParams->postgain = pDapData->dapPostGain;
+        pParams->dapVolLeveler = pDapData->dapVolLeveler;
+        pParams->dapDialogEnhance = pDapData->dapDialogEnhance;
+        pParams->dapVirtualSrnd = pDapData->dapVirtualSrnd;
+        pParams->dapEQ = pDapData->dapEQ;
+    }
+
+    int dap_get_mode_param(DAPContext *pContext, uint32_t param, void* pValue, bool first) {
+        DAPparam params;
+
+        memset(&params, 0, sizeof(params));
+        DAP_get_params(pContext, &params);
+        return dap_resolve_mode_param(&params, param, pValue, first);
+    }
+
+    // hand the current settings over to DAP_process
+    static void DAP_publish(DAPContext *pContext)
+    {
+        DAP_get_params(pContext, &pContext->next_params);
+        ParamSnapshotPublish(&pContext->params, &pContext->next_params);
+    }
+
     int dap_set_enable(DAPContext *pContext, int enable)
     {
         DAPdata *pDapData = &pContext->gDAPdata;
@@ -2680,7 +2827,16 @@ extern "C" {
         return 0;
     }
 
-    int dap_set_effect_mode(DAPContext *pContext, DAPmode eMode)
+    /* the dap_cpdp latency depends on the output mode and on the processing
+     * enabled by the effect mode */
+    static void dap_update_lib_latency(DAPContext *pContext)
+    {
+        int ret = aml_dap_cpdp_get_latency(&pContext->gDAPapi, pContext->gDAPdata.dap_cpdp);
+
+        pContext->lib_latency = (ret > 0) ? ret : 0;
+    }
+
+    int dap_set_effect_mode(DAPContext *pContext, const DAPparam *pParams, DAPmode eMode)
     {
         //ALOGE("<%s::%d>--[mode:%d]", __FUNCTION__, __LINE__, mode);
         dolby_virtual_surround_t dapVirtualSrnd;
@@ -2691,10 +2847,10 @@ extern "C" {
         DAPdata *pDapData = &pContext->gDAPdata;
         pDapData->eDapEffectMode = eMode;
 
-        dap_get_mode_param(pContext, DAP_PARAM_VOL_LEVELER_ENABLE, (void *)&dapVolLeveler, false);
-        dap_get_mode_param(pContext, DAP_PARAM_DE_ENABLE, (void *)&dapDialogEnhance, false);
-        dap_get_mode_param(pContext, DAP_PARAM_SUROUND_ENABLE, (void *)&dapVirtualSrnd, false);
-        dap_get_mode_param(pContext, DAP_PARAM_GEQ_ENABLE, (void *)&dapEQ, false);
+        dap_resolve_mode_param(pParams, DAP_PARAM_VOL_LEVELER_ENABLE, (void *)&dapVolLeveler, false);
+        dap_resolve_mode_param(pParams, DAP_PARAM_DE_ENABLE, (void *)&dapDialogEnhance, false);
+        dap_resolve_mode_param(pParams, DAP_PARAM_SUROUND_ENABLE, (void *)&dapVirtualSrnd, false);
+        dap_resolve_mode_param(pParams, DAP_PARAM_GEQ_ENABLE, (void *)&dapEQ, false);
 
         dap_set_virtual_surround(pContext, (dolby_virtual_surround_t *) & (dapVirtualSrnd));
         dap_set_dialog_enhance(pContext, (dolby_dialog_enhance_t *) & (dapDialogEnhance));
@@ -2711,6 +2867,7 @@ extern "C" {
             dap_load_user_param(pContext, (dolby_base *)&dap_dolby_base_disable);
             dap_set_enable(pContext, 0);
             AudioFadeSetState(&pContext->gAudFade, AUD_FADE_IDLE);
+            dap_update_lib_latency(pContext);
             return 0;
         } else if (eMode == DAP_MODE_CUSTOM) {
             dap_load_user_param(pContext, (dolby_base *)&dap_dolby_base_custom);
@@ -2719,6 +2876,7 @@ extern "C" {
             pDapData->eDapEffectMode = DAP_MODE_MUSIC;
         }
         dap_set_enable(pContext, 1);
+        dap_update_lib_latency(pContext);
 
         ALOGD("%s: dap_effect_mode -> %s", __FUNCTION__, DapEffectModeStr[pDapData->eDapEffectMode]);
 
@@ -2726,6 +2884,56 @@ extern "C" {
         return 0;
     }
 
+    // audio thread: apply the groups changed since the last snapshot
+    static void DAP_apply_params(DAPContext *pContext, const DAPparam *pParams)
+    {
+        DAPparam *cur = &pContext->cur_params;
+        AudioFade_t *pAudioFade = (AudioFade_t *) & (pContext->gAudFade);
+
+        if (pParams->enable_seq != cur->enable_seq) {
+            dap_set_enable(pContext, pParams->enable);
+        }
+        if (pParams->mode_seq != cur->mode_seq) {
+            switch (pParams->modeSet) {
+            case DAP_MODE_SET_UNMUTE:
+                AudioFadeInit(pAudioFade, fadeLinear, 10, 0);
+                AudioFadeSetState(pAudioFade, AUD_FADE_MUTE);
+                dap_set_enable(pContext, 1);
+                break;
+            case DAP_MODE_SET_FADE_OUT:
+                // the mode itself is set once the fade reaches AUD_FADE_MUTE
+                AudioFadeInit(pAudioFade, fadeLinear, 10, 0);
+                AudioFadeSetState(pAudioFade, AUD_FADE_OUT_START);
+                break;
+            case DAP_MODE_SET_DIRECT:
+            default:
+                dap_set_effect_mode(pContext, pParams, (DAPmode)pParams->modeValue);
+                break;
+            }
+        }
+        if (pParams->postgain_seq != cur->postgain_seq) {
+            dap_set_postgain(pContext, pParams->postgain);
+        }
+        if (pParams->vl_seq != cur->vl_seq) {
+            dolby_vol_leveler_t dapVolLeveler = pParams->dapVolLeveler;
+            dap_set_vol_leveler(pContext, &dapVolLeveler);
+        }
+        if (pParams->de_seq != cur->de_seq) {
+            dolby_dialog_enhance_t dapDialogEnhance = pParams->dapDialogEnhance;
+            dap_set_dialog_enhance(pContext, &dapDialogEnhance);
+        }
+        if (pParams->vs_seq != cur->vs_seq) {
+            dolby_virtual_surround_t dapVirtualSrnd = pParams->dapVirtualSrnd;
+            dap_set_virtual_surround(pContext, &dapVirtualSrnd);
+        }
+        if (pParams->eq_seq != cur->eq_seq) {
+            dolby_eq_t dapEQ;
+            dap_resolve_mode_param(pParams, DAP_PARAM_GEQ_ENABLE, (void *)&dapEQ, false);
+            dap_set_eq_params(pContext, &dapEQ);
+        }
+        *cur = *pParams;
+    }
+
 #if 0
     int dap_get_vol_leveler_enable(DAPContext *pContext)
     {
@@ -4260,7 +4468,9 @@ error:
         return 0;
 Error:
         memset(&pContext->gDAPapi, 0, sizeof(pContext->gDAPapi));
-        dlclose(pContext->gDAPLibHandler);
+        if (pContext->gDAPLibHandler) {
+            dlclose(pContext->gDAPLibHandler);
+        }
         pContext->gDAPLibHandler = NULL;
         return -EINVAL;
     }
@@ -4312,7 +4522,7 @@ Error:
 
         // Initializing default setting
         aml_dap_cpdp_output_mode_set(pDAPapi,pDapData->dap_cpdp, dap_out_mode);
-        dap_set_effect_mode(pContext,pDapData->eDapEffectMode);
+        dap_set_effect_mode(pContext,&pContext->next_params,pDapData->eDapEffectMode);
         dap_set_postgain(pContext,pDapData->dapPostGain);
         dap_set_vol_leveler(pContext,(dolby_vol_leveler_t *)&pDapData->dapVolLeveler);
         dap_set_dialog_enhance(pContext,(dolby_dialog_enhance_t *)&pDapData->dapDialogEnhance);
@@ -4357,7 +4567,7 @@ Error:
             }
             // Initializing default setting
             aml_dap_cpdp_output_mode_set(pDAPapi, pDapData->dap_cpdp, pContext->gDAPdata.dapCPDPOutputMode);
-            dap_set_effect_mode(pContext, pDapData->eDapEffectMode);
+            dap_set_effect_mode(pContext, &pContext->next_params, pDapData->eDapEffectMode);
             dap_set_postgain(pContext, pDapData->dapPostGain);
             dap_set_vol_leveler(pContext, (dolby_vol_leveler_t *)&pDapData->dapVolLeveler);
             dap_set_dialog_enhance(pContext, (dolby_dialog_enhance_t *)&pDapData->dapDialogEnhance);
@@ -4401,11 +4611,26 @@ Error:
             return -EINVAL;
         }
 
-        if (pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT) {
+        if (audioFormat2dlbDataType((audio_format_t)pConfig->inputCfg.format) < 0) {
             ALOGW("%s: format in = 0x%x format out = 0x%x", __FUNCTION__, pConfig->inputCfg.format, pConfig->outputCfg.format);
             pConfig->inputCfg.format = pConfig->outputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
         }
 
+        // staging for in place upmix, sized here so that process never allocates
+        unsigned int storeSize = DAP_INPUT_STORE_FRAMES *
+                                 audio_channel_count_from_out_mask(pConfig->inputCfg.channels) *
+                                 audioFormat2sampleSize((audio_format_t)pConfig->inputCfg.format);
+        if (pDapData->inStorgeBufSize < storeSize) {
+            void *buf = realloc(pDapData->inStorgeBuf, storeSize);
+            if (buf == NULL) {
+                ALOGE("%s,no memory for inStorgeBuf buffer", __FUNCTION__);
+                return -ENOMEM;
+            }
+            ALOGI("%s,inStorgeBuf size %u -> %u", __FUNCTION__, pDapData->inStorgeBufSize, storeSize);
+            pDapData->inStorgeBuf = buf;
+            pDapData->inStorgeBufSize = storeSize;
+        }
+
         memcpy(&pContext->config, pConfig, sizeof(effect_config_t));
 
         if (pContext->bUseFade) {
@@ -4613,6 +4838,15 @@ Error:
             ALOGD("%s: get Surround Boost -> %d", __FUNCTION__, value);
             break;
         }
+        case DAP_PARAM_LATENCY:
+            if (*pValueSize < sizeof(uint32_t)) {
+                *pValueSize = 0;
+                return -EINVAL;
+            }
+            value = __atomic_load_n(&pContext->latency, __ATOMIC_RELAXED);
+            *(uint32_t *) pValue = value;
+            ALOGD("%s: get latency -> %d frames", __FUNCTION__, value);
+            break;
         default:
             ALOGE("%s: unknown param %d", __FUNCTION__, param);
             return -EINVAL;
@@ -4636,7 +4870,9 @@ Error:
                 return 0;
             }
             value = *(uint32_t *)pValue;
-            dap_set_enable(pContext, value);
+            pContext->next_params.enable = value;
+            pContext->next_params.enable_seq++;
+            DAP_publish(pContext);
             ALOGD("%s: Set DAP enable -> %s", __FUNCTION__, DapEnableStr[value]);
             break;
         case DAP_PARAM_EFFECT_MODE:
@@ -4652,17 +4888,16 @@ Error:
             pContext->modeValue = value;
 
             if (pContext->bUseFade) {
-                AudioFade_t *pAudioFade = (AudioFade_t *) & (pContext->gAudFade);
-                AudioFadeInit(pAudioFade, fadeLinear, 10, 0);
                 if ((pDapData->eDapEffectMode == DAP_MODE_DISABLE) && (value != DAP_MODE_DISABLE)) {
-                    AudioFadeSetState(pAudioFade, AUD_FADE_MUTE);
-                    dap_set_enable(pContext, 1);
+                    pContext->next_params.modeSet = DAP_MODE_SET_UNMUTE;
                 } else
-                    AudioFadeSetState(pAudioFade, AUD_FADE_OUT_START);
+                    pContext->next_params.modeSet = DAP_MODE_SET_FADE_OUT;
             } else {
                 // origninal code
-                dap_set_effect_mode(pContext, (DAPmode)value);
+                pContext->next_params.modeSet = DAP_MODE_SET_DIRECT;
             }
+            pContext->next_params.mode_seq++;
+            DAP_publish(pContext);
             ALOGD("%s: Set DAP effect -> %s", __FUNCTION__, DapEffectModeStr[value]);
             break;
         case DAP_PARAM_POST_GAIN:
@@ -4671,7 +4906,8 @@ Error:
             }
             value = *(uint32_t *)pValue;
             pDapData->dapPostGain = value;
-            dap_set_postgain(pContext, value);
+            pContext->next_params.postgain_seq++;
+            DAP_publish(pContext);
             ALOGD("%s: Set DAP post gain -> %d", __FUNCTION__, value);
             break;
         case DAP_PARAM_VOL_LEVELER_ENABLE:
@@ -4681,7 +4917,8 @@ Error:
             value = *(uint32_t *)pValue;
             value = (value == 0) ? 0 : 1;
             pDapData->dapVolLeveler.vl_enable = value;
-            dap_set_vol_leveler(pContext, (dolby_vol_leveler_t *)&pDapData->dapVolLeveler);
+            pContext->next_params.vl_seq++;
+            DAP_publish(pContext);
             ALOGD("%s: Set Volume Leveler enable -> %s", __FUNCTION__, DapEnableStr[value]);
             break;
         case DAP_PARAM_VOL_LEVELER_AMOUNT:
@@ -4696,7 +4933,8 @@ Error:
                 value = DAP_CPDP_VOLUME_LEVELER_AMOUNT_MIN;
             }
             pDapData->dapVolLeveler.vl_amount = value;
-            dap_set_vol_leveler(pContext, (dolby_vol_leveler_t *)&pDapData->dapVolLeveler);
+            pContext->next_params.vl_seq++;
+            DAP_publish(pContext);
             ALOGD("%s: Set Volume Leveler amount -> %d", __FUNCTION__, value);
             break;
         case DAP_PARAM_DE_ENABLE:
@@ -4706,7 +4944,8 @@ Error:
             value = *(uint32_t *)pValue;
             value = (value == 0) ? 0 : 1;
             pDapData->dapDialogEnhance.de_enable = value;
-            dap_set_dialog_enhance(pContext, (dolby_dialog_enhance_t *) & (pDapData->dapDialogEnhance));
+            pContext->next_params.de_seq++;
+            DAP_publish(pContext);
             ALOGD("%s: Set Dialog Enhance Enable -> %s", __FUNCTION__, DapEnableStr[value]);
             break;
         case DAP_PARAM_DE_AMOUNT:
@@ -4714,27 +4953,27 @@ Error:
                 return 0;
             }
             value = *(uint32_t *)pValue;
-            pDapData->dapDialogEnhance.de_amount = value;
             if (value > DAP_CPDP_DE_AMOUNT_MAX) {
                 value = DAP_CPDP_DE_AMOUNT_MAX;
             }
             if (value < DAP_CPDP_DE_AMOUNT_MIN) {
                 value = DAP_CPDP_DE_AMOUNT_MIN;
             }
-            dap_set_dialog_enhance(pContext, (dolby_dialog_enhance_t *) & (pDapData->dapDialogEnhance));
+            pDapData->dapDialogEnhance.de_amount = value;
+            pContext->next_params.de_seq++;
+            DAP_publish(pContext);
             ALOGD("%s: Set Dialog Enhance amount -> %d", __FUNCTION__, value);
             break;
         case DAP_PARAM_GEQ_ENABLE:
         {
-            dolby_eq_t dapEQ;
             if (!pContext->gDAPLibHandler) {
                 return 0;
             }
             value = *(uint32_t *)pValue;
             //value = (value == 0) ? 0 : 1;
             pDapData->dapEQ.eq_enable.geq_enable = value;
-            dap_get_mode_param(pContext, param, (void *)&dapEQ, false);
-            dap_set_eq_params(pContext, (dolby_eq_t *) &dapEQ);
+            pContext->next_params.eq_seq++;
+            DAP_publish(pContext);
             ALOGD("%s: Set EQ enable -> %d", __FUNCTION__, value);
             break;
         }
@@ -4766,17 +5005,16 @@ Error:
             }
 
             if (pContext->bUseFade && needFade) {
-                AudioFade_t *pAudioFade = (AudioFade_t *) & (pContext->gAudFade);
-                AudioFadeInit(pAudioFade, fadeLinear, 10, 0);
                 if (pDapData->eDapEffectMode == DAP_MODE_DISABLE) {
-                    AudioFadeSetState(pAudioFade, AUD_FADE_MUTE);
-                    dap_set_enable(pContext, 1);
+                    pContext->next_params.modeSet = DAP_MODE_SET_UNMUTE;
                 } else
-                    AudioFadeSetState(pAudioFade, AUD_FADE_OUT_START);
+                    pContext->next_params.modeSet = DAP_MODE_SET_FADE_OUT;
             } else {
                 // origninal code
-                dap_set_effect_mode(pContext, (DAPmode)value);
+                pContext->next_params.modeSet = DAP_MODE_SET_DIRECT;
             }
+            pContext->next_params.mode_seq++;
+            DAP_publish(pContext);
             break;
         case DAP_PARAM_VIRTUALIZER_ENABLE:
             if (!pContext->gDAPLibHandler) {
@@ -4785,7 +5023,8 @@ Error:
             value = *(uint32_t *)pValue;
             //value = (value == 0) ? 0 : 1;
             pDapData->dapVirtualSrnd.enable.virtualizer_enable = value;
-            dap_set_virtual_surround(pContext, (dolby_virtual_surround_t *) & (pDapData->dapVirtualSrnd));
+            pContext->next_params.vs_seq++;
+            DAP_publish(pContext);
             ALOGD("%s: Set virtualizer enable -> %d", __FUNCTION__, value);
             break;
         case DAP_PARAM_SUROUND_ENABLE:
@@ -4795,7 +5034,8 @@ Error:
             value = *(uint32_t *)pValue;
             value = (value == 0) ? 0 : 1;
             pDapData->dapVirtualSrnd.enable.surround_decoder_enable = value;
-            dap_set_virtual_surround(pContext, (dolby_virtual_surround_t *) & (pDapData->dapVirtualSrnd));
+            pContext->next_params.vs_seq++;
+            DAP_publish(pContext);
             ALOGD("%s: Set surround_decoder enable -> %s", __FUNCTION__, DapEnableStr[value]);
             break;
         case DAP_PARAM_SURROUND_BOOST:
@@ -4804,7 +5044,8 @@ Error:
             }
             value = *(uint32_t *)pValue;
             pDapData->dapVirtualSrnd.surround_boost = value;
-            dap_set_virtual_surround(pContext, (dolby_virtual_surround_t *) & (pDapData->dapVirtualSrnd));
+            pContext->next_params.vs_seq++;
+            DAP_publish(pContext);
             ALOGD("%s: Set Surround Boost value -> %d", __FUNCTION__, value);
             break;
 
@@ -4820,23 +5061,239 @@ Error:
     int DAP_release(DAPContext *pContext)
     {
         dap_release_api(pContext);
+        AudioArenaRelease(&pContext->gDAPdata.arena);
+        ParamSnapshotRelease(&pContext->params);
+        return 0;
+    }
+
+    /* Process one DAP_CPDP_PCM_SAMPLES_PER_BLOCK block. The dlb_buffers point
+     * straight at the interleaved data (nstride = channel count), dap_cpdp
+     * allows the output to overlap the input of the same block.
+     * Returns the output channel count. */
+    static unsigned dap_process_block(DAPContext *pContext, const void *pIn, unsigned inChannels, void *pOut)
+    {
+        DAPdata *pDapData = &(pContext->gDAPdata);
+        DAPapi *pDAPapi = &(pContext->gDAPapi);
+        void *in_pointers[DAP_CPDP_MAX_NUM_CHANNELS];
+        void *out_pointers[DAP_CPDP_MAX_NUM_CHANNELS];
+        dlb_buffer inDlbBuf;
+        dlb_buffer outDlbBuf;
+        unsigned sampleSize = pContext->sample_size;
+        unsigned ch_id, nch, cnt;
+        int ret, errDAP;
+
+        for (ch_id = 0; ch_id < inChannels; ch_id++) {
+            in_pointers[ch_id] = (void *)((const char *)pIn + ch_id * sampleSize);
+        }
+        inDlbBuf.ppdata = in_pointers;
+        inDlbBuf.nchannel = inChannels;
+        inDlbBuf.data_type = pContext->dlb_data_type;
+        inDlbBuf.nstride = inChannels;
+
+        ret = aml_dap_cpdp_prepare(pDAPapi, pDapData->dap_cpdp, &inDlbBuf, NULL, NULL);
+        if (ret <= 0 || ret > DAP_CPDP_MAX_NUM_CHANNELS) {
+            ALOGE("%s, dap_cpdp_prepare returned %d channels", __FUNCTION__, ret);
+            nch = inChannels;
+            errDAP = 1;
+        } else {
+            nch = ret;
+            for (ch_id = 0; ch_id < nch; ch_id++) {
+                out_pointers[ch_id] = (void *)((char *)pOut + ch_id * sampleSize);
+            }
+            outDlbBuf.ppdata = out_pointers;
+            outDlbBuf.nchannel = nch;
+            outDlbBuf.data_type = pContext->dlb_data_type;
+            outDlbBuf.nstride = nch;
+
+            /* The scratch memory does not need to persist between calls to
+             * aml_dap_cpdp_process_api(), nor to be cleared. */
+            errDAP = 0;
+            aml_dap_cpdp_process_api(pDAPapi, pDapData->dap_cpdp, &outDlbBuf, pDapData->pScratchMem, &errDAP);
+        }
+
+        if (errDAP) {
+            // pass through mode, in place the input is already gone
+            if (pOut != pIn) {
+                const char *pSrc = (const char *)pIn;
+                char *pDst = (char *)pOut;
+                for (cnt = 0; cnt < DAP_CPDP_PCM_SAMPLES_PER_BLOCK; cnt++) {
+                    for (ch_id = 0; ch_id < nch; ch_id++) {
+                        if (ch_id < inChannels) {
+                            memcpy(pDst + ch_id * sampleSize, pSrc + ch_id * sampleSize, sampleSize);
+                        } else {
+                            memset(pDst + ch_id * sampleSize, 0, sampleSize);
+                        }
+                    }
+                    pSrc += inChannels * sampleSize;
+                    pDst += nch * sampleSize;
+                }
+            }
+            pDapData->is_passthrough = 1;
+            //ALOGI("%s, errDAP = [%d], passthrough case",__FUNCTION__, errDAP);
+        }
+        return nch;
+    }
+
+    // audio thread: make the delay of this block visible to DAP_PARAM_LATENCY
+    static void dap_publish_latency(DAPContext *pContext, int active)
+    {
+        int32_t latency = 0;
+
+        if (active) {
+            latency = pContext->lib_latency + (pContext->fifo_enable ? DAP_FIFO_LATENCY : 0);
+        }
+        if (latency != __atomic_load_n(&pContext->latency, __ATOMIC_RELAXED)) {
+            ALOGI("%s: latency %d frames (dap_cpdp %u, fifo %d)", __FUNCTION__, latency,
+                  active ? pContext->lib_latency : 0, (active && pContext->fifo_enable) ? DAP_FIFO_LATENCY : 0);
+            __atomic_store_n(&pContext->latency, latency, __ATOMIC_RELAXED);
+        }
+    }
+
+    static void dap_fifo_reset(DAPContext *pContext)
+    {
+        pContext->fifo_enable = 0;
+        pContext->fifo_in_frames = 0;
+        pContext->fifo_out_frames = 0;
+    }
+
+    /* Any frameCount: input is collected into full blocks and the output is
+     * delayed by DAP_FIFO_LATENCY frames, which is the most a partial block
+     * can hold back. Once started the FIFO stays in use so that the latency
+     * does not change with the period size. */
+    static void dap_process_fifo(DAPContext *pContext, const void *pIn, unsigned inChannels, void *pOut, unsigned frameCount)
+    {
+        DAPdata *pDapData = &(pContext->gDAPdata);
+        const char *pSrc = (const char *)pIn;
+        char *pDst = (char *)pOut;
+        char *pFifoIn = (char *)pContext->fifo_in;
+        char *pFifoOut = (char *)pContext->fifo_out;
+        unsigned sampleSize = pContext->sample_size;
+        unsigned pending = 0;
+        unsigned n, nch;
+
+        if (!pContext->fifo_enable) {
+            pContext->fifo_enable = 1;
+            pContext->fifo_in_ch = inChannels;
+            pContext->fifo_out_ch = pDapData->dapOutChannels ? pDapData->dapOutChannels : inChannels;
+            pContext->fifo_in_frames = 0;
+            pContext->fifo_out_frames = DAP_FIFO_LATENCY;
+            memset(pFifoOut, 0, DAP_FIFO_LATENCY * pContext->fifo_out_ch * sampleSize);
+            ALOGI("%s: frameCount %u, use FIFO with %d frames latency", __FUNCTION__, frameCount, DAP_FIFO_LATENCY);
+        } else if (pContext->fifo_in_ch != inChannels) {
+            // the frames already queued can not be remapped, keep their timing
+            memset(pFifoIn, 0, sizeof(pContext->fifo_in));
+            pContext->fifo_in_ch = inChannels;
+        }
+
+        while (frameCount > 0) {
+            n = DAP_CPDP_PCM_SAMPLES_PER_BLOCK - pContext->fifo_in_frames;
+            if (n > frameCount) {
+                n = frameCount;
+            }
+            memcpy(pFifoIn + pContext->fifo_in_frames * inChannels * sampleSize, pSrc, n * inChannels * sampleSize);
+            pContext->fifo_in_frames += n;
+            pSrc += n * inChannels * sampleSize;
+            frameCount -= n;
+            pending += n;
+
+            if (pContext->fifo_in_frames == DAP_CPDP_PCM_SAMPLES_PER_BLOCK) {
+                char *pBlk = pFifoOut + pContext->fifo_out_frames * pContext->fifo_out_ch * sampleSize;
+                nch = dap_process_block(pContext, pFifoIn, inChannels, pBlk);
+                if (nch != pContext->fifo_out_ch) {
+                    // DAP changed its output layout, the queued frames become silence
+                    ALOGI("%s: output channels %u -> %u", __FUNCTION__, pContext->fifo_out_ch, nch);
+                    memmove(pFifoOut + pContext->fifo_out_frames * nch * sampleSize, pBlk,
+                            DAP_CPDP_PCM_SAMPLES_PER_BLOCK * nch * sampleSize);
+                    memset(pFifoOut, 0, pContext->fifo_out_frames * nch * sampleSize);
+                    pContext->fifo_out_ch = nch;
+                }
+                pDapData->dapOutChannels = nch;
+                pContext->fifo_out_frames += DAP_CPDP_PCM_SAMPLES_PER_BLOCK;
+                pContext->fifo_in_frames = 0;
+            }
+
+            // the latency guarantees that every pending frame is available here
+            nch = pContext->fifo_out_ch;
+            n = pending < pContext->fifo_out_frames ? pending : pContext->fifo_out_frames;
+            memcpy(pDst, pFifoOut, n * nch * sampleSize);
+            pDst += n * nch * sampleSize;
+            pending -= n;
+            pContext->fifo_out_frames -= n;
+            memmove(pFifoOut, pFifoOut + n * nch * sampleSize, pContext->fifo_out_frames * nch * sampleSize);
+        }
+    }
+
+    /* frameCount frames through the FIFO, or block by block when frameCount is
+     * a whole number of blocks. Returns the output channel count. */
+    static unsigned dap_process_frames(DAPContext *pContext, const char *pIn, unsigned inChannels,
+                                       char *pOut, unsigned frameCount, bool useFifo)
+    {
+        DAPdata *pDapData = &(pContext->gDAPdata);
+        unsigned sampleSize = pContext->sample_size;
+        unsigned i, nch;
+
+        if (useFifo) {
+            dap_process_fifo(pContext, pIn, inChannels, pOut, frameCount);
+            return pContext->fifo_out_ch;
+        }
+        nch = pDapData->dapOutChannels;
+        for (i = 0; i < frameCount / DAP_CPDP_PCM_SAMPLES_PER_BLOCK; i++) {
+            nch = dap_process_block(pContext, pIn, inChannels, pOut);
+            pDapData->dapOutChannels = nch;
+            pIn += DAP_CPDP_PCM_SAMPLES_PER_BLOCK * inChannels * sampleSize;
+            pOut += DAP_CPDP_PCM_SAMPLES_PER_BLOCK * nch * sampleSize;
+        }
+        return nch;
+    }
+
+    /* In place with up to outChannels of output per frame, staged through
+     * inStorgeBuf in chunks. The input is first moved to the end of the
+     * buffer, from there the output written so far can not reach the input
+     * not read yet. */
+    static int dap_process_staged(DAPContext *pContext, char *pBuf, unsigned inChannels,
+                                  unsigned outChannels, unsigned frameCount, bool useFifo)
+    {
+        DAPdata *pDapData = &(pContext->gDAPdata);
+        unsigned frameSize = inChannels * pContext->sample_size;
+        unsigned chunk = pDapData->inStorgeBufSize / frameSize;
+        char *pSrc = pBuf;
+        char *pDst = pBuf;
+        unsigned n, nch;
+
+        if (!useFifo) {
+            chunk -= chunk % DAP_CPDP_PCM_SAMPLES_PER_BLOCK;
+        }
+        if (chunk == 0) {
+            ALOGE("%s, inStorgeBuf of %u bytes is too small", __FUNCTION__, pDapData->inStorgeBufSize);
+            return -EINVAL;
+        }
+        if (outChannels > inChannels) {
+            pSrc = pBuf + frameCount * (outChannels - inChannels) * pContext->sample_size;
+            memmove(pSrc, pBuf, frameCount * frameSize);
+        }
+        while (frameCount > 0) {
+            n = frameCount < chunk ? frameCount : chunk;
+            memcpy(pDapData->inStorgeBuf, pSrc, n * frameSize);
+            nch = dap_process_frames(pContext, (const char *)pDapData->inStorgeBuf, inChannels, pDst, n, useFifo);
+            pSrc += n * frameSize;
+            pDst += n * nch * pContext->sample_size;
+            frameCount -= n;
+        }
         return 0;
     }
 
     //-------------------Effect Control Interface Implementation--------------------------
     /* In current design, in audio_hw.c,  audio_hal_data_processing()->audio_post_process()
-     *  audio_post_process() call DAP_process() with "inBuffer" and "outBuffer" share same memory address
-     *  to couple with this use case, DAP_process() copy "inBuffer" into "input_storage_buf"
-     *  to assure input data un touched
+     *  audio_post_process() call DAP_process() with "inBuffer" and "outBuffer" share same memory address.
+     *  Blocks are processed in place, only when DAP returns more channels than its input
+     *  "inBuffer" is staged through "inStorgeBuf" so that later blocks stay untouched.
      */
     int DAP_process(effect_handle_t self, audio_buffer_t *inBuffer, audio_buffer_t *outBuffer)
     {
         DAPContext *pContext = (DAPContext *)self;
-        int inSampleSize, outSampleSize;
+        int inSampleSize, outSampleSize, dlbDataType;
         int inChannels, outChannels;
         int ret;
-        unsigned int tmpSize;
-        unsigned int i;
         int status = EXIT_SUCCESS;
         DAPdata *pDapData = &(pContext->gDAPdata);
         DAPapi * pDAPapi = &(pContext->gDAPapi);
@@ -4882,19 +5339,29 @@ Error:
             return -ENODATA;
         }
 
+        int accumulate = AudioAccumulateNeeded(&pContext->accumulate, &pContext->config, inBuffer, outBuffer);
+        int changed;
+        const DAPparam *params = (const DAPparam *)ParamSnapshotAcquire(&pContext->params, &changed);
+
         // read input / output data format from configurations
         inSampleSize = audioFormat2sampleSize((audio_format_t)pContext->config.inputCfg.format);
-        //if (-1 == inSampleSize) {
-        if (2 != inSampleSize) {
-            ALOGE("%s, invalid input sample size to process %d\n", __FUNCTION__, inSampleSize);
+        dlbDataType = audioFormat2dlbDataType((audio_format_t)pContext->config.inputCfg.format);
+        if (dlbDataType < 0) {
+            ALOGE("%s, invalid input format to process 0x%x\n", __FUNCTION__, pContext->config.inputCfg.format);
             return -EINVAL;
         }
         outSampleSize = audioFormat2sampleSize((audio_format_t)pContext->config.outputCfg.format);
-        //if (-1 == outSampleSize) {
-        if (2 != outSampleSize) {
-            ALOGE("%s, invalid output sample size to process %d\n", __FUNCTION__, outSampleSize);
+        if (pContext->config.outputCfg.format != pContext->config.inputCfg.format) {
+            ALOGE("%s, invalid output format to process 0x%x\n", __FUNCTION__, pContext->config.outputCfg.format);
             return -EINVAL;
         }
+        if (dlbDataType != pContext->dlb_data_type) {
+            // dap_cpdp reads and writes this format directly, queued samples are of the old one
+            ALOGI("%s, dlb_buffer data type %d -> %d", __FUNCTION__, pContext->dlb_data_type, dlbDataType);
+            dap_fifo_reset(pContext);
+            pContext->dlb_data_type = dlbDataType;
+            pContext->sample_size = inSampleSize;
+        }
 
         inChannels = popcount(pContext->config.inputCfg.channels);
         outChannels = popcount(pContext->config.outputCfg.channels);
@@ -4903,20 +5370,16 @@ Error:
         ALOGV("%s, inSampleSize = %d, outSampleSize = %d, inChannels = %d, outChannels = %d, inFrameCnt = %d\n",
               __FUNCTION__, inSampleSize, outSampleSize, inChannels, outChannels, inBuffer->frameCount);
 
-        if (!pDapData->bDapCPDPInited || pDapData->bNeedReset) {
-            if (NULL == pDapData->inStorgeBuf) {
-                tmpSize = inBuffer->frameCount * inChannels * inSampleSize;
-                pDapData->inStorgeBuf = malloc(tmpSize);
-                if (pDapData->inStorgeBuf == NULL) {
-                    ALOGE("%s,no memory for headphone output buffer", __FUNCTION__);
-                    //ret = -ENOMEM;
-                    return -EINVAL;
-                }
-                pDapData->inStorgeBufSize = tmpSize;
-                pDapData->curInfrmCnts = inBuffer->frameCount;
-                ALOGE("%s,malloc inStorgeBufSize [%p], size = %d", __FUNCTION__, pDapData->inStorgeBuf, pDapData->inStorgeBufSize);
-            }
-
+        // dap_cpdp is only set up again when the sample rate or the channel
+        // layout changes, everything else is applied to the live instance
+        int in_channel_cnt = audio_channel_count_from_out_mask(pContext->config.inputCfg.channels);
+        if (!pDapData->bDapCPDPInited || pDapData->bNeedReset ||
+            pDapData->init_info.sample_rate != pContext->config.inputCfg.samplingRate ||
+            pDapData->dapInitChannels != (unsigned int)in_channel_cnt) {
+            ALOGI("%s: init dap_cpdp, %u Hz %d channels", __FUNCTION__, pContext->config.inputCfg.samplingRate, in_channel_cnt);
+            // DAP output channels are known again after the first block
+            pDapData->dapOutChannels = 0;
+            dap_fifo_reset(pContext);
             dap_release_api(pContext);
             ret = dap_init_api(pContext);
             if (ret == DAP_RET_FAIL) {
@@ -4924,7 +5387,6 @@ Error:
                 return DAP_RET_FAIL;
             }
 
-            int in_channel_cnt = audio_channel_count_from_out_mask(pContext->config.inputCfg.channels);
             int out_channel_cnt = audio_channel_count_from_out_mask(pContext->config.outputCfg.channels);
             int dap_out_mode = DAP_CPDP_OUTPUT_2_SPEAKER;
             if (in_channel_cnt == 2) {
@@ -4936,11 +5398,12 @@ Error:
             }
 
             pDapData->dapCPDPOutputMode = dap_out_mode;
+            pDapData->dapInitChannels = in_channel_cnt;
             ALOGD("%s:channel_cnt = %d, dap_out_mode = %d", __FUNCTION__, in_channel_cnt, dap_out_mode);
 
             // Initializing all parameers
             aml_dap_cpdp_output_mode_set(pDAPapi, pDapData->dap_cpdp, pDapData->dapCPDPOutputMode);
-            dap_set_effect_mode(pContext, pDapData->eDapEffectMode);
+            dap_set_effect_mode(pContext, params, pDapData->eDapEffectMode);
             //dap_set_vol_leveler(pContext, (dolby_vol_leveler_t *)&pDapData->dapVolLeveler);
             //dap_set_dialog_enhance(pContext, (dolby_dialog_enhance_t *)&pDapData->dapDialogEnhance);
             //dap_set_virtual_surround(pContext, (dolby_virtual_surround_t *)&pDapData->dapVirtualSrnd);
@@ -4948,16 +5411,26 @@ Error:
             //dap_set_enable(pContext, pDapData->bDapEnabled);
 
             pDapData->bNeedReset = 0;
+            // the effect mode covers every group but a pending enable
+            uint32_t enable_seq = pContext->cur_params.enable_seq;
+            pContext->cur_params = *params;
+            pContext->cur_params.enable_seq = enable_seq;
+        }
+        if (changed) {
+            DAP_apply_params(pContext, params);
         }
         pDapData->curInfrmCnts = inBuffer->frameCount;
 
         // pass through data
         if (!pDapData->bDapEnabled || !pContext->gDAPLibHandler || !pDapData->islicenseOK) {
-            // TODO: different sample size support
-            ALOGD("%s, do_passthrough() ,bLicense = %d, bDapEnabled= %d\n", __FUNCTION__, pDapData->islicenseOK, pDapData->bDapEnabled);
-            ret = do_passthrough(inBuffer, outBuffer);
+            ALOGV("%s, passthrough, bLicense = %d, bDapEnabled= %d\n", __FUNCTION__, pDapData->islicenseOK, pDapData->bDapEnabled);
+            AudioBypass(&pContext->config, accumulate, inBuffer, outBuffer);
             pDapData->is_passthrough = 1;
-            return ret;
+            if (pContext->fifo_enable) {
+                dap_fifo_reset(pContext);
+            }
+            dap_publish_latency(pContext, 0);
+            return 0;
         }
 
         // check dap_cpdp
@@ -4969,39 +5442,15 @@ Error:
             ALOGE("<%s::%d>--[!pDapData->pScratchMem]", __FUNCTION__, __LINE__);
             return -EINVAL;
         }
+        if (accumulate) {
+            return AudioAccumulateProcess(&pContext->accumulate, self, &pContext->config, inBuffer, outBuffer);
+        }
 
-        dlb_buffer inDlbBuf;
-        dlb_buffer outDlbBuf;
-        short *pBlkBuf16In = NULL;
-        short *pBlkBuf16Out = NULL;
-        void *channel_pointers[DAP_CPDP_MAX_NUM_CHANNELS];
-
-        /* Audio input and output is done using dlb_buffer structures. These have
-         * an array of channel pointers, and a stride. We create two dlb_buffer
-         * structures which are completely identical except for perhaps the channel
-         * counts and strides. This means that processing will be done inplace.
-         * We also set up our processing to be done on interleaved data, this is
-         * mainly to simplify our IO code. Non-interleaved processing is possible
-         * by changing the channel pointers and stride. */
-        inDlbBuf.ppdata = channel_pointers;
-        inDlbBuf.nchannel = inChannels;//INPUT_CHANNELS;
-        inDlbBuf.data_type = 4;//DLB_BUFFER_SHORT_16;
-        inDlbBuf.nstride = 1;//INPUT_CHANNELS;
-
-        /* We don't know the output channel count here yet, but we can set up
-         * our channel pointers to handle the worst case now. */
-        outDlbBuf.ppdata = channel_pointers;
-        outDlbBuf.data_type = 4;//DLB_BUFFER_SHORT_16;
-
-        int16_t   *pIn16  = (int16_t *)inBuffer->raw;
-        int16_t   *pOut16 = (int16_t *)outBuffer->raw;
-        unsigned char *pInChar = (unsigned char *)inBuffer->raw;
-        unsigned char *pOutChar = (unsigned char *)outBuffer->raw;
+        void *pIn  = inBuffer->raw;
+        void *pOut = outBuffer->raw;
 
         if (pContext->bUseFade) {
-            int i;
             AudioFade_t *pAudFade = (AudioFade_t *) & (pContext->gAudFade);
-            unsigned int modeValue;
             unsigned int nSamples = (unsigned int)inBuffer->frameCount;
 
             if (pAudFade->mFadeState != AUD_FADE_IDLE) {
@@ -5018,17 +5467,17 @@ Error:
                 pAudFade->mfadeFramesUsed = 0;
                 pAudFade->mfadeTimeTotal = DEFAULT_FADE_OUT_MS;
                 pAudFade->muteCounts = 1;
-                AudioFadeBuf(pAudFade, pIn16, nSamples);
+                AudioFadeBuf(pAudFade, pIn, nSamples);
                 pAudFade->mFadeState = AUD_FADE_OUT;
             }
             break;
             case AUD_FADE_OUT: {
                 // do fade out process
                 if (pAudFade->mCurrentVolume != 0) {
-                    AudioFadeBuf(pAudFade, pIn16, nSamples);
+                    AudioFadeBuf(pAudFade, pIn, nSamples);
                 } else {
                     pAudFade->mFadeState = AUD_FADE_MUTE;
-                    mutePCMBuf(pAudFade, pIn16, nSamples);
+                    mutePCMBuf(pAudFade, pIn, nSamples);
                 }
             }
             break;
@@ -5042,19 +5491,17 @@ Error:
                     pAudFade->mfadeTimeUsed = 0;
                     pAudFade->mfadeFramesUsed = 0;
                     pAudFade->mfadeTimeTotal = DEFAULT_FADE_IN_MS;
-                    mutePCMBuf(pAudFade, pIn16, nSamples);
+                    mutePCMBuf(pAudFade, pIn, nSamples);
                     // do actrually setting
-                    modeValue = pContext->modeValue;
-                    // origninal code
-                    dap_set_effect_mode(pContext, (DAPmode)modeValue);
+                    dap_set_effect_mode(pContext, params, (DAPmode)params->modeValue);
                 } else {
-                    mutePCMBuf(pAudFade, pIn16, nSamples);
+                    mutePCMBuf(pAudFade, pIn, nSamples);
                     pAudFade->muteCounts--;
                 }
             }
             break;
             case AUD_FADE_IN: {
-                AudioFadeBuf(pAudFade, pIn16, nSamples);
+                AudioFadeBuf(pAudFade, pIn, nSamples);
                 if (pAudFade->mCurrentVolume == 1 << 16) {
                     pAudFade->mFadeState = AUD_FADE_IDLE;
                 }
@@ -5068,28 +5515,13 @@ Error:
             }
         }
 
-        // begain start processing data
-        tmpSize = inBuffer->frameCount * inChannels * inSampleSize;
-        if (pDapData->inStorgeBufSize < tmpSize) {
-            ALOGI("%s,realloc pDapData->inStorgeBuf size from %zu to %zu", __FUNCTION__, pDapData->inStorgeBufSize, tmpSize);
-            pDapData->inStorgeBuf = realloc(pDapData->inStorgeBuf, tmpSize);
-            if (pDapData->inStorgeBuf == NULL) {
-                ALOGE("%s,no memory for inStorgeBuf buffer", __FUNCTION__);
-                //ret = -ENOMEM;
-                return -EINVAL;
-            }
-            pDapData->inStorgeBufSize = tmpSize;
-        }
-
-        memset(pDapData->inStorgeBuf, 0, pDapData->inStorgeBufSize);
-        char *input_storage_buf = (char *)pDapData->inStorgeBuf;
-        memcpy((void *)input_storage_buf, (const void *)pInChar, tmpSize);
-
-        for (i = 0; i < DAP_CPDP_MAX_NUM_CHANNELS; i++) {
-            // we don't have malloc these data,we use .DATA area.
-            channel_pointers[i] = pDapData->audioInTmp16[i];
-            inDlbBuf.ppdata[i] = channel_pointers[i];
-            outDlbBuf.ppdata[i] = channel_pointers[i] ;
+        // once dap_cpdp has told its output layout, drained silence is not run
+        // through it. The FIFO keeps its frames, so the latency is unchanged.
+        if (AudioSilenceDetect(&pContext->silence, pIn, inBuffer->frameCount,
+                inChannels * inSampleSize, pContext->config.inputCfg.samplingRate) &&
+            pDapData->dapOutChannels != 0) {
+            memset(pOut, 0, inBuffer->frameCount * pDapData->dapOutChannels * outSampleSize);
+            return status;
         }
 
         pDapData->totalFrmCnts += inBuffer->frameCount;
@@ -5101,70 +5533,25 @@ Error:
             //stack.log("MS12DAP_Effect_callstack");
         }
 
-        if (inBuffer->frameCount % DAP_CPDP_PCM_SAMPLES_PER_BLOCK != 0) {
-            ALOGE("%s,frameCount(%d) not muliplier of %d", __FUNCTION__, inBuffer->frameCount, DAP_CPDP_PCM_SAMPLES_PER_BLOCK);
-        }
-
-        int cnt = 0;
-        for (i = 0; i < inBuffer->frameCount / DAP_CPDP_PCM_SAMPLES_PER_BLOCK; i++) {
-            int offset = i * DAP_CPDP_PCM_SAMPLES_PER_BLOCK * inChannels * sizeof(short);
-            pBlkBuf16In = (short *)(input_storage_buf + offset);
-            unsigned ch_id = 0;
-            unsigned nch = inDlbBuf.nchannel;
-
-            /* Interleave data into DLB buffer structure */
-            for (cnt = 0; cnt < DAP_CPDP_PCM_SAMPLES_PER_BLOCK; cnt++) {
-                for (ch_id = 0; ch_id < nch; ch_id++) {
-                    //NOTE: inDlbBuf.ppdata[i] = pDapData->audioInTmp16[i];
-                    pDapData->audioInTmp16[ch_id][cnt] = pBlkBuf16In[cnt * nch + ch_id];
-                    //ALOGE("[%x]", audio[ch_id][cnt]);
-                }
-            }
-
-            outDlbBuf.nchannel = aml_dap_cpdp_prepare(pDAPapi, pDapData->dap_cpdp, &inDlbBuf, NULL, NULL);
-            outDlbBuf.nstride = 1;
-
-            /* The call to aml_dap_cpdp_process_api() requires scratch memory. This memory
-             * does not need to persist between calls to aml_dap_cpdp_process_api() and
-             * can be allocated on the stack if convenient. */
-            int errDAP;
-            memset(pDapData->pScratchMem, 0, pDapData->uScratchSize);
-            aml_dap_cpdp_process_api(pDAPapi, pDapData->dap_cpdp, &outDlbBuf, pDapData->pScratchMem, &errDAP);
-
-            if (errDAP) {
-                offset = i * DAP_CPDP_PCM_SAMPLES_PER_BLOCK * outDlbBuf.nchannel * (sizeof(short)) ;
-                pBlkBuf16Out = (short *)(pOutChar + offset);
-                ch_id = 0;
-                nch = outDlbBuf.nchannel;
-
-                // output data also point to inplace memory
-                for (cnt = 0; cnt < DAP_CPDP_PCM_SAMPLES_PER_BLOCK; cnt++) {
-                    for (ch_id = 0; ch_id < nch; ch_id++) {
-                        /* pass through mode */
-                        pBlkBuf16Out[cnt * nch + ch_id] = pBlkBuf16In[cnt * nch + ch_id];
-                        //pBlkBuf16Out[cnt * nch + ch_id] = 0;
-                        //ALOGE("[%x]", audio[ch_id][cnt]);
-                    }
-                }
-
-                pDapData->is_passthrough = 1;
-                //ALOGI("%s, errDAP = [%d], passthrough case",__FUNCTION__, errDAP);
-            } else {
-                offset = i * DAP_CPDP_PCM_SAMPLES_PER_BLOCK * outDlbBuf.nchannel * (sizeof(short)) ;
-                pBlkBuf16Out = (short *)(pOutChar + offset);
-                ch_id = 0;
-                nch = outDlbBuf.nchannel;
-
-                // output data also point to inplace memory
-                for (cnt = 0; cnt < DAP_CPDP_PCM_SAMPLES_PER_BLOCK; cnt++) {
-                    for (ch_id = 0; ch_id < nch; ch_id++) {
-                        /* Write the resulting data to the array */
-                        pBlkBuf16Out[cnt * nch + ch_id] = pDapData->audioInTmp16[ch_id][cnt];
-                        //ALOGE("[%x]", audio[ch_id][cnt]);
-                    }
-                }
+        // begain start processing data
+        const char *pBlkBufIn = (const char *)pIn;
+        char *pBlkBufOut = (char *)pOut;
+        unsigned nBlocks = inBuffer->frameCount / DAP_CPDP_PCM_SAMPLES_PER_BLOCK;
+        bool useFifo = pContext->fifo_enable || (inBuffer->frameCount % DAP_CPDP_PCM_SAMPLES_PER_BLOCK) != 0;
+        if ((useFifo || nBlocks > 1) && pIn == pOut &&
+            (pDapData->dapOutChannels == 0 || pDapData->dapOutChannels > (unsigned)inChannels)) {
+            // DAP upmixes (or has not told yet): the output written so far
+            // would overwrite input not read yet
+            unsigned stageChannels = (unsigned)outChannels > pDapData->dapOutChannels ?
+                                     (unsigned)outChannels : pDapData->dapOutChannels;
+            ret = dap_process_staged(pContext, pBlkBufOut, inChannels, stageChannels, inBuffer->frameCount, useFifo);
+            if (ret < 0) {
+                return ret;
             }
+        } else {
+            dap_process_frames(pContext, pBlkBufIn, inChannels, pBlkBufOut, inBuffer->frameCount, useFifo);
         }
+        dap_publish_latency(pContext, 1);
 
         return status;
     }
@@ -5314,6 +5701,8 @@ Error:
         pContext->gDAPdata.totalFrmCnts = 0;
         pContext->gDAPdata.is_passthrough = 0;
         pContext->gDAPdata.islicenseOK = 0;
+        pContext->dlb_data_type = DLB_BUFFER_SHORT_16;
+        pContext->sample_size = sizeof(int16_t);
 
         memcpy((void *) & (pContext->gDAPdata.dapBaseSetting), (void *)&dap_dolby_base_music, sizeof(dolby_base));
 
@@ -5331,8 +5720,17 @@ Error:
         // after loading dapBaseSetting from ini file , make it as custom settings.
         memcpy((void *)&dap_dolby_base_custom, (void *) & (pContext->gDAPdata.dapBaseSetting) , sizeof(dolby_base));
 
+        pContext->next_params.enable = pContext->gDAPdata.bDapEnabled;
+        DAP_get_params(pContext, &pContext->next_params);
+        pContext->cur_params = pContext->next_params;
+        if (ParamSnapshotInit(&pContext->params, &pContext->next_params, sizeof(DAPparam)) < 0) {
+            delete pContext;
+            return -EINVAL;
+        }
+
         if (DAP_load_lib(pContext) < 0) {
             ALOGE("%s: Load Library File faied", __FUNCTION__);
+            ParamSnapshotRelease(&pContext->params);
             delete pContext;
             return -EINVAL;
         }
@@ -5342,15 +5740,26 @@ Error:
         pContext->gDAPdata.islicenseOK = aml_get_chip_ms12_license((DAPapi *)&pContext->gDAPapi);
         ALOGI("%s,islicenseOK = %d", __FUNCTION__, pContext->gDAPdata.islicenseOK);
 
-        pContext->gDAPdata.inStorgeBufSize = DAP_INPUT_STORE_SIZE;
+        if (dap_reserve_arena(pContext) != DAP_RET_SUCESS) {
+            DAP_unload_lib(pContext);
+            ParamSnapshotRelease(&pContext->params);
+            delete pContext;
+            return -ENOMEM;
+        }
+
+        // stereo 16 bit until DAP_configure
+        pContext->gDAPdata.inStorgeBufSize = DAP_INPUT_STORE_FRAMES * 2 * sizeof(int16_t);
         pContext->gDAPdata.inStorgeBuf = malloc(pContext->gDAPdata.inStorgeBufSize);
         if (pContext->gDAPdata.inStorgeBuf == NULL) {
             ALOGE("%s,no memory for inStorgeBuf buffer", __FUNCTION__);
+            ParamSnapshotRelease(&pContext->params);
             delete pContext;
             return -EINVAL;
         }
         ALOGI("%s,malloc inStorgeBufSize [%p], size = %d", __FUNCTION__, pContext->gDAPdata.inStorgeBuf, pContext->gDAPdata.inStorgeBufSize);
 
+        AudioSilenceInit(&pContext->silence, DAP_TAIL_MS);
+
         pContext->itfe = &DAPInterface;
         pContext->state = DAP_STATE_UNINITIALIZED;
 
@@ -5378,7 +5787,6 @@ Error:
         if (pContext->gDAPdata.inStorgeBuf) {
             free(pContext->gDAPdata.inStorgeBuf);
             pContext->gDAPdata.inStorgeBuf = NULL;
-            return -EINVAL;
         }
 
         DAP_release(pContext);
@@ -16,15 +16,27 @@ LOCAL_SHARED_LIBRARIES := \
 
 LOCAL_C_INCLUDES := \
     $(LOCAL_PATH) \
+    vendor/amlogic/frameworks/av/libaudioeffect/Utility \
     hardware/amlogic/audio/utils/ini/include \
     hardware/libhardware/include/hardware \
     hardware/libhardware/include \
     system/media/audio/include
 
 LOCAL_SRC_FILES += TrebleBass.cpp
-
+LOCAL_SRC_FILES += ../Utility/ParamSnapshot.c
+LOCAL_SRC_FILES += ../Utility/AudioSilence.c
+LOCAL_SRC_FILES += ../Utility/AudioBypass.c
+
+# TREBASS_SOURCE_ENGINE := true runs the per-session shelves in
+# TrebleBass.cpp instead of the prebuilt libAmlTrebleBass
+ifeq ($(TREBASS_SOURCE_ENGINE),true)
+LOCAL_CFLAGS += -DTREBASS_SOURCE_ENGINE
+LOCAL_SRC_FILES += ../Utility/AudioBiquad.c
+LOCAL_SRC_FILES += ../Utility/AudioConvert.c
+else
 LOCAL_LDFLAGS_arm  += $(LOCAL_PATH)/libAmlTrebleBass.a
 LOCAL_LDFLAGS_arm64 += $(LOCAL_PATH)/libAmlTrebleBass64.a
+endif
 
 LOCAL_MULTILIB := both
 
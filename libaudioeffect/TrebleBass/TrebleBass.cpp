@@ -37,10 +37,18 @@
 
 #include "IniParser.h"
 #include "TrebleBass.h"
+#include "ParamSnapshot.h"
 
 extern "C" {
 
+#ifdef TREBASS_SOURCE_ENGINE
+#include "../Utility/AudioBiquad.h"
+#include "../Utility/AudioConvert.h"
+#else
 #include "aml_treble_bass.h"
+#endif
+#include "../Utility/AudioSilence.h"
+#include "../Utility/AudioBypass.h"
 
 #define MODEL_SUM_DEFAULT_PATH "/vendor/etc/tvconfig/model/model_sum.ini"
 #define AUDIO_EFFECT_DEFAULT_PATH "/vendor/etc/tvconfig/audio/AMLOGIC_AUDIO_EFFECT_DEFAULT.ini"
@@ -87,15 +95,173 @@ typedef struct TreBassdata_s {
     int32_t       enable;
 } TreBassdata;
 
+/* snapshot read by TrebleBass_process */
+typedef struct TreBassparams_s {
+    int32_t       enable;
+    float         bass_gain;
+    float         treble_gain;
+    /* bumped by EFFECT_CMD_RESET, the state is cleared by the audio thread */
+    uint32_t      reset_seq;
+} TreBassparams;
+
+// the shelves have rung out well within this
+#define TREBASS_TAIL_MS 100
+
+#ifdef TREBASS_SOURCE_ENGINE
+
+#define TREBASS_BLOCK_FRAMES 256
+/* shelves meant to follow libAmlTrebleBass: bass +-10 dB below 135 Hz,
+ * treble +-12 dB above about 1 kHz over the same level range. Not yet
+ * checked against the archive's response. */
+#define TREBASS_BASS_FC 135.0f
+#define TREBASS_TREBLE_FC 1065.0f
+#define TREBASS_SHELF_Q 0.8f
+#define TREBASS_TREBLE_SCALE 1.2f
+
+/* low shelf then high shelf, one state per channel. Owned by the
+ * audio thread, redesigned only when a gain or the format changes. */
+typedef struct TreBassengine_s {
+    uint32_t      sample_rate;
+    int32_t       channels;
+    // gains the shelves are designed with, in dB
+    float         bass_gain;
+    float         treble_gain;
+    // processed since the last reset
+    int32_t       running;
+    AudioBiquad_t shelf;
+    float         work[TREBASS_BLOCK_FRAMES * AUDIO_BIQUAD_MAX_CHANNELS];
+} TreBassengine;
+
+static void TrebleBass_engine_design(TreBassengine *eng, float bass_gain, float treble_gain)
+{
+    AudioBiquadCoef_t coef;
+
+    AudioBiquadDesign(&coef, AUDIO_BIQUAD_LOWSHELF, eng->sample_rate,
+            TREBASS_BASS_FC, TREBASS_SHELF_Q, bass_gain);
+    AudioBiquadSetCoef(&eng->shelf, 0, &coef);
+    AudioBiquadDesign(&coef, AUDIO_BIQUAD_HIGHSHELF, eng->sample_rate,
+            TREBASS_TREBLE_FC, TREBASS_SHELF_Q, treble_gain * TREBASS_TREBLE_SCALE);
+    AudioBiquadSetCoef(&eng->shelf, 1, &coef);
+    eng->bass_gain = bass_gain;
+    eng->treble_gain = treble_gain;
+}
+
+static void TrebleBass_engine_init(TreBassengine *eng, uint32_t sample_rate, int32_t channels,
+        float bass_gain, float treble_gain)
+{
+    eng->sample_rate = sample_rate;
+    eng->channels = channels;
+    AudioBiquadInit(&eng->shelf, 2, channels);
+    TrebleBass_engine_design(eng, bass_gain, treble_gain);
+}
+
+static void TrebleBass_engine_reset(TreBassengine *eng)
+{
+    AudioBiquadReset(&eng->shelf);
+    eng->running = 0;
+}
+
+// interleaved 16 bit, in place or not
+static void TrebleBass_engine_process(TreBassengine *eng, const int16_t *in, int16_t *out, size_t frames)
+{
+    size_t n, samples;
+
+    eng->running = 1;
+    while (frames > 0) {
+        n = frames < TREBASS_BLOCK_FRAMES ? frames : TREBASS_BLOCK_FRAMES;
+        samples = n * eng->channels;
+        AudioConvertS16ToFloat(in, eng->work, samples);
+        AudioBiquadProcess(&eng->shelf, eng->work, eng->work, n);
+        AudioConvertFloatToS16(eng->work, out, samples);
+        in += samples;
+        out += samples;
+        frames -= n;
+    }
+}
+
+static void TrebleBass_engine_process_float(TreBassengine *eng, const float *in, float *out, size_t frames)
+{
+    eng->running = 1;
+    AudioBiquadProcess(&eng->shelf, in, out, frames);
+}
+
+#else
+
+/* The prebuilt libAmlTrebleBass: 16 bit stereo only, and a single state
+ * shared by all the sessions. It stays the default until the response of
+ * the source shelves has been compared with it. */
+typedef struct TreBassengine_s {
+    uint32_t      sample_rate;
+    int32_t       channels;
+    float         bass_gain;
+    float         treble_gain;
+    int32_t       running;
+} TreBassengine;
+
+static void TrebleBass_engine_design(TreBassengine *eng, float bass_gain, float treble_gain)
+{
+    audio_Treble_Bass_init(bass_gain, treble_gain);
+    eng->bass_gain = bass_gain;
+    eng->treble_gain = treble_gain;
+}
+
+static void TrebleBass_engine_init(TreBassengine *eng, uint32_t sample_rate, int32_t channels,
+        float bass_gain, float treble_gain)
+{
+    eng->sample_rate = sample_rate;
+    eng->channels = channels;
+    TrebleBass_engine_design(eng, bass_gain, treble_gain);
+}
+
+// the archive has no reset, initializing it again clears its state
+static void TrebleBass_engine_reset(TreBassengine *eng)
+{
+    audio_Treble_Bass_init(eng->bass_gain, eng->treble_gain);
+    eng->running = 0;
+}
+
+static void TrebleBass_engine_process(TreBassengine *eng, const int16_t *in, int16_t *out, size_t frames)
+{
+    eng->running = 1;
+    audio_Treble_Bass_process((int16_t *)in, out, (int)frames);
+}
+
+#endif
+
 typedef struct TREBASSContext_s {
     const struct effect_interface_s *itfe;
     effect_config_t                 config;
     treblebass_state_e                    state;
     TreBassdata                        gTreBassdata;
+    ParamSnapshot_t                    params;
+    uint32_t                           reset_seq;      // control thread
+    uint32_t                           reset_seq_done; // audio thread
+    TreBassengine                      engine;
+    AudioSilence_t                     silence;
+    AudioAccumulate_t                  accumulate;
 } TREBASSContext;
 
 const char *TREBASSStatusstr[] = {"Disable", "Enable"};
 
+static void TrebleBass_get_params(TREBASSContext *pContext, TreBassparams *params)
+{
+    TreBassdata *data = &pContext->gTreBassdata;
+
+    params->enable = data->enable;
+    params->bass_gain = data->tbcfg.bass_gain;
+    params->treble_gain = data->tbcfg.treble_gain;
+    params->reset_seq = pContext->reset_seq;
+}
+
+/* hand the current settings to the audio thread */
+static void TrebleBass_publish(TREBASSContext *pContext)
+{
+    TreBassparams params;
+
+    TrebleBass_get_params(pContext, &params);
+    ParamSnapshotPublish(&pContext->params, &params);
+}
+
 int TrebleBass_get_model_name(char *model_name, int size)
 {
      int ret = -1;
@@ -206,14 +372,24 @@ int TrebleBass_configure(TREBASSContext *pContext, effect_config_t *pConfig)
         return -EINVAL;
     if (pConfig->inputCfg.format != pConfig->outputCfg.format)
         return -EINVAL;
+#ifdef TREBASS_SOURCE_ENGINE
+    if (audio_channel_count_from_out_mask(pConfig->inputCfg.channels) == 0 ||
+            audio_channel_count_from_out_mask(pConfig->inputCfg.channels) > AUDIO_BIQUAD_MAX_CHANNELS) {
+#else
     if (pConfig->inputCfg.channels != AUDIO_CHANNEL_OUT_STEREO) {
+#endif
         ALOGW("%s: channels in = 0x%x channels out = 0x%x", __FUNCTION__, pConfig->inputCfg.channels, pConfig->outputCfg.channels);
         pConfig->inputCfg.channels = pConfig->outputCfg.channels = AUDIO_CHANNEL_OUT_STEREO;
     }
     if (pConfig->outputCfg.accessMode != EFFECT_BUFFER_ACCESS_WRITE &&
             pConfig->outputCfg.accessMode != EFFECT_BUFFER_ACCESS_ACCUMULATE)
         return -EINVAL;
+#ifdef TREBASS_SOURCE_ENGINE
+    if (pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT &&
+            pConfig->inputCfg.format != AUDIO_FORMAT_PCM_FLOAT) {
+#else
     if (pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT) {
+#endif
         ALOGW("%s: format in = 0x%x format out = 0x%x", __FUNCTION__, pConfig->inputCfg.format, pConfig->outputCfg.format);
         pConfig->inputCfg.format = pConfig->outputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
     }
@@ -280,7 +456,7 @@ int TrebleBass_setParameter(TREBASSContext *pContext, void *pParam, void *pValue
         }
         tbcfg->bass_level = value;
         tbcfg->bass_gain = ((float)value - 50)/5; //-10dB~10dB
-        audio_Treble_Bass_init(tbcfg->bass_gain, tbcfg->treble_gain);
+        TrebleBass_publish(pContext);
         ALOGD("%s: Set Bass -> %fdB, Treble -> %fdB, value %d",
                 __FUNCTION__, tbcfg->bass_gain, tbcfg->treble_gain, value);
         break;
@@ -292,13 +468,14 @@ int TrebleBass_setParameter(TREBASSContext *pContext, void *pParam, void *pValue
         }
         tbcfg->treble_level = value;
         tbcfg->treble_gain = ((float)value - 50)/5; //-10dB~10dB
-        audio_Treble_Bass_init(tbcfg->bass_gain, tbcfg->treble_gain);
+        TrebleBass_publish(pContext);
         ALOGD("%s: Set Bass -> %fdB, Treble -> %fdB, value %d",
                 __FUNCTION__, tbcfg->bass_gain, tbcfg->treble_gain, value);
         break;
     case TREBASS_PARAM_ENABLE:
         value = *(int32_t *)pValue;
         data->enable = value;
+        TrebleBass_publish(pContext);
 
         ALOGD("%s: Set status -> %s", __FUNCTION__, TREBASSStatusstr[value]);
         break;
@@ -310,8 +487,9 @@ int TrebleBass_setParameter(TREBASSContext *pContext, void *pParam, void *pValue
     return 0;
 }
 
-int TrebleBass_release(TREBASSContext *pContext __unused)
+int TrebleBass_release(TREBASSContext *pContext)
 {
+    ParamSnapshotRelease(&pContext->params);
     return 0;
 }
 
@@ -336,16 +514,45 @@ int TrebleBass_process(effect_handle_t self, audio_buffer_t *inBuffer, audio_buf
         return -ENODATA;
     }
 
-    int16_t *in  = (int16_t *)inBuffer->raw;
-    int16_t *out = (int16_t *)outBuffer->raw;
-    TreBassdata *data = &pContext->gTreBassdata;
-    if (!data->enable) {
-        for (size_t i = 0; i < inBuffer->frameCount; i++) {
-            *out++ = *in++;
-            *out++ = *in++;
-        }
+    TreBassengine *eng = &pContext->engine;
+    uint32_t sample_rate = pContext->config.inputCfg.samplingRate;
+    int32_t channels = audio_channel_count_from_out_mask(pContext->config.inputCfg.channels);
+    int is_float = pContext->config.inputCfg.format == AUDIO_FORMAT_PCM_FLOAT;
+    size_t frame_size = channels * (is_float ? sizeof(float) : sizeof(int16_t));
+    int accumulate = AudioAccumulateNeeded(&pContext->accumulate, &pContext->config, inBuffer, outBuffer);
+    int changed;
+    const TreBassparams *params = (const TreBassparams *)ParamSnapshotAcquire(&pContext->params, &changed);
+    if (eng->sample_rate != sample_rate || eng->channels != channels) {
+        // new layout from EFFECT_CMD_SET_CONFIG
+        TrebleBass_engine_init(eng, sample_rate, channels, params->bass_gain, params->treble_gain);
+    } else if (changed && (params->bass_gain != eng->bass_gain ||
+            params->treble_gain != eng->treble_gain)) {
+        TrebleBass_engine_design(eng, params->bass_gain, params->treble_gain);
+    }
+    if (params->reset_seq != pContext->reset_seq_done) {
+        pContext->reset_seq_done = params->reset_seq;
+        TrebleBass_engine_reset(eng);
+    }
+
+    if (!params->enable || (eng->bass_gain == 0.0f && eng->treble_gain == 0.0f)) {
+        // flat, the shelves restart from silence once a gain is set
+        if (eng->running)
+            TrebleBass_engine_reset(eng);
+        AudioBypass(&pContext->config, accumulate, inBuffer, outBuffer);
+    } else if (accumulate) {
+        return AudioAccumulateProcess(&pContext->accumulate, self, &pContext->config, inBuffer, outBuffer);
+    } else if (AudioSilenceDetect(&pContext->silence, inBuffer->raw, inBuffer->frameCount,
+            frame_size, sample_rate)) {
+        // silent past the tail, the output is silence as well
+        AudioBypass(&pContext->config, 0, inBuffer, outBuffer);
+#ifdef TREBASS_SOURCE_ENGINE
+    } else if (is_float) {
+        TrebleBass_engine_process_float(eng, (const float *)inBuffer->raw,
+                (float *)outBuffer->raw, inBuffer->frameCount);
+#endif
     } else {
-        audio_Treble_Bass_process(in, in, inBuffer->frameCount);
+        TrebleBass_engine_process(eng, (const int16_t *)inBuffer->raw,
+                (int16_t *)outBuffer->raw, inBuffer->frameCount);
     }
     return 0;
 }
@@ -375,7 +582,9 @@ int TrebleBass_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
         *(int *) pReplyData = TrebleBass_configure(pContext, (effect_config_t *) pCmdData);
         break;
     case EFFECT_CMD_RESET:
-        //HPEQ_reset(pContext);
+        // the filter state belongs to the audio thread, cleared there
+        pContext->reset_seq++;
+        TrebleBass_publish(pContext);
         break;
     case EFFECT_CMD_ENABLE:
         if (pReplyData == NULL || replySize == NULL || *replySize != sizeof(int))
@@ -473,6 +682,14 @@ int TrebleBassLib_Create(const effect_uuid_t * uuid, int32_t sessionId __unused,
         ALOGE("%s: Load INI File faied, use default param", __FUNCTION__);
         pContext->gTreBassdata.enable = 1;
     }
+    TreBassparams params;
+    TrebleBass_get_params(pContext, &params);
+    if (ParamSnapshotInit(&pContext->params, &params, sizeof(TreBassparams)) < 0) {
+        delete pContext;
+        return -EINVAL;
+    }
+
+    AudioSilenceInit(&pContext->silence, TREBASS_TAIL_MS);
 
     pContext->itfe = &TrebleBassInterface;
     pContext->state = TREBASS_STATE_UNINITIALIZED;
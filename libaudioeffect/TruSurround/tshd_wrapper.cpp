@@ -36,6 +36,15 @@
 #include <unistd.h>
 #include "IniParser.h"
 #include "tshd_wrapper.h"
+#include "AudioSilence.h"
+#include "AudioBypass.h"
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+#include <arm_neon.h>
+#define SRS_USE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SRS_USE_SSE2
+#endif
 
 extern "C" {
 
@@ -45,6 +54,8 @@ extern "C" {
 #else
 #define LIBSRS_PATH "/system/lib/soundfx/libsrs.so"
 #endif
+// libsrs does not report its latency, leave its surround and limiter room to drain
+#define SRS_TAIL_MS 500
 
 // effect_handle_t interface implementation for SRS effect
 extern const struct effect_interface_s SRSInterface;
@@ -203,6 +214,8 @@ typedef struct SRSContext_s {
     void                            *gSRSLibHandler;
     SRSapi                          gSRSapi;
     SRSdata                         gSRSdata;
+    AudioSilence_t                  silence;
+    AudioAccumulate_t               accumulate;
 } SRSContext;
 
 static TS_SRScfg TS_default_usr_cfg[TS_MODE_MUM] = {
@@ -240,6 +253,36 @@ int16_t clamp16(int32_t sample)
     return sample;
 }
 
+// buf = clamp16(buf * gain) in place, the product truncated toward zero
+static void SRS_apply_gain(int16_t *buf, size_t samples, float gain)
+{
+    size_t i = 0;
+
+#if defined(SRS_USE_NEON)
+    float32x4_t g = vdupq_n_f32(gain);
+    for (; i + 8 <= samples; i += 8) {
+        int16x8_t x = vld1q_s16(buf + i);
+        int32x4_t lo = vcvtq_s32_f32(vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), g));
+        int32x4_t hi = vcvtq_s32_f32(vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), g));
+        vst1q_s16(buf + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+    }
+#elif defined(SRS_USE_SSE2)
+    __m128 g = _mm_set1_ps(gain);
+    for (; i + 8 <= samples; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(buf + i));
+        // sign extend by placing each sample in the high half of a lane
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        lo = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(lo), g));
+        hi = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(hi), g));
+        _mm_storeu_si128((__m128i *)(buf + i), _mm_packs_epi32(lo, hi));
+    }
+#endif
+    for (; i < samples; i++) {
+        buf[i] = clamp16((int32_t)(buf[i] * gain));
+    }
+}
+
 int SRS_get_model_name(char *model_name, int size)
 {
     int fd;
@@ -1279,20 +1322,20 @@ int SRS_process(effect_handle_t self, audio_buffer_t *inBuffer, audio_buffer_t *
     int16_t   *in  = (int16_t *)inBuffer->raw;
     int16_t   *out = (int16_t *)outBuffer->raw;
     SRSdata *data = &pContext->gSRSdata;
+    int accumulate = AudioAccumulateNeeded(&pContext->accumulate, &pContext->config, inBuffer, outBuffer);
 
     if (!data->enable || !pContext->gSRSLibHandler) {
-        for (size_t i = 0; i < inBuffer->frameCount; i++) {
-            *out++ = *in++;
-            *out++ = *in++;
-        }
+        AudioBypass(&pContext->config, accumulate, inBuffer, outBuffer);
+    } else if (accumulate) {
+        return AudioAccumulateProcess(&pContext->accumulate, self, &pContext->config, inBuffer, outBuffer);
+    } else if (AudioSilenceDetect(&pContext->silence, in, inBuffer->frameCount,
+            2 * sizeof(int16_t), pContext->config.inputCfg.samplingRate)) {
+        AudioBypass(&pContext->config, 0, inBuffer, outBuffer);
     } else {
         (*pContext->gSRSapi.SRS_process)(in, out, inBuffer->frameCount);
-        for (size_t i = 0; i < inBuffer->frameCount; i++) {
-            /*Input left process*/
-            *out++ = clamp16((int32_t)(*in++ * data->comp_gain));
-            /*Input right process*/
-            *out++ = clamp16((int32_t)(*in++ * data->comp_gain));
-        }
+        /* output gain compensation of the TruSurround output */
+        if (data->comp_gain != 1.0f)
+            SRS_apply_gain(out, inBuffer->frameCount * 2, data->comp_gain);
     }
 
     return 0;
@@ -1425,6 +1468,8 @@ int SRSLib_Create(const effect_uuid_t *uuid, int32_t sessionId __unused, int32_t
         ALOGE("%s: Load Library File faied", __FUNCTION__);
     }
 
+    AudioSilenceInit(&pContext->silence, SRS_TAIL_MS);
+
     pContext->itfe = &SRSInterface;
     pContext->state = SRS_STATE_UNINITIALIZED;
 
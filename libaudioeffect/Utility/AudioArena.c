@@ -0,0 +1,106 @@
+/*
+ * * Copyright (c) 2014 Amlogic, Inc. All rights reserved.
+ * * *
+ * This source code is subject to the terms and conditions defined in the
+ * * file 'LICENSE' which is part of this source code package.
+ * * *
+ * Description:
+ * */
+
+
+
+#define LOG_TAG "audio_arena"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <cutils/log.h>
+#include "AudioArena.h"
+
+
+size_t AudioArenaBlockSize(size_t size)
+{
+    return (size + AUDIO_ARENA_ALIGN - 1) & ~(size_t)(AUDIO_ARENA_ALIGN - 1);
+}
+
+int AudioArenaReserve(AudioArena_t *pArena, size_t size, int flags)
+{
+    void *base = NULL;
+
+    if (pArena == NULL) {
+        return AUDIO_ARENA_ERR;
+    }
+
+    size = AudioArenaBlockSize(size);
+    pArena->used = 0;
+    if (pArena->base != NULL && pArena->size >= size) {
+        return AUDIO_ARENA_OK;
+    }
+
+    if (pArena->base != NULL) {
+        ALOGW("%s: grow from %zu to %zu bytes", __FUNCTION__, pArena->size, size);
+    }
+    AudioArenaRelease(pArena);
+    if (size == 0) {
+        return AUDIO_ARENA_OK;
+    }
+    if (posix_memalign(&base, AUDIO_ARENA_ALIGN, size) != 0) {
+        ALOGE("%s: alloc %zu bytes failed", __FUNCTION__, size);
+        return AUDIO_ARENA_ERR;
+    }
+    // fault all pages in now instead of in the first processed block
+    memset(base, 0, size);
+    pArena->base = (unsigned char *)base;
+    pArena->size = size;
+
+    if (flags & AUDIO_ARENA_MLOCK) {
+        // best effort, RLIMIT_MEMLOCK may not allow it
+        if (mlock(base, size) == 0) {
+            pArena->locked = 1;
+        } else {
+            ALOGW("%s: mlock %zu bytes failed", __FUNCTION__, size);
+        }
+    }
+    ALOGI("%s: %zu bytes at %p%s", __FUNCTION__, size, base, pArena->locked ? ", locked" : "");
+
+    return AUDIO_ARENA_OK;
+}
+
+void AudioArenaRelease(AudioArena_t *pArena)
+{
+    if (pArena == NULL) {
+        return;
+    }
+
+    if (pArena->base != NULL) {
+        if (pArena->locked) {
+            munlock(pArena->base, pArena->size);
+        }
+        free(pArena->base);
+    }
+    pArena->base = NULL;
+    pArena->size = 0;
+    pArena->used = 0;
+    pArena->locked = 0;
+}
+
+void AudioArenaRewind(AudioArena_t *pArena)
+{
+    if (pArena != NULL) {
+        pArena->used = 0;
+    }
+}
+
+void *AudioArenaAlloc(AudioArena_t *pArena, size_t size)
+{
+    void *p;
+
+    size = AudioArenaBlockSize(size);
+    if (pArena == NULL || pArena->base == NULL || size > pArena->size - pArena->used) {
+        return NULL;
+    }
+    p = pArena->base + pArena->used;
+    pArena->used += size;
+
+    return p;
+}
@@ -0,0 +1,65 @@
+/*
+ * * Copyright (c) 2014 Amlogic, Inc. All rights reserved.
+ * * *
+ * This source code is subject to the terms and conditions defined in the
+ * * file 'LICENSE' which is part of this source code package.
+ * * *
+ * Description:
+ *     Per-context memory arena for the persistent and scratch memory of
+ *     the effect libraries.
+ *
+ *     The arena is reserved once from the library memory queries, outside
+ *     the audio thread, and handed out again on every (re)init without
+ *     calling the allocator. Its pages are touched when reserved, and
+ *     optionally locked, so the first processed block does not fault them
+ *     in. Blocks are cache line aligned and only freed all together.
+ * */
+
+
+#ifndef __AUDIOARENA_H__
+#define __AUDIOARENA_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIO_ARENA_ERR -1
+#define AUDIO_ARENA_OK 0
+
+#define AUDIO_ARENA_ALIGN 64
+
+// AudioArenaReserve flags
+#define AUDIO_ARENA_MLOCK 0x1
+
+typedef struct {
+    unsigned char *base;
+    size_t size;
+    size_t used;
+    int locked;
+} AudioArena_t;
+
+// bytes a block of size bytes takes from the arena
+size_t AudioArenaBlockSize(size_t size);
+
+/* Make room for size bytes and drop all blocks. Nothing is allocated when
+ * the arena is already large enough, which is the case on every reinit
+ * with unchanged library memory needs. */
+int AudioArenaReserve(AudioArena_t *pArena, size_t size, int flags);
+
+void AudioArenaRelease(AudioArena_t *pArena);
+
+// drop all blocks and keep the memory, safe on the audio thread
+void AudioArenaRewind(AudioArena_t *pArena);
+
+// next block from the reserved memory, NULL when it does not fit
+void *AudioArenaAlloc(AudioArena_t *pArena, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__AUDIOARENA_H__
+
@@ -0,0 +1,386 @@
+/*
+ * * Copyright (c) 2014 Amlogic, Inc. All rights reserved.
+ * * *
+ * This source code is subject to the terms and conditions defined in the
+ * * file 'LICENSE' which is part of this source code package.
+ * * *
+ * Description:
+ * */
+
+
+
+#define LOG_TAG "audio_biquad"
+
+#include <math.h>
+#include <string.h>
+#include <cutils/log.h>
+#include "AudioBiquad.h"
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+#include <arm_neon.h>
+#define AUDIO_BIQUAD_USE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define AUDIO_BIQUAD_USE_SSE2
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// state below this is flushed, the recursion would go denormal on silence
+#define AUDIO_BIQUAD_DENORMAL 1e-20f
+
+
+void AudioBiquadIdentity(AudioBiquadCoef_t *pCoef)
+{
+    pCoef->b0 = 1.0f;
+    pCoef->b1 = 0.0f;
+    pCoef->b2 = 0.0f;
+    pCoef->a1 = 0.0f;
+    pCoef->a2 = 0.0f;
+}
+
+int AudioBiquadDesign(AudioBiquadCoef_t *pCoef, AudioBiquadType_t type,
+        float sampleRate, float fc, float q, float gain)
+{
+    double fs = sampleRate, f = fc;
+    double A, w0, cw, alpha, sA;
+    double b0, b1, b2, a0, a1, a2;
+
+    if (pCoef == NULL || !(fs > 0.0) || !(f > 0.0) || !(q > 0.0f)) {
+        ALOGE("%s: fs %f fc %f q %f", __FUNCTION__, sampleRate, fc, q);
+        return AUDIO_BIQUAD_ERR;
+    }
+    if (f > 0.49 * fs) {
+        f = 0.49 * fs;
+    }
+    A = pow(10.0, gain / 40.0);
+    w0 = 2.0 * M_PI * f / fs;
+    cw = cos(w0);
+    alpha = sin(w0) / (2.0 * q);
+    sA = 2.0 * sqrt(A) * alpha;
+
+    switch (type) {
+    case AUDIO_BIQUAD_PEAK:
+        b0 = 1.0 + alpha * A;
+        b1 = -2.0 * cw;
+        b2 = 1.0 - alpha * A;
+        a0 = 1.0 + alpha / A;
+        a1 = -2.0 * cw;
+        a2 = 1.0 - alpha / A;
+        break;
+    case AUDIO_BIQUAD_LOWSHELF:
+        b0 = A * ((A + 1.0) - (A - 1.0) * cw + sA);
+        b1 = 2.0 * A * ((A - 1.0) - (A + 1.0) * cw);
+        b2 = A * ((A + 1.0) - (A - 1.0) * cw - sA);
+        a0 = (A + 1.0) + (A - 1.0) * cw + sA;
+        a1 = -2.0 * ((A - 1.0) + (A + 1.0) * cw);
+        a2 = (A + 1.0) + (A - 1.0) * cw - sA;
+        break;
+    case AUDIO_BIQUAD_HIGHSHELF:
+        b0 = A * ((A + 1.0) + (A - 1.0) * cw + sA);
+        b1 = -2.0 * A * ((A - 1.0) + (A + 1.0) * cw);
+        b2 = A * ((A + 1.0) + (A - 1.0) * cw - sA);
+        a0 = (A + 1.0) - (A - 1.0) * cw + sA;
+        a1 = 2.0 * ((A - 1.0) - (A + 1.0) * cw);
+        a2 = (A + 1.0) - (A - 1.0) * cw - sA;
+        break;
+    case AUDIO_BIQUAD_LOWPASS:
+        b0 = (1.0 - cw) * 0.5;
+        b1 = 1.0 - cw;
+        b2 = (1.0 - cw) * 0.5;
+        a0 = 1.0 + alpha;
+        a1 = -2.0 * cw;
+        a2 = 1.0 - alpha;
+        break;
+    case AUDIO_BIQUAD_HIGHPASS:
+        b0 = (1.0 + cw) * 0.5;
+        b1 = -(1.0 + cw);
+        b2 = (1.0 + cw) * 0.5;
+        a0 = 1.0 + alpha;
+        a1 = -2.0 * cw;
+        a2 = 1.0 - alpha;
+        break;
+    default:
+        ALOGE("%s: unknown type %d", __FUNCTION__, type);
+        return AUDIO_BIQUAD_ERR;
+    }
+
+    pCoef->b0 = (float)(b0 / a0);
+    pCoef->b1 = (float)(b1 / a0);
+    pCoef->b2 = (float)(b2 / a0);
+    pCoef->a1 = (float)(a1 / a0);
+    pCoef->a2 = (float)(a2 / a0);
+
+    return AUDIO_BIQUAD_OK;
+}
+
+double AudioBiquadResponseDb(const AudioBiquadCoef_t *pCoef, float sampleRate, float f)
+{
+    double w = 2.0 * M_PI * f / sampleRate;
+    double c1 = cos(w), s1 = sin(w), c2 = cos(2.0 * w), s2 = sin(2.0 * w);
+    double nr = pCoef->b0 + pCoef->b1 * c1 + pCoef->b2 * c2;
+    double ni = -(pCoef->b1 * s1 + pCoef->b2 * s2);
+    double dr = 1.0 + pCoef->a1 * c1 + pCoef->a2 * c2;
+    double di = -(pCoef->a1 * s1 + pCoef->a2 * s2);
+
+    return 10.0 * log10((nr * nr + ni * ni) / (dr * dr + di * di));
+}
+
+int AudioBiquadInit(AudioBiquad_t *pBiquad, int stages, int channels)
+{
+    int i;
+
+    if (pBiquad == NULL || stages < 0 || stages > AUDIO_BIQUAD_MAX_STAGES ||
+            channels <= 0 || channels > AUDIO_BIQUAD_MAX_CHANNELS) {
+        ALOGE("%s: %d stages %d channels", __FUNCTION__, stages, channels);
+        return AUDIO_BIQUAD_ERR;
+    }
+    memset(pBiquad, 0, sizeof(AudioBiquad_t));
+    pBiquad->stages = stages;
+    pBiquad->channels = channels;
+    for (i = 0; i < AUDIO_BIQUAD_MAX_STAGES; i++) {
+        AudioBiquadIdentity(&pBiquad->coef[i]);
+    }
+
+    return AUDIO_BIQUAD_OK;
+}
+
+void AudioBiquadReset(AudioBiquad_t *pBiquad)
+{
+    memset(pBiquad->s1, 0, sizeof(pBiquad->s1));
+    memset(pBiquad->s2, 0, sizeof(pBiquad->s2));
+}
+
+void AudioBiquadSetCoef(AudioBiquad_t *pBiquad, int stage, const AudioBiquadCoef_t *pCoef)
+{
+    if (stage < 0 || stage >= pBiquad->stages) {
+        return;
+    }
+    pBiquad->coef[stage] = *pCoef;
+}
+
+// one stage of one channel, every stride-th sample
+static void biquad_stage(const AudioBiquadCoef_t *c, float *s1, float *s2,
+        const float *in, float *out, size_t stride, size_t frames)
+{
+    const float b0 = c->b0, b1 = c->b1, b2 = c->b2, a1 = c->a1, a2 = c->a2;
+    float z1 = *s1, z2 = *s2, x, y;
+    size_t i;
+
+    for (i = 0; i < frames; i++, in += stride, out += stride) {
+        x = *in;
+        y = b0 * x + z1;
+        z1 = b1 * x - a1 * y + z2;
+        z2 = b2 * x - a2 * y;
+        *out = y;
+    }
+    *s1 = z1;
+    *s2 = z2;
+}
+
+#if defined(AUDIO_BIQUAD_USE_NEON) || defined(AUDIO_BIQUAD_USE_SSE2)
+
+#if defined(AUDIO_BIQUAD_USE_NEON)
+typedef float32x4_t biquad_v;
+typedef uint32x4_t biquad_mask;
+#define V_LOAD(p) vld1q_f32(p)
+#define V_STORE(p, v) vst1q_f32(p, v)
+#define V_DUP(x) vdupq_n_f32(x)
+#define V_ADD(a, b) vaddq_f32(a, b)
+#define V_SUB(a, b) vsubq_f32(a, b)
+#define V_MUL(a, b) vmulq_f32(a, b)
+#define M_LOAD(p) vld1q_u32(p)
+#define V_SELECT(m, a, b) vbslq_f32(m, a, b)
+// [x, v0, v1, v2]
+#define V_SHIFT_IN(v, x) vextq_f32(vdupq_n_f32(x), v, 3)
+#define V_LANE3(v) vgetq_lane_f32(v, 3)
+#else
+typedef __m128 biquad_v;
+typedef __m128 biquad_mask;
+#define V_LOAD(p) _mm_loadu_ps(p)
+#define V_STORE(p, v) _mm_storeu_ps(p, v)
+#define V_DUP(x) _mm_set1_ps(x)
+#define V_ADD(a, b) _mm_add_ps(a, b)
+#define V_SUB(a, b) _mm_sub_ps(a, b)
+#define V_MUL(a, b) _mm_mul_ps(a, b)
+#define M_LOAD(p) _mm_loadu_ps((const float *)(p))
+#define V_SELECT(m, a, b) _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b))
+#define V_SHIFT_IN(v, x) _mm_move_ss(_mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4)), _mm_set_ss(x))
+#define V_LANE3(v) _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)))
+#endif
+
+/* one stage of four channels side by side, every stride-th frame */
+static void biquad_stage_x4(const AudioBiquadCoef_t *c, float *s1, float *s2,
+        const float *in, float *out, size_t stride, size_t frames)
+{
+    const biquad_v b0 = V_DUP(c->b0), b1 = V_DUP(c->b1), b2 = V_DUP(c->b2);
+    const biquad_v a1 = V_DUP(c->a1), a2 = V_DUP(c->a2);
+    biquad_v z1 = V_LOAD(s1), z2 = V_LOAD(s2), x, y;
+    size_t i;
+
+    for (i = 0; i < frames; i++) {
+        x = V_LOAD(in + i * stride);
+        y = V_ADD(V_MUL(b0, x), z1);
+        z1 = V_ADD(V_SUB(V_MUL(b1, x), V_MUL(a1, y)), z2);
+        z2 = V_SUB(V_MUL(b2, x), V_MUL(a2, y));
+        V_STORE(out + i * stride, y);
+    }
+    V_STORE(s1, z1);
+    V_STORE(s2, z2);
+}
+
+/* Four stages of one channel in the four lanes. At step s lane j works on
+ * sample s - j, the input of lane j being what lane j - 1 gave one step
+ * before. The first and last three steps only update the lanes that have
+ * a sample, the steps in between run all lanes without masking. */
+static void biquad_stages4(const AudioBiquadCoef_t *c, int n, float *s1, float *s2,
+        size_t s_stride, const float *in, float *out, size_t stride, size_t frames)
+{
+    float b0[4], b1[4], b2[4], a1[4], a2[4], z[4];
+    uint32_t m[4];
+    biquad_v vb0, vb1, vb2, va1, va2, z1, z2, x, y, n1, n2;
+    biquad_mask mask;
+    size_t s, head = frames < 3 ? frames : 3;
+    int j;
+
+    for (j = 0; j < 4; j++) {
+        // missing stages pass through
+        b0[j] = j < n ? c[j].b0 : 1.0f;
+        b1[j] = j < n ? c[j].b1 : 0.0f;
+        b2[j] = j < n ? c[j].b2 : 0.0f;
+        a1[j] = j < n ? c[j].a1 : 0.0f;
+        a2[j] = j < n ? c[j].a2 : 0.0f;
+    }
+    vb0 = V_LOAD(b0);
+    vb1 = V_LOAD(b1);
+    vb2 = V_LOAD(b2);
+    va1 = V_LOAD(a1);
+    va2 = V_LOAD(a2);
+    for (j = 0; j < 4; j++)
+        z[j] = j < n ? s1[j * s_stride] : 0.0f;
+    z1 = V_LOAD(z);
+    for (j = 0; j < 4; j++)
+        z[j] = j < n ? s2[j * s_stride] : 0.0f;
+    z2 = V_LOAD(z);
+    y = V_DUP(0.0f);
+
+#define BIQUAD_STEP(xin) \
+    x = V_SHIFT_IN(y, xin); \
+    y = V_ADD(V_MUL(vb0, x), z1); \
+    n1 = V_ADD(V_SUB(V_MUL(vb1, x), V_MUL(va1, y)), z2); \
+    n2 = V_SUB(V_MUL(vb2, x), V_MUL(va2, y));
+
+    for (s = 0; s < frames + 3; s++) {
+        if (s == head) {
+            for (; s < frames; s++) {
+                BIQUAD_STEP(in[s * stride]);
+                z1 = n1;
+                z2 = n2;
+                out[(s - 3) * stride] = V_LANE3(y);
+            }
+            if (s == frames + 3)
+                break;
+        }
+        BIQUAD_STEP(s < frames ? in[s * stride] : 0.0f);
+        for (j = 0; j < 4; j++)
+            m[j] = ((size_t)j <= s && s - j < frames) ? 0xffffffff : 0;
+        mask = M_LOAD(m);
+        z1 = V_SELECT(mask, n1, z1);
+        z2 = V_SELECT(mask, n2, z2);
+        if (s >= 3)
+            out[(s - 3) * stride] = V_LANE3(y);
+    }
+#undef BIQUAD_STEP
+
+    V_STORE(z, z1);
+    for (j = 0; j < n; j++)
+        s1[j * s_stride] = z[j];
+    V_STORE(z, z2);
+    for (j = 0; j < n; j++)
+        s2[j * s_stride] = z[j];
+}
+
+#endif
+
+// all stages of one channel
+static void biquad_channel(AudioBiquad_t *pBiquad, int ch, const float *in, float *out,
+        size_t stride, size_t frames)
+{
+    int i = 0;
+
+#if defined(AUDIO_BIQUAD_USE_NEON) || defined(AUDIO_BIQUAD_USE_SSE2)
+    int n;
+    for (; pBiquad->stages - i >= 2; i += n) {
+        n = pBiquad->stages - i < 4 ? pBiquad->stages - i : 4;
+        biquad_stages4(&pBiquad->coef[i], n, &pBiquad->s1[i][ch], &pBiquad->s2[i][ch],
+                AUDIO_BIQUAD_MAX_CHANNELS, in, out, stride, frames);
+        in = out;
+    }
+#endif
+    for (; i < pBiquad->stages; i++) {
+        biquad_stage(&pBiquad->coef[i], &pBiquad->s1[i][ch], &pBiquad->s2[i][ch],
+                in, out, stride, frames);
+        in = out;
+    }
+}
+
+static void biquad_flush_denormal(AudioBiquad_t *pBiquad)
+{
+    int i, ch;
+
+    for (i = 0; i < pBiquad->stages; i++) {
+        for (ch = 0; ch < pBiquad->channels; ch++) {
+            if (fabsf(pBiquad->s1[i][ch]) < AUDIO_BIQUAD_DENORMAL)
+                pBiquad->s1[i][ch] = 0.0f;
+            if (fabsf(pBiquad->s2[i][ch]) < AUDIO_BIQUAD_DENORMAL)
+                pBiquad->s2[i][ch] = 0.0f;
+        }
+    }
+}
+
+void AudioBiquadProcess(AudioBiquad_t *pBiquad, const float *in, float *out, size_t frames)
+{
+    size_t channels = pBiquad->channels;
+    int ch = 0;
+
+    if (frames == 0) {
+        return;
+    }
+    if (pBiquad->stages == 0) {
+        if (out != in)
+            memmove(out, in, frames * channels * sizeof(float));
+        return;
+    }
+
+#if defined(AUDIO_BIQUAD_USE_NEON) || defined(AUDIO_BIQUAD_USE_SSE2)
+    for (; ch + 4 <= (int)channels; ch += 4) {
+        const float *src = in + ch;
+        int i;
+        for (i = 0; i < pBiquad->stages; i++) {
+            biquad_stage_x4(&pBiquad->coef[i], &pBiquad->s1[i][ch], &pBiquad->s2[i][ch],
+                    src, out + ch, channels, frames);
+            src = out + ch;
+        }
+    }
+#endif
+    for (; ch < (int)channels; ch++) {
+        biquad_channel(pBiquad, ch, in + ch, out + ch, channels, frames);
+    }
+    biquad_flush_denormal(pBiquad);
+}
+
+void AudioBiquadProcessPlanar(AudioBiquad_t *pBiquad, const float *const *in, float *const *out, size_t frames)
+{
+    int ch;
+
+    for (ch = 0; ch < pBiquad->channels; ch++) {
+        if (pBiquad->stages == 0) {
+            if (out[ch] != in[ch])
+                memmove(out[ch], in[ch], frames * sizeof(float));
+            continue;
+        }
+        biquad_channel(pBiquad, ch, in[ch], out[ch], 1, frames);
+    }
+    biquad_flush_denormal(pBiquad);
+}
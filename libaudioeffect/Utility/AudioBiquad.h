@@ -0,0 +1,97 @@
+/*
+ * * Copyright (c) 2014 Amlogic, Inc. All rights reserved.
+ * * *
+ * This source code is subject to the terms and conditions defined in the
+ * * file 'LICENSE' which is part of this source code package.
+ * * *
+ * Description:
+ *     Biquad cascade shared by the filter based effects.
+ *
+ *     Every stage is a transposed direct form II biquad with its own state
+ *     per channel. Float samples are processed interleaved or planar, in
+ *     place or not. With NEON or SSE2 four channels of an interleaved
+ *     buffer run in parallel, and buffers with fewer channels run four
+ *     stages in parallel, each stage one sample behind the previous one.
+ *
+ *     Coefficients follow the RBJ audio EQ cookbook and can be designed
+ *     for any sample rate.
+ * */
+
+
+#ifndef __AUDIOBIQUAD_H__
+#define __AUDIOBIQUAD_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIO_BIQUAD_ERR -1
+#define AUDIO_BIQUAD_OK 0
+
+#define AUDIO_BIQUAD_MAX_STAGES 16
+// multiple of 4, see AudioBiquad_t
+#define AUDIO_BIQUAD_MAX_CHANNELS 8
+
+typedef enum {
+    AUDIO_BIQUAD_PEAK,
+    AUDIO_BIQUAD_LOWSHELF,
+    AUDIO_BIQUAD_HIGHSHELF,
+    AUDIO_BIQUAD_LOWPASS,
+    AUDIO_BIQUAD_HIGHPASS,
+} AudioBiquadType_t;
+
+// normalized to a0: y = b0*x + b1*x1 + b2*x2 - a1*y1 - a2*y2
+typedef struct {
+    float b0;
+    float b1;
+    float b2;
+    float a1;
+    float a2;
+} AudioBiquadCoef_t;
+
+typedef struct {
+    int stages;
+    int channels;
+    AudioBiquadCoef_t coef[AUDIO_BIQUAD_MAX_STAGES];
+    // state of each stage, channels side by side
+    float s1[AUDIO_BIQUAD_MAX_STAGES][AUDIO_BIQUAD_MAX_CHANNELS];
+    float s2[AUDIO_BIQUAD_MAX_STAGES][AUDIO_BIQUAD_MAX_CHANNELS];
+} AudioBiquad_t;
+
+/* Coefficients of one stage. fc is the center or corner frequency in Hz,
+ * q the quality factor (the slope for shelves, 0.707 is the steepest
+ * without overshoot), gain in dB for peak and shelves only. */
+int AudioBiquadDesign(AudioBiquadCoef_t *pCoef, AudioBiquadType_t type,
+        float sampleRate, float fc, float q, float gain);
+
+// pass through stage
+void AudioBiquadIdentity(AudioBiquadCoef_t *pCoef);
+
+// response of a stage at f, in dB
+double AudioBiquadResponseDb(const AudioBiquadCoef_t *pCoef, float sampleRate, float f);
+
+// all stages pass through, state cleared
+int AudioBiquadInit(AudioBiquad_t *pBiquad, int stages, int channels);
+
+// state cleared, coefficients kept
+void AudioBiquadReset(AudioBiquad_t *pBiquad);
+
+/* New coefficients for a stage. The state is kept, callers switching
+ * between very different responses may want to crossfade. */
+void AudioBiquadSetCoef(AudioBiquad_t *pBiquad, int stage, const AudioBiquadCoef_t *pCoef);
+
+// frames of interleaved samples, in may be out
+void AudioBiquadProcess(AudioBiquad_t *pBiquad, const float *in, float *out, size_t frames);
+
+// one buffer per channel, in[ch] may be out[ch]
+void AudioBiquadProcessPlanar(AudioBiquad_t *pBiquad, const float *const *in, float *const *out, size_t frames);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__AUDIOBIQUAD_H__
+
@@ -0,0 +1,234 @@
+/*
+ * * Copyright (c) 2014 Amlogic, Inc. All rights reserved.
+ * * *
+ * This source code is subject to the terms and conditions defined in the
+ * * file 'LICENSE' which is part of this source code package.
+ * * *
+ * Description:
+ * */
+
+
+
+#include <errno.h>
+#include <string.h>
+#include <system/audio.h>
+#include "AudioBypass.h"
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+#include <arm_neon.h>
+#define AUDIO_BYPASS_USE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define AUDIO_BYPASS_USE_SSE2
+#endif
+
+
+void AudioAccumulateS16(const int16_t *in, int16_t *out, size_t samples)
+{
+    size_t i = 0;
+    int32_t s;
+
+#if defined(AUDIO_BYPASS_USE_NEON)
+    for (; i + 8 <= samples; i += 8)
+        vst1q_s16(out + i, vqaddq_s16(vld1q_s16(out + i), vld1q_s16(in + i)));
+#elif defined(AUDIO_BYPASS_USE_SSE2)
+    for (; i + 8 <= samples; i += 8) {
+        __m128i y = _mm_adds_epi16(_mm_loadu_si128((const __m128i *)(out + i)),
+                                   _mm_loadu_si128((const __m128i *)(in + i)));
+        _mm_storeu_si128((__m128i *)(out + i), y);
+    }
+#endif
+    for (; i < samples; i++) {
+        s = (int32_t)out[i] + in[i];
+        out[i] = s > INT16_MAX ? INT16_MAX : (s < INT16_MIN ? INT16_MIN : (int16_t)s);
+    }
+}
+
+#if defined(AUDIO_BYPASS_USE_SSE2)
+/* no saturating 32 bit add, the sum overflowed when both operands
+ * have the sign it does not have, it then takes the limit of a */
+static inline __m128i AudioBypassAddsEpi32(__m128i a, __m128i b)
+{
+    const __m128i vmax = _mm_set1_epi32(INT32_MAX);
+    __m128i y = _mm_add_epi32(a, b);
+    __m128i ovf = _mm_srai_epi32(_mm_andnot_si128(_mm_xor_si128(a, b), _mm_xor_si128(a, y)), 31);
+    __m128i lim = _mm_xor_si128(_mm_srai_epi32(a, 31), vmax);
+    return _mm_or_si128(_mm_and_si128(ovf, lim), _mm_andnot_si128(ovf, y));
+}
+#endif
+
+void AudioAccumulateS32(const int32_t *in, int32_t *out, size_t samples)
+{
+    size_t i = 0;
+    int64_t s;
+
+#if defined(AUDIO_BYPASS_USE_NEON)
+    for (; i + 4 <= samples; i += 4)
+        vst1q_s32(out + i, vqaddq_s32(vld1q_s32(out + i), vld1q_s32(in + i)));
+#elif defined(AUDIO_BYPASS_USE_SSE2)
+    for (; i + 4 <= samples; i += 4) {
+        __m128i y = AudioBypassAddsEpi32(_mm_loadu_si128((const __m128i *)(out + i)),
+                                         _mm_loadu_si128((const __m128i *)(in + i)));
+        _mm_storeu_si128((__m128i *)(out + i), y);
+    }
+#endif
+    for (; i < samples; i++) {
+        s = (int64_t)out[i] + in[i];
+        out[i] = s > INT32_MAX ? INT32_MAX : (s < INT32_MIN ? INT32_MIN : (int32_t)s);
+    }
+}
+
+void AudioAccumulateQ8_24(const int32_t *in, int32_t *out, size_t samples)
+{
+    size_t i = 0;
+    int64_t s;
+
+#if defined(AUDIO_BYPASS_USE_NEON)
+    const int32x4_t vmax = vdupq_n_s32(AUDIO_Q8_24_MAX);
+    const int32x4_t vmin = vdupq_n_s32(AUDIO_Q8_24_MIN);
+    for (; i + 4 <= samples; i += 4) {
+        int32x4_t y = vqaddq_s32(vld1q_s32(out + i), vld1q_s32(in + i));
+        vst1q_s32(out + i, vmaxq_s32(vminq_s32(y, vmax), vmin));
+    }
+#elif defined(AUDIO_BYPASS_USE_SSE2)
+    // no 32 bit min/max before SSE4.1, select on the compares
+    const __m128i vmax = _mm_set1_epi32(AUDIO_Q8_24_MAX);
+    const __m128i vmin = _mm_set1_epi32(AUDIO_Q8_24_MIN);
+    for (; i + 4 <= samples; i += 4) {
+        __m128i y = AudioBypassAddsEpi32(_mm_loadu_si128((const __m128i *)(out + i)),
+                                         _mm_loadu_si128((const __m128i *)(in + i)));
+        __m128i gt = _mm_cmpgt_epi32(y, vmax);
+        __m128i lt = _mm_cmpgt_epi32(vmin, y);
+        y = _mm_or_si128(_mm_and_si128(gt, vmax), _mm_andnot_si128(gt, y));
+        y = _mm_or_si128(_mm_and_si128(lt, vmin), _mm_andnot_si128(lt, y));
+        _mm_storeu_si128((__m128i *)(out + i), y);
+    }
+#endif
+    for (; i < samples; i++) {
+        s = (int64_t)out[i] + in[i];
+        out[i] = s > AUDIO_Q8_24_MAX ? AUDIO_Q8_24_MAX :
+                 (s < AUDIO_Q8_24_MIN ? AUDIO_Q8_24_MIN : (int32_t)s);
+    }
+}
+
+void AudioAccumulateFloat(const float *in, float *out, size_t samples)
+{
+    size_t i = 0;
+
+#if defined(AUDIO_BYPASS_USE_NEON)
+    for (; i + 4 <= samples; i += 4)
+        vst1q_f32(out + i, vaddq_f32(vld1q_f32(out + i), vld1q_f32(in + i)));
+#elif defined(AUDIO_BYPASS_USE_SSE2)
+    for (; i + 4 <= samples; i += 4)
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_loadu_ps(in + i)));
+#endif
+    for (; i < samples; i++)
+        out[i] += in[i];
+}
+
+int AudioAccumulateNeeded(const AudioAccumulate_t *pAccumulate, const effect_config_t *config,
+        const audio_buffer_t *in, const audio_buffer_t *out)
+{
+    return config->outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE &&
+           in->raw != out->raw && !pAccumulate->running;
+}
+
+// whole buffers of one format, samples of out
+static void AudioBypassSamples(audio_format_t format, int accumulate,
+        const void *in, void *out, size_t samples)
+{
+    if (!accumulate) {
+        memcpy(out, in, samples * audio_bytes_per_sample(format));
+        return;
+    }
+    switch (format) {
+    case AUDIO_FORMAT_PCM_16_BIT:
+        AudioAccumulateS16((const int16_t *)in, (int16_t *)out, samples);
+        break;
+    case AUDIO_FORMAT_PCM_32_BIT:
+        AudioAccumulateS32((const int32_t *)in, (int32_t *)out, samples);
+        break;
+    case AUDIO_FORMAT_PCM_8_24_BIT:
+        AudioAccumulateQ8_24((const int32_t *)in, (int32_t *)out, samples);
+        break;
+    case AUDIO_FORMAT_PCM_FLOAT:
+        AudioAccumulateFloat((const float *)in, (float *)out, samples);
+        break;
+    default:
+        // packed 24 and 8 bit cannot be added in place, they are written
+        memcpy(out, in, samples * audio_bytes_per_sample(format));
+        break;
+    }
+}
+
+void AudioBypass(const effect_config_t *config, int accumulate,
+        const audio_buffer_t *in, audio_buffer_t *out)
+{
+    audio_format_t format = (audio_format_t)config->outputCfg.format;
+    size_t bps = audio_bytes_per_sample(format);
+    size_t in_ch = audio_channel_count_from_out_mask(config->inputCfg.channels);
+    size_t out_ch = audio_channel_count_from_out_mask(config->outputCfg.channels);
+    size_t ch = in_ch < out_ch ? in_ch : out_ch;
+    size_t i;
+
+    if (in->raw == out->raw) {
+        if (in_ch == out_ch)
+            return;
+        // in place: narrower frames are packed front to back, wider ones back to front
+        if (out_ch < in_ch) {
+            for (i = 0; i < in->frameCount; i++)
+                memmove((uint8_t *)out->raw + i * out_ch * bps,
+                        (const uint8_t *)in->raw + i * in_ch * bps, ch * bps);
+        } else {
+            for (i = in->frameCount; i-- > 0;) {
+                memmove((uint8_t *)out->raw + i * out_ch * bps,
+                        (const uint8_t *)in->raw + i * in_ch * bps, ch * bps);
+                memset((uint8_t *)out->raw + (i * out_ch + ch) * bps, 0, (out_ch - ch) * bps);
+            }
+        }
+        return;
+    }
+    if (in_ch == out_ch) {
+        AudioBypassSamples(format, accumulate, in->raw, out->raw, in->frameCount * ch);
+        return;
+    }
+    for (i = 0; i < in->frameCount; i++) {
+        AudioBypassSamples(format, accumulate, (const uint8_t *)in->raw + i * in_ch * bps,
+                (uint8_t *)out->raw + i * out_ch * bps, ch);
+        // channels in does not have are silent, adding silence leaves them as they are
+        if (out_ch > ch && !accumulate)
+            memset((uint8_t *)out->raw + (i * out_ch + ch) * bps, 0, (out_ch - ch) * bps);
+    }
+}
+
+int AudioAccumulateProcess(AudioAccumulate_t *pAccumulate, effect_handle_t self,
+        const effect_config_t *config, audio_buffer_t *in, audio_buffer_t *out)
+{
+    audio_format_t format = (audio_format_t)config->outputCfg.format;
+    size_t in_frame = audio_channel_count_from_out_mask(config->inputCfg.channels) *
+                      audio_bytes_per_sample((audio_format_t)config->inputCfg.format);
+    size_t bps = audio_bytes_per_sample(format);
+    size_t out_ch = audio_channel_count_from_out_mask(config->outputCfg.channels);
+    size_t out_frame = out_ch * bps;
+    size_t chunk, pos, n;
+    audio_buffer_t sub_in, sub_out;
+    int ret = 0;
+
+    if (bps == 0 || out_ch > AUDIO_ACCUMULATE_MAX_CHANNELS)
+        return -EINVAL;
+    chunk = sizeof(pAccumulate->scratch) / (AUDIO_ACCUMULATE_MAX_CHANNELS * bps);
+    pAccumulate->running = 1;
+    for (pos = 0; pos < in->frameCount && ret == 0; pos += n) {
+        n = in->frameCount - pos;
+        if (n > chunk)
+            n = chunk;
+        sub_in.frameCount = sub_out.frameCount = n;
+        sub_in.raw = (uint8_t *)in->raw + pos * in_frame;
+        sub_out.raw = pAccumulate->scratch;
+        ret = (*self)->process(self, &sub_in, &sub_out);
+        if (ret == 0)
+            AudioBypassSamples(format, 1, pAccumulate->scratch,
+                    (uint8_t *)out->raw + pos * out_frame, n * out_ch);
+    }
+    pAccumulate->running = 0;
+    return ret;
+}
@@ -0,0 +1,71 @@
+/*
+ * * Copyright (c) 2014 Amlogic, Inc. All rights reserved.
+ * * *
+ * This source code is subject to the terms and conditions defined in the
+ * * file 'LICENSE' which is part of this source code package.
+ * * *
+ * Description:
+ *     Output of the effects by the access mode of outputCfg. A disabled
+ *     effect does nothing in place, copies distinct buffers and adds its
+ *     input to the output with EFFECT_BUFFER_ACCESS_ACCUMULATE. An enabled
+ *     effect that only knows how to write its output is run on scratch
+ *     chunks that are then added to the output. In place buffers are
+ *     always written, there is nothing to accumulate into.
+ * */
+
+
+#ifndef __AUDIOBYPASS_H__
+#define __AUDIOBYPASS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <hardware/audio_effect.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* scratch of one chunk, whatever the number of channels the effect writes
+ * up to AUDIO_ACCUMULATE_MAX_CHANNELS. Chunks are then 256 or 512 frames,
+ * whole blocks of the block based libraries (VirtualX, DAP). */
+#define AUDIO_ACCUMULATE_MAX_CHANNELS   8
+#define AUDIO_ACCUMULATE_SCRATCH_BYTES  (256 * AUDIO_ACCUMULATE_MAX_CHANNELS * 4)
+
+typedef struct {
+    // process() is being called by AudioAccumulateProcess()
+    int         running;
+    uint8_t     scratch[AUDIO_ACCUMULATE_SCRATCH_BYTES];
+} AudioAccumulate_t;
+
+// full scale of AUDIO_FORMAT_PCM_8_24_BIT, +-1.0 in Q8.24
+#define AUDIO_Q8_24_MAX ((1 << 24) - 1)
+#define AUDIO_Q8_24_MIN (-(1 << 24))
+
+// saturating out += in
+void AudioAccumulateS16(const int16_t *in, int16_t *out, size_t samples);
+void AudioAccumulateS32(const int32_t *in, int32_t *out, size_t samples);
+void AudioAccumulateQ8_24(const int32_t *in, int32_t *out, size_t samples);
+void AudioAccumulateFloat(const float *in, float *out, size_t samples);
+
+/* 1 when process() has to add to out rather than write it: the output is
+ * ACCUMULATE, out is not in and AudioAccumulateProcess() is not running */
+int AudioAccumulateNeeded(const AudioAccumulate_t *pAccumulate, const effect_config_t *config,
+        const audio_buffer_t *in, const audio_buffer_t *out);
+
+/* in to out unprocessed, added with accumulate. Layouts are expected to
+ * match, otherwise only the channels that both frames have room for pass,
+ * in place as well, and the output channels in does not have are written
+ * silent (left as they are when accumulating) */
+void AudioBypass(const effect_config_t *config, int accumulate,
+        const audio_buffer_t *in, audio_buffer_t *out);
+
+/* runs the process() of self into scratch and adds the result to out, chunk
+ * by chunk, returns the first error of process() */
+int AudioAccumulateProcess(AudioAccumulate_t *pAccumulate, effect_handle_t self,
+        const effect_config_t *config, audio_buffer_t *in, audio_buffer_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__AUDIOBYPASS_H__
@@ -0,0 +1,71 @@
+/*
+ * * Copyright (c) 2014 Amlogic, Inc. All rights reserved.
+ * * *
+ * This source code is subject to the terms and conditions defined in the
+ * * file 'LICENSE' which is part of this source code package.
+ * * *
+ * Description:
+ * */
+
+
+
+#include "AudioConvert.h"
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+#include <arm_neon.h>
+#define AUDIO_CONVERT_USE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define AUDIO_CONVERT_USE_SSE2
+#endif
+
+
+void AudioConvertS16ToFloat(const int16_t *in, float *out, size_t samples)
+{
+    const float scale = 1.0f / 32768.0f;
+    size_t i = 0;
+
+#if defined(AUDIO_CONVERT_USE_NEON)
+    for (; i + 8 <= samples; i += 8) {
+        int16x8_t x = vld1q_s16(in + i);
+        vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), scale));
+        vst1q_f32(out + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), scale));
+    }
+#elif defined(AUDIO_CONVERT_USE_SSE2)
+    const __m128 vscale = _mm_set1_ps(scale);
+    for (; i + 8 <= samples; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), vscale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), vscale));
+    }
+#endif
+    for (; i < samples; i++)
+        out[i] = in[i] * scale;
+}
+
+void AudioConvertFloatToS16(const float *in, int16_t *out, size_t samples)
+{
+    size_t i = 0;
+
+#if defined(AUDIO_CONVERT_USE_NEON)
+    for (; i + 8 <= samples; i += 8) {
+        int32x4_t lo = vcvtq_s32_f32(vmulq_n_f32(vld1q_f32(in + i), 32768.0f));
+        int32x4_t hi = vcvtq_s32_f32(vmulq_n_f32(vld1q_f32(in + i + 4), 32768.0f));
+        vst1q_s16(out + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+    }
+#elif defined(AUDIO_CONVERT_USE_SSE2)
+    const __m128 vscale = _mm_set1_ps(32768.0f);
+    const __m128 vmin = _mm_set1_ps(-32768.0f), vmax = _mm_set1_ps(32767.0f);
+    for (; i + 8 <= samples; i += 8) {
+        __m128 lo = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i), vscale), vmin), vmax);
+        __m128 hi = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 4), vscale), vmin), vmax);
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(_mm_cvttps_epi32(lo), _mm_cvttps_epi32(hi)));
+    }
+#endif
+    for (; i < samples; i++) {
+        float v = in[i] * 32768.0f;
+        v = v < -32768.0f ? -32768.0f : (v > 32767.0f ? 32767.0f : v);
+        out[i] = (int16_t)v;
+    }
+}
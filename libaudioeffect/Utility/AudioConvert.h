@@ -0,0 +1,33 @@
+/*
+ * * Copyright (c) 2014 Amlogic, Inc. All rights reserved.
+ * * *
+ * This source code is subject to the terms and conditions defined in the
+ * * file 'LICENSE' which is part of this source code package.
+ * * *
+ * Description:
+ *     Sample format conversion for the float based effects, with NEON or
+ *     SSE2 paths. Float samples are full scale at 1.0.
+ * */
+
+
+#ifndef __AUDIOCONVERT_H__
+#define __AUDIOCONVERT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void AudioConvertS16ToFloat(const int16_t *in, float *out, size_t samples);
+
+// truncating, saturated to 16 bit
+void AudioConvertFloatToS16(const float *in, int16_t *out, size_t samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__AUDIOCONVERT_H__
+
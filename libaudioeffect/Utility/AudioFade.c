@@ -11,12 +11,24 @@
 
 #define LOG_TAG "audio_fade"
 
+#include <string.h>
 #include <cutils/log.h>
+#include <system/audio.h>
 #include "AudioFade.h"
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+#include <arm_neon.h>
+#define AUDIO_FADE_USE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define AUDIO_FADE_USE_SSE2
+#endif
 
 
 #define TABLE_LENGTH 128
 
+// frames whose gains are computed before they are applied in one go
+#define FADE_SUBBLOCK_FRAMES 16
+
 //typedef long long int64_t;
 //typedef unsigned long long uint64_t;
 //typedef long int32_t;
@@ -170,6 +182,19 @@ int mFadeTable_16bit[fadeMax][TABLE_LENGTH] = {
     }
 };
 
+// sin(0 .. pi/2) in Q15, equal-power crossfade gains
+static const int16_t mCrossFadeSin[TABLE_LENGTH + 1] = {
+    0, 402, 804, 1206, 1608, 2009, 2411, 2811, 3212, 3612, 4011, 4410, 4808, 5205, 5602, 5998,
+    6393, 6787, 7180, 7571, 7962, 8351, 8740, 9127, 9512, 9896, 10279, 10660, 11039, 11417, 11793, 12167,
+    12540, 12910, 13279, 13646, 14010, 14373, 14733, 15091, 15447, 15800, 16151, 16500, 16846, 17190, 17531, 17869,
+    18205, 18538, 18868, 19195, 19520, 19841, 20160, 20475, 20788, 21097, 21403, 21706, 22006, 22302, 22595, 22884,
+    23170, 23453, 23732, 24008, 24279, 24548, 24812, 25073, 25330, 25583, 25833, 26078, 26320, 26557, 26791, 27020,
+    27246, 27467, 27684, 27897, 28106, 28311, 28511, 28707, 28899, 29086, 29269, 29448, 29622, 29792, 29957, 30118,
+    30274, 30425, 30572, 30715, 30853, 30986, 31114, 31238, 31357, 31471, 31581, 31686, 31786, 31881, 31972, 32058,
+    32138, 32214, 32286, 32352, 32413, 32470, 32522, 32568, 32610, 32647, 32679, 32706, 32729, 32746, 32758, 32766,
+    32767,
+};
+
 int fadeNext(fadeMethod fade_method, int t, int b, int c, int d)
 {
     int e;
@@ -209,60 +234,398 @@ int fadeNext(fadeMethod fade_method, int t, int b, int c, int d)
 }
 
 
+// fadeNext() for the frames t .. t + nFrames - 1, without a divide per frame
+static void fadeNextGains(fadeMethod fade_method, unsigned int t, int b, int c, int d,
+                          int32_t *pGain, unsigned int nFrames)
+{
+    unsigned int k;
+
+    switch (fade_method) {
+    default:
+    case fadeLinear: {
+        // c * t / d, truncated towards zero as the division does
+        uint64_t absc = (c < 0) ? -(int64_t)c : c;
+        uint64_t q = (absc * t) / d;
+        uint64_t r = (absc * t) % d;
+        uint64_t dq = absc / d;
+        uint64_t dr = absc % d;
+
+        for (k = 0; k < nFrames; k++) {
+            pGain[k] = ((c < 0) ? -(int64_t)q : (int64_t)q) + b;
+            q += dq;
+            r += dr;
+            if (r >= (uint64_t)d) {
+                r -= d;
+                q++;
+            }
+        }
+        break;
+    }
+    case fadeInQuad:
+    case fadeOutQuad:
+    case fadeInOutQuad:
+    case fadeInCubic:
+    case fadeOutCubic:
+    case fadeInOutCubic:
+    case fadeInQuart:
+    case fadeOutQuart:
+    case fadeInOutQuart:
+    case fadeInQuint:
+    case fadeOutQuint:
+    case fadeInOutQuint: {
+        const int *table = mFadeTable_16bit[fade_method];
+        uint32_t div = d - 1;
+        // inter = (t << 16) / (d - 1), stepped as quotient and remainder
+        uint32_t inter = ((uint64_t)t << 16) / div;
+        uint32_t rem = ((uint64_t)t << 16) % div;
+        uint32_t dinter = (1 << 16) / div;
+        uint32_t drem = (1 << 16) % div;
+
+        for (k = 0; k < nFrames; k++) {
+            uint32_t index = inter * (TABLE_LENGTH - 1);
+            uint16_t x1 = index >> 16;
+            uint16_t x2 = index & 0xffff;
+            uint32_t y1, y2, y3;
+
+            if (x1 > TABLE_LENGTH - 1) {
+                x1 = TABLE_LENGTH - 1;
+            }
+            y1 = table[x1];
+            y3 = (x1 + 1 < TABLE_LENGTH) ? (uint32_t)table[x1 + 1] : y1;
+            y2 = (x2 * (y3 - y1) >> 16) + y1;
+            pGain[k] = (((uint64_t)c * y2) >> 16) + b;
+
+            inter += dinter;
+            rem += drem;
+            if (rem >= div) {
+                rem -= div;
+                inter++;
+            }
+        }
+        break;
+    }
+    }
+}
+
+// buf = buf * gain >> 16, one gain per frame, gain in [0, 1 << 16]
+static void fadeApplyGains(int16_t *pBuf, const int32_t *pGain, unsigned int nFrames, unsigned int nchannels)
+{
+    unsigned int i = 0, j;
+
+    if (nchannels == 2) {
+#if defined(AUDIO_FADE_USE_NEON)
+        for (; i + 4 <= nFrames; i += 4) {
+            int32x4_t g = vld1q_s32(pGain + i);
+            int32x4x2_t g2 = vzipq_s32(g, g);
+            int16x8_t x = vld1q_s16(pBuf + 2 * i);
+            int32x4_t lo = vmulq_s32(vmovl_s16(vget_low_s16(x)), g2.val[0]);
+            int32x4_t hi = vmulq_s32(vmovl_s16(vget_high_s16(x)), g2.val[1]);
+            vst1q_s16(pBuf + 2 * i, vcombine_s16(vshrn_n_s32(lo, 16), vshrn_n_s32(hi, 16)));
+        }
+#elif defined(AUDIO_FADE_USE_SSE2)
+        const __m128i mask16 = _mm_set1_epi32(0xffff);
+        for (; i + 4 <= nFrames; i += 4) {
+            __m128i g = _mm_loadu_si128((const __m128i *)(pGain + i));
+            // low 16 bits of each gain in both channel lanes, all ones for 1 << 16
+            __m128i glo = _mm_and_si128(g, mask16);
+            __m128i ghi = _mm_sub_epi32(_mm_setzero_si128(), _mm_srai_epi32(g, 16));
+            __m128i x = _mm_loadu_si128((const __m128i *)(pBuf + 2 * i));
+            __m128i y;
+            glo = _mm_or_si128(glo, _mm_slli_epi32(glo, 16));
+            // signed x * unsigned glo >> 16 from the unsigned product
+            y = _mm_mulhi_epu16(x, glo);
+            y = _mm_sub_epi16(y, _mm_and_si128(_mm_srai_epi16(x, 15), glo));
+            y = _mm_add_epi16(y, _mm_and_si128(x, ghi));
+            _mm_storeu_si128((__m128i *)(pBuf + 2 * i), y);
+        }
+#endif
+    }
+    for (; i < nFrames; i++) {
+        for (j = 0; j < nchannels; j++) {
+            pBuf[i * nchannels + j] = (pBuf[i * nchannels + j] * pGain[i]) >> 16;
+        }
+    }
+}
+
+static void fadeApplyGains32(int32_t *pBuf, const int32_t *pGain, unsigned int nFrames, unsigned int nchannels)
+{
+    unsigned int i, j;
+
+    for (i = 0; i < nFrames; i++) {
+        for (j = 0; j < nchannels; j++) {
+            pBuf[i * nchannels + j] = ((int64_t)pBuf[i * nchannels + j] * pGain[i]) >> 16;
+        }
+    }
+}
+
+static void fadeApplyGainsFloat(float *pBuf, const int32_t *pGain, unsigned int nFrames, unsigned int nchannels)
+{
+    unsigned int i, j;
+
+    for (i = 0; i < nFrames; i++) {
+        float g = pGain[i] * (1.0f / 65536.0f);
+        for (j = 0; j < nchannels; j++) {
+            pBuf[i * nchannels + j] *= g;
+        }
+    }
+}
+
+// bytes per sample, formats other than 32 bit and float are handled as 16 bit
+static unsigned int fadeSampleSize(unsigned int format)
+{
+    if (format == AUDIO_FORMAT_PCM_32_BIT || format == AUDIO_FORMAT_PCM_FLOAT) {
+        return 4;
+    }
+    return 2;
+}
+
 int AudioFadeBuf(AudioFade_t *pAudFade, void *rawBuf, unsigned int nSamples)
 {
-    //int** outbuf;
-    int16_t * pOut16bit;
-    int32_t tmp32;
+    int32_t gain[FADE_SUBBLOCK_FRAMES];
     unsigned int nchannels;
-    unsigned int i, j;
+    unsigned int i, k, n;
     int delta = 0;
 
-    // currently fix to 16bits
-    pOut16bit = (int16_t *)rawBuf;
     nchannels = pAudFade->channels;
 
-    pAudFade->mfadeFramesTotal = ((long long)pAudFade->mfadeTimeTotal * pAudFade->samplingRate) / 1000;
-
     delta = pAudFade->mTargetVolume - pAudFade->mStartVolume;
-    ALOGI("%s,mfadeFramesTotal=%d delta=%d,samplingRate = %d,channels = %d,format = %d\n", __FUNCTION__,
-          pAudFade->mfadeFramesTotal,
-          delta,
-          pAudFade->samplingRate,
-          pAudFade->channels,
-          pAudFade->format);
-
-    for (i = 0; i < nSamples; i++) {
-        if (pAudFade->mfadeFramesTotal == 0) {
-            pAudFade->mCurrentVolume = pAudFade->mTargetVolume;
-        } else if (pAudFade->mfadeFramesUsed < pAudFade->mfadeFramesTotal) {
-            // caculate next volume
-            pAudFade->mCurrentVolume = fadeNext(pAudFade->mfadeMethod, pAudFade->mfadeFramesUsed,
-                                                pAudFade->mStartVolume, delta, pAudFade->mfadeFramesTotal - 1);
-            pAudFade->mfadeFramesUsed++;
+    if (pAudFade->mfadeFramesUsed == 0) {
+        // a new ramp, its length does not change until the next one
+        pAudFade->mfadeFramesTotal = ((long long)pAudFade->mfadeTimeTotal * pAudFade->samplingRate) / 1000;
+        ALOGV("%s,mfadeFramesTotal=%d delta=%d,samplingRate = %d,channels = %d,format = %d\n", __FUNCTION__,
+              pAudFade->mfadeFramesTotal,
+              delta,
+              pAudFade->samplingRate,
+              pAudFade->channels,
+              pAudFade->format);
+    }
+    if (pAudFade->mfadeFramesTotal == 0) {
+        pAudFade->mCurrentVolume = pAudFade->mTargetVolume;
+    }
+
+    for (i = 0; i < nSamples; i += n) {
+        n = nSamples - i;
+        if (n > FADE_SUBBLOCK_FRAMES) {
+            n = FADE_SUBBLOCK_FRAMES;
         }
-        for (j = 0; j < nchannels; j++) {
-            tmp32 = pOut16bit[i * nchannels + j] * pAudFade->mCurrentVolume;
-            pOut16bit[i * nchannels + j] = tmp32 >> 16;
+        if (pAudFade->mfadeFramesUsed < pAudFade->mfadeFramesTotal) {
+            if (n > pAudFade->mfadeFramesTotal - pAudFade->mfadeFramesUsed) {
+                n = pAudFade->mfadeFramesTotal - pAudFade->mfadeFramesUsed;
+            }
+            fadeNextGains(pAudFade->mfadeMethod, pAudFade->mfadeFramesUsed, pAudFade->mStartVolume,
+                          delta, pAudFade->mfadeFramesTotal - 1, gain, n);
+            pAudFade->mCurrentVolume = gain[n - 1];
+            pAudFade->mfadeFramesUsed += n;
+        } else {
+            for (k = 0; k < n; k++) {
+                gain[k] = pAudFade->mCurrentVolume;
+            }
+        }
+        switch (pAudFade->format) {
+        case AUDIO_FORMAT_PCM_32_BIT:
+            fadeApplyGains32((int32_t *)rawBuf + i * nchannels, gain, n, nchannels);
+            break;
+        case AUDIO_FORMAT_PCM_FLOAT:
+            fadeApplyGainsFloat((float *)rawBuf + i * nchannels, gain, n, nchannels);
+            break;
+        default:
+            fadeApplyGains((int16_t *)rawBuf + i * nchannels, gain, n, nchannels);
+            break;
         }
     }
-    // ALOGI("mCurrentVolume=%d\n",pAudFade->mCurrentVolume);
     return AUD_FADE_OK;
 }
 
 void mutePCMBuf(AudioFade_t *pAudFade, void *rawBuf, unsigned int nSamples)
 {
-    int16_t * pOut16bit;
-    unsigned int i, j;
-    unsigned int nchannels;
+    // all zero bits is silence for the integer and the float formats
+    memset(rawBuf, 0, nSamples * pAudFade->channels * fadeSampleSize(pAudFade->format));
+}
 
-    // currently fix to 16bits
-    pOut16bit = (int16_t *)rawBuf;
-    nchannels = pAudFade->channels;
+unsigned int AudioCrossFadeFrames(AudioFade_t *pAudFade, unsigned int nSamples)
+{
+    unsigned int nFrames;
 
-    for (i = 0; i < nSamples; i++) {
-        for (j = 0; j < nchannels; j++) {
-            pOut16bit[i * nchannels + j] = 0;
+    if (pAudFade->channels == 0 || pAudFade->channels > AUD_CROSSFADE_MAX_CHANNELS) {
+        return 0;
+    }
+    // the crossfade buffers hold 16 bit samples
+    if (fadeSampleSize(pAudFade->format) != sizeof(int16_t)) {
+        return 0;
+    }
+    nFrames = ((long long)pAudFade->mfadeTimeTotal * pAudFade->samplingRate) / 1000;
+    if (nFrames > AUD_CROSSFADE_MAX_FRAMES) {
+        nFrames = AUD_CROSSFADE_MAX_FRAMES;
+    }
+    if (nFrames > nSamples) {
+        nFrames = nSamples;
+    }
+    return nFrames;
+}
+
+void AudioCrossFadeKeep(AudioFade_t *pAudFade, AudioCrossFade_t *pCross, const void *rawBuf, unsigned int nSamples)
+{
+    const int16_t *pIn16bit = (const int16_t *)rawBuf;
+    unsigned int nchannels = pAudFade->channels;
+    unsigned int n, first;
+
+    if (nchannels == 0 || nchannels > AUD_CROSSFADE_MAX_CHANNELS) {
+        pCross->preRollFrames = 0;
+        return;
+    }
+    // only the newest frames of a long block are kept, older ones are
+    // overwritten in place instead of being shifted out
+    n = nSamples;
+    if (n > AUD_CROSSFADE_PREROLL_FRAMES) {
+        pIn16bit += (n - AUD_CROSSFADE_PREROLL_FRAMES) * nchannels;
+        n = AUD_CROSSFADE_PREROLL_FRAMES;
+    }
+    if (pCross->preRollPos >= AUD_CROSSFADE_PREROLL_FRAMES) {
+        pCross->preRollPos = 0;
+    }
+    first = AUD_CROSSFADE_PREROLL_FRAMES - pCross->preRollPos;
+    if (first > n) {
+        first = n;
+    }
+    memcpy(pCross->preRoll + pCross->preRollPos * nchannels, pIn16bit, first * nchannels * sizeof(int16_t));
+    if (n > first) {
+        memcpy(pCross->preRoll, pIn16bit + first * nchannels, (n - first) * nchannels * sizeof(int16_t));
+    }
+    pCross->preRollPos = (pCross->preRollPos + n) % AUD_CROSSFADE_PREROLL_FRAMES;
+    pCross->preRollFrames += n;
+    if (pCross->preRollFrames > AUD_CROSSFADE_PREROLL_FRAMES) {
+        pCross->preRollFrames = AUD_CROSSFADE_PREROLL_FRAMES;
+    }
+}
+
+static void crossFadeReverse(int16_t *buf, unsigned int nFrames, unsigned int nchannels)
+{
+    int16_t *head = buf;
+    int16_t *tail = buf + (nFrames - 1) * nchannels;
+    int16_t tmp;
+    unsigned int ch;
+
+    for (; nFrames > 1 && head < tail; head += nchannels, tail -= nchannels) {
+        for (ch = 0; ch < nchannels; ch++) {
+            tmp = head[ch];
+            head[ch] = tail[ch];
+            tail[ch] = tmp;
+        }
+    }
+}
+
+unsigned int AudioCrossFadePreRoll(AudioFade_t *pAudFade, AudioCrossFade_t *pCross)
+{
+    unsigned int nchannels = pAudFade->channels;
+    unsigned int nFrames = pCross->preRollFrames;
+    unsigned int oldest;
+
+    pCross->preRollFrames = 0;
+    if (nFrames == 0 || nchannels == 0 || nchannels > AUD_CROSSFADE_MAX_CHANNELS) {
+        pCross->preRollPos = 0;
+        return 0;
+    }
+    // rotate the oldest frame to the start, only done once per crossfade
+    oldest = (pCross->preRollPos + AUD_CROSSFADE_PREROLL_FRAMES - nFrames) % AUD_CROSSFADE_PREROLL_FRAMES;
+    if (oldest != 0) {
+        crossFadeReverse(pCross->preRoll, oldest, nchannels);
+        crossFadeReverse(pCross->preRoll + oldest * nchannels, AUD_CROSSFADE_PREROLL_FRAMES - oldest, nchannels);
+        crossFadeReverse(pCross->preRoll, AUD_CROSSFADE_PREROLL_FRAMES, nchannels);
+    }
+    pCross->preRollPos = 0;
+    return nFrames;
+}
+
+// Q15 sin of a Q24 fraction of pi/2
+static int crossFadeSin(uint32_t pos)
+{
+    uint32_t index = pos >> 17;
+    uint32_t frac = (pos >> 1) & 0xffff;
+
+    if (index >= TABLE_LENGTH) {
+        return mCrossFadeSin[TABLE_LENGTH];
+    }
+    return mCrossFadeSin[index] + (((mCrossFadeSin[index + 1] - mCrossFadeSin[index]) * (int)frac) >> 16);
+}
+
+void AudioCrossFadeBuf(AudioFade_t *pAudFade, const void *oldBuf, void *newBuf, unsigned int nSamples)
+{
+    const int16_t *pOld = (const int16_t *)oldBuf;
+    int16_t *pNew = (int16_t *)newBuf;
+    unsigned int nchannels = pAudFade->channels;
+    // cos and sin of each frame, interleaved
+    int16_t gain[FADE_SUBBLOCK_FRAMES * 2];
+    uint32_t pos, rem, dpos, drem;
+    unsigned int i, j, k, n;
+    int32_t tmp32;
+
+    if (nSamples == 0) {
+        return;
+    }
+    // pos = (i + 1) / nSamples in Q24, the last frame is the new setting only
+    dpos = (1 << 24) / nSamples;
+    drem = (1 << 24) % nSamples;
+    pos = dpos;
+    rem = drem;
+
+    for (i = 0; i < nSamples; i += n) {
+        n = nSamples - i;
+        if (n > FADE_SUBBLOCK_FRAMES) {
+            n = FADE_SUBBLOCK_FRAMES;
+        }
+        for (k = 0; k < n; k++) {
+            gain[2 * k] = crossFadeSin((1 << 24) - pos);
+            gain[2 * k + 1] = crossFadeSin(pos);
+            pos += dpos;
+            rem += drem;
+            if (rem >= nSamples) {
+                rem -= nSamples;
+                pos++;
+            }
+        }
+
+        k = 0;
+        if (nchannels == 2) {
+#if defined(AUDIO_FADE_USE_NEON)
+            for (; k + 4 <= n; k += 4) {
+                int16x4x2_t g = vld2_s16(gain + 2 * k);
+                int16x4x2_t gc = vzip_s16(g.val[0], g.val[0]);
+                int16x4x2_t gs = vzip_s16(g.val[1], g.val[1]);
+                int16x8_t o = vld1q_s16(pOld + 2 * (i + k));
+                int16x8_t x = vld1q_s16(pNew + 2 * (i + k));
+                int32x4_t lo = vmull_s16(vget_low_s16(o), gc.val[0]);
+                int32x4_t hi = vmull_s16(vget_high_s16(o), gc.val[1]);
+                lo = vmlal_s16(lo, vget_low_s16(x), gs.val[0]);
+                hi = vmlal_s16(hi, vget_high_s16(x), gs.val[1]);
+                vst1q_s16(pNew + 2 * (i + k), vcombine_s16(vqrshrn_n_s32(lo, 15), vqrshrn_n_s32(hi, 15)));
+            }
+#elif defined(AUDIO_FADE_USE_SSE2)
+            const __m128i round = _mm_set1_epi32(1 << 14);
+            for (; k + 4 <= n; k += 4) {
+                // one (cos, sin) pair per frame, repeated for both channels
+                __m128i g = _mm_loadu_si128((const __m128i *)(gain + 2 * k));
+                __m128i o = _mm_loadu_si128((const __m128i *)(pOld + 2 * (i + k)));
+                __m128i x = _mm_loadu_si128((const __m128i *)(pNew + 2 * (i + k)));
+                __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(o, x), _mm_unpacklo_epi32(g, g));
+                __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(o, x), _mm_unpackhi_epi32(g, g));
+                lo = _mm_srai_epi32(_mm_add_epi32(lo, round), 15);
+                hi = _mm_srai_epi32(_mm_add_epi32(hi, round), 15);
+                _mm_storeu_si128((__m128i *)(pNew + 2 * (i + k)), _mm_packs_epi32(lo, hi));
+            }
+#endif
+        }
+        for (; k < n; k++) {
+            for (j = 0; j < nchannels; j++) {
+                tmp32 = pOld[(i + k) * nchannels + j] * gain[2 * k] +
+                        pNew[(i + k) * nchannels + j] * gain[2 * k + 1];
+                tmp32 = (tmp32 + (1 << 14)) >> 15;
+                if (tmp32 > 32767) {
+                    tmp32 = 32767;
+                } else if (tmp32 < -32768) {
+                    tmp32 = -32768;
+                }
+                pNew[(i + k) * nchannels + j] = tmp32;
+            }
         }
     }
 }
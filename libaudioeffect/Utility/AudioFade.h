@@ -16,6 +16,11 @@
 
 #define DEFAULT_FADE_IN_MS  50 //(ms)
 #define DEFAULT_FADE_OUT_MS  50 //(ms)
+#define DEFAULT_CROSSFADE_MS  10 //(ms)
+
+#define AUD_CROSSFADE_MAX_FRAMES      512
+#define AUD_CROSSFADE_PREROLL_FRAMES  512
+#define AUD_CROSSFADE_MAX_CHANNELS    2
 
 typedef enum {
     fadeLinear,
@@ -43,6 +48,7 @@ typedef enum {
     AUD_FADE_MUTE      = 3,
     AUD_FADE_IN_START  = 4,
     AUD_FADE_IN        = 5,
+    AUD_FADE_CROSS     = 6, // crossfade from the old to the new setting in the next block
 } fade_state_e;
 
 
@@ -69,6 +75,18 @@ typedef struct {
 
 } AudioFade_t;
 
+// Buffers for AUD_FADE_CROSS: the window is processed with the old setting,
+// then the new setting is warmed up on preRoll (the input preceding the
+// block) and run on the same window, both outputs are blended with equal power.
+// preRoll is a ring, preRollPos is where the next input frame goes.
+typedef struct {
+    unsigned int preRollFrames;
+    unsigned int preRollPos;
+    short preRoll[AUD_CROSSFADE_PREROLL_FRAMES * AUD_CROSSFADE_MAX_CHANNELS];
+    short input[AUD_CROSSFADE_MAX_FRAMES * AUD_CROSSFADE_MAX_CHANNELS];
+    short old[AUD_CROSSFADE_MAX_FRAMES * AUD_CROSSFADE_MAX_CHANNELS];
+} AudioCrossFade_t;
+
 // fadeMs: time interval need to do fade in/fade out (in million seconds)
 // muteFrms: after fade out, how many audio frames need to mute
 int AudioFadeInit(AudioFade_t *pAudFade, fadeMethod fade_method, int fadeMs, int muteFrms);
@@ -85,5 +103,19 @@ int AudioFadeSetFormat(AudioFade_t *pAudFade,
 
 void mutePCMBuf(AudioFade_t *pAudFade, void *rawBuf, unsigned int nSamples);
 
+// frames of the crossfade window in a block of nSamples frames,
+// 0 when the format does not allow a crossfade
+unsigned int AudioCrossFadeFrames(AudioFade_t *pAudFade, unsigned int nSamples);
+
+// keep the tail of the (unprocessed) input as pre-roll for the next crossfade
+void AudioCrossFadeKeep(AudioFade_t *pAudFade, AudioCrossFade_t *pCross, const void *rawBuf, unsigned int nSamples);
+
+// frames of pre-roll, oldest first from pCross->preRoll. The pre-roll is
+// consumed: it may be processed in place, keeping restarts afterwards.
+unsigned int AudioCrossFadePreRoll(AudioFade_t *pAudFade, AudioCrossFade_t *pCross);
+
+// newBuf = oldBuf * cos + newBuf * sin, the angle going to pi/2 over nSamples frames
+void AudioCrossFadeBuf(AudioFade_t *pAudFade, const void *oldBuf, void *newBuf, unsigned int nSamples);
+
 #endif //__AUDIOFADE_H__
 
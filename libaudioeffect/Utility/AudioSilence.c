@@ -0,0 +1,99 @@
+/*
+ * * Copyright (c) 2014 Amlogic, Inc. All rights reserved.
+ * * *
+ * This source code is subject to the terms and conditions defined in the
+ * * file 'LICENSE' which is part of this source code package.
+ * * *
+ * Description:
+ * */
+
+
+
+#define LOG_TAG "audio_silence"
+
+#include <stdlib.h>
+#include <string.h>
+#include <cutils/log.h>
+#include <cutils/properties.h>
+#include "AudioSilence.h"
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+#include <arm_neon.h>
+#define AUDIO_SILENCE_USE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define AUDIO_SILENCE_USE_SSE2
+#endif
+
+
+void AudioSilenceInit(AudioSilence_t *pSilence, uint32_t tail_ms)
+{
+    char value[PROPERTY_VALUE_MAX];
+    int blocks = AUDIO_SILENCE_BLOCKS_DEFAULT;
+
+    if (property_get(AUDIO_SILENCE_BLOCKS_PROPERTY, value, NULL) > 0)
+        blocks = atoi(value);
+    pSilence->tail_ms = tail_ms;
+    pSilence->hold_blocks = blocks > 0 ? blocks : 0;
+    AudioSilenceReset(pSilence);
+    ALOGV("%s: tail %u ms, hold %u blocks", __FUNCTION__, tail_ms, pSilence->hold_blocks);
+}
+
+void AudioSilenceReset(AudioSilence_t *pSilence)
+{
+    pSilence->silent_blocks = 0;
+    pSilence->silent_frames = 0;
+}
+
+int AudioSilenceIsZero(const void *buf, size_t bytes)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    size_t i = 0;
+
+    // OR 64 bytes at a time, audio that is not silent leaves on the first
+#if defined(AUDIO_SILENCE_USE_NEON)
+    for (; i + 64 <= bytes; i += 64) {
+        uint32x4_t v = vorrq_u32(vorrq_u32(vld1q_u32((const uint32_t *)(p + i)),
+                                           vld1q_u32((const uint32_t *)(p + i + 16))),
+                                 vorrq_u32(vld1q_u32((const uint32_t *)(p + i + 32)),
+                                           vld1q_u32((const uint32_t *)(p + i + 48))));
+        uint32x2_t r = vorr_u32(vget_low_u32(v), vget_high_u32(v));
+        if (vget_lane_u32(r, 0) | vget_lane_u32(r, 1))
+            return 0;
+    }
+#elif defined(AUDIO_SILENCE_USE_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 64 <= bytes; i += 64) {
+        __m128i v = _mm_or_si128(_mm_or_si128(_mm_loadu_si128((const __m128i *)(p + i)),
+                                              _mm_loadu_si128((const __m128i *)(p + i + 16))),
+                                 _mm_or_si128(_mm_loadu_si128((const __m128i *)(p + i + 32)),
+                                              _mm_loadu_si128((const __m128i *)(p + i + 48))));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) != 0xffff)
+            return 0;
+    }
+#endif
+    for (; i < bytes; i++) {
+        if (p[i])
+            return 0;
+    }
+    return 1;
+}
+
+int AudioSilenceDetect(AudioSilence_t *pSilence, const void *buf, size_t frames,
+        size_t frame_size, uint32_t sample_rate)
+{
+    int bypass;
+
+    if (pSilence->hold_blocks == 0)
+        return 0;
+    if (!AudioSilenceIsZero(buf, frames * frame_size)) {
+        AudioSilenceReset(pSilence);
+        return 0;
+    }
+    bypass = pSilence->silent_blocks >= pSilence->hold_blocks &&
+             pSilence->silent_frames * 1000 >= (uint64_t)pSilence->tail_ms * sample_rate;
+    if (pSilence->silent_blocks < pSilence->hold_blocks)
+        pSilence->silent_blocks++;
+    if (!bypass)
+        pSilence->silent_frames += frames;
+    return bypass;
+}
@@ -0,0 +1,55 @@
+/*
+ * * Copyright (c) 2014 Amlogic, Inc. All rights reserved.
+ * * *
+ * This source code is subject to the terms and conditions defined in the
+ * * file 'LICENSE' which is part of this source code package.
+ * * *
+ * Description:
+ *     Digital silence detection for the effects. An effect whose input has
+ *     been all zero for AUDIO_SILENCE_BLOCKS_PROPERTY process() calls, and
+ *     for at least its tail time, produces silence too and can skip its
+ *     DSP until the first buffer with a non-zero sample.
+ * */
+
+
+#ifndef __AUDIOSILENCE_H__
+#define __AUDIOSILENCE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// silent process() calls before the bypass, 0 turns the detection off
+#define AUDIO_SILENCE_BLOCKS_PROPERTY   "media.effect.silence_blocks"
+#define AUDIO_SILENCE_BLOCKS_DEFAULT    8
+
+typedef struct {
+    // time the effect output needs to decay once the input is silent
+    uint32_t tail_ms;
+    uint32_t hold_blocks;
+    // silence seen before the current buffer
+    uint32_t silent_blocks;
+    uint64_t silent_frames;
+} AudioSilence_t;
+
+// reads AUDIO_SILENCE_BLOCKS_PROPERTY
+void AudioSilenceInit(AudioSilence_t *pSilence, uint32_t tail_ms);
+void AudioSilenceReset(AudioSilence_t *pSilence);
+
+// 1 when every byte is zero, -0.0f is not silence
+int AudioSilenceIsZero(const void *buf, size_t bytes);
+
+/* 1 when buf is silent and the silence before it has drained the tail, the
+ * output of the effect is then silence as well */
+int AudioSilenceDetect(AudioSilence_t *pSilence, const void *buf, size_t frames,
+        size_t frame_size, uint32_t sample_rate);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__AUDIOSILENCE_H__
+
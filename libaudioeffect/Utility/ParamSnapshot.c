@@ -0,0 +1,106 @@
+/*
+ * * Copyright (c) 2014 Amlogic, Inc. All rights reserved.
+ * * *
+ * This source code is subject to the terms and conditions defined in the
+ * * file 'LICENSE' which is part of this source code package.
+ * * *
+ * Description:
+ * */
+
+
+
+#define LOG_TAG "param_snapshot"
+
+#include <stdlib.h>
+#include <string.h>
+#include <cutils/log.h>
+#include "ParamSnapshot.h"
+
+
+#define PARAM_SNAPSHOT_DIRTY 0x4
+#define PARAM_SNAPSHOT_INDEX 0x3
+
+int ParamSnapshotInit(ParamSnapshot_t *pSnap, const void *init, size_t size)
+{
+    int i;
+
+    if (pSnap == NULL || size == 0) {
+        return PARAM_SNAPSHOT_ERR;
+    }
+
+    memset(pSnap, 0, sizeof(ParamSnapshot_t));
+    for (i = 0; i < PARAM_SNAPSHOT_SLOTS; i++) {
+        pSnap->slot[i] = calloc(1, size);
+        if (pSnap->slot[i] == NULL) {
+            ALOGE("%s: alloc %zu bytes failed", __FUNCTION__, size);
+            ParamSnapshotRelease(pSnap);
+            return PARAM_SNAPSHOT_ERR;
+        }
+        if (init != NULL) {
+            memcpy(pSnap->slot[i], init, size);
+        }
+    }
+    pSnap->size = size;
+    pSnap->front = 0;
+    pSnap->shared = 1;
+    pSnap->back = 2;
+    pthread_mutex_init(&pSnap->lock, NULL);
+
+    return PARAM_SNAPSHOT_OK;
+}
+
+void ParamSnapshotRelease(ParamSnapshot_t *pSnap)
+{
+    int i;
+
+    if (pSnap == NULL) {
+        return;
+    }
+
+    for (i = 0; i < PARAM_SNAPSHOT_SLOTS; i++) {
+        if (pSnap->slot[i] != NULL) {
+            free(pSnap->slot[i]);
+            pSnap->slot[i] = NULL;
+        }
+    }
+    if (pSnap->size != 0) {
+        pthread_mutex_destroy(&pSnap->lock);
+        pSnap->size = 0;
+    }
+}
+
+int ParamSnapshotPublish(ParamSnapshot_t *pSnap, const void *params)
+{
+    unsigned int prev;
+
+    if (pSnap == NULL || pSnap->size == 0 || params == NULL) {
+        return PARAM_SNAPSHOT_ERR;
+    }
+
+    pthread_mutex_lock(&pSnap->lock);
+    memcpy(pSnap->slot[pSnap->back], params, pSnap->size);
+    // release: the slot contents are visible before the reader can take it
+    prev = __atomic_exchange_n(&pSnap->shared, pSnap->back | PARAM_SNAPSHOT_DIRTY, __ATOMIC_ACQ_REL);
+    pSnap->back = prev & PARAM_SNAPSHOT_INDEX;
+    pthread_mutex_unlock(&pSnap->lock);
+
+    return PARAM_SNAPSHOT_OK;
+}
+
+const void *ParamSnapshotAcquire(ParamSnapshot_t *pSnap, int *changed)
+{
+    unsigned int prev;
+    int updated = 0;
+
+    if (__atomic_load_n(&pSnap->shared, __ATOMIC_RELAXED) & PARAM_SNAPSHOT_DIRTY) {
+        // hand the old front back to the writer and take the new snapshot
+        prev = __atomic_exchange_n(&pSnap->shared, pSnap->front, __ATOMIC_ACQ_REL);
+        pSnap->front = prev & PARAM_SNAPSHOT_INDEX;
+        updated = 1;
+    }
+    if (changed != NULL) {
+        *changed = updated;
+    }
+
+    return pSnap->slot[pSnap->front];
+}
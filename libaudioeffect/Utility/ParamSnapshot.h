@@ -0,0 +1,65 @@
+/*
+ * * Copyright (c) 2014 Amlogic, Inc. All rights reserved.
+ * * *
+ * This source code is subject to the terms and conditions defined in the
+ * * file 'LICENSE' which is part of this source code package.
+ * * *
+ * Description:
+ *     Immutable parameter snapshots shared between the control thread
+ *     (setParameter/configure) and the audio thread (process).
+ *
+ *     Three slots are rotated by atomic index swaps: the writer fills its
+ *     private slot and swaps it with the shared one, the reader swaps the
+ *     shared slot with its own when a new snapshot is pending. The reader
+ *     never blocks and always sees a complete parameter set. Writers are
+ *     serialized against each other by a mutex that the reader never takes.
+ * */
+
+
+#ifndef __PARAMSNAPSHOT_H__
+#define __PARAMSNAPSHOT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PARAM_SNAPSHOT_ERR -1
+#define PARAM_SNAPSHOT_OK 0
+
+#define PARAM_SNAPSHOT_SLOTS 3
+
+typedef struct {
+    void *slot[PARAM_SNAPSHOT_SLOTS];
+    size_t size;
+    /* shared slot index, PARAM_SNAPSHOT_DIRTY set when not yet taken by the reader */
+    unsigned int shared;
+    /* owned by the writer, only touched with lock held */
+    unsigned int back;
+    /* owned by the reader */
+    unsigned int front;
+    pthread_mutex_t lock;
+} ParamSnapshot_t;
+
+// allocate the slots and fill all of them with init (size bytes)
+int ParamSnapshotInit(ParamSnapshot_t *pSnap, const void *init, size_t size);
+
+void ParamSnapshotRelease(ParamSnapshot_t *pSnap);
+
+// control thread: copy params into a new snapshot and make it visible
+int ParamSnapshotPublish(ParamSnapshot_t *pSnap, const void *params);
+
+// audio thread: return the newest snapshot, valid until the next acquire.
+// *changed (optional) is set to 1 when a snapshot was published since the
+// previous acquire, its contents are not compared and may be the same.
+const void *ParamSnapshotAcquire(ParamSnapshot_t *pSnap, int *changed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__PARAMSNAPSHOT_H__
+
@@ -14,6 +14,7 @@ LOCAL_SHARED_LIBRARIES := \
 
 LOCAL_C_INCLUDES := \
     $(LOCAL_PATH) \
+    vendor/amlogic/frameworks/av/libaudioeffect/Utility \
     hardware/amlogic/audio/utils/ini/include \
     hardware/libhardware/include/hardware \
     hardware/libhardware/include \
@@ -21,9 +22,11 @@ LOCAL_C_INCLUDES := \
 
 LOCAL_SRC_FILES += Virtual_Bass.cpp \
 	Virtual_Bass_Arithmetic.cpp
+LOCAL_SRC_FILES += ../Utility/ParamSnapshot.c
+LOCAL_SRC_FILES += ../Utility/AudioBiquad.c
+LOCAL_SRC_FILES += ../Utility/AudioSilence.c
+LOCAL_SRC_FILES += ../Utility/AudioBypass.c
 
-#LOCAL_LDFLAGS_arm  += $(LOCAL_PATH)/lib_aml_agc.a
-#LOCAL_LDFLAGS_arm64  += $(LOCAL_PATH)/lib_aml_agc64.a
 LOCAL_MULTILIB := both
 LOCAL_PRELINK_MODULE := false
 
@@ -18,7 +18,7 @@
  *
  */
 #define LOG_TAG "Virtual_Bass_Effect"
-#define LOG_NDEBUG 0
+//#define LOG_NDEBUG 0
 
 #include <cutils/log.h>
 #include <utils/Log.h>
@@ -37,6 +37,9 @@
 
 #include "IniParser.h"
 #include "Virtual_Bass.h"
+#include "ParamSnapshot.h"
+#include "AudioSilence.h"
+#include "AudioBypass.h"
 
 extern "C"{
 
@@ -44,6 +47,8 @@ extern "C"{
 
 #define MODEL_SUM_DEFAULT_PATH "/vendor/etc/tvconfig/model/model_sum.ini"
 #define AUDIO_EFFECT_DEFAULT_PATH "/vendor/etc/tvconfig/audio/AMLOGIC_AUDIO_EFFECT_t962x_r311_FHD.ini"
+// the sub-bass low passes have rung out well within this
+#define VIRTUAL_BASS_TAIL_MS 100
 
 // effect_handle_t interface implementation for Virtual_Bass effect
 extern const struct effect_interface_s VirtualBassInterface;
@@ -95,8 +100,6 @@ typedef struct VirtualBasscfg_s{
 } VirtualBasscfg;
 
 typedef struct VirtualBassdata_s {
-    /* Virtual_Bass API needed data */
-    void        *agc;
     VirtualBasscfg      tbcfg;
     int32_t     enable;
     int32_t     *usr_cfg;
@@ -105,15 +108,55 @@ typedef struct VirtualBassdata_s {
     int32_t     soure_id;
 } VirtualBassdata;
 
+/* snapshot read by Virtual_Bass_process */
+typedef struct VirtualBassparam_s {
+    int32_t             enable;
+    VirtualBasscfg      tbcfg;
+    /* bumped by EFFECT_CMD_RESET, the engine is reset by the audio thread */
+    uint32_t            reset_seq;
+} VirtualBassparam;
+
 typedef struct VirtualBassContext_s {
     const struct effect_interface_s *itfe;
     effect_config_t                 config;
     Virtual_Bass_state_e            state;
     VirtualBassdata                 gVirtualBassdata;
+    ParamSnapshot_t                 params;
+    uint32_t                        reset_seq;      // control thread
+    // owned by the audio thread
+    uint32_t                        reset_seq_done;
+    int32_t                         active;
+    VirtualBassEngine_t             engine;
+    AudioSilence_t                  silence;
+    AudioAccumulate_t               accumulate;
 } VirtualBassContext;
 
 const char *VirtualBassStatusstr[] = {"Disable", "Enable"};
 
+static void Virtual_Bass_get_params(VirtualBassContext *pContext, VirtualBassparam *params)
+{
+    VirtualBassdata *data = &pContext->gVirtualBassdata;
+
+    params->enable = data->enable;
+    params->tbcfg = data->tbcfg;
+    params->reset_seq = pContext->reset_seq;
+}
+
+/* hand the current settings to the audio thread, the engine is set there */
+static void Virtual_Bass_publish(VirtualBassContext *pContext)
+{
+    VirtualBassparam params;
+
+    Virtual_Bass_get_params(pContext, &params);
+    ParamSnapshotPublish(&pContext->params, &params);
+}
+
+static void Virtual_Bass_set_engine(VirtualBassContext *pContext, const VirtualBasscfg *tbcfg)
+{
+    VirtualBassSetParameter(&pContext->engine, tbcfg->peak_level, tbcfg->dynamic_threshold,
+        tbcfg->noise_threshold, tbcfg->response_time, tbcfg->release_time);
+}
+
 int Virtual_Bass_get_model_name(char *model_name, int size)
 {
     int ret = -1;
@@ -279,15 +322,8 @@ int Virtual_Bass_init(VirtualBassContext *pContext)
     pContext->config.outputCfg.bufferProvider.cookie = NULL;
     pContext->config.outputCfg.mask = EFFECT_CONFIG_ALL;
 
-    if (data->agc == NULL) {
-        VirtualBassInit();
-        VirtualBassSetParameter();
-
-        ALOGI("Virtual_Bass_init! peak_level = %fdB, dynamic_theshold = %fdB, noise_threshold = %fdB\n",
-            data->tbcfg.peak_level, data->tbcfg.dynamic_threshold, data->tbcfg.noise_threshold);
-    } else {
-        ALOGE("%s, Virtual_Bass is exist\n", __FUNCTION__);
-    }
+    ALOGI("Virtual_Bass_init! peak_level = %fdB, dynamic_theshold = %fdB, noise_threshold = %fdB\n",
+        data->tbcfg.peak_level, data->tbcfg.dynamic_threshold, data->tbcfg.noise_threshold);
 
     ALOGD("%s: sucessful", __FUNCTION__);
     return 0;
@@ -310,7 +346,8 @@ int Virtual_Bass_configure(VirtualBassContext *pContext, effect_config_t *pConfi
     if (pConfig->outputCfg.accessMode != EFFECT_BUFFER_ACCESS_WRITE &&
         pConfig->outputCfg.accessMode != EFFECT_BUFFER_ACCESS_ACCUMULATE)
         return -EINVAL;
-    if (pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT) {
+    if (pConfig->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT &&
+        pConfig->inputCfg.format != AUDIO_FORMAT_PCM_FLOAT) {
         ALOGW("%s: format in = 0x%x format out = 0x%x", __FUNCTION__,
             pConfig->inputCfg.format, pConfig->outputCfg.format);
         pConfig->inputCfg.format = pConfig->outputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
@@ -331,36 +368,37 @@ int Virtual_Bass_setParameter(VirtualBassContext *pContext, void *pParam, void *
        case VIRTUAL_BASS_PARAM_PEAK_LEVEL:
             value = *(int32_t *)pValue;
             tbcfg->peak_level = (float)value;
-            VirtualBassSetParameter();
+            Virtual_Bass_publish(pContext);
             ALOGD("%s: set peak_level -> %f ", __FUNCTION__, tbcfg->peak_level);
             break;
        case VIRTUAL_BASS_PARAM_DYNAMIC_THRESHOLD:
             value = *(int32_t *)pValue;
             tbcfg->dynamic_threshold = (float)value;
-            VirtualBassSetParameter();
+            Virtual_Bass_publish(pContext);
             ALOGD("%s: set dynamic_threshold -> %f ", __FUNCTION__, tbcfg->dynamic_threshold);
             break;
        case VIRTUAL_BASS_PARAM_NOISE_THRESHOLD :
             value = *(int32_t *)pValue;
             tbcfg->noise_threshold = (float)value;
-            VirtualBassSetParameter();
+            Virtual_Bass_publish(pContext);
             ALOGD("%s: set noise_threshold -> %f ", __FUNCTION__, tbcfg->noise_threshold);
             break;
        case VIRTUAL_BASS_PARAM_RESPONSE_TIME:
             value = *(int32_t *)pValue;
             tbcfg->response_time = value / 48; // UI set sample
-            VirtualBassSetParameter();
+            Virtual_Bass_publish(pContext);
             ALOGD("%s: set response_time-> %d ", __FUNCTION__, tbcfg->response_time);
             break;
        case VIRTUAL_BASS_PARAM_ENABLE:
             value = *(int32_t *)pValue;
             data->enable = value;
+            Virtual_Bass_publish(pContext);
             ALOGD("%s: Set status -> %s", __FUNCTION__, VirtualBassStatusstr[value]);
             break;
        case VIRTUAL_BASS_PARAM_RELEASE_TIME:
             value = *(int32_t *)pValue;
             tbcfg->release_time = value * 1000; // UI set s, here change s to ms
-            VirtualBassSetParameter();
+            Virtual_Bass_publish(pContext);
             ALOGD("%s: set release_time-> %d ", __FUNCTION__, tbcfg->release_time);
             break;
        case VIRTUAL_BASS_PARAM_SOURCE_IN:
@@ -464,6 +502,7 @@ int Virtual_Bass_release(VirtualBassContext *pContext)
         free(data->usr_cfg);
         data->usr_cfg = NULL;
     }
+    ParamSnapshotRelease(&pContext->params);
 
     return 0;
 }
@@ -473,7 +512,7 @@ int Virtual_Bass_release(VirtualBassContext *pContext)
 int Virtual_Bass_process(effect_handle_t self, audio_buffer_t *inBuffer, audio_buffer_t *outBuffer)
 {
     VirtualBassContext* pContext = ( VirtualBassContext *)self;
-ALOGD("%s   ", __FUNCTION__);
+
     if (pContext == NULL)
         return -EINVAL;
 
@@ -485,20 +524,47 @@ ALOGD("%s   ", __FUNCTION__);
     if (pContext->state != VIRTUAL_BASS_STATE_ACTIVE)
         return -ENODATA;
 
-    int16_t *in  = (int16_t *)inBuffer->raw;
-    int16_t *out = (int16_t *)outBuffer->raw;
-    VirtualBassdata*data = &pContext->gVirtualBassdata;
-
-    if (!data->enable) {
-        for (size_t i = 0; i < inBuffer->frameCount; i++) {
-            *out++ = *in++;
-            *out++ = *in++;
-        }
-				ALOGD("%s: enable ", __FUNCTION__);
-    } else {
-        VirtualBassProcess(data->agc);
-			ALOGD("%s: disable ", __FUNCTION__);
+    VirtualBassEngine_t *eng = &pContext->engine;
+    int is_float = pContext->config.inputCfg.format == AUDIO_FORMAT_PCM_FLOAT;
+    size_t frame_size = 2 * (is_float ? sizeof(float) : sizeof(int16_t));
+    int accumulate = AudioAccumulateNeeded(&pContext->accumulate, &pContext->config, inBuffer, outBuffer);
+    int changed;
+    const VirtualBassparam *params = (const VirtualBassparam *)ParamSnapshotAcquire(&pContext->params, &changed);
+
+    if (eng->sample_rate != pContext->config.inputCfg.samplingRate) {
+        // new rate from EFFECT_CMD_SET_CONFIG, redesign the filters for it
+        VirtualBassInit(eng, pContext->config.inputCfg.samplingRate);
+        Virtual_Bass_set_engine(pContext, &params->tbcfg);
+    } else if (changed) {
+        Virtual_Bass_set_engine(pContext, &params->tbcfg);
+    }
+    if (params->reset_seq != pContext->reset_seq_done) {
+        pContext->reset_seq_done = params->reset_seq;
+        VirtualBassReset(eng);
+    }
+    if (!params->enable) {
+        pContext->active = 0;
+        AudioBypass(&pContext->config, accumulate, inBuffer, outBuffer);
+        return 0;
     }
+    if (accumulate)
+        return AudioAccumulateProcess(&pContext->accumulate, self, &pContext->config, inBuffer, outBuffer);
+    if (!pContext->active) {
+        // the filters still hold the audio from before the bypass
+        VirtualBassReset(eng);
+        pContext->active = 1;
+    }
+    if (AudioSilenceDetect(&pContext->silence, inBuffer->raw, inBuffer->frameCount,
+            frame_size, pContext->config.inputCfg.samplingRate)) {
+        // silent past the tail, no sub-bass left to generate harmonics from
+        VirtualBassSilence(eng, inBuffer->frameCount);
+        AudioBypass(&pContext->config, 0, inBuffer, outBuffer);
+        return 0;
+    }
+    if (is_float)
+        VirtualBassProcessFloat(eng, (const float *)inBuffer->raw, (float *)outBuffer->raw, inBuffer->frameCount);
+    else
+        VirtualBassProcess(eng, (const int16_t *)inBuffer->raw, (int16_t *)outBuffer->raw, inBuffer->frameCount);
 
     return 0;
 }
@@ -527,6 +593,9 @@ int Virtual_Bass_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSiz
         *(int *) pReplyData = Virtual_Bass_configure(pContext, (effect_config_t *) pCmdData);
         break;
     case EFFECT_CMD_RESET:
+        // the engine belongs to the audio thread, reset there
+        pContext->reset_seq++;
+        Virtual_Bass_publish(pContext);
         break;
     case EFFECT_CMD_ENABLE:
         if (pReplyData == NULL || replySize == NULL || *replySize != sizeof(int))
@@ -623,6 +692,15 @@ int VirtualBassLib_Create(const effect_uuid_t * uuid, int32_t sessionId __unused
         ALOGE("%s: Load INI File faied, use default param", __FUNCTION__);
         pContext->gVirtualBassdata.enable = 0;
     }
+    VirtualBassparam params;
+    Virtual_Bass_get_params(pContext, &params);
+    if (ParamSnapshotInit(&pContext->params, &params, sizeof(VirtualBassparam)) < 0) {
+        Virtual_Bass_release(pContext);
+        delete pContext;
+        return -EINVAL;
+    }
+
+    AudioSilenceInit(&pContext->silence, VIRTUAL_BASS_TAIL_MS);
 
     pContext->itfe = &VirtualBassInterface;
     pContext->state = VIRTUAL_BASS_STATE_UNINITIALIZED;
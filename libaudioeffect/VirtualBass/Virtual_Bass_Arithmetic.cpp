@@ -1,38 +1,345 @@
+/*
+ * Copyright (C) 2017 Amlogic Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
 #define LOG_TAG "Virtual_Bass_Effect_Arithmetic"
-#define LOG_NDEBUG 0
+//#define LOG_NDEBUG 0
 
 #include <cutils/log.h>
 #include <utils/Log.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
-#include <stdio.h>
-#include <unistd.h>
-
-#include <hardware/audio_effect.h>
-#include <cutils/properties.h>
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+#include <arm_neon.h>
+#define VB_USE_NEON
+#endif
 
 #include "Virtual_Bass_Arithmetic.h"
 
-int VirtualBassInit(void)
+// speaker cutoff, the sub-bass below it is replaced by its harmonics
+#define VB_CROSSOVER_HZ 120.0f
+// harmonics kept up to the 3rd
+#define VB_HARMONIC_LP_HZ 360.0f
+// the 2nd harmonic of a rectified sine is 7.5 dB below the fundamental
+#define VB_HARMONIC_MAKEUP 2.0f
+#define VB_FILTER_Q 0.707f
+// above dynamic_threshold the harmonics rise 1 dB for every 4 dB
+#define VB_COMPRESS_RATIO 4.0f
+
+#define VB_Q28(x) ((int32_t)lrintf((x) * 268435456.0f))
+#define VB_Q30_SCALE (1.0f / 1073741824.0f)
+
+
+static void vb_coef_q(VirtualBassCoefQ_t *q, const AudioBiquadCoef_t *c)
 {
-	ALOGE("%s: test \n", __FUNCTION__);
-	return 0;
+    q->b0 = VB_Q28(c->b0);
+    q->b1 = VB_Q28(c->b1);
+    q->b2 = VB_Q28(c->b2);
+    q->a1 = VB_Q28(c->a1);
+    q->a2 = VB_Q28(c->a2);
 }
 
-int VirtualBassSetParameter(void) {
-	ALOGE("%s: test \n", __FUNCTION__);
-	return 0;
+static inline int32_t vb_sat32(int64_t v)
+{
+    return v > INT32_MAX ? INT32_MAX : (v < INT32_MIN ? INT32_MIN : (int32_t)v);
 }
 
-int VirtualBassProcess(void *date)
+// one sample of channel ch, rounding like vqrshrn_n_s64(acc, 28)
+static inline int32_t vb_biquad_q(const VirtualBassCoefQ_t *c, VirtualBassStateQ_t *s, int ch, int32_t x)
 {
-	ALOGE("%s: test date = %s\n", __FUNCTION__,date);
-	return 0;
+    int64_t acc = (int64_t)c->b0 * x + (int64_t)c->b1 * s->x1[ch] + (int64_t)c->b2 * s->x2[ch]
+            - (int64_t)c->a1 * s->y1[ch] - (int64_t)c->a2 * s->y2[ch];
+    int32_t y = vb_sat32((acc + (1LL << 27)) >> 28);
+
+    s->x2[ch] = s->x1[ch];
+    s->x1[ch] = x;
+    s->y2[ch] = s->y1[ch];
+    s->y1[ch] = y;
+    return y;
 }
 
+int VirtualBassInit(VirtualBassEngine_t *pEngine, uint32_t sampleRate)
+{
+    AudioBiquadCoef_t coef;
+
+    if (pEngine == NULL || sampleRate == 0)
+        return -1;
+
+    pEngine->sample_rate = sampleRate;
+    AudioBiquadInit(&pEngine->hp, 1, 2);
+    AudioBiquadInit(&pEngine->lp, 2, 1);
+    AudioBiquadInit(&pEngine->harmonic, 2, 1);
+
+    AudioBiquadDesign(&coef, AUDIO_BIQUAD_HIGHPASS, sampleRate, VB_CROSSOVER_HZ, VB_FILTER_Q, 0.0f);
+    AudioBiquadSetCoef(&pEngine->hp, 0, &coef);
+    vb_coef_q(&pEngine->hp_q, &coef);
+
+    // Linkwitz-Riley, the harmonics are generated from a clean sub-bass
+    AudioBiquadDesign(&coef, AUDIO_BIQUAD_LOWPASS, sampleRate, VB_CROSSOVER_HZ, VB_FILTER_Q, 0.0f);
+    AudioBiquadSetCoef(&pEngine->lp, 0, &coef);
+    AudioBiquadSetCoef(&pEngine->lp, 1, &coef);
+    vb_coef_q(&pEngine->lp_q[0], &coef);
+    vb_coef_q(&pEngine->lp_q[1], &coef);
+
+    // drops the DC of the rectifier and what is left of the fundamental
+    AudioBiquadDesign(&coef, AUDIO_BIQUAD_HIGHPASS, sampleRate, VB_CROSSOVER_HZ, VB_FILTER_Q, 0.0f);
+    AudioBiquadSetCoef(&pEngine->harmonic, 0, &coef);
+    vb_coef_q(&pEngine->harmonic_q[0], &coef);
+    AudioBiquadDesign(&coef, AUDIO_BIQUAD_LOWPASS, sampleRate, VB_HARMONIC_LP_HZ, VB_FILTER_Q, 0.0f);
+    coef.b0 *= VB_HARMONIC_MAKEUP;
+    coef.b1 *= VB_HARMONIC_MAKEUP;
+    coef.b2 *= VB_HARMONIC_MAKEUP;
+    AudioBiquadSetCoef(&pEngine->harmonic, 1, &coef);
+    vb_coef_q(&pEngine->harmonic_q[1], &coef);
+
+    VirtualBassReset(pEngine);
+    ALOGI("%s: %u Hz, crossover %.0f Hz", __FUNCTION__, sampleRate, VB_CROSSOVER_HZ);
+    return 0;
+}
+
+void VirtualBassReset(VirtualBassEngine_t *pEngine)
+{
+    AudioBiquadReset(&pEngine->hp);
+    AudioBiquadReset(&pEngine->lp);
+    AudioBiquadReset(&pEngine->harmonic);
+    memset(&pEngine->hp_s, 0, sizeof(pEngine->hp_s));
+    memset(pEngine->lp_s, 0, sizeof(pEngine->lp_s));
+    memset(pEngine->harmonic_s, 0, sizeof(pEngine->harmonic_s));
+    pEngine->envelope = 0.0f;
+    pEngine->gain_prev = 0.0f;
+    pEngine->gain_next = 0.0f;
+}
+
+int VirtualBassSetParameter(VirtualBassEngine_t *pEngine, float peak_level, float dynamic_threshold,
+        float noise_threshold, int response_time, int release_time)
+{
+    if (pEngine == NULL)
+        return -1;
+
+    pEngine->peak_level = peak_level;
+    pEngine->dynamic_threshold = dynamic_threshold;
+    pEngine->noise_threshold = noise_threshold;
+    pEngine->response_time = response_time;
+    pEngine->release_time = release_time;
+    return 0;
+}
+
+static float vb_time_coef(const VirtualBassEngine_t *pEngine, int ms, size_t frames)
+{
+    float len = (float)ms * pEngine->sample_rate / 1000.0f;
+
+    if (len <= (float)frames)
+        return 0.0f;
+    return expf(-(float)frames / len);
+}
+
+/* gain of the harmonics at the end of a block from the sub-bass peak.
+ * None under noise_threshold, unity up to dynamic_threshold, compressed
+ * above it, and never taking the harmonics over peak_level. */
+static void vb_update_gain(VirtualBassEngine_t *pEngine, float peak, size_t frames)
+{
+    float coef, level, gain;
+
+    coef = peak > pEngine->envelope ? vb_time_coef(pEngine, pEngine->response_time, frames)
+            : vb_time_coef(pEngine, pEngine->release_time, frames);
+    pEngine->envelope = peak + coef * (pEngine->envelope - peak);
+    level = 20.0f * log10f(pEngine->envelope + 1e-9f);
 
+    pEngine->gain_prev = pEngine->gain_next;
+    if (level < pEngine->noise_threshold) {
+        pEngine->gain_next = 0.0f;
+        return;
+    }
+    gain = 0.0f;
+    if (level > pEngine->dynamic_threshold)
+        gain = (pEngine->dynamic_threshold - level) * (1.0f - 1.0f / VB_COMPRESS_RATIO);
+    if (level + gain > pEngine->peak_level)
+        gain = pEngine->peak_level - level;
+    gain = powf(10.0f, gain / 20.0f);
+    pEngine->gain_next = gain > 1.0f ? 1.0f : gain;
+}
+
+void VirtualBassSilence(VirtualBassEngine_t *pEngine, size_t frames)
+{
+    vb_update_gain(pEngine, 0.0f, frames);
+    pEngine->gain_prev = pEngine->gain_next;
+}
+
+/* Q31, the Q30 product with a Q31 gain is exactly vqdmulhq_s32 */
+static inline int32_t vb_gain_q31(float gain)
+{
+    return gain >= 1.0f ? INT32_MAX : (int32_t)(gain * 2147483648.0f);
+}
+
+static void vb_block_q(VirtualBassEngine_t *pEngine, const int16_t *in, int16_t *out, size_t frames)
+{
+    int32_t *mono = pEngine->mono_q, *hi = pEngine->hi_q;
+    int32_t peak = 0, g0, dg;
+    size_t i = 0;
+
+    // crossover high pass of both channels
+#if defined(VB_USE_NEON)
+    {
+        const VirtualBassCoefQ_t *c = &pEngine->hp_q;
+        VirtualBassStateQ_t *s = &pEngine->hp_s;
+        int32x2_t x1 = vld1_s32(s->x1), x2 = vld1_s32(s->x2);
+        int32x2_t y1 = vld1_s32(s->y1), y2 = vld1_s32(s->y2);
+        for (; i + 2 <= frames; i += 2) {
+            int32x4_t x = vshll_n_s16(vld1_s16(in + i * 2), 15);
+            int32x2_t xa = vget_low_s32(x), xb = vget_high_s32(x);
+            int64x2_t acc = vmull_n_s32(xa, c->b0);
+            acc = vmlal_n_s32(acc, x1, c->b1);
+            acc = vmlal_n_s32(acc, x2, c->b2);
+            acc = vmlsl_n_s32(acc, y1, c->a1);
+            acc = vmlsl_n_s32(acc, y2, c->a2);
+            int32x2_t ya = vqrshrn_n_s64(acc, 28);
+            acc = vmull_n_s32(xb, c->b0);
+            acc = vmlal_n_s32(acc, xa, c->b1);
+            acc = vmlal_n_s32(acc, x1, c->b2);
+            acc = vmlsl_n_s32(acc, ya, c->a1);
+            acc = vmlsl_n_s32(acc, y1, c->a2);
+            int32x2_t yb = vqrshrn_n_s64(acc, 28);
+            vst1q_s32(hi + i * 2, vcombine_s32(ya, yb));
+            x2 = xa;
+            x1 = xb;
+            y2 = ya;
+            y1 = yb;
+        }
+        vst1_s32(s->x1, x1);
+        vst1_s32(s->x2, x2);
+        vst1_s32(s->y1, y1);
+        vst1_s32(s->y2, y2);
+    }
+#endif
+    for (; i < frames; i++) {
+        hi[i * 2] = vb_biquad_q(&pEngine->hp_q, &pEngine->hp_s, 0, (int32_t)in[i * 2] << 15);
+        hi[i * 2 + 1] = vb_biquad_q(&pEngine->hp_q, &pEngine->hp_s, 1, (int32_t)in[i * 2 + 1] << 15);
+    }
+
+    // sub-bass of L+R, rectified
+    for (i = 0; i < frames; i++) {
+        int32_t x = ((int32_t)in[i * 2] + in[i * 2 + 1]) << 14;
+        x = vb_biquad_q(&pEngine->lp_q[0], &pEngine->lp_s[0], 0, x);
+        x = vb_biquad_q(&pEngine->lp_q[1], &pEngine->lp_s[1], 0, x);
+        mono[i] = x;
+    }
+    i = 0;
+#if defined(VB_USE_NEON)
+    {
+        int32x4_t vpeak = vdupq_n_s32(0);
+        for (; i + 4 <= frames; i += 4) {
+            int32x4_t r = vqabsq_s32(vld1q_s32(mono + i));
+            vpeak = vmaxq_s32(vpeak, r);
+            vst1q_s32(mono + i, r);
+        }
+        int32x2_t p2 = vpmax_s32(vget_low_s32(vpeak), vget_high_s32(vpeak));
+        p2 = vpmax_s32(p2, p2);
+        peak = vget_lane_s32(p2, 0);
+    }
+#endif
+    for (; i < frames; i++) {
+        int32_t r = mono[i] == INT32_MIN ? INT32_MAX : abs(mono[i]);
+        peak = r > peak ? r : peak;
+        mono[i] = r;
+    }
+
+    // harmonics of the rectified sub-bass
+    for (i = 0; i < frames; i++) {
+        int32_t x = vb_biquad_q(&pEngine->harmonic_q[0], &pEngine->harmonic_s[0], 0, mono[i]);
+        mono[i] = vb_biquad_q(&pEngine->harmonic_q[1], &pEngine->harmonic_s[1], 0, x);
+    }
+
+    vb_update_gain(pEngine, peak * VB_Q30_SCALE, frames);
+    g0 = vb_gain_q31(pEngine->gain_prev);
+    dg = (vb_gain_q31(pEngine->gain_next) - g0) / (int32_t)frames;
+
+    // recombination, out = hi + gain * harmonics
+    i = 0;
+#if defined(VB_USE_NEON)
+    {
+        const int32_t ramp[4] = {0, 1, 2, 3};
+        int32x4_t vg = vmlaq_n_s32(vdupq_n_s32(g0), vld1q_s32(ramp), dg);
+        int32x4_t vstep = vdupq_n_s32((int32_t)((uint32_t)dg * 4));
+        for (; i + 4 <= frames; i += 4) {
+            int32x4_t h = vqdmulhq_s32(vld1q_s32(mono + i), vg);
+            int32x4x2_t hh = vzipq_s32(h, h);
+            int32x4_t a = vqaddq_s32(vld1q_s32(hi + i * 2), hh.val[0]);
+            int32x4_t b = vqaddq_s32(vld1q_s32(hi + i * 2 + 4), hh.val[1]);
+            vst1q_s16(out + i * 2, vcombine_s16(vqrshrn_n_s32(a, 15), vqrshrn_n_s32(b, 15)));
+            vg = vaddq_s32(vg, vstep);
+        }
+    }
+#endif
+    for (; i < frames; i++) {
+        int32_t g = g0 + (int32_t)i * dg;
+        int32_t h = (int32_t)(((int64_t)mono[i] * g * 2) >> 32);
+        for (int ch = 0; ch < 2; ch++) {
+            int64_t v = ((int64_t)vb_sat32((int64_t)hi[i * 2 + ch] + h) + (1 << 14)) >> 15;
+            out[i * 2 + ch] = v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : (int16_t)v);
+        }
+    }
+}
+
+void VirtualBassProcess(VirtualBassEngine_t *pEngine, const int16_t *in, int16_t *out, size_t frames)
+{
+    size_t n;
+
+    while (frames > 0) {
+        n = frames < VIRTUAL_BASS_BLOCK_FRAMES ? frames : VIRTUAL_BASS_BLOCK_FRAMES;
+        vb_block_q(pEngine, in, out, n);
+        in += n * 2;
+        out += n * 2;
+        frames -= n;
+    }
+}
+
+static void vb_block_float(VirtualBassEngine_t *pEngine, const float *in, float *out, size_t frames)
+{
+    float *mono = pEngine->mono, *hi = pEngine->hi;
+    float peak = 0.0f, g, dg;
+    size_t i;
+
+    AudioBiquadProcess(&pEngine->hp, in, hi, frames);
+    for (i = 0; i < frames; i++)
+        mono[i] = 0.5f * (in[i * 2] + in[i * 2 + 1]);
+    AudioBiquadProcess(&pEngine->lp, mono, mono, frames);
+    for (i = 0; i < frames; i++) {
+        mono[i] = fabsf(mono[i]);
+        peak = mono[i] > peak ? mono[i] : peak;
+    }
+    AudioBiquadProcess(&pEngine->harmonic, mono, mono, frames);
+
+    vb_update_gain(pEngine, peak, frames);
+    g = pEngine->gain_prev;
+    dg = (pEngine->gain_next - pEngine->gain_prev) / frames;
+    for (i = 0; i < frames; i++, g += dg) {
+        out[i * 2] = hi[i * 2] + g * mono[i];
+        out[i * 2 + 1] = hi[i * 2 + 1] + g * mono[i];
+    }
+}
+
+void VirtualBassProcessFloat(VirtualBassEngine_t *pEngine, const float *in, float *out, size_t frames)
+{
+    size_t n;
+
+    while (frames > 0) {
+        n = frames < VIRTUAL_BASS_BLOCK_FRAMES ? frames : VIRTUAL_BASS_BLOCK_FRAMES;
+        vb_block_float(pEngine, in, out, n);
+        in += n * 2;
+        out += n * 2;
+        frames -= n;
+    }
+}
@@ -14,16 +14,84 @@
  * limitations under the License.
  */
 
-#ifndef _AMLAGC_H_
-#define _AMLAGC_H_
+#ifndef _VIRTUAL_BASS_ARITHMETIC_H_
+#define _VIRTUAL_BASS_ARITHMETIC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../Utility/AudioBiquad.h"
 
 #ifdef __cplusplus
 extern "C"  {
 #endif
 
-int VirtualBassInit(void);
-int VirtualBassSetParameter(void);
-int VirtualBassProcess(void *date);
+// frames between two gain updates
+#define VIRTUAL_BASS_BLOCK_FRAMES 64
+
+/* biquad in Q28, y = b0*x + b1*x1 + b2*x2 - a1*y1 - a2*y2 on Q30 samples */
+typedef struct {
+    int32_t b0;
+    int32_t b1;
+    int32_t b2;
+    int32_t a1;
+    int32_t a2;
+} VirtualBassCoefQ_t;
+
+// direct form I, one entry per channel
+typedef struct {
+    int32_t x1[2];
+    int32_t x2[2];
+    int32_t y1[2];
+    int32_t y2[2];
+} VirtualBassStateQ_t;
+
+/* Stereo psychoacoustic bass. The sub-bass of the L+R sum is split off
+ * below the crossover, full wave rectified to generate its harmonics,
+ * band limited and added to both channels, which are high passed at the
+ * crossover so that the speaker does not have to reproduce it. The level
+ * of the harmonics follows the sub-bass envelope. 16 bit buffers run
+ * through a fixed point kernel, float buffers through the float version
+ * of the same filters. */
+typedef struct {
+    uint32_t            sample_rate;
+    // channel high pass, sub-bass low pass x2, harmonic high pass and low pass
+    AudioBiquad_t       hp;
+    AudioBiquad_t       lp;
+    AudioBiquad_t       harmonic;
+    VirtualBassCoefQ_t  hp_q;
+    VirtualBassCoefQ_t  lp_q[2];
+    VirtualBassCoefQ_t  harmonic_q[2];
+    VirtualBassStateQ_t hp_s;
+    VirtualBassStateQ_t lp_s[2];
+    VirtualBassStateQ_t harmonic_s[2];
+    // dynamics, levels in dB, times in ms
+    float               peak_level;
+    float               dynamic_threshold;
+    float               noise_threshold;
+    int                 response_time;
+    int                 release_time;
+    float               envelope;
+    // harmonic gains at the start and the end of the block
+    float               gain_prev;
+    float               gain_next;
+    // scratch of one block
+    float               mono[VIRTUAL_BASS_BLOCK_FRAMES];
+    float               hi[VIRTUAL_BASS_BLOCK_FRAMES * 2];
+    int32_t             mono_q[VIRTUAL_BASS_BLOCK_FRAMES];
+    int32_t             hi_q[VIRTUAL_BASS_BLOCK_FRAMES * 2];
+} VirtualBassEngine_t;
+
+int VirtualBassInit(VirtualBassEngine_t *pEngine, uint32_t sampleRate);
+// filter state cleared, harmonics start from silence
+void VirtualBassReset(VirtualBassEngine_t *pEngine);
+// digitally silent input that is not processed, the envelope releases as if it was
+void VirtualBassSilence(VirtualBassEngine_t *pEngine, size_t frames);
+int VirtualBassSetParameter(VirtualBassEngine_t *pEngine, float peak_level, float dynamic_threshold,
+        float noise_threshold, int response_time, int release_time);
+// interleaved stereo, in may be out
+void VirtualBassProcess(VirtualBassEngine_t *pEngine, const int16_t *in, int16_t *out, size_t frames);
+void VirtualBassProcessFloat(VirtualBassEngine_t *pEngine, const float *in, float *out, size_t frames);
 
 #ifdef __cplusplus
 }
@@ -37,13 +37,28 @@
 #include <unistd.h>
 #include "IniParser.h"
 #include "Virtualx.h"
+#include "ParamSnapshot.h"
+#include "AudioSilence.h"
+#include "AudioBypass.h"
 #include <pthread.h>
 
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+#include <arm_neon.h>
+#define VIRTUALX_USE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define VIRTUALX_USE_SSE2
+#endif
+
 extern "C" {
 
 #define MODEL_SUM_DEFAULT_PATH "/vendor/etc/tvconfig/model/model_sum.ini"
 #define AUDIO_EFFECT_DEFAULT_PATH "/vendor/etc/tvconfig/audio/AMLOGIC_AUDIO_EFFECT_DEFAULT.ini"
 #define DTS_VIRTUALX_FRAME_SIZE 256
+// frames buffered once the FIFO is in use, enough for any frameCount
+#define DTS_VIRTUALX_FIFO_LATENCY (DTS_VIRTUALX_FRAME_SIZE - 1)
+// reverb of the virtualizer and the limiter release of libvx
+#define DTS_VIRTUALX_TAIL_MS 500
 #define FXP32(val, x) (int32_t)(val * ((int64_t)1L << (32 - x)))
 #define FXP16( val, x ) ( int32_t )( val * ( 1L << ( 16 - x ) ) )
 
@@ -433,29 +448,244 @@ typedef struct vxdata_s {
     int            surround_mode;
 } vxdata;
 
+/* snapshot read by Virtualx_process. setParameter only stages the library
+ * settings here, the audio thread calls the library setters between two
+ * blocks so that a parameter set is never applied half way. */
+enum {
+    VX_STAGE_TRUVOLUME,
+    VX_STAGE_VX,
+    VX_STAGE_MBHL,
+    VX_STAGE_NUM,
+};
+
+#define VX_SET_MAX      96
+#define VX_AEQ_BAND_MAX 12
+
+/* latest value passed to one of the int32_t library setters */
+typedef struct vxset_s {
+    int         (*set)(int32_t value);
+    int32_t     value;
+    // vxparam.seq when it was staged
+    uint32_t    seq;
+} vxset;
+
+typedef struct vxparam_s {
+    int32_t     enable;
+    int32_t     ch_num;
+    // (1 << VX_STAGE_xxx) set for each library stage that is enabled
+    uint32_t    stages;
+    // bumped on every staged change, never reused
+    uint32_t    seq;
+    // setters in the order they were first staged, applied when their seq moves
+    int32_t     set_num;
+    vxset       set[VX_SET_MAX];
+    float       lowcrossfreq;
+    float       midcrossfreq;
+    uint32_t    mbhl_design_seq;
+    int32_t     spksize;
+    float       hpratio;
+    float       extbass;
+    uint32_t    tbhd_design_seq;
+    // seteq_band() 0: LR link, 1..4: band frequency, gain, Q, type
+    int32_t     aeq_link;
+    float       aeq_band[4][VX_AEQ_BAND_MAX];
+    uint32_t    aeq_band_seq[5];
+    // EFFECT_CMD_RESET
+    uint32_t    reset_seq;
+} vxparam;
+
 typedef struct vxContext_s {
     const struct effect_interface_s *itfe;
     effect_config_t                 config;
     Virtualx_state_e                state;
     void                            *gVXLibHandler;
     vxdata                          gvxdata;
+    ParamSnapshot_t                 params;
+    // last published snapshot, control thread only
+    vxparam                         next_params;
+    // last applied by the audio thread
+    vxparam                         cur_params;
     Virtualxapi                     gVirtualxapi;
     int32_t                         sTempBuffer[12][256];
     int32_t                         TempBuffer[12][256];
     int32_t                         *ppMappedInCh[12];
     int32_t                         *ppMappedOutCh[12];
-    float                           lowcrossfreq;
-    float                           midcrossfreq;
-    int32_t                         spksize;
-    float                           hpratio;
-    float                           extbass;
+    // stages run on every block, rebuilt by Virtualx_apply_params
+    int (*stage[VX_STAGE_NUM])(int32_t **in, int32_t **out);
+    int32_t                         stage_num;
+    // input planes filled per block, the others are kept zero. 0: no plan yet
+    int32_t                         plan_in_ch;
     int32_t                         ch_num;
+    // block adapter for frame counts that are not a multiple of
+    // DTS_VIRTUALX_FRAME_SIZE, audio thread only except fifo_latency
+    int32_t                         fifo_enable;
+    int32_t                         fifo_latency;
+    int32_t                         fifo_in_ch;
+    uint32_t                        fifo_in_frames;
+    uint32_t                        fifo_out_frames;
+    int16_t                         fifo_in[DTS_VIRTUALX_FRAME_SIZE * 6];
+    int16_t                         fifo_out[DTS_VIRTUALX_FRAME_SIZE * 2 * 2];
+    AudioSilence_t                  silence;
+    AudioAccumulate_t               accumulate;
 } vxContext;
 
 const char *VXStatusstr[] = {"Disable", "Enable"};
 const char *VXDialogClarityModestr[DC_MODE_MUM] = {"OFF", "LOW", "HIGH"};
 const char *VXSurroundModestr[TS_MODE_MUM] = {"ON", "OFF"};
 
+static void Virtualx_publish(vxContext *pContext)
+{
+    pContext->next_params.enable = pContext->gvxdata.enable;
+    ParamSnapshotPublish(&pContext->params, &pContext->next_params);
+}
+
+/* stage a library setter, called by the audio thread on the next block */
+static void Virtualx_set(vxContext *pContext, int (*set)(int32_t), int32_t value)
+{
+    vxparam *next = &pContext->next_params;
+    int i;
+
+    for (i = 0; i < next->set_num; i++) {
+        if (next->set[i].set == set)
+            break;
+    }
+    if (i == VX_SET_MAX) {
+        ALOGE("%s: no room for another setter", __FUNCTION__);
+        return;
+    }
+    if (i == next->set_num)
+        next->set_num++;
+    next->set[i].set = set;
+    next->set[i].value = value;
+    next->set[i].seq = ++next->seq;
+}
+
+/* library setting as last set, staged values are not in the library yet */
+static void Virtualx_get(vxContext *pContext, int (*set)(int32_t), int (*get)(int32_t *), int32_t *value)
+{
+    const vxparam *next = &pContext->next_params;
+
+    for (int i = 0; i < next->set_num; i++) {
+        if (next->set[i].set == set) {
+            *value = next->set[i].value;
+            return;
+        }
+    }
+    (*get)(value);
+}
+
+/* stage seteq_band(band, p), p has one float per AEQ band */
+static void Virtualx_set_eq_band(vxContext *pContext, int band, const float *p)
+{
+    vxparam *next = &pContext->next_params;
+    int num = pContext->gvxdata.aeq_bandnum;
+
+    if (num > VX_AEQ_BAND_MAX)
+        num = VX_AEQ_BAND_MAX;
+    memcpy(next->aeq_band[band - 1], p, num * sizeof(float));
+    next->aeq_band_seq[band] = ++next->seq;
+}
+
+static uint32_t Virtualx_cfg_stages(const vxdata *data)
+{
+    return (data->vxcfg.Truvolume.enable ? 1 << VX_STAGE_TRUVOLUME : 0) |
+           (data->vxcfg.vxlib.enable ? 1 << VX_STAGE_VX : 0) |
+           (data->vxcfg.mbhl.mbhl_enable ? 1 << VX_STAGE_MBHL : 0);
+}
+
+/* enable or disable a library stage, a disabled stage is not called at all */
+static void Virtualx_set_stage(vxContext *pContext, int stage, int32_t value)
+{
+    switch (stage) {
+    case VX_STAGE_TRUVOLUME:
+        Virtualx_set(pContext, pContext->gVirtualxapi.settruvolume_ctren, value);
+        break;
+    case VX_STAGE_VX:
+        Virtualx_set(pContext, pContext->gVirtualxapi.setvxlib1_enable, value);
+        break;
+    case VX_STAGE_MBHL:
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_enable, value);
+        break;
+    default:
+        return;
+    }
+    if (value)
+        pContext->next_params.stages |= 1 << stage;
+    else
+        pContext->next_params.stages &= ~(1 << stage);
+}
+
+static void Virtualx_fifo_reset(vxContext *pContext)
+{
+    pContext->fifo_enable = 0;
+    pContext->fifo_in_frames = 0;
+    pContext->fifo_out_frames = 0;
+    __atomic_store_n(&pContext->fifo_latency, 0, __ATOMIC_RELAXED);
+}
+
+static void Virtualx_build_plan(vxContext *pContext, const vxparam *params)
+{
+    int inCh = params->ch_num == 1 ? 6 : 2;
+    int n = 0;
+
+    if (params->stages & (1 << VX_STAGE_TRUVOLUME))
+        pContext->stage[n++] = pContext->gVirtualxapi.Truvolume_process;
+    // VX_process also downmixes 5.1 to stereo, it stays for 5.1 input and
+    // passes the channels through when the VX stage is disabled
+    if ((params->stages & (1 << VX_STAGE_VX)) || inCh == 6)
+        pContext->stage[n++] = pContext->gVirtualxapi.VX_process;
+    if (params->stages & (1 << VX_STAGE_MBHL))
+        pContext->stage[n++] = pContext->gVirtualxapi.MBHL_process;
+    pContext->stage_num = n;
+
+    // planes the input does not fill only have to be cleared once
+    if (inCh != pContext->plan_in_ch) {
+        for (int i = inCh; i < 12; i++)
+            memset(pContext->ppMappedInCh[i], 0, DTS_VIRTUALX_FRAME_SIZE * sizeof(int32_t));
+        pContext->plan_in_ch = inCh;
+    }
+    ALOGD("%s: stages 0x%x, %d input channels", __FUNCTION__, params->stages, inCh);
+}
+
+static void Virtualx_apply_params(vxContext *pContext, const vxparam *params)
+{
+    vxparam *cur = &pContext->cur_params;
+    Virtualxapi *api = &pContext->gVirtualxapi;
+    int32_t basslvl;
+
+    if (params->reset_seq != cur->reset_seq) {
+        (*api->VX_reset)();
+        Virtualx_fifo_reset(pContext);
+        memset(pContext->sTempBuffer, 0, sizeof(pContext->sTempBuffer));
+        memset(pContext->TempBuffer, 0, sizeof(pContext->TempBuffer));
+    }
+    if (params->ch_num != cur->ch_num)
+        (*api->setvxlib1_inmode)(params->ch_num);
+    for (int i = 0; i < params->set_num; i++) {
+        const vxset *set = &params->set[i];
+        if (i >= cur->set_num || set->seq != cur->set[i].seq)
+            (*set->set)(set->value);
+    }
+    if (params->mbhl_design_seq != cur->mbhl_design_seq)
+        (*api->setmbhl_FilterDesign)(params->lowcrossfreq, params->midcrossfreq);
+    if (params->tbhd_design_seq != cur->tbhd_design_seq) {
+        (*api->gettbhdx_tempgain)(&basslvl);
+        (*api->settbhd_FilterDesign)(params->spksize, ((float)basslvl)/1073741824.0f,
+                params->hpratio, params->extbass);
+    }
+    if (params->aeq_band_seq[0] != cur->aeq_band_seq[0]) {
+        int32_t link = params->aeq_link;
+        (*api->seteq_band)(0, (void *)&link);
+    }
+    for (int i = 1; i < 5; i++) {
+        if (params->aeq_band_seq[i] != cur->aeq_band_seq[i])
+            (*api->seteq_band)(i, (void *)params->aeq_band[i - 1]);
+    }
+    if (params->stages != cur->stages || params->ch_num != cur->ch_num || pContext->plan_in_ch == 0)
+        Virtualx_build_plan(pContext, params);
+    *cur = *params;
+}
+
 int Virtualx_get_model_name(char *model_name, int size)
 {
     int ret = -1;
@@ -1806,11 +2036,16 @@ int Virtualx_init(vxContext *pContext)
 
     //init counter and value
     pContext->ch_num = 0;
-    pContext->lowcrossfreq = 300;
-    pContext->midcrossfreq = 5000;
-    pContext->spksize = 80;
-    pContext->hpratio = 0.5f;
-    pContext->extbass = 0.8f;
+    pContext->next_params.ch_num = 0;
+    pContext->next_params.stages = Virtualx_cfg_stages(data);
+    // VX_init() below loads the library settings from data
+    pContext->next_params.set_num = 0;
+    pContext->next_params.lowcrossfreq = 300;
+    pContext->next_params.midcrossfreq = 5000;
+    pContext->next_params.spksize = 80;
+    pContext->next_params.hpratio = 0.5f;
+    pContext->next_params.extbass = 0.8f;
+    Virtualx_publish(pContext);
     data->vxlib_enable = data->vxcfg.vxlib.enable;
     data->input_mode = data->vxcfg.vxlib.input_mode;
     data->output_mode = data->vxcfg.vxlib.output_mode;
@@ -1897,14 +2132,9 @@ int Virtualx_init(vxContext *pContext)
 
 int Virtualx_reset(vxContext *pContext)
 {
-    if (pContext->gVXLibHandler)
-        (*pContext->gVirtualxapi.VX_reset)();
-    memset(pContext->sTempBuffer,0,sizeof(int32_t) * 12 * 256);
-    memset(pContext->TempBuffer,0,sizeof(int32_t) * 12 * 256);
-    for (int i = 0; i < 12; i++) {
-        memset((void*)pContext->ppMappedInCh[i],0,256 * sizeof(int32_t));
-        memset((void*)pContext->ppMappedOutCh[i],0,256 * sizeof(int32_t));
-    }
+    // the library and the FIFO belong to the audio thread
+    pContext->next_params.reset_seq = ++pContext->next_params.seq;
+    Virtualx_publish(pContext);
     return 0;
 }
 
@@ -1936,9 +2166,9 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
     int32_t param = *(int32_t *)pParam;
     int32_t value;
     float scale;
-    int32_t basslvl;
     float * p;
     vxdata *data = &pContext->gvxdata;
+    vxparam *next = &pContext->next_params;
     switch (param) {
     case VIRTUALX_PARAM_ENABLE:
         if (!pContext->gVXLibHandler) {
@@ -1964,8 +2194,8 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         data->vxdialogclarity_enable = data->DC_usr_cfg[value].vxdialogclarity.enable;
         data->vxdialogclarity_level = FXP32(data->DC_usr_cfg[value].vxdialogclarity.level,2);
         if (data->enable) {
-            (*pContext->gVirtualxapi.settsx_dcenable)(data->vxdialogclarity_enable);
-            (*pContext->gVirtualxapi.settsx_dccontrol)(data->vxdialogclarity_level);
+            Virtualx_set(pContext, pContext->gVirtualxapi.settsx_dcenable, data->vxdialogclarity_enable);
+            Virtualx_set(pContext, pContext->gVirtualxapi.settsx_dccontrol, data->vxdialogclarity_level);
             ALOGD("%s: Set Dialog Clarity Mode %s", __FUNCTION__, VXDialogClarityModestr[value]);
         } else {
             ALOGD("%s: Set Dialog Clarity Mode failed", __FUNCTION__);
@@ -2001,26 +2231,26 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         data->hpfo = data->TS_usr_cfg[value].tbhdx.hpfo;
         data->highpass_enble = data->TS_usr_cfg[value].tbhdx.highpass_enble;
         if (data->enable) {
-            (*pContext->gVirtualxapi.settsx_enable)(data->vxtrusurround_enable);
-            (*pContext->gVirtualxapi.settsx_pssvmtrxenable)(data->upmixer_enable);
-            (*pContext->gVirtualxapi.settsx_horizontctl)(data->horizontaleffect_control);
-            (*pContext->gVirtualxapi.settsx_frntctrl)(data->frontwidening_control);
-            (*pContext->gVirtualxapi.settsx_surroundctrl)(data->surroundwidening_control);
-            (*pContext->gVirtualxapi.settsx_lprgain)(data->phantomcenter_mixlevel);
-            (*pContext->gVirtualxapi.settsx_heightmixcoeff)(data->heightmix_coeff);
-            (*pContext->gVirtualxapi.settsx_centergain)(data->center_gain);
-            (*pContext->gVirtualxapi.settsx_heightdiscards)(data->height_discard);
-            (*pContext->gVirtualxapi.settsx_discard)(data->discard);
-            (*pContext->gVirtualxapi.settsx_hghtupmixenable)(data->heightupmix_enable);
-            (*pContext->gVirtualxapi.settsx_defenable)(data->vxdefinition_enable);
-            (*pContext->gVirtualxapi.settsx_defcontrol)(data->vxdefinition_level);
-            (*pContext->gVirtualxapi.settbhdx_enable)(data->tbhdx_enable);
-            (*pContext->gVirtualxapi.settbhdx_monomode)(data->monomode_enable);
-            (*pContext->gVirtualxapi.settbhdx_spksize)(data->speaker_size);
-            (*pContext->gVirtualxapi.settbhdx_tempgain)(data->tmporal_gain);
-            (*pContext->gVirtualxapi.settbhdx_maxgain)(data->max_gain);
-            (*pContext->gVirtualxapi.settbhdx_hporder)(data->hpfo);
-            (*pContext->gVirtualxapi.settbhdx_hpenable)(data->highpass_enble);
+            Virtualx_set(pContext, pContext->gVirtualxapi.settsx_enable, data->vxtrusurround_enable);
+            Virtualx_set(pContext, pContext->gVirtualxapi.settsx_pssvmtrxenable, data->upmixer_enable);
+            Virtualx_set(pContext, pContext->gVirtualxapi.settsx_horizontctl, data->horizontaleffect_control);
+            Virtualx_set(pContext, pContext->gVirtualxapi.settsx_frntctrl, data->frontwidening_control);
+            Virtualx_set(pContext, pContext->gVirtualxapi.settsx_surroundctrl, data->surroundwidening_control);
+            Virtualx_set(pContext, pContext->gVirtualxapi.settsx_lprgain, data->phantomcenter_mixlevel);
+            Virtualx_set(pContext, pContext->gVirtualxapi.settsx_heightmixcoeff, data->heightmix_coeff);
+            Virtualx_set(pContext, pContext->gVirtualxapi.settsx_centergain, data->center_gain);
+            Virtualx_set(pContext, pContext->gVirtualxapi.settsx_heightdiscards, data->height_discard);
+            Virtualx_set(pContext, pContext->gVirtualxapi.settsx_discard, data->discard);
+            Virtualx_set(pContext, pContext->gVirtualxapi.settsx_hghtupmixenable, data->heightupmix_enable);
+            Virtualx_set(pContext, pContext->gVirtualxapi.settsx_defenable, data->vxdefinition_enable);
+            Virtualx_set(pContext, pContext->gVirtualxapi.settsx_defcontrol, data->vxdefinition_level);
+            Virtualx_set(pContext, pContext->gVirtualxapi.settbhdx_enable, data->tbhdx_enable);
+            Virtualx_set(pContext, pContext->gVirtualxapi.settbhdx_monomode, data->monomode_enable);
+            Virtualx_set(pContext, pContext->gVirtualxapi.settbhdx_spksize, data->speaker_size);
+            Virtualx_set(pContext, pContext->gVirtualxapi.settbhdx_tempgain, data->tmporal_gain);
+            Virtualx_set(pContext, pContext->gVirtualxapi.settbhdx_maxgain, data->max_gain);
+            Virtualx_set(pContext, pContext->gVirtualxapi.settbhdx_hporder, data->hpfo);
+            Virtualx_set(pContext, pContext->gVirtualxapi.settbhdx_hpenable, data->highpass_enble);
              ALOGD("%s: Set Surround Mode %s", __FUNCTION__, VXSurroundModestr[value]);
         } else {
             ALOGD("%s: Set Surround Mode failed", __FUNCTION__);
@@ -2032,7 +2262,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.setmbhl_enable)(value);
+        Virtualx_set_stage(pContext, VX_STAGE_MBHL, value);
         ALOGD("%s set mbhl enable is %d", __FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_BYPASS_GAIN_I32:
@@ -2041,7 +2271,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,2);
-        (*pContext->gVirtualxapi.setmbhl_bypassgain)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_bypassgain, value);
         ALOGD("%s set mbhl baypss gain is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_REFERENCE_LEVEL_I32:
@@ -2050,7 +2280,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,2);
-        (*pContext->gVirtualxapi.setmbhl_reflevel)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_reflevel, value);
         ALOGD("%s set mbhl reflevel is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_VOLUME_I32:
@@ -2059,7 +2289,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,2);
-        (*pContext->gVirtualxapi.setmbhl_volume)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_volume, value);
         ALOGD("%s set mbhl volume is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_VOLUME_STEP_I32:
@@ -2067,7 +2297,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.setmbhl_volumestep)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_volumestep, value);
         ALOGD("%s set mbhl volumestep is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_BALANCE_STEP_I32:
@@ -2075,7 +2305,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.setmbhl_balancestep)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_balancestep, value);
         ALOGD("%s set mbhl balancestep is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_OUTPUT_GAIN_I32:
@@ -2084,7 +2314,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,2);
-        (*pContext->gVirtualxapi.setmbhl_outputgain)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_outputgain, value);
         ALOGD("%s set mbhl outputgain is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_MODE_I32:
@@ -2092,7 +2322,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.setmbhl_mode)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_mode, value);
         ALOGD("%s set mbhl mode is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_PROCESS_DISCARD_I32:
@@ -2100,7 +2330,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.setmbhl_processdiscard)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_processdiscard, value);
         ALOGD("%s set mbhl process discard is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_CROSS_LOW_I32:
@@ -2108,7 +2338,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.setmbhl_lowcross)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_lowcross, value);
         ALOGD("%s set mbhl lowcross is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_CROSS_MID_I32:
@@ -2116,7 +2346,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.setmbhl_crossmid)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_crossmid, value);
         ALOGD("%s set mbhl crossmid is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_COMP_ATTACK_I32:
@@ -2124,7 +2354,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.setmbhl_compattrack)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_compattrack, value);
         ALOGD("%s set mbhl compattrack is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_COMP_LOW_RELEASE_I32:
@@ -2132,7 +2362,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.setmbhl_lowrelease)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_lowrelease, value);
         ALOGD("%s set mbhl lowrelease is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_COMP_LOW_RATIO_I32:
@@ -2141,7 +2371,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,6);
-        (*pContext->gVirtualxapi.setmbhl_complowratio)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_complowratio, value);
         ALOGD("%s set mbhl complowratio is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_COMP_LOW_THRESH_I32:
@@ -2150,7 +2380,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,5);
-        (*pContext->gVirtualxapi.setmbhl_complowthresh)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_complowthresh, value);
         ALOGD("%s set mbhl complowthresh is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_COMP_LOW_MAKEUP_I32:
@@ -2159,7 +2389,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,5);
-        (*pContext->gVirtualxapi.setmbhl_lowmakeup)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_lowmakeup, value);
         ALOGD("%s set mbhl lowmakeup is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_COMP_MID_RELEASE_I32:
@@ -2167,7 +2397,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.setmbhl_compmidrelease)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_compmidrelease, value);
         ALOGD("%s set mbhl compmidrelease is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_COMP_MID_RATIO_I32:
@@ -2176,7 +2406,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,6);
-        (*pContext->gVirtualxapi.setmbhl_midratio)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_midratio, value);
         ALOGD("%s set mbhl midratio is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_COMP_MID_THRESH_I32:
@@ -2185,7 +2415,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,5);
-        (*pContext->gVirtualxapi.setmbhl_compmidthresh)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_compmidthresh, value);
         ALOGD("%s set mbhl compmidthresh is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_COMP_MID_MAKEUP_I32:
@@ -2194,7 +2424,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,5);
-        (*pContext->gVirtualxapi.setmbhl_compmidmakeup)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_compmidmakeup, value);
         ALOGD("%s set mbhl compmidmakeup is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_COMP_HIGH_RELEASE_I32:
@@ -2202,7 +2432,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.setmbhl_comphighrelease)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_comphighrelease, value);
         ALOGD("%s set mbhl comphighrelease is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_COMP_HIGH_RATIO_I32:
@@ -2211,7 +2441,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,6);
-        (*pContext->gVirtualxapi.setmbhl_comphighratio)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_comphighratio, value);
         ALOGD("%s set mbhl comphighratio is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_COMP_HIGH_THRESH_I32:
@@ -2220,7 +2450,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,5);
-        (*pContext->gVirtualxapi.setmbhl_comphighthresh)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_comphighthresh, value);
         ALOGD("%s set mbhl comphighthresh is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_COMP_HIGH_MAKEUP_I32:
@@ -2229,7 +2459,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,5);
-        (*pContext->gVirtualxapi.setmbhl_comphighmakeup)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_comphighmakeup, value);
         ALOGD("%s set mbhl comphighmakeup is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_BOOST_I32:
@@ -2238,7 +2468,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,11);
-        (*pContext->gVirtualxapi.setmbhl_boost)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_boost, value);
         ALOGD("%s set mbhl boost is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_THRESHOLD_I32:
@@ -2247,7 +2477,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,2);
-        (*pContext->gVirtualxapi.setmbhl_threshold)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_threshold, value);
         ALOGD("%s set mbhl threshold is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_SLOW_OFFSET_I32:
@@ -2256,7 +2486,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,3);
-        (*pContext->gVirtualxapi.setmbhl_slowoffset)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_slowoffset, value);
         ALOGD("%s set mbhl slowoffset %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_FAST_ATTACK_I32:
@@ -2265,7 +2495,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,5);
-        (*pContext->gVirtualxapi.setmbhl_fastattack)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_fastattack, value);
         ALOGD("%s set mbhl fastattackt %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_FAST_RELEASE_I32:
@@ -2273,7 +2503,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.setmbhl_fastrelease)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_fastrelease, value);
         ALOGD("%s set mbhl fastrelease %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_SLOW_ATTACK_I32:
@@ -2281,7 +2511,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.setmbhl_slowattrack)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_slowattrack, value);
         ALOGD("%s set mbhl slowattrack %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_SLOW_RELEASE_I32:
@@ -2289,7 +2519,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.setmbhl_slowrelease)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_slowrelease, value);
         ALOGD("%s set mbhl slowrelease %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_DELAY_I32:
@@ -2297,7 +2527,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.setmbhl_delay)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_delay, value);
         ALOGD("%s set mbhl delay %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_ENVELOPE_FREQUENCY_I32:
@@ -2305,7 +2535,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.setmbhl_envelopefre)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setmbhl_envelopefre, value);
         ALOGD("%s set mbhl envelopefre %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_TBHDX_ENABLE_I32:
@@ -2313,7 +2543,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.settbhdx_enable)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settbhdx_enable, value);
         ALOGD("%s set tbhdx enable %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_TBHDX_MONO_MODE_I32:
@@ -2321,7 +2551,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.settbhdx_monomode)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settbhdx_monomode, value);
         ALOGD("%s set tbhdx monomode %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_TBHDX_MAXGAIN_I32:
@@ -2330,7 +2560,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,2);
-        (*pContext->gVirtualxapi.settbhdx_maxgain)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settbhdx_maxgain, value);
         ALOGD("%s set tbhdx maxgain %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_TBHDX_SPKSIZE_I32:
@@ -2338,7 +2568,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.settbhdx_spksize)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settbhdx_spksize, value);
         ALOGD("%s set tbhdx spksize %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_TBHDX_HP_ENABLE_I32:
@@ -2346,7 +2576,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.settbhdx_hpenable)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settbhdx_hpenable, value);
         ALOGD("%s set tbhdx hpenable %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_TBHDX_TEMP_GAIN_I32:
@@ -2355,7 +2585,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,2);
-        (*pContext->gVirtualxapi.settbhdx_tempgain)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settbhdx_tempgain, value);
         ALOGD("%s set tbhdx tempgain %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_TBHDX_PROCESS_DISCARD_I32:
@@ -2363,7 +2593,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.settbhdx_processdiscard)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settbhdx_processdiscard, value);
         ALOGD("%s set tbhdx process discard %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_TBHDX_HPORDER_I32:
@@ -2371,7 +2601,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.settbhdx_hporder)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settbhdx_hporder, value);
         ALOGD("%s set tbhdx hporder %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_VX_ENABLE_I32:
@@ -2379,7 +2609,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.setvxlib1_enable)(value);
+        Virtualx_set_stage(pContext, VX_STAGE_VX, value);
         ALOGD("%s set vxlib1 enable %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_VX_INPUT_MODE_I32:
@@ -2390,7 +2620,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         if (value > 1)
             value = 1;
         pContext->ch_num = value; // here to set input ch num
-        (*pContext->gVirtualxapi.setvxlib1_inmode)(value);
+        pContext->next_params.ch_num = value; // inmode follows on the audio thread
         ALOGD("%s set vxlib1 inmode %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_VX_OUTPUT_MODE_I32:
@@ -2398,7 +2628,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.setvxlib1_outmode)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setvxlib1_outmode, value);
         ALOGD("%s set vxlib1 outmode %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_VX_HEADROOM_GAIN_I32:
@@ -2407,7 +2637,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,2);
-        (pContext->gVirtualxapi.setvxlib1_heardroomgain)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setvxlib1_heardroomgain, value);
         ALOGD("%s set vxlib1 heardroomgain %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_VX_PROC_OUTPUT_GAIN_I32:
@@ -2416,7 +2646,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,4);
-        (*pContext->gVirtualxapi.setvxlib1_procoutgain)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setvxlib1_procoutgain, value);
         ALOGD("%s set vxlib1 procoutgain %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_TSX_ENABLE_I32:
@@ -2424,7 +2654,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.settsx_enable)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_enable, value);
         ALOGD("%s set tsx enable %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_TSX_PASSIVEMATRIXUPMIX_ENABLE_I32:
@@ -2432,7 +2662,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.settsx_pssvmtrxenable)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_pssvmtrxenable, value);
         ALOGD("%s set tsx pssvmtrxenable %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_TSX_HEIGHT_UPMIX_ENABLE_I32:
@@ -2440,7 +2670,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.settsx_hghtupmixenable)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_hghtupmixenable, value);
         ALOGD("%s set tsx hghtupmixenable %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_TSX_LPR_GAIN_I32:
@@ -2449,7 +2679,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,3);
-        (*pContext->gVirtualxapi.settsx_lprgain)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_lprgain, value);
         ALOGD("%s set tsx lprgain %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_TSX_CENTER_GAIN_I32:
@@ -2458,7 +2688,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,3);
-        (pContext->gVirtualxapi.settsx_centergain)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_centergain, value);
         ALOGD("%s set tsx centergain %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_TSX_HORIZ_VIR_EFF_CTRL_I32:
@@ -2466,7 +2696,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.settsx_horizontctl)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_horizontctl, value);
         ALOGD("%s set tsx horizontctl %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_TSX_HEIGHTMIX_COEFF_I32:
@@ -2475,7 +2705,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,3);
-        (*pContext->gVirtualxapi.settsx_heightmixcoeff)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_heightmixcoeff, value);
         ALOGD("%s set tsx heightmixcoeff %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_TSX_PROCESS_DISCARD_I32:
@@ -2483,7 +2713,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.settsx_discard)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_discard, value);
         ALOGD("%s set tsx discard %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_TSX_HEIGHT_DISCARD_I32:
@@ -2491,7 +2721,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.settsx_heightdiscards)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_heightdiscards, value);
         ALOGD("%s set tsx heightdiscards %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_TSX_FRNT_CTRL_I32:
@@ -2500,7 +2730,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,3);
-        (*pContext->gVirtualxapi.settsx_frntctrl)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_frntctrl, value);
         ALOGD("%s set tsx frntctrl %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_TSX_SRND_CTRL_I32:
@@ -2509,7 +2739,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,3);
-        (*pContext->gVirtualxapi.settsx_surroundctrl)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_surroundctrl, value);
         ALOGD("%s set tsx surroundctrl %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_VX_DC_ENABLE_I32:
@@ -2517,7 +2747,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.settsx_dcenable)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_dcenable, value);
         ALOGD("%s set tsx dcenable %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_VX_DC_CONTROL_I32:
@@ -2526,7 +2756,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,2);
-        (*pContext->gVirtualxapi.settsx_dccontrol)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_dccontrol, value);
         ALOGD("%s set tsx dccontrol %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_VX_DEF_ENABLE_I32:
@@ -2534,7 +2764,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.settsx_defenable)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_defenable, value);
         ALOGD("%s set tsx defenable %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_VX_DEF_CONTROL_I32:
@@ -2543,7 +2773,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         }
         scale = *(float *)pValue;
         value = FXP32(scale,2);
-        (*pContext->gVirtualxapi.settsx_defcontrol)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_defcontrol, value);
         ALOGD("%s set tsx defcontrol %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_LOUDNESS_CONTROL_ENABLE_I32:
@@ -2551,7 +2781,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.settruvolume_ctren)(value);
+        Virtualx_set_stage(pContext, VX_STAGE_TRUVOLUME, value);
         ALOGD("%s set truvolume ctren %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_LOUDNESS_CONTROL_TARGET_LOUDNESS_I32:
@@ -2559,7 +2789,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.settruvolume_ctrtarget)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settruvolume_ctrtarget, value);
         ALOGD("%s set truvolume ctrtarget %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_LOUDNESS_CONTROL_PRESET_I32:
@@ -2567,7 +2797,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.settruvolume_ctrpreset)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settruvolume_ctrpreset, value);
         ALOGD("%s set truvolume ctrpreset %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_LOUDNESS_CONTROL_IO_MODE_I32:
@@ -2575,58 +2805,58 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.setlc_inmode)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setlc_inmode, value);
         ALOGD("%s set lc inmode %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_APP_FRT_LOWCROSS_F32:
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        pContext->lowcrossfreq = *(float*)pValue;
-        (*pContext->gVirtualxapi.setmbhl_FilterDesign)(pContext->lowcrossfreq,pContext->midcrossfreq);
-        ALOGD("%s set mbhl filter design low freq %f and mid freq %f",__FUNCTION__,pContext->lowcrossfreq,pContext->midcrossfreq);
+        next->lowcrossfreq = *(float*)pValue;
+        next->mbhl_design_seq = ++next->seq;
+        ALOGD("%s set mbhl filter design low freq %f and mid freq %f",__FUNCTION__,next->lowcrossfreq,next->midcrossfreq);
         break;
     case DTS_PARAM_MBHL_APP_FRT_MIDCROSS_F32:
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        pContext->midcrossfreq = *(float*)pValue;
-        (*pContext->gVirtualxapi.setmbhl_FilterDesign)(pContext->lowcrossfreq,pContext->midcrossfreq);
-        ALOGD("%s set mbhl filter design low freq %f and mid freq %f",__FUNCTION__,pContext->lowcrossfreq,pContext->midcrossfreq);
+        next->midcrossfreq = *(float*)pValue;
+        next->mbhl_design_seq = ++next->seq;
+        ALOGD("%s set mbhl filter design low freq %f and mid freq %f",__FUNCTION__,next->lowcrossfreq,next->midcrossfreq);
         break;
     case DTS_PARAM_TBHDX_APP_SPKSIZE_I32:
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        pContext->spksize = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.gettbhdx_tempgain)(&basslvl);
-        (*pContext->gVirtualxapi.settbhd_FilterDesign)(pContext->spksize,((float)basslvl)/1073741824.0f,pContext->hpratio,pContext->extbass);
-        ALOGD("%s set tbhd filter design spksize %d  hpratio %f extbass %f",__FUNCTION__,pContext->spksize,pContext->hpratio,pContext->extbass);
+        next->spksize = *(int32_t *)pValue;
+        // the bass level is read back from the library when it is applied
+        next->tbhd_design_seq = ++next->seq;
+        ALOGD("%s set tbhd filter design spksize %d  hpratio %f extbass %f",__FUNCTION__,next->spksize,next->hpratio,next->extbass);
         break;
     case DTS_PARAM_TBHDX_APP_HPRATIO_F32:
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        pContext->hpratio = *(float *)pValue;
-        (*pContext->gVirtualxapi.gettbhdx_tempgain)(&basslvl);
-        (*pContext->gVirtualxapi.settbhd_FilterDesign)(pContext->spksize,((float)basslvl)/1073741824.0f,pContext->hpratio,pContext->extbass);
-        ALOGD("%s set tbhd filter design spksize %d  hpratio %f extbass %f",__FUNCTION__,pContext->spksize,pContext->hpratio,pContext->extbass);
+        next->hpratio = *(float *)pValue;
+        // the bass level is read back from the library when it is applied
+        next->tbhd_design_seq = ++next->seq;
+        ALOGD("%s set tbhd filter design spksize %d  hpratio %f extbass %f",__FUNCTION__,next->spksize,next->hpratio,next->extbass);
         break;
     case DTS_PARAM_TBHDX_APP_EXTBASS_F32:
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        pContext->extbass = *(float *)pValue;
-        (*pContext->gVirtualxapi.gettbhdx_tempgain)(&basslvl);
-        (*pContext->gVirtualxapi.settbhd_FilterDesign)(pContext->spksize,((float)basslvl)/1073741824.0f,pContext->hpratio,pContext->extbass);
-        ALOGD("%s set tbhd filter design spksize %d  hpratio %f extbass %f",__FUNCTION__,pContext->spksize,pContext->hpratio,pContext->extbass);
+        next->extbass = *(float *)pValue;
+        // the bass level is read back from the library when it is applied
+        next->tbhd_design_seq = ++next->seq;
+        ALOGD("%s set tbhd filter design spksize %d  hpratio %f extbass %f",__FUNCTION__,next->spksize,next->hpratio,next->extbass);
         break;
     case DTS_PARAM_AEQ_ENABLE_I32:
         if (!pContext->gVXLibHandler) {
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.seteq_enable)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.seteq_enable, value);
         ALOGD("%s set eq enable %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_AEQ_DISCARD_I32:
@@ -2634,7 +2864,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.seteq_discard)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.seteq_discard, value);
         ALOGD("%s set eq discard %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_AEQ_INPUT_GAIN_I16:
@@ -2645,7 +2875,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         value = FXP16(scale,1);
         if (value > 32767)
             value = 32767;
-        (*pContext->gVirtualxapi.seteq_inputG)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.seteq_inputG, value);
         ALOGD("%s set eq input gain %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_AEQ_OUTPUT_GAIN_I16:
@@ -2656,7 +2886,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         value = FXP16(scale,1);
         if (value > 32767)
             value = 32767;
-        (*pContext->gVirtualxapi.seteq_outputG)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.seteq_outputG, value);
         ALOGD("%s set eq output gain %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_AEQ_BYPASS_GAIN_I16:
@@ -2667,7 +2897,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         value = FXP16(scale,1);
         if (value > 32767)
             value = 32767;
-        (*pContext->gVirtualxapi.seteq_bypassG)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.seteq_bypassG, value);
         ALOGD("%s set eq bypass gain %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_AEQ_LR_LINK_I32:
@@ -2675,7 +2905,8 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         value = *(int32_t*)pValue;
-        (*pContext->gVirtualxapi.seteq_band)(0,(void*)&value);
+        next->aeq_link = value;
+        next->aeq_band_seq[0] = ++next->seq;
         ALOGD("%s set eq link flag is %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_AEQ_BAND_Fre:
@@ -2683,28 +2914,28 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         p = (float *)pValue;
-        (*pContext->gVirtualxapi.seteq_band)(1,(void*)p);
+        Virtualx_set_eq_band(pContext, 1, p);
         break;
     case DTS_PARAM_AEQ_BAND_Gain:
         if (!pContext->gVXLibHandler) {
             return 0;
         }
         p = (float *)pValue;
-        (*pContext->gVirtualxapi.seteq_band)(2,(void*)p);
+        Virtualx_set_eq_band(pContext, 2, p);
         break;
     case DTS_PARAM_AEQ_BAND_Q:
         if (!pContext->gVXLibHandler) {
             return 0;
         }
         p = (float *)pValue;
-        (*pContext->gVirtualxapi.seteq_band)(3,(void*)p);
+        Virtualx_set_eq_band(pContext, 3, p);
         break;
     case DTS_PARAM_AEQ_BAND_type:
         if (!pContext->gVXLibHandler) {
             return 0;
         }
         p = (float *)pValue;
-        (*pContext->gVirtualxapi.seteq_band)(4,(void*)p);
+        Virtualx_set_eq_band(pContext, 4, p);
         break;
     case DTS_PARAM_CHANNEL_NUM:
         if (!pContext->gVXLibHandler) {
@@ -2721,8 +2952,8 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             return 0;
         }
         p = (float *)pValue;
-        (*pContext->gVirtualxapi.setvxlib1_enable)((int32_t)*p++);
-        (*pContext->gVirtualxapi.settsx_dcenable)((int32_t)*p);
+        Virtualx_set_stage(pContext, VX_STAGE_VX, (int32_t)*p++);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_dcenable, (int32_t)*p);
         break;
     case AUDIO_DTS_PARAM_TYPE_TRU_SURROUND:
         if (!pContext->gVXLibHandler) {
@@ -2735,7 +2966,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             value = 1;
         else if (value < 0)
             value = 0;
-        (*pContext->gVirtualxapi.setvxlib1_enable)(value);
+        Virtualx_set_stage(pContext, VX_STAGE_VX, value);
         scale = *p++;
         if (scale < 0.125)
             scale = 0.125;
@@ -2743,7 +2974,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             scale = 1.0;
         ALOGV("scale2 is %f",scale);
         value = FXP32(scale,2);
-        (pContext->gVirtualxapi.setvxlib1_heardroomgain)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setvxlib1_heardroomgain, value);
         scale = *p++;
         if (scale < 0.5)
             scale = 0.5;
@@ -2758,21 +2989,21 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         else if (value > 1)
             value = 1;
         ALOGV("value4 is %d",value);
-        (*pContext->gVirtualxapi.settsx_enable)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_enable, value);
         value = (int32_t)*p++;
         if (value < 0)
             value = 0;
         else if (value > 1)
             value = 1;
         ALOGV("value5 is %d",value);
-        (*pContext->gVirtualxapi.settsx_pssvmtrxenable)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_pssvmtrxenable, value);
         value = (int32_t)*p++;
         if (value < 0)
             value = 0;
         else if (value > 1)
             value = 1;
         ALOGV("value6 is %d",value);
-        (*pContext->gVirtualxapi.settsx_horizontctl)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_horizontctl, value);
         scale = *p++;
         if (scale < 0.5)
             scale = 0.5;
@@ -2780,7 +3011,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             scale = 2.0;
         ALOGV("scale7 is %f",scale);
         value = FXP32(scale,3);
-        (*pContext->gVirtualxapi.settsx_frntctrl)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_frntctrl, value);
         scale = *p;
         if (scale < 0.5)
             scale = 0.5;
@@ -2788,7 +3019,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             scale = 2.0;
         ALOGV("scale8 is %f",scale);
         value = FXP32(scale,3);
-        (*pContext->gVirtualxapi.settsx_surroundctrl)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_surroundctrl, value);
         break;
     case AUDIO_DTS_PARAM_TYPE_CC3D:
         if (!pContext->gVXLibHandler) {
@@ -2801,7 +3032,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         else if (value > 1)
             value = 1;
         ALOGV("value1 is %d",value);
-        (*pContext->gVirtualxapi.setvxlib1_enable)(value);
+        Virtualx_set_stage(pContext, VX_STAGE_VX, value);
         scale = *p++;
         if (scale < 0.125)
             scale = 0.125;
@@ -2809,7 +3040,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             scale = 1.0;
         ALOGV("scale2 is %f",scale);
         value = FXP32(scale,2);
-        (pContext->gVirtualxapi.setvxlib1_heardroomgain)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setvxlib1_heardroomgain, value);
         scale = *p++;
         if (scale < 0.5)
             scale = 0.5;
@@ -2831,21 +3062,21 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         else if (value > 1)
             value = 1;
         ALOGV("value5 is %d",value);
-        (*pContext->gVirtualxapi.settsx_pssvmtrxenable)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_pssvmtrxenable, value);
         value = (int32_t)*p++;
         if (value < 0)
             value = 0;
         else if (value > 1)
             value = 1;
         ALOGV("value6 is %d",value);
-        (*pContext->gVirtualxapi.settsx_hghtupmixenable)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_hghtupmixenable, value);
         value = (int32_t)*p++;
         if (value < 0)
             value = 0;
         else if (value > 1)
             value = 1;
         ALOGV("value7 is %d",value);
-        (*pContext->gVirtualxapi.settsx_heightdiscards)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_heightdiscards, value);
         scale = *p;
         if (scale < 0.5)
             scale = 0.5;
@@ -2853,7 +3084,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             scale = 2.0;
         ALOGV("scale8 is %f",scale);
          value = FXP32(scale,3);
-        (*pContext->gVirtualxapi.settsx_heightmixcoeff)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_heightmixcoeff, value);
         break;
     case AUDIO_DTS_PARAM_TYPE_TRU_BASS:
         if (!pContext->gVXLibHandler) {
@@ -2866,7 +3097,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         else if (value > 1)
             value = 1;
         ALOGV("value1 is %d",value);
-        (*pContext->gVirtualxapi.setvxlib1_enable)(value);
+        Virtualx_set_stage(pContext, VX_STAGE_VX, value);
         scale = *p++;
         if (scale < 0.125)
             scale = 0.125;
@@ -2874,7 +3105,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             scale = 1.0;
         ALOGV("scale2 is %f",scale);
         value = FXP32(scale,2);
-        (pContext->gVirtualxapi.setvxlib1_heardroomgain)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setvxlib1_heardroomgain, value);
         scale = *p++;
         if (scale < 0.5)
             scale = 0.5;
@@ -2889,21 +3120,21 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         else if (value > 1)
             value = 1;
         ALOGV("value4 is %d",value);
-        (*pContext->gVirtualxapi.settbhdx_enable)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settbhdx_enable, value);
         value = (int32_t)*p++;
         if (value < 0)
             value = 0;
         else if (value > 1)
             value = 1;
         ALOGV("value5 is %d",value);
-        (*pContext->gVirtualxapi.settbhdx_monomode)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settbhdx_monomode, value);
         value = (int32_t)*p++;
         if (value < 0)
             value = 0;
         else if (value > 12)
             value = 12;
         ALOGV("value6 is %d",value);
-        (*pContext->gVirtualxapi.settbhdx_spksize)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settbhdx_spksize, value);
         scale = *p++;
         if (scale < 0.0)
             scale = 0.0;
@@ -2911,7 +3142,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             scale = 1.0;
         ALOGV("scale7 is %f",scale);
         value = FXP32(scale,2);
-        (*pContext->gVirtualxapi.settbhdx_tempgain)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settbhdx_tempgain, value);
         scale = *p++;
         if (scale < 0.0)
             scale = 0.0;
@@ -2919,21 +3150,21 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             scale = 1.0;
         ALOGV("scale8 is %f",scale);
         value = FXP32(scale,2);
-        (*pContext->gVirtualxapi.settbhdx_maxgain)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settbhdx_maxgain, value);
         value = (int32_t)*p++;
         if (value < 1)
             value = 1;
         else if (value > 8)
             value = 8;
         ALOGV("value9 is %d",value);
-        (*pContext->gVirtualxapi.settbhdx_hporder)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settbhdx_hporder, value);
         value = (int32_t)*p;
         if (value < 0)
             value = 0;
         else if (value > 1)
             value = 1;
         ALOGV("value10 is %d",value);
-        (*pContext->gVirtualxapi.settbhdx_hpenable)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settbhdx_hpenable, value);
         break;
     case AUDIO_DTS_PARAM_TYPE_TRU_DIALOG:
         if (!pContext->gVXLibHandler) {
@@ -2942,7 +3173,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         p = (float *)pValue;
         value = (int32_t)*p++;
         ALOGV("value1 is %d",value);
-        (*pContext->gVirtualxapi.setvxlib1_enable)(value);
+        Virtualx_set_stage(pContext, VX_STAGE_VX, value);
         scale = *p++;
         if (scale < 0.125)
             scale = 0.125;
@@ -2950,7 +3181,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             scale = 1.0;
         ALOGV("scale2 is %f",scale);
         value = FXP32(scale,2);
-        (pContext->gVirtualxapi.setvxlib1_heardroomgain)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setvxlib1_heardroomgain, value);
         scale = *p++;
         if (scale < 0.5)
             scale = 0.5;
@@ -2973,7 +3204,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             scale = 2.0;
         ALOGV("scale5 is %f",scale);
         value = FXP32(scale,3);
-        (*pContext->gVirtualxapi.settsx_lprgain)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_lprgain, value);
         scale = *p++;
         if (scale < 1.0)
             scale = 1.0;
@@ -2981,14 +3212,14 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             scale = 2.0;
         ALOGV("scale6 is %f",scale);
         value = FXP32(scale,3);
-        (pContext->gVirtualxapi.settsx_centergain)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_centergain, value);
         value = (int32_t)*p++;
         if (value < 0)
             value = 0;
         else if (value > 1)
             value = 1;
         ALOGV("value7 is %d",value);
-        (*pContext->gVirtualxapi.settsx_dcenable)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_dcenable, value);
         scale = *p;
         if (scale < 0.0)
             scale = 0.0;
@@ -2996,7 +3227,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             scale = 1.0;
         ALOGV("scale8 is %f",scale);
         value = FXP32(scale,2);
-        (*pContext->gVirtualxapi.settsx_dccontrol)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_dccontrol, value);
         break;
     case AUDIO_DTS_PARAM_TYPE_DEFINATION:
         if (!pContext->gVXLibHandler) {
@@ -3009,7 +3240,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         else if (value > 1)
             value = 1;
         ALOGV("value1 is %d",value);
-        (*pContext->gVirtualxapi.setvxlib1_enable)(value);
+        Virtualx_set_stage(pContext, VX_STAGE_VX, value);
         scale = *p++;
         if (scale < 0.125)
             scale = 0.125;
@@ -3017,7 +3248,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             scale = 1.0;
         ALOGV("scale2 is %f",scale);
         value = FXP32(scale,2);
-        (pContext->gVirtualxapi.setvxlib1_heardroomgain)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setvxlib1_heardroomgain, value);
         scale = *p++;
         if (scale < 0.5)
             scale = 0.5;
@@ -3025,7 +3256,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             scale = 4.0;
         ALOGV("scale3 is %f",scale);
         value = FXP32(scale,4);
-        (*pContext->gVirtualxapi.setvxlib1_procoutgain)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.setvxlib1_procoutgain, value);
         value = (int32_t)*p++;
         if (value < 0)
             value = 0;
@@ -3039,7 +3270,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         else if (value > 1)
             value = 1;
         ALOGV("value5 is %d",value);
-        (*pContext->gVirtualxapi.settsx_defenable)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_defenable, value);
         scale = *p;
         if (scale < 0.0)
             scale = 0.0;
@@ -3047,7 +3278,7 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
             scale = 1.0;
         ALOGV("scale6 is %f",scale);
         value = FXP32(scale,2);
-        (*pContext->gVirtualxapi.settsx_defcontrol)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settsx_defcontrol, value);
         break;
     case AUDIO_DTS_PARAM_TYPE_TRU_VOLUME:
         if (!pContext->gVXLibHandler) {
@@ -3060,26 +3291,27 @@ int Virtualx_setParameter(vxContext *pContext, void *pParam, void *pValue)
         else if (value > 1)
             value = 1;
         ALOGV("value1 is %d",value);
-        (*pContext->gVirtualxapi.settruvolume_ctren)(value);
+        Virtualx_set_stage(pContext, VX_STAGE_TRUVOLUME, value);
         value = (int32_t)*p++;
         if (value < -40)
             value = -40;
         else if (value > 0)
             value = 0;
         ALOGV("value2 is %d",value);
-        (*pContext->gVirtualxapi.settruvolume_ctrtarget)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settruvolume_ctrtarget, value);
         value = (int32_t)*p;
         if (value < 0)
             value = 0;
         else if (value > 2)
             value = 2;
         ALOGV("value3 is %d",value);
-        (*pContext->gVirtualxapi.settruvolume_ctrpreset)(value);
+        Virtualx_set(pContext, pContext->gVirtualxapi.settruvolume_ctrpreset, value);
         break;
     default:
         ALOGE("%s: unknown param %08x", __FUNCTION__, param);
         return -EINVAL;
     }
+    Virtualx_publish(pContext);
     return 0;
 }
 
@@ -3125,6 +3357,15 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         *(uint32_t *) pValue = value;
         ALOGD("%s: Get Surround Mode %s", __FUNCTION__,VXSurroundModestr[data->surround_mode]);
         break;
+    case VIRTUALX_PARAM_LATENCY:
+        if (*pValueSize < sizeof(uint32_t)) {
+            *pValueSize = 0;
+            return -EINVAL;
+        }
+        value = __atomic_load_n(&pContext->fifo_latency, __ATOMIC_RELAXED);
+        *(uint32_t *) pValue = value;
+        ALOGD("%s: Get latency -> %d frames", __FUNCTION__, value);
+        break;
     case DTS_PARAM_MBHL_ENABLE_I32:
         if (*pValueSize < sizeof(uint32_t)) {
             *pValueSize = 0;
@@ -3133,7 +3374,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_enable)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_enable, pContext->gVirtualxapi.getmbhl_enable, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl enable is %d", __FUNCTION__, value);
         break;
@@ -3145,7 +3386,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_bypassgain)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_bypassgain, pContext->gVirtualxapi.getmbhl_bypassgain, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhlbypassgain %d", __FUNCTION__, value);
         break;
@@ -3157,7 +3398,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_reflevel)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_reflevel, pContext->gVirtualxapi.getmbhl_reflevel, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl reflevel %d", __FUNCTION__, value);
         break;
@@ -3169,7 +3410,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_volume)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_volume, pContext->gVirtualxapi.getmbhl_volume, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl volume is %d",__FUNCTION__, value);
         break;
@@ -3181,7 +3422,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_volumestep)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_volumestep, pContext->gVirtualxapi.getmbhl_volumestep, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl volumestep is %d",__FUNCTION__, value);
         break;
@@ -3193,7 +3434,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_balancestep)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_balancestep, pContext->gVirtualxapi.getmbhl_balancestep, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl balancestep is %d",__FUNCTION__, value);
         break;
@@ -3205,7 +3446,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_outputgain)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_outputgain, pContext->gVirtualxapi.getmbhl_outputgain, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl outputgain is %d",__FUNCTION__, value);
         break;
@@ -3217,7 +3458,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_mode)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_mode, pContext->gVirtualxapi.getmbhl_mode, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl mode is %d",__FUNCTION__, value);
         break;
@@ -3229,7 +3470,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_processdiscard)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_processdiscard, pContext->gVirtualxapi.getmbhl_processdiscard, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl process discard is %d",__FUNCTION__, value);
         break;
@@ -3241,7 +3482,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_lowcross)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_lowcross, pContext->gVirtualxapi.getmbhl_lowcross, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl lowcross is %d",__FUNCTION__, value);
         break;
@@ -3253,7 +3494,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_crossmid)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_crossmid, pContext->gVirtualxapi.getmbhl_crossmid, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl crossmid is %d",__FUNCTION__, value);
         break;
@@ -3265,7 +3506,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_compattrack)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_compattrack, pContext->gVirtualxapi.getmbhl_compattrack, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl compattrack is %d",__FUNCTION__, value);
         break;
@@ -3277,7 +3518,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_lowrelease)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_lowrelease, pContext->gVirtualxapi.getmbhl_lowrelease, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl lowrelease is %d",__FUNCTION__, value);
         break;
@@ -3289,7 +3530,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_complowratio)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_complowratio, pContext->gVirtualxapi.getmbhl_complowratio, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl complowratio is %d",__FUNCTION__, value);
         break;
@@ -3301,7 +3542,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_complowthresh)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_complowthresh, pContext->gVirtualxapi.getmbhl_complowthresh, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl complowthresh is %d",__FUNCTION__, value);
         break;
@@ -3313,7 +3554,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_lowmakeup)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_lowmakeup, pContext->gVirtualxapi.getmbhl_lowmakeup, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl lowmakeup is %d",__FUNCTION__, value);
         break;
@@ -3325,7 +3566,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_compmidrelease)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_compmidrelease, pContext->gVirtualxapi.getmbhl_compmidrelease, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl compmidrelease is %d",__FUNCTION__, value);
         break;
@@ -3337,7 +3578,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_midratio)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_midratio, pContext->gVirtualxapi.getmbhl_midratio, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl midratio is %d",__FUNCTION__, value);
         break;
@@ -3349,7 +3590,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_compmidthresh)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_compmidthresh, pContext->gVirtualxapi.getmbhl_compmidthresh, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl compmidthresh is %d",__FUNCTION__, value);
         break;
@@ -3361,7 +3602,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_compmidmakeup)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_compmidmakeup, pContext->gVirtualxapi.getmbhl_compmidmakeup, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl compmidmakeup is %d",__FUNCTION__, value);
         break;
@@ -3375,7 +3616,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         }
 
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.getmbhl_comphighrelease)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_comphighrelease, pContext->gVirtualxapi.getmbhl_comphighrelease, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl comphighrelease is %d",__FUNCTION__, value);
         break;
@@ -3387,7 +3628,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_comphighratio)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_comphighratio, pContext->gVirtualxapi.getmbhl_comphighratio, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl comphighratio is %d",__FUNCTION__, value);
         break;
@@ -3399,7 +3640,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_comphighthresh)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_comphighthresh, pContext->gVirtualxapi.getmbhl_comphighthresh, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl comphighthresh is %d",__FUNCTION__, value);
         break;
@@ -3411,7 +3652,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_comphighmakeup)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_comphighmakeup, pContext->gVirtualxapi.getmbhl_comphighmakeup, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl comphighmakeup is %d",__FUNCTION__, value);
         break;
@@ -3423,7 +3664,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_boost)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_boost, pContext->gVirtualxapi.getmbhl_boost, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl boost is %d",__FUNCTION__, value);
         break;
@@ -3435,7 +3676,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_threshold)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_threshold, pContext->gVirtualxapi.getmbhl_threshold, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl threshold is %d",__FUNCTION__, value);
         break;
@@ -3447,7 +3688,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_slowoffset)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_slowoffset, pContext->gVirtualxapi.getmbhl_slowoffset, &value);
         ALOGD("%s get mbhl slowoffset %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_FAST_ATTACK_I32:
@@ -3458,7 +3699,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_fastattack)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_fastattack, pContext->gVirtualxapi.getmbhl_fastattack, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl fastattackt %d",__FUNCTION__, value);
         break;
@@ -3470,7 +3711,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_fastrelease)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_fastrelease, pContext->gVirtualxapi.getmbhl_fastrelease, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl fastrelease %d",__FUNCTION__, value);
         break;
@@ -3482,7 +3723,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_slowattrack)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_slowattrack, pContext->gVirtualxapi.getmbhl_slowattrack, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl slowattrack %d",__FUNCTION__, value);
         break;
@@ -3494,10 +3735,9 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-
-        value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.setmbhl_slowrelease)(value);
-        ALOGD("%s set mbhl slowrelease %d",__FUNCTION__, value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_slowrelease, pContext->gVirtualxapi.getmbhl_slowrelease, &value);
+        *(int32_t *) pValue = value;
+        ALOGD("%s get mbhl slowrelease %d",__FUNCTION__, value);
         break;
     case DTS_PARAM_MBHL_DELAY_I32:
         if (*pValueSize < sizeof(uint32_t)) {
@@ -3507,7 +3747,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getmbhl_delay)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_delay, pContext->gVirtualxapi.getmbhl_delay, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl delay %d",__FUNCTION__, value);
         break;
@@ -3521,7 +3761,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         }
 
         value = *(int32_t *)pValue;
-        (*pContext->gVirtualxapi.getmbhl_envelopefre)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setmbhl_envelopefre, pContext->gVirtualxapi.getmbhl_envelopefre, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get mbhl envelopefre %d",__FUNCTION__, value);
         break;
@@ -3533,7 +3773,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.gettbhdx_enable)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settbhdx_enable, pContext->gVirtualxapi.gettbhdx_enable, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get tbhdx enable %d",__FUNCTION__, value);
         break;
@@ -3545,7 +3785,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.gettbhdx_monomode)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settbhdx_monomode, pContext->gVirtualxapi.gettbhdx_monomode, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get tbhdx monomode %d",__FUNCTION__, value);
         break;
@@ -3557,7 +3797,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.gettbhdx_maxgain)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settbhdx_maxgain, pContext->gVirtualxapi.gettbhdx_maxgain, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get tbhdx maxgain %d",__FUNCTION__, value);
         break;
@@ -3569,7 +3809,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.gettbhdx_spksize)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settbhdx_spksize, pContext->gVirtualxapi.gettbhdx_spksize, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get tbhdx spksize %d",__FUNCTION__, value);
         break;
@@ -3581,7 +3821,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.gettbhdx_hpenable)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settbhdx_hpenable, pContext->gVirtualxapi.gettbhdx_hpenable, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get tbhdx hpenable %d",__FUNCTION__, value);
         break;
@@ -3593,7 +3833,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.gettbhdx_tempgain)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settbhdx_tempgain, pContext->gVirtualxapi.gettbhdx_tempgain, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get tbhdx tempgain %d",__FUNCTION__, value);
         break;
@@ -3605,7 +3845,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getthbdx_processdiscard)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settbhdx_processdiscard, pContext->gVirtualxapi.getthbdx_processdiscard, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get tbhdx process discard %d",__FUNCTION__, value);
         break;
@@ -3617,7 +3857,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.gettbhdx_hporder)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settbhdx_hporder, pContext->gVirtualxapi.gettbhdx_hporder, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get tbhdx hporder %d",__FUNCTION__, value);
         break;
@@ -3629,7 +3869,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getvxlib1_enable)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setvxlib1_enable, pContext->gVirtualxapi.getvxlib1_enable, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get vxlib1 enable %d",__FUNCTION__, value);
         break;
@@ -3641,7 +3881,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getvxlib1_inmode)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setvxlib1_inmode, pContext->gVirtualxapi.getvxlib1_inmode, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get vxlib1 inmode %d",__FUNCTION__, value);
         break;
@@ -3653,7 +3893,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getvxlib1_outmode)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setvxlib1_outmode, pContext->gVirtualxapi.getvxlib1_outmode, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get vxlib1 outmode %d",__FUNCTION__, value);
         break;
@@ -3665,7 +3905,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getvxlib1_heardroomgain)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setvxlib1_heardroomgain, pContext->gVirtualxapi.getvxlib1_heardroomgain, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get vxlib1 heardroomgain %d",__FUNCTION__, value);
         break;
@@ -3677,7 +3917,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.getvxlib1_procoutgain)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.setvxlib1_procoutgain, pContext->gVirtualxapi.getvxlib1_procoutgain, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get vxlib1 procoutgain %d",__FUNCTION__, value);
         break;
@@ -3689,7 +3929,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.gettsx_enable)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settsx_enable, pContext->gVirtualxapi.gettsx_enable, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get tsx enable %d",__FUNCTION__, value);
         break;
@@ -3701,7 +3941,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.gettsx_pssvmtrxenable)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settsx_pssvmtrxenable, pContext->gVirtualxapi.gettsx_pssvmtrxenable, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get tsx pssvmtrxenable %d",__FUNCTION__, value);
         break;
@@ -3713,7 +3953,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.gettsx_hghtupmixenable)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settsx_hghtupmixenable, pContext->gVirtualxapi.gettsx_hghtupmixenable, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get tsx hghtupmixenable %d",__FUNCTION__, value);
         break;
@@ -3725,7 +3965,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.gettsx_lprgain)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settsx_lprgain, pContext->gVirtualxapi.gettsx_lprgain, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get tsx lprgain %d",__FUNCTION__, value);
         break;
@@ -3737,7 +3977,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (pContext->gVirtualxapi.gettsx_centergain)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settsx_centergain, pContext->gVirtualxapi.gettsx_centergain, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get tsx centergain %d",__FUNCTION__, value);
         break;
@@ -3749,7 +3989,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.gettsx_horizontctl)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settsx_horizontctl, pContext->gVirtualxapi.gettsx_horizontctl, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get tsx horizontctl %d",__FUNCTION__, value);
         break;
@@ -3761,7 +4001,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.gettsx_heightmixcoeff)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settsx_heightmixcoeff, pContext->gVirtualxapi.gettsx_heightmixcoeff, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get tsx heightmixcoeff %d",__FUNCTION__, value);
         break;
@@ -3773,7 +4013,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.gettsx_discard)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settsx_discard, pContext->gVirtualxapi.gettsx_discard, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get tsx discard %d",__FUNCTION__, value);
         break;
@@ -3785,7 +4025,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.gettsx_heightdiscards)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settsx_heightdiscards, pContext->gVirtualxapi.gettsx_heightdiscards, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get tsx heightdiscards %d",__FUNCTION__, value);
         break;
@@ -3797,7 +4037,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.gettsx_frntctrl)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settsx_frntctrl, pContext->gVirtualxapi.gettsx_frntctrl, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get tsx frntctrl %d",__FUNCTION__, value);
         break;
@@ -3809,7 +4049,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.gettsx_surroundctrl)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settsx_surroundctrl, pContext->gVirtualxapi.gettsx_surroundctrl, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get tsx surroundctrl %d",__FUNCTION__, value);
         break;
@@ -3821,7 +4061,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.gettsx_dcenable)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settsx_dcenable, pContext->gVirtualxapi.gettsx_dcenable, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get tsx dcenable %d",__FUNCTION__, value);
         break;
@@ -3833,7 +4073,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.gettsx_dccontrol)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settsx_dccontrol, pContext->gVirtualxapi.gettsx_dccontrol, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get tsx dccontrol %d",__FUNCTION__, value);
         break;
@@ -3845,7 +4085,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.gettsx_defenable)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settsx_defenable, pContext->gVirtualxapi.gettsx_defenable, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get tsx defenable %d",__FUNCTION__, value);
         break;
@@ -3857,7 +4097,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.gettsx_defcontrol)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settsx_defcontrol, pContext->gVirtualxapi.gettsx_defcontrol, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get tsx defcontrol %d",__FUNCTION__, value);
         break;
@@ -3869,7 +4109,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.gettruvolume_ctren)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settruvolume_ctren, pContext->gVirtualxapi.gettruvolume_ctren, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get truvolume ctren %d",__FUNCTION__, value);
         break;
@@ -3881,7 +4121,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.gettruvolume_ctrtarget)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settruvolume_ctrtarget, pContext->gVirtualxapi.gettruvolume_ctrtarget, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get truvolume ctrtarget %d",__FUNCTION__, value);
         break;
@@ -3893,7 +4133,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.gettruvolume_ctrpreset)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.settruvolume_ctrpreset, pContext->gVirtualxapi.gettruvolume_ctrpreset, &value);
         *(int32_t *) pValue = value;
         ALOGD("%s get truvolume ctrpreset %d",__FUNCTION__, value);
         break;
@@ -3905,7 +4145,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.geteq_enable)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.seteq_enable, pContext->gVirtualxapi.geteq_enable, &value);
         *(int32_t *) pValue = value;
         break;
     case DTS_PARAM_AEQ_INPUT_GAIN_I16:
@@ -3916,7 +4156,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.geteq_inputG)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.seteq_inputG, pContext->gVirtualxapi.geteq_inputG, &value);
         *(int32_t *) pValue = value;
         break;
     case DTS_PARAM_AEQ_OUTPUT_GAIN_I16:
@@ -3927,7 +4167,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.geteq_outputG)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.seteq_outputG, pContext->gVirtualxapi.geteq_outputG, &value);
         *(int32_t *) pValue = value;
         break;
     case DTS_PARAM_AEQ_BYPASS_GAIN_I16:
@@ -3938,7 +4178,7 @@ int Virtualx_getParameter(vxContext *pContext, void *pParam, size_t *pValueSize,
         if (!pContext->gVXLibHandler) {
             return 0;
         }
-        (*pContext->gVirtualxapi.geteq_bypassG)(&value);
+        Virtualx_get(pContext, pContext->gVirtualxapi.seteq_bypassG, pContext->gVirtualxapi.geteq_bypassG, &value);
         *(int32_t *) pValue = value;
         break;
     default:
@@ -3953,11 +4193,163 @@ int Virtualx_release(vxContext *pContext)
     if (pContext->gVXLibHandler) {
        (*pContext->gVirtualxapi.VX_release)();
     }
+    ParamSnapshotRelease(&pContext->params);
     return 0;
 }
 
 //-------------------Effect Control Interface Implementation--------------------------
 
+static inline int Virtualx_in_channels(const vxparam *params)
+{
+    return params->ch_num == 1 ? 6 : 2;
+}
+
+// the config with the input layout that ch_num selects
+static inline effect_config_t Virtualx_io_config(const vxContext *pContext, const vxparam *params)
+{
+    effect_config_t config = pContext->config;
+
+    config.inputCfg.channels = Virtualx_in_channels(params) == 6 ?
+            AUDIO_CHANNEL_OUT_5POINT1 : AUDIO_CHANNEL_OUT_STEREO;
+    config.outputCfg.channels = AUDIO_CHANNEL_OUT_STEREO;
+    return config;
+}
+
+// Q15 interleaved stereo to Q31 planes
+static void Virtualx_deinterleave_2ch(const int16_t *in, int32_t *l, int32_t *r, size_t n)
+{
+    size_t i = 0;
+
+#if defined(VIRTUALX_USE_NEON)
+    // whole vectors counted up front so that the tail loop stays bounded
+    const size_t nvec = n & ~(size_t)7;
+    for (; i < nvec; i += 8) {
+        int16x8x2_t x = vld2q_s16(in + 2 * i);
+        vst1q_s32(l + i, vshll_n_s16(vget_low_s16(x.val[0]), 16));
+        vst1q_s32(l + i + 4, vshll_n_s16(vget_high_s16(x.val[0]), 16));
+        vst1q_s32(r + i, vshll_n_s16(vget_low_s16(x.val[1]), 16));
+        vst1q_s32(r + i + 4, vshll_n_s16(vget_high_s16(x.val[1]), 16));
+    }
+#elif defined(VIRTUALX_USE_SSE2)
+    // a frame is one 32 bit lane R:L, L << 16 and R << 16 need no unpack
+    const __m128i hi = _mm_set1_epi32(0xffff0000);
+    const size_t nvec = n & ~(size_t)3;
+    for (; i < nvec; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + 2 * i));
+        _mm_storeu_si128((__m128i *)(l + i), _mm_slli_epi32(x, 16));
+        _mm_storeu_si128((__m128i *)(r + i), _mm_and_si128(x, hi));
+    }
+#endif
+    for (; i < n; i++) {
+        l[i] = (int32_t(in[2 * i])) << 16;
+        r[i] = (int32_t(in[2 * i + 1])) << 16;
+    }
+}
+
+// Q31 planes to Q15 interleaved stereo, truncating
+static void Virtualx_interleave_2ch(const int32_t *l, const int32_t *r, int16_t *out, size_t n)
+{
+    size_t i = 0;
+
+#if defined(VIRTUALX_USE_NEON)
+    const size_t nvec = n & ~(size_t)7;
+    for (; i < nvec; i += 8) {
+        int16x8x2_t x;
+        x.val[0] = vcombine_s16(vshrn_n_s32(vld1q_s32(l + i), 16), vshrn_n_s32(vld1q_s32(l + i + 4), 16));
+        x.val[1] = vcombine_s16(vshrn_n_s32(vld1q_s32(r + i), 16), vshrn_n_s32(vld1q_s32(r + i + 4), 16));
+        vst2q_s16(out + 2 * i, x);
+    }
+#elif defined(VIRTUALX_USE_SSE2)
+    const size_t nvec = n & ~(size_t)7;
+    for (; i < nvec; i += 8) {
+        __m128i pl = _mm_packs_epi32(_mm_srai_epi32(_mm_loadu_si128((const __m128i *)(l + i)), 16),
+                                     _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(l + i + 4)), 16));
+        __m128i pr = _mm_packs_epi32(_mm_srai_epi32(_mm_loadu_si128((const __m128i *)(r + i)), 16),
+                                     _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(r + i + 4)), 16));
+        _mm_storeu_si128((__m128i *)(out + 2 * i), _mm_unpacklo_epi16(pl, pr));
+        _mm_storeu_si128((__m128i *)(out + 2 * i + 8), _mm_unpackhi_epi16(pl, pr));
+    }
+#endif
+    for (; i < n; i++) {
+        out[2 * i] = (int16_t)(l[i] >> 16);
+        out[2 * i + 1] = (int16_t)(r[i] >> 16);
+    }
+}
+
+// one DTS_VIRTUALX_FRAME_SIZE block through the stage plan, stereo out
+static void Virtualx_process_block(vxContext *pContext, const vxparam *params, const int16_t *in, int16_t *out)
+{
+    int32_t **planes = pContext->ppMappedInCh;
+
+    if (params->ch_num == 0 /*for 2ch process*/) {
+        Virtualx_deinterleave_2ch(in, pContext->ppMappedInCh[0], pContext->ppMappedInCh[1], DTS_VIRTUALX_FRAME_SIZE);
+    } else if (params->ch_num == 1 /*for 5.1 ch process*/) {
+        for (int sampleCount = 0; sampleCount < DTS_VIRTUALX_FRAME_SIZE; sampleCount++) {
+            for (int i = 0; i < 6; i++) {
+                pContext->ppMappedInCh[i][sampleCount] = (int32_t(*in++)) << 16;
+            }
+        }
+    }
+    // the first stage reads the input planes, the others run in place
+    for (int i = 0; i < pContext->stage_num; i++) {
+        (*pContext->stage[i])(planes, pContext->ppMappedOutCh);
+        planes = pContext->ppMappedOutCh;
+    }
+    Virtualx_interleave_2ch(planes[0], planes[1], out, DTS_VIRTUALX_FRAME_SIZE);
+}
+
+/* Any frameCount: input is collected into full blocks and the output is
+ * delayed by DTS_VIRTUALX_FIFO_LATENCY frames, which is the most a partial
+ * block can hold back. Once started the FIFO stays in use so that the
+ * latency does not change with the period size. */
+static void Virtualx_process_fifo(vxContext *pContext, const vxparam *params,
+        const int16_t *in, int16_t *out, size_t frameCount)
+{
+    int inCh = Virtualx_in_channels(params);
+    uint32_t pending = 0;
+    uint32_t n;
+
+    if (!pContext->fifo_enable) {
+        pContext->fifo_enable = 1;
+        pContext->fifo_in_ch = inCh;
+        pContext->fifo_in_frames = 0;
+        pContext->fifo_out_frames = DTS_VIRTUALX_FIFO_LATENCY;
+        memset(pContext->fifo_out, 0, DTS_VIRTUALX_FIFO_LATENCY * 2 * sizeof(int16_t));
+        __atomic_store_n(&pContext->fifo_latency, DTS_VIRTUALX_FIFO_LATENCY, __ATOMIC_RELAXED);
+        ALOGI("%s: frameCount %zu, use FIFO with %d frames latency", __FUNCTION__, frameCount, DTS_VIRTUALX_FIFO_LATENCY);
+    } else if (pContext->fifo_in_ch != inCh) {
+        // the frames already queued can not be remapped, keep their timing
+        memset(pContext->fifo_in, 0, sizeof(pContext->fifo_in));
+        pContext->fifo_in_ch = inCh;
+    }
+
+    while (frameCount > 0) {
+        n = DTS_VIRTUALX_FRAME_SIZE - pContext->fifo_in_frames;
+        if (n > frameCount)
+            n = frameCount;
+        memcpy(pContext->fifo_in + pContext->fifo_in_frames * inCh, in, n * inCh * sizeof(int16_t));
+        pContext->fifo_in_frames += n;
+        in += n * inCh;
+        frameCount -= n;
+        pending += n;
+
+        if (pContext->fifo_in_frames == DTS_VIRTUALX_FRAME_SIZE) {
+            Virtualx_process_block(pContext, params, pContext->fifo_in,
+                    pContext->fifo_out + pContext->fifo_out_frames * 2);
+            pContext->fifo_out_frames += DTS_VIRTUALX_FRAME_SIZE;
+            pContext->fifo_in_frames = 0;
+        }
+
+        // the latency guarantees that every pending frame is available here
+        n = pending < pContext->fifo_out_frames ? pending : pContext->fifo_out_frames;
+        memcpy(out, pContext->fifo_out, n * 2 * sizeof(int16_t));
+        out += n * 2;
+        pending -= n;
+        pContext->fifo_out_frames -= n;
+        memmove(pContext->fifo_out, pContext->fifo_out + n * 2, pContext->fifo_out_frames * 2 * sizeof(int16_t));
+    }
+}
+
 int Virtualx_process(effect_handle_t self, audio_buffer_t *inBuffer, audio_buffer_t *outBuffer)
 {
     vxContext *pContext = (vxContext *)self;
@@ -3975,40 +4367,34 @@ int Virtualx_process(effect_handle_t self, audio_buffer_t *inBuffer, audio_buffe
 
     int16_t  *in   = (int16_t *)inBuffer->raw;
     int16_t  *out  = (int16_t *)outBuffer->raw;
-    vxdata   *data = &pContext->gvxdata;
-    if (!data->enable || !pContext->gVXLibHandler) {
-        for (size_t i = 0; i < inBuffer->frameCount; i++) {
-            *out++ = *in++;
-            *out++ = *in++;
-        }
-    } else {
-        int32_t blockSize = DTS_VIRTUALX_FRAME_SIZE;
-        int32_t blockCount = inBuffer->frameCount / blockSize;
+    int changed;
+    int accumulate = AudioAccumulateNeeded(&pContext->accumulate, &pContext->config, inBuffer, outBuffer);
+    const vxparam *params = (const vxparam *)ParamSnapshotAcquire(&pContext->params, &changed);
+    if (changed && pContext->gVXLibHandler)
+        Virtualx_apply_params(pContext, params);
+    if (!params->enable || !pContext->gVXLibHandler) {
+        if (pContext->fifo_enable)
+            Virtualx_fifo_reset(pContext);
+        effect_config_t config = Virtualx_io_config(pContext, params);
+        AudioBypass(&config, accumulate, inBuffer, outBuffer);
+    } else if (accumulate) {
+        effect_config_t config = Virtualx_io_config(pContext, params);
+        return AudioAccumulateProcess(&pContext->accumulate, self, &config, inBuffer, outBuffer);
+    } else if (AudioSilenceDetect(&pContext->silence, in, inBuffer->frameCount,
+            Virtualx_in_channels(params) * sizeof(int16_t), pContext->config.inputCfg.samplingRate)) {
+        // the output is stereo whatever the input layout, the FIFO keeps its
+        // frames so that the latency is unchanged when the audio comes back
+        memset(out, 0, inBuffer->frameCount * 2 * sizeof(int16_t));
+    } else if (!pContext->fifo_enable && inBuffer->frameCount % DTS_VIRTUALX_FRAME_SIZE == 0) {
+        int32_t blockCount = inBuffer->frameCount / DTS_VIRTUALX_FRAME_SIZE;
+        int inCh = Virtualx_in_channels(params);
         for (int i = 0; i < blockCount; i++) {
-            for (int sampleCount = 0; sampleCount < 256; sampleCount++) {
-                if (pContext->ch_num == 0 /*for 2ch process*/) {
-                    pContext->ppMappedInCh[0][sampleCount] = (int32_t(*in++)) << 16; // L & R
-                    pContext->ppMappedInCh[1][sampleCount] = (int32_t(*in++)) << 16;
-                    for (int i = 2; i < 12; i++) {
-                        pContext->ppMappedInCh[i][sampleCount] = 0;
-                    }
-               } else if (pContext->ch_num == 1 /*for 5.1 ch process*/) {
-                    for (int i = 0; i < 6; i++) {
-                        pContext->ppMappedInCh[i][sampleCount] = (int32_t(*in++)) << 16;
-                    }
-                    for (int i = 6; i < 12; i++) {
-                        pContext->ppMappedInCh[i][sampleCount] = 0;
-                    }
-                }
-            }
-            (*pContext->gVirtualxapi.Truvolume_process)(pContext->ppMappedInCh,pContext->ppMappedOutCh);
-            (*pContext->gVirtualxapi.VX_process)(pContext->ppMappedOutCh,pContext->ppMappedOutCh);
-            (*pContext->gVirtualxapi.MBHL_process)(pContext->ppMappedOutCh,pContext->ppMappedOutCh);
-            for (int sampleCount = 0;sampleCount < 256; sampleCount++) {
-                *out++  = (int16_t)(pContext->ppMappedOutCh[0][sampleCount] >> 16);
-                *out++  = (int16_t)(pContext->ppMappedOutCh[1][sampleCount] >> 16);
-            }
+            Virtualx_process_block(pContext, params, in, out);
+            in += DTS_VIRTUALX_FRAME_SIZE * inCh;
+            out += DTS_VIRTUALX_FRAME_SIZE * 2;
         }
+    } else {
+        Virtualx_process_fifo(pContext, params, in, out, inBuffer->frameCount);
     }
     return 0;
 }
@@ -4153,6 +4539,17 @@ int VirtualxLib_Create(const effect_uuid_t *uuid, int32_t sessionId __unused, in
         ALOGE("%s: Load Library File faied", __FUNCTION__);
     }
 
+    pContext->next_params.enable = pContext->gvxdata.enable;
+    pContext->next_params.stages = Virtualx_cfg_stages(&pContext->gvxdata);
+    pContext->cur_params = pContext->next_params;
+    if (ParamSnapshotInit(&pContext->params, &pContext->next_params, sizeof(vxparam)) < 0) {
+        unload_Virtualx_lib(pContext);
+        delete pContext;
+        return -EINVAL;
+    }
+
+    AudioSilenceInit(&pContext->silence, DTS_VIRTUALX_TAIL_MS);
+
     pContext->itfe = &VirtualxInterface;
     pContext->state = VIRTUALX_STATE_UNINITIALIZED;
 
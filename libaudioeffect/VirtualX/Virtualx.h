@@ -131,6 +131,8 @@ typedef enum {
     AUDIO_DTS_PARAM_TYPE_TRU_DIALOG,
     AUDIO_DTS_PARAM_TYPE_DEFINATION,
     AUDIO_DTS_PARAM_TYPE_TRU_VOLUME,
+    /*query only: frames of delay added by the block FIFO*/
+    VIRTUALX_PARAM_LATENCY,
 } Virtualx_params;
 
 #endif
@@ -14,6 +14,7 @@ LOCAL_SHARED_LIBRARIES := \
 
 LOCAL_C_INCLUDES := \
     $(LOCAL_PATH) \
+    vendor/amlogic/frameworks/av/libaudioeffect/Utility \
     hardware/amlogic/audio/utils/ini/include \
     hardware/libhardware/include/hardware \
     hardware/libhardware/include \
@@ -24,6 +25,10 @@ LOCAL_C_INCLUDES := \
     frameworks/av/media/libeffects/lvm/lib/Common/src \
 
 LOCAL_SRC_FILES += Virtualsurround.cpp
+LOCAL_SRC_FILES += ../Utility/ParamSnapshot.c
+LOCAL_SRC_FILES += ../Utility/AudioArena.c
+LOCAL_SRC_FILES += ../Utility/AudioSilence.c
+LOCAL_SRC_FILES += ../Utility/AudioBypass.c
 
 LOCAL_LDFLAGS_arm  += $(LOCAL_PATH)/libmusicbundle.a
 LOCAL_LDFLAGS_arm64  += $(LOCAL_PATH)/libmusicbundle64.a
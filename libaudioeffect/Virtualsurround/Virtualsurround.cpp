@@ -36,6 +36,10 @@
 #include <hardware/audio_effect.h>
 #include <cutils/properties.h>
 #include "Virtualsurround.h"
+#include "ParamSnapshot.h"
+#include "AudioArena.h"
+#include "AudioSilence.h"
+#include "AudioBypass.h"
 
 
 #include "IniParser.h"
@@ -46,14 +50,10 @@ extern "C"{
 #include "InstAlloc.h"
 #include "LVCS_Private.h"
 
-LVCS_Handle_t           hCSInstance = LVM_NULL; /* Concert Sound instance handle */
-LVCS_Instance_t         CS_Instance;        /* Concert Sound instance */
-LVCS_MemTab_t           CS_MemTab;          /* Memory table */
-LVCS_Capabilities_t     CS_Capabilities;    /* Initial capabilities */
-static pthread_mutex_t audio_vir_mutex = PTHREAD_MUTEX_INITIALIZER;
-
 #define MODEL_SUM_DEFAULT_PATH "/vendor/etc/tvconfig/model/model_sum.ini"
 #define AUDIO_EFFECT_DEFAULT_PATH "/vendor/etc/tvconfig/audio/AMLOGIC_AUDIO_EFFECT_DEFAULT.ini"
+// reverb tail of the Concert Sound room
+#define VIRTUALSURROUND_TAIL_MS 500
 
 // effect_handle_t interface implementation for Virtualsurround effect
 extern const struct effect_interface_s VirtualsurroundInterface;
@@ -98,6 +98,18 @@ typedef struct VirtualsurroundContext_s {
     effect_config_t                 config;
     Virtualsurround_state_e         state;
     Virtualsurrounddata             gVirtualsurrounddata;
+    /* Virtualsurroundcfg snapshot, LVCS is updated by the audio thread */
+    ParamSnapshot_t                 params;
+    /* Concert Sound state of this session */
+    LVCS_Handle_t                   hCSInstance;        /* Concert Sound instance handle */
+    LVCS_Instance_t                 CS_Instance;        /* Concert Sound instance */
+    LVCS_MemTab_t                   CS_MemTab;          /* Memory table */
+    LVCS_Capabilities_t             CS_Capabilities;    /* Initial capabilities */
+    AudioArena_t                    CS_Arena;           /* CS_MemTab regions */
+    /* held by EFFECT_CMD_INIT while LVCS is rebuilt, process only tries it */
+    pthread_mutex_t                 init_lock;
+    AudioSilence_t                  silence;
+    AudioAccumulate_t               accumulate;
 } VirtualsurroundContext;
 
 const char *VirtualsurroundStatusstr[] = {"Disable", "Enable"};
@@ -173,39 +185,67 @@ error:
     return result;
 }
 
+/* forget the instance. The regions are owned by CS_Arena: they are carved
+ * again by the next init and only freed by Virtualsurround_release() */
+static void Virtualsurround_free_instance(VirtualsurroundContext *pContext)
+{
+    LVCS_MemTab_t *CS_MemTab = &pContext->CS_MemTab;
+    int i;
+
+    for (i = 0; i < LVM_NR_MEMORY_REGIONS; i++) {
+        CS_MemTab->Region[i].pBaseAddress = NULL;
+    }
+    pContext->hCSInstance = LVM_NULL;
+}
+
 int Virtualsurround_init(VirtualsurroundContext *pContext) {
     LVCS_ReturnStatus_en    LVCS_Status;
-    LVCS_Params_t *CS_Params = &CS_Instance.Params;
+    LVCS_Params_t *CS_Params = &pContext->CS_Instance.Params;
+    LVCS_MemTab_t *CS_MemTab = &pContext->CS_MemTab;
+    LVCS_Capabilities_t *CS_Capabilities = &pContext->CS_Capabilities;
+    size_t arenaSize = 0;
     int i = 0;
 
-    pthread_mutex_lock(&audio_vir_mutex);
-    CS_Capabilities.MaxBlockSize = 2048;
-    CS_Capabilities.pBundleInstance = (void*)hCSInstance;
+    pthread_mutex_lock(&pContext->init_lock);
+    Virtualsurround_free_instance(pContext);
+    CS_Capabilities->MaxBlockSize = 2048;
+    CS_Capabilities->pBundleInstance = (void*)pContext->hCSInstance;
     LVCS_Status = LVCS_Memory(LVM_NULL,
-                              &CS_MemTab,
-                              &CS_Capabilities);
-    CS_MemTab.Region[LVCS_MEMREGION_PERSISTENT_SLOW_DATA].pBaseAddress = &CS_Instance;
-    /* Allocate memory */
+                              CS_MemTab,
+                              CS_Capabilities);
+    CS_MemTab->Region[LVCS_MEMREGION_PERSISTENT_SLOW_DATA].pBaseAddress = &pContext->CS_Instance;
+    /* Allocate memory, only the first init (or a larger need) reaches the allocator */
     for (i = 0; i < LVM_NR_MEMORY_REGIONS; i++) {
-        if (CS_MemTab.Region[i].Size != 0) {
-            CS_MemTab.Region[i].pBaseAddress = malloc(CS_MemTab.Region[i].Size);
-            if (CS_MemTab.Region[i].pBaseAddress == LVM_NULL) {
+        arenaSize += AudioArenaBlockSize(CS_MemTab->Region[i].Size);
+    }
+    if (AudioArenaReserve(&pContext->CS_Arena, arenaSize, AUDIO_ARENA_MLOCK) != AUDIO_ARENA_OK) {
+        Virtualsurround_free_instance(pContext);
+        pthread_mutex_unlock(&pContext->init_lock);
+        return LVCS_NULLADDRESS;
+    }
+    for (i = 0; i < LVM_NR_MEMORY_REGIONS; i++) {
+        if (CS_MemTab->Region[i].Size != 0) {
+            CS_MemTab->Region[i].pBaseAddress = AudioArenaAlloc(&pContext->CS_Arena, CS_MemTab->Region[i].Size);
+            if (CS_MemTab->Region[i].pBaseAddress == LVM_NULL) {
                 ALOGV("\tLVM_ERROR :LvmBundle_init CreateInstance Failed to allocate %"
-                    " bytes for region %u\n", CS_MemTab.Region[i].Size, i );
+                    " bytes for region %u\n", CS_MemTab->Region[i].Size, i );
+                Virtualsurround_free_instance(pContext);
+                pthread_mutex_unlock(&pContext->init_lock);
                 return LVCS_NULLADDRESS;
             } else {
                 ALOGV("\tLvmBundle_init CreateInstance allocated %"
                     " bytes for region %u at %p\n",
-                    CS_MemTab.Region[i].Size, i, CS_MemTab.Region[i].pBaseAddress);
+                    CS_MemTab->Region[i].Size, i, CS_MemTab->Region[i].pBaseAddress);
             }
         }
     }
-    hCSInstance = LVM_NULL;
-    LVCS_Status = LVCS_Init(&hCSInstance,
-                              &CS_MemTab,
-                              &CS_Capabilities);
+    pContext->hCSInstance = LVM_NULL;
+    LVCS_Status = LVCS_Init(&pContext->hCSInstance,
+                              CS_MemTab,
+                              CS_Capabilities);
     pContext->gVirtualsurrounddata.tbcfg.effectlevel = 0;
     pContext->gVirtualsurrounddata.tbcfg.enable = 0;
+    ParamSnapshotPublish(&pContext->params, &pContext->gVirtualsurrounddata.tbcfg);
     CS_Params->OperatingMode = LVCS_OFF;
     CS_Params->CompressorMode = LVM_MODE_ON;
     CS_Params->SourceFormat = LVCS_MONOINSTEREO;//LVCS_STEREO;
@@ -213,7 +253,7 @@ int Virtualsurround_init(VirtualsurroundContext *pContext) {
     CS_Params->SampleRate  = LVM_FS_48000;
     CS_Params->ReverbLevel = 512;
     CS_Params->EffectLevel = 32700; /* 0~32767 */
-    pthread_mutex_unlock(&audio_vir_mutex);
+    pthread_mutex_unlock(&pContext->init_lock);
 
     pContext->config.inputCfg.accessMode = EFFECT_BUFFER_ACCESS_READ;
     pContext->config.inputCfg.channels = AUDIO_CHANNEL_OUT_STEREO;
@@ -266,38 +306,22 @@ int Virtualsurround_setParameter(VirtualsurroundContext *pContext, void *pParam,
     int32_t value;
     Virtualsurrounddata *data=&pContext->gVirtualsurrounddata;
     Virtualsurroundcfg *tbcfg=&data->tbcfg;
-    LVCS_ReturnStatus_en  CS_Status;
-    LVCS_Params_t *CS_Params = &CS_Instance.Params;
-    if (hCSInstance == LVM_NULL)
+    if (pContext->hCSInstance == LVM_NULL)
         return LVCS_NULLADDRESS;
-    pthread_mutex_lock(&audio_vir_mutex);
     switch (param) {
         case VIRTUALSURROUND_PARAM_ENABLE:
             value = *(int32_t *)pValue;
             tbcfg->enable = value;
-            if (tbcfg->enable == 1)
-               CS_Params->OperatingMode = LVCS_ON;
-            else
-               CS_Params->OperatingMode = LVCS_OFF;
-            LVCS_Control(hCSInstance,CS_Params);
-            pthread_mutex_unlock(&audio_vir_mutex);
             break;
         case VIRTUALSURROUND_PARAM_EFFECTLEVEL:
             value = *(int32_t *)pValue;
             tbcfg->effectlevel = value;
-            if (tbcfg->effectlevel > 100)
-                CS_Params->EffectLevel = 32700;
-            else if (tbcfg->effectlevel < 0)
-                CS_Params->EffectLevel  = 0;
-            else
-                CS_Params->EffectLevel = tbcfg->effectlevel * 327;
-            LVCS_Control(hCSInstance,CS_Params);
-            pthread_mutex_unlock(&audio_vir_mutex);
             break;
         default:
             ALOGE("%s: unknown param %08x", __FUNCTION__, param);
             return -EINVAL;
     }
+    ParamSnapshotPublish(&pContext->params, tbcfg);
     return 0;
 }
 
@@ -330,17 +354,29 @@ int Virtualsurround_getParameter(VirtualsurroundContext*pContext, void *pParam,
     return 0;
 }
 
-int Virtualsurround_release(VirtualsurroundContext *pContext __unused) {
-    int i;
-    pthread_mutex_lock(&audio_vir_mutex);
-    for (i = 0; i < LVM_NR_MEMORY_REGIONS; i++) {
-        if (CS_MemTab.Region[i].pBaseAddress != 0) {
-            free(CS_MemTab.Region[i].pBaseAddress);
-            CS_MemTab.Region[i].pBaseAddress = NULL;
-        }
-    }
-    hCSInstance = LVM_NULL;
-    pthread_mutex_unlock(&audio_vir_mutex);
+/* audio thread: hand a new configuration to LVCS between two blocks */
+static void Virtualsurround_apply_params(VirtualsurroundContext *pContext, const Virtualsurroundcfg *tbcfg)
+{
+    LVCS_Params_t *CS_Params = &pContext->CS_Instance.Params;
+
+    if (tbcfg->enable == 1)
+        CS_Params->OperatingMode = LVCS_ON;
+    else
+        CS_Params->OperatingMode = LVCS_OFF;
+    if (tbcfg->effectlevel > 100)
+        CS_Params->EffectLevel = 32700;
+    else if (tbcfg->effectlevel < 0)
+        CS_Params->EffectLevel  = 0;
+    else
+        CS_Params->EffectLevel = tbcfg->effectlevel * 327;
+    LVCS_Control(pContext->hCSInstance,CS_Params);
+}
+
+int Virtualsurround_release(VirtualsurroundContext *pContext) {
+    ParamSnapshotRelease(&pContext->params);
+    Virtualsurround_free_instance(pContext);
+    AudioArenaRelease(&pContext->CS_Arena);
+    pthread_mutex_destroy(&pContext->init_lock);
     return 0;
 }
 
@@ -348,7 +384,6 @@ int Virtualsurround_release(VirtualsurroundContext *pContext __unused) {
 
 int Virtualsurround_process(effect_handle_t self, audio_buffer_t *inBuffer, audio_buffer_t *outBuffer)
 {
-    LVCS_ReturnStatus_en        CS_Status;
     VirtualsurroundContext * pContext = (VirtualsurroundContext *)self;
     if (pContext == NULL) {
         return -EINVAL;
@@ -365,21 +400,35 @@ int Virtualsurround_process(effect_handle_t self, audio_buffer_t *inBuffer, audi
     }
     int16_t *in  = (int16_t *)inBuffer->raw;
     int16_t *out = (int16_t *)outBuffer->raw;
-    Virtualsurrounddata *data = &pContext->gVirtualsurrounddata;
-    if (!data->tbcfg.enable) {
-        for (size_t i = 0; i < inBuffer->frameCount; i++) {
-            *out++ = *in++;
-            *out++ = *in++;
-        }
+    int accumulate = AudioAccumulateNeeded(&pContext->accumulate, &pContext->config, inBuffer, outBuffer);
+    int changed;
+    int ret = 0;
+    // EFFECT_CMD_INIT is rebuilding the instance, let this block through
+    if (pthread_mutex_trylock(&pContext->init_lock) != 0) {
+        AudioBypass(&pContext->config, accumulate, inBuffer, outBuffer);
+        return 0;
+    }
+    const Virtualsurroundcfg *tbcfg =
+        (const Virtualsurroundcfg *)ParamSnapshotAcquire(&pContext->params, &changed);
+    if (changed && pContext->hCSInstance != LVM_NULL) {
+        Virtualsurround_apply_params(pContext, tbcfg);
+    }
+    if (!tbcfg->enable) {
+        AudioBypass(&pContext->config, accumulate, inBuffer, outBuffer);
+    } else if (pContext->hCSInstance == LVM_NULL) {
+        ret = LVCS_NULLADDRESS;
+    } else if (accumulate) {
+        // process() is entered again for each chunk
+        pthread_mutex_unlock(&pContext->init_lock);
+        return AudioAccumulateProcess(&pContext->accumulate, self, &pContext->config, inBuffer, outBuffer);
+    } else if (AudioSilenceDetect(&pContext->silence, in, inBuffer->frameCount,
+            2 * sizeof(int16_t), pContext->config.inputCfg.samplingRate)) {
+        AudioBypass(&pContext->config, 0, inBuffer, outBuffer);
     } else {
-        if (hCSInstance == LVM_NULL)
-            return LVCS_NULLADDRESS;
-        pthread_mutex_lock(&audio_vir_mutex);
-        LVCS_Process(hCSInstance,in,out,inBuffer->frameCount);
-
-        pthread_mutex_unlock(&audio_vir_mutex);
+        LVCS_Process(pContext->hCSInstance,in,out,inBuffer->frameCount);
     }
-    return 0;
+    pthread_mutex_unlock(&pContext->init_lock);
+    return ret;
 }
 
 int Virtualsurround_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
@@ -494,6 +543,13 @@ int VirtualsurroundLib_Create(const effect_uuid_t * uuid, int32_t sessionId __un
         ALOGE("%s: Load INI File faied, use default param", __FUNCTION__);
         pContext->gVirtualsurrounddata.tbcfg.enable = 0;
     }
+    if (ParamSnapshotInit(&pContext->params, &pContext->gVirtualsurrounddata.tbcfg,
+            sizeof(Virtualsurroundcfg)) < 0) {
+        delete pContext;
+        return -EINVAL;
+    }
+    pthread_mutex_init(&pContext->init_lock, NULL);
+    AudioSilenceInit(&pContext->silence, VIRTUALSURROUND_TAIL_MS);
     pContext->itfe = &VirtualsurroundInterface;
     pContext->state = VIRTUALSURROUND_STATE_UNINITIALIZED;
     *pHandle = (effect_handle_t)pContext;
@@ -0,0 +1,310 @@
+LOCAL_PATH := $(call my-dir)
+
+# Host builds of the effect libraries for AudioEffectHostRunner.
+# The Android-only headers (cutils/log, cutils/properties, IniParser) are
+# replaced by the ones in stub/include. Effects that link target-only
+# prebuilt archives (Hpeq, Virtualsurround) can only
+# be run once a host build of their archive is available.
+EFFECT_HOST_C_INCLUDES := \
+    $(LOCAL_PATH)/stub/include \
+    hardware/libhardware/include \
+    system/media/audio/include \
+    system/core/libcutils/include
+
+# Android-only pieces stubbed for host
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE := libaudioeffect_hoststub
+
+LOCAL_C_INCLUDES := $(EFFECT_HOST_C_INCLUDES)
+LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)/stub/include
+
+LOCAL_SRC_FILES := stub/host_stub.cpp
+
+include $(BUILD_HOST_STATIC_LIBRARY)
+
+# offline runner
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE := AudioEffectHostRunner
+
+LOCAL_C_INCLUDES := $(EFFECT_HOST_C_INCLUDES)
+
+LOCAL_SRC_FILES := host_runner.cpp
+
+LOCAL_CFLAGS += -O2
+LOCAL_LDLIBS += -ldl
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# Utility biquad cascade benchmark
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE := AudioBiquadBench
+
+LOCAL_C_INCLUDES := \
+    $(EFFECT_HOST_C_INCLUDES) \
+    $(LOCAL_PATH)/../Utility
+
+LOCAL_SRC_FILES := \
+    ../effects_tool/biquad_bench.cpp \
+    ../Utility/AudioBiquad.c
+LOCAL_STATIC_LIBRARIES := libaudioeffect_hoststub
+
+LOCAL_CFLAGS += -O2
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# Balance
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE := libbalance_host
+
+LOCAL_C_INCLUDES := \
+    $(EFFECT_HOST_C_INCLUDES) \
+    $(LOCAL_PATH)/../Balance \
+    $(LOCAL_PATH)/../Utility
+
+LOCAL_SRC_FILES := \
+    ../Balance/Balance.cpp \
+    ../Utility/ParamSnapshot.c \
+    ../Utility/AudioSilence.c \
+    ../Utility/AudioBypass.c
+LOCAL_STATIC_LIBRARIES := libaudioeffect_hoststub
+
+LOCAL_CFLAGS += -O2
+
+include $(BUILD_HOST_SHARED_LIBRARY)
+
+# Geq
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE := libgeq_host
+
+LOCAL_C_INCLUDES := \
+    $(EFFECT_HOST_C_INCLUDES) \
+    $(LOCAL_PATH)/../Geq \
+    $(LOCAL_PATH)/../Utility
+
+LOCAL_SRC_FILES := \
+    ../Geq/Geq.cpp \
+    ../Utility/AudioFade.c \
+    ../Utility/ParamSnapshot.c \
+    ../Utility/AudioBiquad.c \
+    ../Utility/AudioConvert.c \
+    ../Utility/AudioSilence.c \
+    ../Utility/AudioBypass.c
+LOCAL_STATIC_LIBRARIES := libaudioeffect_hoststub
+
+# libAmlGeq is target only, the host build runs the source engine
+LOCAL_CFLAGS += -O2 -DGEQ_SOURCE_ENGINE
+
+include $(BUILD_HOST_SHARED_LIBRARY)
+
+# AVL
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE := libavl_host
+
+LOCAL_C_INCLUDES := \
+    $(EFFECT_HOST_C_INCLUDES) \
+    $(LOCAL_PATH)/../AVL \
+    $(LOCAL_PATH)/../Utility
+
+LOCAL_SRC_FILES := \
+    ../AVL/Avl.cpp \
+    ../Utility/ParamSnapshot.c \
+    ../Utility/AudioConvert.c \
+    ../Utility/AudioSilence.c \
+    ../Utility/AudioBypass.c
+LOCAL_STATIC_LIBRARIES := libaudioeffect_hoststub
+
+# lib_aml_agc is target only, the host build runs the source leveler
+LOCAL_CFLAGS += -O2 -DAVL_SOURCE_ENGINE
+
+include $(BUILD_HOST_SHARED_LIBRARY)
+
+# TrebleBass
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE := libtreblebasswrapper_host
+
+LOCAL_C_INCLUDES := \
+    $(EFFECT_HOST_C_INCLUDES) \
+    $(LOCAL_PATH)/../TrebleBass \
+    $(LOCAL_PATH)/../Utility
+
+LOCAL_SRC_FILES := \
+    ../TrebleBass/TrebleBass.cpp \
+    ../Utility/ParamSnapshot.c \
+    ../Utility/AudioBiquad.c \
+    ../Utility/AudioConvert.c \
+    ../Utility/AudioSilence.c \
+    ../Utility/AudioBypass.c
+LOCAL_STATIC_LIBRARIES := libaudioeffect_hoststub
+
+# libAmlTrebleBass is target only, the host build runs the source shelves
+LOCAL_CFLAGS += -O2 -DTREBASS_SOURCE_ENGINE
+
+include $(BUILD_HOST_SHARED_LIBRARY)
+
+# VirtualBass
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE := libvirtualbass_host
+
+LOCAL_C_INCLUDES := \
+    $(EFFECT_HOST_C_INCLUDES) \
+    $(LOCAL_PATH)/../VirtualBass \
+    $(LOCAL_PATH)/../Utility
+
+LOCAL_SRC_FILES := \
+    ../VirtualBass/Virtual_Bass.cpp \
+    ../VirtualBass/Virtual_Bass_Arithmetic.cpp \
+    ../Utility/ParamSnapshot.c \
+    ../Utility/AudioBiquad.c \
+    ../Utility/AudioSilence.c \
+    ../Utility/AudioBypass.c
+LOCAL_STATIC_LIBRARIES := libaudioeffect_hoststub
+
+LOCAL_CFLAGS += -O2
+
+include $(BUILD_HOST_SHARED_LIBRARY)
+
+# EffectChain, the members are the *_host libraries above, dlopen'ed from
+# chain_lib_path of the effect INI
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE := libeffectchain_host
+
+LOCAL_C_INCLUDES := \
+    $(EFFECT_HOST_C_INCLUDES) \
+    $(LOCAL_PATH)/../EffectChain \
+    $(LOCAL_PATH)/../Utility
+
+LOCAL_SRC_FILES := \
+    ../EffectChain/EffectChain.cpp \
+    ../Utility/AudioConvert.c \
+    ../Utility/AudioSilence.c \
+    ../Utility/AudioBypass.c
+LOCAL_STATIC_LIBRARIES := libaudioeffect_hoststub
+
+LOCAL_CFLAGS += -O2 -DEFFECT_CHAIN_LIB_SUFFIX=\"_host\"
+LOCAL_LDLIBS += -ldl
+
+include $(BUILD_HOST_SHARED_LIBRARY)
+
+# DBX, the dbx-tv library itself is dlopen'ed at runtime
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE := libdbx_host
+
+LOCAL_C_INCLUDES := \
+    $(EFFECT_HOST_C_INCLUDES) \
+    $(LOCAL_PATH)/../DBX \
+    $(LOCAL_PATH)/../Utility
+
+LOCAL_SRC_FILES := \
+    ../DBX/dbx.cpp \
+    ../Utility/AudioArena.c \
+    ../Utility/AudioSilence.c \
+    ../Utility/AudioBypass.c
+LOCAL_STATIC_LIBRARIES := libaudioeffect_hoststub
+
+LOCAL_CFLAGS += -O2
+LOCAL_LDLIBS += -ldl
+
+include $(BUILD_HOST_SHARED_LIBRARY)
+
+# VirtualX, libvx is dlopen'ed at runtime
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE := libvirtualx_host
+
+LOCAL_C_INCLUDES := \
+    $(EFFECT_HOST_C_INCLUDES) \
+    $(LOCAL_PATH)/../VirtualX \
+    $(LOCAL_PATH)/../Utility
+
+LOCAL_SRC_FILES := \
+    ../VirtualX/Virtualx.cpp \
+    ../Utility/ParamSnapshot.c \
+    ../Utility/AudioSilence.c \
+    ../Utility/AudioBypass.c
+LOCAL_STATIC_LIBRARIES := libaudioeffect_hoststub
+
+LOCAL_CFLAGS += -O2
+LOCAL_LDLIBS += -ldl
+
+include $(BUILD_HOST_SHARED_LIBRARY)
+
+# TruSurround, libsrs is dlopen'ed at runtime
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE := libsrswrapper_host
+
+LOCAL_C_INCLUDES := \
+    $(EFFECT_HOST_C_INCLUDES) \
+    $(LOCAL_PATH)/../TruSurround \
+    $(LOCAL_PATH)/../Utility
+
+LOCAL_SRC_FILES := \
+    ../TruSurround/tshd_wrapper.cpp \
+    ../Utility/AudioSilence.c \
+    ../Utility/AudioBypass.c
+LOCAL_STATIC_LIBRARIES := libaudioeffect_hoststub
+
+LOCAL_CFLAGS += -O2
+LOCAL_LDLIBS += -ldl
+
+include $(BUILD_HOST_SHARED_LIBRARY)
+
+# MS12 DAP, the dap_cpdp library is dlopen'ed at runtime
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE := libms12dapwrapper_host
+
+LOCAL_C_INCLUDES := \
+    $(EFFECT_HOST_C_INCLUDES) \
+    $(LOCAL_PATH)/../Ms12Dap \
+    $(LOCAL_PATH)/../Utility
+
+LOCAL_SRC_FILES := \
+    ../Ms12Dap/ms12_dap_wapper.cpp \
+    ../Utility/AudioFade.c \
+    ../Utility/ParamSnapshot.c \
+    ../Utility/AudioArena.c \
+    ../Utility/AudioSilence.c \
+    ../Utility/AudioBypass.c
+LOCAL_STATIC_LIBRARIES := libaudioeffect_hoststub
+
+LOCAL_CFLAGS += -O2
+LOCAL_LDLIBS += -ldl
+
+include $(BUILD_HOST_SHARED_LIBRARY)
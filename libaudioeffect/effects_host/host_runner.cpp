@@ -0,0 +1,614 @@
+/*
+ * Copyright (C) 2018 Amlogic Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *  DESCRIPTION:
+ *      Offline host runner for the libaudioeffect plugins.
+ *
+ *      The effect library is loaded through AUDIO_EFFECT_LIBRARY_INFO_SYM
+ *      exactly as AudioFlinger does (create_effect, EFFECT_CMD_INIT,
+ *      EFFECT_CMD_SET_CONFIG, EFFECT_CMD_ENABLE, process), a WAV or raw
+ *      PCM file is streamed through it in frameCount blocks and the cost
+ *      of process() is reported as ns/frame and real-time factor.
+ *
+ *      Example:
+ *        AudioEffectHostRunner -l out/host/linux-x86/lib64/libbalance_host.so \
+ *            -i music.wav -o music_out.wav -n 256 -p 0=10
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <dlfcn.h>
+#include <time.h>
+#include <unistd.h>
+#include <hardware/audio_effect.h>
+
+#ifdef LOG
+#undef LOG
+#endif
+#define LOG(x...) printf("[AudioEffectHost] " x)
+#define ERR(x...) fprintf(stderr, "[AudioEffectHost] " x)
+
+#define DEFAULT_FRAME_COUNT     256
+#define DEFAULT_SAMPLE_RATE     48000
+#define DEFAULT_CHANNELS        2
+#define MAX_PARAMS              32
+#define HOST_INI_ENV            "AUDIO_EFFECT_HOST_INI"
+
+#define WAV_FORMAT_PCM          1
+#define WAV_FORMAT_IEEE_FLOAT   3
+#define WAV_FORMAT_EXTENSIBLE   0xFFFE
+
+typedef struct effect_uuid_entry_s {
+    const char *name;
+    effect_uuid_t uuid;
+} effect_uuid_entry_t;
+
+// library name (audio_effect_library_t.name) -> effect UUID
+static const effect_uuid_entry_t gEffectUuids[] = {
+    {"Balance",          {0x6f33b3a0, 0x578e, 0x11e5, 0x892f, {0x00, 0x02, 0xa5, 0xd5, 0xc5, 0x1b}}},
+    {"TrebleBass",       {0x76733af0, 0x2889, 0x11e2, 0x81c1, {0x08, 0x00, 0x20, 0x0c, 0x9a, 0x66}}},
+    {"Geq",              {0x2e2a5fa6, 0xcae8, 0x45f5, 0xbb70, {0xa2, 0x9c, 0x1f, 0x30, 0x74, 0xb2}}},
+    {"Hpeq",             {0x049754aa, 0xc4cf, 0x439f, 0x897e, {0x37, 0xdd, 0x0c, 0x38, 0x11, 0x20}}},
+    {"Avl",              {0x08246a2a, 0xb2d3, 0x4621, 0xb804, {0x42, 0xc9, 0xb4, 0x78, 0xeb, 0x9d}}},
+    {"VirtualBass",      {0xa7eb1f3d, 0x2c99, 0x4664, 0x8593, {0x19, 0x40, 0x59, 0x51, 0xe3, 0x02}}},
+    {"DBX",              {0x07210842, 0x7432, 0x4624, 0x8b97, {0x35, 0xac, 0x87, 0x82, 0xef, 0xa3}}},
+    {"VirtualX",         {0x61821587, 0xce3c, 0x4aac, 0x9122, {0x86, 0xd8, 0x74, 0xea, 0x1f, 0xb1}}},
+    {"True Surround HD", {0x8a857720, 0x0209, 0x11e2, 0xa9d8, {0x00, 0x02, 0xa5, 0xd5, 0xc5, 0x1b}}},
+    {"MS12 DAP",         {0x86cafba6, 0x3ff3, 0x485d, 0xb8df, {0x0d, 0xe9, 0x6b, 0x34, 0xb2, 0x72}}},
+    {"Virtualsurround",  {0xc8459cd3, 0x4400, 0x4859, 0xb76b, {0xe1, 0x2c, 0xc2, 0xaa, 0x67, 0xce}}},
+    {"EffectChain",      {0x85190cc9, 0x0597, 0x416b, 0x8ebc, {0x78, 0x94, 0x12, 0x68, 0x4a, 0xaf}}},
+};
+
+typedef struct host_param_s {
+    uint32_t id;
+    int is_float;
+    union {
+        int32_t v;
+        float f;
+    };
+} host_param_t;
+
+typedef struct host_pcm_s {
+    void *data;
+    size_t frames;
+    uint32_t rate;
+    uint32_t channels;
+    audio_format_t format;
+} host_pcm_t;
+
+typedef struct host_options_s {
+    const char *lib_path;
+    const char *in_path;
+    const char *out_path;
+    const char *uuid_str;
+    const char *ini_path;
+    size_t frame_count;
+    int loops;
+    int in_place;
+    uint32_t rate;
+    uint32_t channels;
+    audio_format_t format;
+    host_param_t params[MAX_PARAMS];
+    int param_num;
+} host_options_t;
+
+static void PrintHelp(const char *name)
+{
+    LOG("Usage: %s -l <effect.so> -i <input.wav|input.raw> [options]\n", name);
+    LOG("  -o <file>        write processed audio (.wav gets a WAV header, otherwise raw)\n");
+    LOG("  -u <uuid>        effect UUID, default is looked up from the library name\n");
+    LOG("  -n <frames>      frameCount per process() call, default %d\n", DEFAULT_FRAME_COUNT);
+    LOG("  -r <rate>        raw input sample rate, default %d\n", DEFAULT_SAMPLE_RATE);
+    LOG("  -c <channels>    raw input channel count, default %d\n", DEFAULT_CHANNELS);
+    LOG("  -f <s16|float>   raw input sample format, default s16\n");
+    LOG("  -p <id>=<value>  EFFECT_CMD_SET_PARAM before processing, value with '.' is float\n");
+    LOG("  -I <file>        effect INI used in place of the tvconfig one\n");
+    LOG("  -R <loops>       stream the input this many times, default 1\n");
+    LOG("  -P               process in place (inBuffer == outBuffer) as the audio HAL does\n");
+}
+
+static int parse_uuid(const char *str, effect_uuid_t *uuid)
+{
+    unsigned int tmp[11];
+
+    if (sscanf(str, "%08x-%04x-%04x-%04x-%02x%02x%02x%02x%02x%02x",
+               &tmp[0], &tmp[1], &tmp[2], &tmp[3], &tmp[4], &tmp[5],
+               &tmp[6], &tmp[7], &tmp[8], &tmp[9]) < 10)
+        return -EINVAL;
+    uuid->timeLow = tmp[0];
+    uuid->timeMid = tmp[1];
+    uuid->timeHiAndVersion = tmp[2];
+    uuid->clockSeq = tmp[3];
+    for (int i = 0; i < 6; i++)
+        uuid->node[i] = tmp[4 + i];
+    return 0;
+}
+
+static audio_channel_mask_t channel_mask_from_count(uint32_t channels)
+{
+    switch (channels) {
+    case 1:
+        return AUDIO_CHANNEL_OUT_MONO;
+    case 2:
+        return AUDIO_CHANNEL_OUT_STEREO;
+    case 4:
+        return AUDIO_CHANNEL_OUT_QUAD;
+    case 6:
+        return AUDIO_CHANNEL_OUT_5POINT1;
+    case 8:
+        return AUDIO_CHANNEL_OUT_7POINT1;
+    default:
+        return 0;
+    }
+}
+
+static size_t sample_size(audio_format_t format)
+{
+    return format == AUDIO_FORMAT_PCM_16_BIT ? sizeof(int16_t) : sizeof(float);
+}
+
+//------------------------------ PCM file I/O --------------------------------
+
+static uint32_t rd_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t rd_le16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static void wr_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static void wr_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = v; p[1] = v >> 8;
+}
+
+static int read_file(const char *path, uint8_t **buf, size_t *size)
+{
+    FILE *fp = fopen(path, "rb");
+    long len;
+
+    if (fp == NULL) {
+        ERR("open %s failed: %s\n", path, strerror(errno));
+        return -errno;
+    }
+    fseek(fp, 0, SEEK_END);
+    len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    *buf = (uint8_t *)malloc(len > 0 ? len : 1);
+    if (*buf == NULL || fread(*buf, 1, len, fp) != (size_t)len) {
+        ERR("read %s failed\n", path);
+        fclose(fp);
+        free(*buf);
+        return -EIO;
+    }
+    fclose(fp);
+    *size = len;
+    return 0;
+}
+
+static int load_pcm(const host_options_t *opt, host_pcm_t *pcm)
+{
+    uint8_t *buf = NULL;
+    size_t size = 0;
+    size_t pos, data_off = 0, data_len = 0;
+    int fmt_found = 0;
+    int ret;
+
+    ret = read_file(opt->in_path, &buf, &size);
+    if (ret < 0)
+        return ret;
+
+    pcm->rate = opt->rate;
+    pcm->channels = opt->channels;
+    pcm->format = opt->format;
+
+    if (size >= 12 && !memcmp(buf, "RIFF", 4) && !memcmp(buf + 8, "WAVE", 4)) {
+        for (pos = 12; pos + 8 <= size; ) {
+            uint32_t chunk_len = rd_le32(buf + pos + 4);
+            const uint8_t *chunk = buf + pos + 8;
+
+            if (!memcmp(buf + pos, "fmt ", 4) && chunk_len >= 16) {
+                uint16_t tag = rd_le16(chunk);
+                uint16_t bits = rd_le16(chunk + 14);
+
+                if (tag == WAV_FORMAT_EXTENSIBLE && chunk_len >= 26)
+                    tag = rd_le16(chunk + 24);
+                pcm->channels = rd_le16(chunk + 2);
+                pcm->rate = rd_le32(chunk + 4);
+                if (tag == WAV_FORMAT_PCM && bits == 16) {
+                    pcm->format = AUDIO_FORMAT_PCM_16_BIT;
+                } else if (tag == WAV_FORMAT_IEEE_FLOAT && bits == 32) {
+                    pcm->format = AUDIO_FORMAT_PCM_FLOAT;
+                } else {
+                    ERR("unsupported WAV format tag %u, %u bits\n", tag, bits);
+                    free(buf);
+                    return -EINVAL;
+                }
+                fmt_found = 1;
+            } else if (!memcmp(buf + pos, "data", 4)) {
+                data_off = pos + 8;
+                data_len = chunk_len;
+                if (data_off + data_len > size)
+                    data_len = size - data_off;
+                break;
+            }
+            pos += 8 + chunk_len + (chunk_len & 1);
+        }
+        if (!fmt_found || data_off == 0) {
+            ERR("%s: malformed WAV file\n", opt->in_path);
+            free(buf);
+            return -EINVAL;
+        }
+    } else {
+        data_len = size;
+    }
+
+    if (pcm->channels == 0) {
+        free(buf);
+        return -EINVAL;
+    }
+    pcm->frames = data_len / (pcm->channels * sample_size(pcm->format));
+    pcm->data = malloc(data_len > 0 ? data_len : 1);
+    if (pcm->data == NULL) {
+        free(buf);
+        return -ENOMEM;
+    }
+    memcpy(pcm->data, buf + data_off, data_len);
+    free(buf);
+    return 0;
+}
+
+static int write_pcm(const char *path, const host_pcm_t *pcm)
+{
+    size_t len = pcm->frames * pcm->channels * sample_size(pcm->format);
+    size_t plen = strlen(path);
+    FILE *fp = fopen(path, "wb");
+
+    if (fp == NULL) {
+        ERR("open %s failed: %s\n", path, strerror(errno));
+        return -errno;
+    }
+    if (plen > 4 && !strcasecmp(path + plen - 4, ".wav")) {
+        uint8_t hdr[44];
+        uint32_t frame_size = pcm->channels * sample_size(pcm->format);
+
+        memcpy(hdr, "RIFF", 4);
+        wr_le32(hdr + 4, 36 + len);
+        memcpy(hdr + 8, "WAVEfmt ", 8);
+        wr_le32(hdr + 16, 16);
+        wr_le16(hdr + 20, pcm->format == AUDIO_FORMAT_PCM_16_BIT ? WAV_FORMAT_PCM : WAV_FORMAT_IEEE_FLOAT);
+        wr_le16(hdr + 22, pcm->channels);
+        wr_le32(hdr + 24, pcm->rate);
+        wr_le32(hdr + 28, pcm->rate * frame_size);
+        wr_le16(hdr + 32, frame_size);
+        wr_le16(hdr + 34, sample_size(pcm->format) * 8);
+        memcpy(hdr + 36, "data", 4);
+        wr_le32(hdr + 40, len);
+        fwrite(hdr, 1, sizeof(hdr), fp);
+    }
+    fwrite(pcm->data, 1, len, fp);
+    fclose(fp);
+    return 0;
+}
+
+// convert in place to the format the effect accepted in EFFECT_CMD_SET_CONFIG
+static int convert_pcm(host_pcm_t *pcm, audio_format_t format)
+{
+    size_t samples = pcm->frames * pcm->channels;
+    size_t i;
+
+    if (pcm->format == format)
+        return 0;
+
+    if (format == AUDIO_FORMAT_PCM_FLOAT) {
+        float *dst = (float *)malloc(samples * sizeof(float) + 1);
+        const int16_t *src = (const int16_t *)pcm->data;
+
+        if (dst == NULL)
+            return -ENOMEM;
+        for (i = 0; i < samples; i++)
+            dst[i] = src[i] * (1.0f / 32768.0f);
+        free(pcm->data);
+        pcm->data = dst;
+    } else {
+        int16_t *dst = (int16_t *)pcm->data;
+        const float *src = (const float *)pcm->data;
+
+        for (i = 0; i < samples; i++) {
+            float f = src[i] * 32768.0f;
+            dst[i] = f >= 32767.0f ? 32767 : (f <= -32768.0f ? -32768 : (int16_t)f);
+        }
+    }
+    pcm->format = format;
+    return 0;
+}
+
+//---------------------------- Effect control --------------------------------
+
+static int effect_command(effect_handle_t handle, uint32_t cmd, uint32_t size, void *data)
+{
+    int reply = 0;
+    uint32_t reply_size = sizeof(reply);
+    int ret;
+
+    ret = (*handle)->command(handle, cmd, size, data, &reply_size, &reply);
+    if (ret < 0)
+        return ret;
+    return reply;
+}
+
+static int effect_set_param(effect_handle_t handle, const host_param_t *param)
+{
+    uint32_t buf[(sizeof(effect_param_t) + 2 * sizeof(uint32_t)) / sizeof(uint32_t)];
+    effect_param_t *p = (effect_param_t *)buf;
+
+    p->status = 0;
+    p->psize = sizeof(uint32_t);
+    p->vsize = sizeof(uint32_t);
+    memcpy(p->data, &param->id, sizeof(uint32_t));
+    memcpy(p->data + sizeof(uint32_t), &param->v, sizeof(uint32_t));
+    return effect_command(handle, EFFECT_CMD_SET_PARAM, sizeof(buf), p);
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int parse_options(int argc, char **argv, host_options_t *opt)
+{
+    int c;
+
+    memset(opt, 0, sizeof(*opt));
+    opt->frame_count = DEFAULT_FRAME_COUNT;
+    opt->rate = DEFAULT_SAMPLE_RATE;
+    opt->channels = DEFAULT_CHANNELS;
+    opt->format = AUDIO_FORMAT_PCM_16_BIT;
+    opt->loops = 1;
+
+    while ((c = getopt(argc, argv, "l:i:o:u:n:r:c:f:p:I:R:Ph")) != -1) {
+        switch (c) {
+        case 'l':
+            opt->lib_path = optarg;
+            break;
+        case 'i':
+            opt->in_path = optarg;
+            break;
+        case 'o':
+            opt->out_path = optarg;
+            break;
+        case 'u':
+            opt->uuid_str = optarg;
+            break;
+        case 'n':
+            opt->frame_count = strtoul(optarg, NULL, 0);
+            break;
+        case 'r':
+            opt->rate = strtoul(optarg, NULL, 0);
+            break;
+        case 'c':
+            opt->channels = strtoul(optarg, NULL, 0);
+            break;
+        case 'f':
+            opt->format = strcmp(optarg, "float") ? AUDIO_FORMAT_PCM_16_BIT : AUDIO_FORMAT_PCM_FLOAT;
+            break;
+        case 'p': {
+            host_param_t *param = &opt->params[opt->param_num];
+            const char *value = strchr(optarg, '=');
+
+            if (opt->param_num >= MAX_PARAMS || value == NULL)
+                return -EINVAL;
+            param->id = strtoul(optarg, NULL, 0);
+            param->is_float = strchr(value, '.') != NULL;
+            if (param->is_float)
+                param->f = strtof(value + 1, NULL);
+            else
+                param->v = strtol(value + 1, NULL, 0);
+            opt->param_num++;
+            break;
+        }
+        case 'I':
+            opt->ini_path = optarg;
+            break;
+        case 'R':
+            opt->loops = atoi(optarg);
+            break;
+        case 'P':
+            opt->in_place = 1;
+            break;
+        default:
+            return -EINVAL;
+        }
+    }
+    if (opt->lib_path == NULL || opt->in_path == NULL || opt->frame_count == 0 || opt->loops <= 0)
+        return -EINVAL;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    host_options_t opt;
+    host_pcm_t pcm, out;
+    audio_effect_library_t *lib;
+    effect_handle_t handle = NULL;
+    effect_config_t config;
+    effect_uuid_t uuid;
+    void *dl;
+    uint8_t *block_in, *block_out;
+    size_t frame_size, pos, frames, blocks = 0;
+    int64_t t, total_ns = 0, max_ns = 0;
+    int ret, i, loop;
+
+    if (parse_options(argc, argv, &opt) < 0) {
+        PrintHelp(argv[0]);
+        return 1;
+    }
+    if (opt.ini_path)
+        setenv(HOST_INI_ENV, opt.ini_path, 1);
+
+    memset(&pcm, 0, sizeof(pcm));
+    if (load_pcm(&opt, &pcm) < 0)
+        return 1;
+    if (channel_mask_from_count(pcm.channels) == 0) {
+        ERR("unsupported channel count %u\n", pcm.channels);
+        return 1;
+    }
+
+    dl = dlopen(opt.lib_path, RTLD_NOW);
+    if (dl == NULL) {
+        ERR("dlopen %s failed: %s\n", opt.lib_path, dlerror());
+        return 1;
+    }
+    lib = (audio_effect_library_t *)dlsym(dl, AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR);
+    if (lib == NULL || lib->tag != AUDIO_EFFECT_LIBRARY_TAG) {
+        ERR("%s: no valid %s symbol\n", opt.lib_path, AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR);
+        return 1;
+    }
+
+    if (opt.uuid_str) {
+        if (parse_uuid(opt.uuid_str, &uuid) < 0) {
+            ERR("bad uuid %s\n", opt.uuid_str);
+            return 1;
+        }
+    } else {
+        for (i = 0; i < (int)(sizeof(gEffectUuids) / sizeof(gEffectUuids[0])); i++) {
+            if (!strcmp(lib->name, gEffectUuids[i].name))
+                break;
+        }
+        if (i == (int)(sizeof(gEffectUuids) / sizeof(gEffectUuids[0]))) {
+            ERR("unknown library \"%s\", pass the effect uuid with -u\n", lib->name);
+            return 1;
+        }
+        uuid = gEffectUuids[i].uuid;
+    }
+
+    ret = lib->create_effect(&uuid, 0, 0, &handle);
+    if (ret < 0 || handle == NULL) {
+        ERR("create_effect failed: %d\n", ret);
+        return 1;
+    }
+
+    memset(&config, 0, sizeof(config));
+    config.inputCfg.samplingRate = config.outputCfg.samplingRate = pcm.rate;
+    config.inputCfg.channels = config.outputCfg.channels = channel_mask_from_count(pcm.channels);
+    config.inputCfg.format = config.outputCfg.format = pcm.format;
+    config.inputCfg.accessMode = EFFECT_BUFFER_ACCESS_READ;
+    config.outputCfg.accessMode = EFFECT_BUFFER_ACCESS_WRITE;
+    config.inputCfg.mask = config.outputCfg.mask = EFFECT_CONFIG_ALL;
+
+    if ((ret = effect_command(handle, EFFECT_CMD_INIT, 0, NULL)) != 0 ||
+        (ret = effect_command(handle, EFFECT_CMD_SET_CONFIG, sizeof(config), &config)) != 0) {
+        ERR("effect init/config failed: %d\n", ret);
+        return 1;
+    }
+    // effects rewrite unsupported configs in place (most force stereo 16 bit)
+    if (audio_channel_count_from_out_mask(config.inputCfg.channels) != pcm.channels) {
+        ERR("effect only accepts channel mask 0x%x, input has %u channels\n",
+            config.inputCfg.channels, pcm.channels);
+        return 1;
+    }
+    if (config.inputCfg.format != pcm.format) {
+        LOG("effect forced format 0x%x, converting input\n", config.inputCfg.format);
+        if (convert_pcm(&pcm, (audio_format_t)config.inputCfg.format) < 0)
+            return 1;
+    }
+    for (i = 0; i < opt.param_num; i++) {
+        ret = effect_set_param(handle, &opt.params[i]);
+        if (ret != 0)
+            ERR("set param %u failed: %d\n", opt.params[i].id, ret);
+    }
+    if ((ret = effect_command(handle, EFFECT_CMD_ENABLE, 0, NULL)) != 0) {
+        ERR("effect enable failed: %d\n", ret);
+        return 1;
+    }
+
+    frame_size = pcm.channels * sample_size(pcm.format);
+    out = pcm;
+    out.data = calloc(pcm.frames ? pcm.frames : 1, frame_size);
+    block_in = (uint8_t *)calloc(opt.frame_count, frame_size);
+    block_out = opt.in_place ? block_in : (uint8_t *)calloc(opt.frame_count, frame_size);
+    if (out.data == NULL || block_in == NULL || block_out == NULL) {
+        ERR("no memory\n");
+        return 1;
+    }
+
+    // I/O stays outside the timed region: each block is staged in a fixed
+    // buffer, as the mixer thread would hand it over, then processed.
+    for (loop = 0; loop < opt.loops; loop++) {
+        for (pos = 0; pos < pcm.frames; pos += opt.frame_count) {
+            audio_buffer_t inBuf, outBuf;
+
+            frames = pcm.frames - pos < opt.frame_count ? pcm.frames - pos : opt.frame_count;
+            memset(block_in, 0, opt.frame_count * frame_size);
+            memcpy(block_in, (uint8_t *)pcm.data + pos * frame_size, frames * frame_size);
+            inBuf.frameCount = outBuf.frameCount = opt.frame_count;
+            inBuf.raw = block_in;
+            outBuf.raw = block_out;
+
+            t = now_ns();
+            ret = (*handle)->process(handle, &inBuf, &outBuf);
+            t = now_ns() - t;
+            if (ret < 0 && ret != -ENODATA) {
+                ERR("process failed at frame %zu: %d\n", pos, ret);
+                return 1;
+            }
+            total_ns += t;
+            if (t > max_ns)
+                max_ns = t;
+            blocks++;
+            if (loop == 0)
+                memcpy((uint8_t *)out.data + pos * frame_size, block_out, frames * frame_size);
+        }
+    }
+
+    frames = blocks * opt.frame_count;
+    LOG("effect      : %s (%s)\n", lib->name, lib->implementor);
+    LOG("input       : %zu frames, %u Hz, %u ch, %s\n", pcm.frames, pcm.rate, pcm.channels,
+        pcm.format == AUDIO_FORMAT_PCM_16_BIT ? "s16" : "float");
+    LOG("blocks      : %zu x %zu frames%s\n", blocks, opt.frame_count, opt.in_place ? " (in place)" : "");
+    LOG("total       : %.3f ms\n", total_ns / 1e6);
+    LOG("ns/frame    : %.2f\n", frames ? (double)total_ns / frames : 0.0);
+    LOG("max block   : %.3f us (budget %.3f us)\n", max_ns / 1e3, opt.frame_count * 1e6 / pcm.rate);
+    // real-time factor: processing time over audio time, 1.0 means one full core
+    LOG("RTF         : %.6f\n", frames ? (total_ns / 1e9) / ((double)frames / pcm.rate) : 0.0);
+
+    effect_command(handle, EFFECT_CMD_DISABLE, 0, NULL);
+    lib->release_effect(handle);
+
+    if (opt.out_path)
+        write_pcm(opt.out_path, &out);
+
+    if (!opt.in_place)
+        free(block_out);
+    free(block_in);
+    free(out.data);
+    free(pcm.data);
+    dlclose(dl);
+    return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2018 Amlogic Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *  DESCRIPTION:
+ *      Host implementation of the Android pieces used by the effect
+ *      libraries: logging, system properties and the tvconfig IniParser.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+
+#include <cutils/log.h>
+#include <cutils/properties.h>
+
+#include "IniParser.h"
+
+#define HOST_INI_ENV      "AUDIO_EFFECT_HOST_INI"
+#define HOST_LOG_ENV      "AUDIO_EFFECT_HOST_LOG"
+#define EFFECT_INI_KEY    "AMLOGIC_AUDIO_EFFECT_INI_PATH"
+
+//-------------------------------- Logging -----------------------------------
+
+static int host_log_level(void)
+{
+    static int level = -1;
+    const char *env;
+
+    if (level < 0) {
+        env = getenv(HOST_LOG_ENV);
+        // warnings and errors only unless asked for more
+        level = env ? atoi(env) : ANDROID_LOG_WARN;
+    }
+    return level;
+}
+
+extern "C" int __android_log_print(int prio, const char *tag, const char *fmt, ...)
+{
+    static const char prio_char[] = "??VDIWE";
+    va_list ap;
+
+    if (prio < host_log_level())
+        return 0;
+
+    fprintf(stderr, "%c/%s: ", (prio >= 0 && prio <= ANDROID_LOG_ERROR) ? prio_char[prio] : '?',
+            tag ? tag : "");
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    if (fmt[0] == '\0' || fmt[strlen(fmt) - 1] != '\n')
+        fputc('\n', stderr);
+    return 0;
+}
+
+//------------------------------- Properties ---------------------------------
+
+static void property_env_name(const char *key, char *name, size_t size)
+{
+    size_t i;
+
+    for (i = 0; key[i] != '\0' && i + 1 < size; i++)
+        name[i] = (key[i] == '.') ? '_' : key[i];
+    name[i] = '\0';
+}
+
+extern "C" int property_get(const char *key, char *value, const char *default_value)
+{
+    char name[PROPERTY_KEY_MAX * 2];
+    const char *env;
+
+    property_env_name(key, name, sizeof(name));
+    env = getenv(name);
+    if (env == NULL)
+        env = default_value;
+    if (env == NULL) {
+        value[0] = '\0';
+        return -1;
+    }
+    snprintf(value, PROPERTY_VALUE_MAX, "%s", env);
+    return strlen(value);
+}
+
+extern "C" int property_set(const char *key, const char *value)
+{
+    char name[PROPERTY_KEY_MAX * 2];
+
+    property_env_name(key, name, sizeof(name));
+    return setenv(name, value, 1);
+}
+
+//-------------------------------- IniParser ---------------------------------
+
+static char *ini_trim(char *str)
+{
+    char *end;
+
+    while (*str == ' ' || *str == '\t')
+        str++;
+    end = str + strlen(str);
+    while (end > str && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n'))
+        *--end = '\0';
+    return str;
+}
+
+int IniParser::parse(const char *filename)
+{
+    char line[4096];
+    std::string section;
+    FILE *fp;
+
+    mValues.clear();
+    fp = fopen(filename, "r");
+    if (fp == NULL) {
+        // missing tvconfig file on host: behave as an empty INI so that
+        // the AMLOGIC_AUDIO_EFFECT_INI_PATH lookup falls through to HOST_INI_ENV
+        return getenv(HOST_INI_ENV) ? 0 : -1;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        char *p = ini_trim(line);
+        char *eq;
+
+        if (*p == '\0' || *p == '#' || *p == ';')
+            continue;
+        if (*p == '[') {
+            char *close = strchr(p, ']');
+            if (close) {
+                *close = '\0';
+                section = ini_trim(p + 1);
+            }
+            continue;
+        }
+        eq = strchr(p, '=');
+        if (eq == NULL)
+            continue;
+        *eq = '\0';
+        mValues[section + "|" + ini_trim(p)] = ini_trim(eq + 1);
+    }
+    fclose(fp);
+    return 0;
+}
+
+const char *IniParser::GetString(const char *section, const char *key, const char *def_value)
+{
+    std::map<std::string, std::string>::const_iterator it;
+
+    it = mValues.find(std::string(section) + "|" + key);
+    if (it != mValues.end())
+        return it->second.c_str();
+    if (strcmp(key, EFFECT_INI_KEY) == 0 && getenv(HOST_INI_ENV))
+        return getenv(HOST_INI_ENV);
+    return def_value;
+}
+
+int IniParser::GetInt(const char *section, const char *key, int def_value)
+{
+    const char *value = GetString(section, key, NULL);
+
+    return value ? (int)strtol(value, NULL, 0) : def_value;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2018 Amlogic Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *  DESCRIPTION:
+ *      Host replacement for the tvconfig IniParser. Only the calls made by
+ *      the effect libraries are provided.
+ *
+ *      The /vendor/etc/tvconfig files do not exist on a build box, so when
+ *      AUDIO_EFFECT_HOST_INI is set:
+ *        - parse() of a missing file succeeds with no content, and
+ *        - the AMLOGIC_AUDIO_EFFECT_INI_PATH lookup returns that file,
+ *      which sends every effect straight to the given effect INI.
+ *
+ */
+
+#ifndef _AUDIO_EFFECT_HOST_INIPARSER_H_
+#define _AUDIO_EFFECT_HOST_INIPARSER_H_
+
+#include <map>
+#include <string>
+
+class IniParser {
+public:
+    IniParser() {}
+    ~IniParser() {}
+
+    int parse(const char *filename);
+    const char *GetString(const char *section, const char *key, const char *def_value);
+    int GetInt(const char *section, const char *key, int def_value);
+
+private:
+    std::map<std::string, std::string> mValues;
+};
+
+#endif
@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2018 Amlogic Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *  DESCRIPTION:
+ *      Host replacement for <utils/CallStack.h>. Nothing is dumped on host.
+ *
+ */
+
+#ifndef _AUDIO_EFFECT_HOST_UTILS_CALLSTACK_H_
+#define _AUDIO_EFFECT_HOST_UTILS_CALLSTACK_H_
+
+namespace android {
+
+class CallStack {
+public:
+    void update() {}
+    void log(const char *) {}
+};
+
+} // namespace android
+
+#endif
@@ -40,4 +40,27 @@ LOCAL_SHARED_LIBRARIES := \
     libmedia_helper \
     libmediaplayerservice \
 
-include $(BUILD_EXECUTABLE)
\ No newline at end of file
+include $(BUILD_EXECUTABLE)
+
+#for biquad cascade benchmark
+include $(CLEAR_VARS)
+
+LOCAL_ARM_MODE := arm
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE    := AudioBiquadBench
+
+LOCAL_SRC_FILES := \
+    biquad_bench.cpp \
+    ../Utility/AudioBiquad.c
+
+LOCAL_SHARED_LIBRARIES := \
+    libcutils \
+    liblog \
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/../Utility \
+
+LOCAL_CFLAGS += -O2
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2018 Amlogic Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *  DESCRIPTION:
+ *      Benchmark of the Utility biquad cascade.
+ *
+ *      Every stage/channel/layout combination is run through AudioBiquad
+ *      and through a plain one stage at a time loop, on the same random
+ *      input in frameCount blocks. The cost is reported as ns per biquad
+ *      and sample, with the largest difference between the two outputs.
+ *
+ *      Example:
+ *        AudioBiquadBench -n 256 -s 9 -c 2
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "AudioBiquad.h"
+
+#ifdef LOG
+#undef LOG
+#endif
+#define LOG(x...) printf("[AudioBiquadBench] " x)
+
+#define DEFAULT_FRAME_COUNT     256
+#define DEFAULT_SECONDS         10
+#define SAMPLE_RATE             48000
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void PrintHelp(const char *name)
+{
+    LOG("Usage: %s [-n frameCount] [-s stages] [-c channels] [-t seconds]\n", name);
+    LOG("    -n  frames per block, default %d\n", DEFAULT_FRAME_COUNT);
+    LOG("    -s  only this number of stages, default 1, 2, 4, 9 and 16\n");
+    LOG("    -c  only this number of channels, default 1, 2, 6 and 8\n");
+    LOG("    -t  seconds of audio per run, default %d\n", DEFAULT_SECONDS);
+}
+
+// what the cascade does, one stage of one channel at a time
+static void reference_process(AudioBiquad_t *pBiquad, float *buf, size_t frames)
+{
+    int ch, i;
+    size_t n;
+
+    for (ch = 0; ch < pBiquad->channels; ch++) {
+        for (i = 0; i < pBiquad->stages; i++) {
+            const AudioBiquadCoef_t *c = &pBiquad->coef[i];
+            float z1 = pBiquad->s1[i][ch], z2 = pBiquad->s2[i][ch];
+            float *p = buf + ch;
+            for (n = 0; n < frames; n++, p += pBiquad->channels) {
+                float x = *p, y = c->b0 * x + z1;
+                z1 = c->b1 * x - c->a1 * y + z2;
+                z2 = c->b2 * x - c->a2 * y;
+                *p = y;
+            }
+            pBiquad->s1[i][ch] = z1;
+            pBiquad->s2[i][ch] = z2;
+        }
+    }
+}
+
+static void design_stages(AudioBiquad_t *pBiquad, int stages, int channels)
+{
+    AudioBiquadCoef_t coef;
+    int i;
+
+    AudioBiquadInit(pBiquad, stages, channels);
+    for (i = 0; i < stages; i++) {
+        // a graphic EQ like spread of boosts and cuts
+        AudioBiquadDesign(&coef, AUDIO_BIQUAD_PEAK, SAMPLE_RATE,
+                (float)(40.0 * pow(1.6, i)), 1.4f, (i % 2) ? -6.0f : 6.0f);
+        AudioBiquadSetCoef(pBiquad, i, &coef);
+    }
+}
+
+static void run(int stages, int channels, int planar, size_t frameCount, size_t total)
+{
+    AudioBiquad_t bq, ref;
+    float *in, *out, *expect, *plane;
+    const float *pin[AUDIO_BIQUAD_MAX_CHANNELS];
+    float *pout[AUDIO_BIQUAD_MAX_CHANNELS];
+    size_t pos, n, i, samples = total * channels;
+    int64_t t, bq_ns = 0, ref_ns = 0;
+    double diff, max_diff = 0.0, ops;
+    int ch;
+
+    in = (float *)malloc(samples * sizeof(float));
+    out = (float *)malloc(samples * sizeof(float));
+    expect = (float *)malloc(samples * sizeof(float));
+    plane = (float *)malloc(frameCount * channels * sizeof(float));
+    if (!in || !out || !expect || !plane) {
+        LOG("alloc failed\n");
+        goto exit;
+    }
+    srand(1);
+    for (i = 0; i < samples; i++)
+        in[i] = (float)rand() / RAND_MAX - 0.5f;
+    memcpy(expect, in, samples * sizeof(float));
+    // fault the output pages in outside of the timing
+    memset(out, 0, samples * sizeof(float));
+
+    design_stages(&bq, stages, channels);
+    ref = bq;
+    for (pos = 0; pos < total; pos += n) {
+        n = total - pos < frameCount ? total - pos : frameCount;
+        if (planar) {
+            // planes of the block, deinterleaving is not timed
+            for (ch = 0; ch < channels; ch++) {
+                for (i = 0; i < n; i++)
+                    plane[ch * n + i] = in[(pos + i) * channels + ch];
+                pin[ch] = pout[ch] = plane + ch * n;
+            }
+            t = now_ns();
+            AudioBiquadProcessPlanar(&bq, pin, pout, n);
+            bq_ns += now_ns() - t;
+            for (ch = 0; ch < channels; ch++) {
+                for (i = 0; i < n; i++)
+                    out[(pos + i) * channels + ch] = plane[ch * n + i];
+            }
+        } else {
+            t = now_ns();
+            AudioBiquadProcess(&bq, in + pos * channels, out + pos * channels, n);
+            bq_ns += now_ns() - t;
+        }
+        t = now_ns();
+        reference_process(&ref, expect + pos * channels, n);
+        ref_ns += now_ns() - t;
+        // same denormal flush as the cascade
+        for (i = 0; i < (size_t)stages; i++) {
+            for (ch = 0; ch < channels; ch++) {
+                if (fabsf(ref.s1[i][ch]) < 1e-20f)
+                    ref.s1[i][ch] = 0.0f;
+                if (fabsf(ref.s2[i][ch]) < 1e-20f)
+                    ref.s2[i][ch] = 0.0f;
+            }
+        }
+    }
+    for (i = 0; i < samples; i++) {
+        diff = fabs(out[i] - expect[i]);
+        if (diff > max_diff)
+            max_diff = diff;
+    }
+
+    ops = (double)samples * stages;
+    LOG("%2d stages %d ch %-11s %6.2f ns/biquad (ref %6.2f) x%.2f  max diff %g\n",
+            stages, channels, planar ? "planar" : "interleaved",
+            bq_ns / ops, ref_ns / ops, bq_ns > 0 ? (double)ref_ns / bq_ns : 0.0, max_diff);
+
+exit:
+    free(in);
+    free(out);
+    free(expect);
+    free(plane);
+}
+
+int main(int argc, char **argv)
+{
+    static const int all_stages[] = {1, 2, 4, 9, 16};
+    static const int all_channels[] = {1, 2, 6, 8};
+    size_t frameCount = DEFAULT_FRAME_COUNT;
+    int seconds = DEFAULT_SECONDS, stages = 0, channels = 0;
+    int opt, i, j, planar;
+
+    while ((opt = getopt(argc, argv, "n:s:c:t:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            frameCount = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            stages = atoi(optarg);
+            break;
+        case 'c':
+            channels = atoi(optarg);
+            break;
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        default:
+            PrintHelp(argv[0]);
+            return 1;
+        }
+    }
+    if (frameCount == 0 || seconds <= 0 ||
+            stages < 0 || stages > AUDIO_BIQUAD_MAX_STAGES ||
+            channels < 0 || channels > AUDIO_BIQUAD_MAX_CHANNELS) {
+        PrintHelp(argv[0]);
+        return 1;
+    }
+
+    LOG("%zu frames per block, %d s at %d Hz\n", frameCount, seconds, SAMPLE_RATE);
+    for (i = 0; i < (int)(sizeof(all_stages) / sizeof(all_stages[0])); i++) {
+        if (stages && i > 0)
+            break;
+        for (j = 0; j < (int)(sizeof(all_channels) / sizeof(all_channels[0])); j++) {
+            if (channels && j > 0)
+                break;
+            for (planar = 0; planar < 2; planar++) {
+                run(stages ? stages : all_stages[i], channels ? channels : all_channels[j],
+                        planar, frameCount, (size_t)seconds * SAMPLE_RATE);
+            }
+        }
+    }
+
+    return 0;
+}